@@ -0,0 +1,207 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <type_traits>
+
+#include <Windows.h>
+
+// Maps handles to object pointers. find can be called from any thread without a lock, while insert, erase and
+// synchronize must be serialized by the caller.
+// Readers are tracked with a two-phase epoch: synchronize returns only after every find that could have read the
+// previous state of the map has finished. Replaced tables are freed only after synchronize, and callers must call
+// synchronize between erasing a key and destroying the object it mapped to.
+template <typename Key, typename Value>
+class ConcurrentHandleMap
+{
+public:
+	ConcurrentHandleMap() : m_table(new Table(MIN_SLOT_BITS))
+	{
+	}
+
+	~ConcurrentHandleMap()
+	{
+		delete m_table.load(std::memory_order_relaxed);
+	}
+
+	ConcurrentHandleMap(const ConcurrentHandleMap&) = delete;
+	ConcurrentHandleMap& operator=(const ConcurrentHandleMap&) = delete;
+
+	bool erase(Key key)
+	{
+		auto& slot = m_table.load(std::memory_order_relaxed)->findSlot(key);
+		if (key != slot.key.load(std::memory_order_relaxed) || !slot.value.load(std::memory_order_relaxed))
+		{
+			return false;
+		}
+		slot.value.store(nullptr, std::memory_order_release);
+		return true;
+	}
+
+	Value* find(Key key) const
+	{
+		ReadScope readScope(*this);
+		auto table = m_table.load(std::memory_order_acquire);
+		const auto& slot = table->findSlot(key);
+		return key == slot.key.load(std::memory_order_acquire) ? slot.value.load(std::memory_order_acquire) : nullptr;
+	}
+
+	void insert(Key key, Value* value)
+	{
+		auto table = m_table.load(std::memory_order_relaxed);
+		auto slot = &table->findSlot(key);
+		if (key == slot->key.load(std::memory_order_relaxed))
+		{
+			slot->value.store(value, std::memory_order_release);
+			return;
+		}
+
+		if ((m_usedSlotCount + 1) * 2 > table->slotCount)
+		{
+			table = rebuild();
+			slot = &table->findSlot(key);
+		}
+
+		slot->value.store(value, std::memory_order_relaxed);
+		slot->key.store(key, std::memory_order_release);
+		++m_usedSlotCount;
+	}
+
+	void synchronize()
+	{
+		const UINT epoch = m_epoch.fetch_add(1);
+		while (0 != m_readerCounts[epoch & 1].load())
+		{
+			std::this_thread::yield();
+		}
+	}
+
+private:
+	static const UINT MIN_SLOT_BITS = 6;
+
+	struct Slot
+	{
+		std::atomic<Key> key{};
+		std::atomic<Value*> value{};
+	};
+
+	struct Table
+	{
+		Table(UINT slotBits)
+			: slots(new Slot[std::size_t(1) << slotBits])
+			, slotCount(std::size_t(1) << slotBits)
+			, shift(32 - slotBits)
+		{
+		}
+
+		// Erased keys stay in their slots until the next rebuild, so probing never needs to move entries that
+		// concurrent readers may be passing over. The load factor keeps at least one empty slot to end each probe.
+		Slot& findSlot(Key key) const
+		{
+			const std::size_t mask = slotCount - 1;
+			std::size_t i = getHomeSlot(key);
+			while (true)
+			{
+				const Key slotKey = slots[i].key.load(std::memory_order_acquire);
+				if (slotKey == key || Key{} == slotKey)
+				{
+					return slots[i];
+				}
+				i = (i + 1) & mask;
+			}
+		}
+
+		std::size_t getHomeSlot(Key key) const
+		{
+			UINT value = 0;
+			if constexpr (std::is_pointer_v<Key>)
+			{
+				value = static_cast<UINT>(reinterpret_cast<UINT_PTR>(key));
+			}
+			else
+			{
+				value = static_cast<UINT>(key);
+			}
+			return (value * 0x9E3779B9) >> shift;
+		}
+
+		std::unique_ptr<Slot[]> slots;
+		std::size_t slotCount;
+		UINT shift;
+	};
+
+	class ReadScope
+	{
+	public:
+		ReadScope(const ConcurrentHandleMap& map) : m_readerCount(map.enterRead())
+		{
+		}
+
+		~ReadScope()
+		{
+			m_readerCount.fetch_sub(1, std::memory_order_release);
+		}
+
+	private:
+		std::atomic<UINT>& m_readerCount;
+	};
+
+	std::atomic<UINT>& enterRead() const
+	{
+		while (true)
+		{
+			const UINT epoch = m_epoch.load();
+			auto& readerCount = m_readerCounts[epoch & 1];
+			readerCount.fetch_add(1);
+			if (epoch == m_epoch.load())
+			{
+				return readerCount;
+			}
+			readerCount.fetch_sub(1);
+		}
+	}
+
+	Table* rebuild()
+	{
+		auto oldTable = m_table.load(std::memory_order_relaxed);
+		std::size_t liveCount = 0;
+		for (std::size_t i = 0; i < oldTable->slotCount; ++i)
+		{
+			if (oldTable->slots[i].value.load(std::memory_order_relaxed))
+			{
+				++liveCount;
+			}
+		}
+
+		UINT slotBits = MIN_SLOT_BITS;
+		while ((liveCount + 1) * 4 > (std::size_t(1) << slotBits))
+		{
+			++slotBits;
+		}
+
+		auto newTable = new Table(slotBits);
+		for (std::size_t i = 0; i < oldTable->slotCount; ++i)
+		{
+			auto value = oldTable->slots[i].value.load(std::memory_order_relaxed);
+			if (value)
+			{
+				const Key key = oldTable->slots[i].key.load(std::memory_order_relaxed);
+				auto& slot = newTable->findSlot(key);
+				slot.key.store(key, std::memory_order_relaxed);
+				slot.value.store(value, std::memory_order_relaxed);
+			}
+		}
+
+		m_table.store(newTable, std::memory_order_release);
+		m_usedSlotCount = liveCount;
+		synchronize();
+		delete oldTable;
+		return newTable;
+	}
+
+	std::atomic<Table*> m_table;
+	std::size_t m_usedSlotCount = 0;
+	mutable std::atomic<UINT> m_epoch = 0;
+	mutable std::atomic<UINT> m_readerCounts[2] = {};
+};
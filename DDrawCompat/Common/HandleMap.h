@@ -0,0 +1,197 @@
+#pragma once
+
+#include <memory>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <Windows.h>
+
+template <typename Key, typename Value>
+class HandleMap
+{
+public:
+	typedef std::pair<const Key, Value> value_type;
+
+	class iterator
+	{
+	public:
+		iterator(const HandleMap* map = nullptr, std::size_t index = 0) : m_map(map), m_index(index) {}
+
+		value_type& operator*() const { return *m_map->m_entries[m_index]; }
+		value_type* operator->() const { return m_map->m_entries[m_index].get(); }
+		iterator& operator++() { ++m_index; return *this; }
+		bool operator==(const iterator& other) const { return m_index == other.m_index; }
+		bool operator!=(const iterator& other) const { return m_index != other.m_index; }
+
+	private:
+		friend class HandleMap;
+
+		const HandleMap* m_map;
+		std::size_t m_index;
+	};
+
+	typedef iterator const_iterator;
+
+	HandleMap() : m_slots(MIN_SLOT_COUNT), m_shift(32 - MIN_SLOT_BITS)
+	{
+	}
+
+	HandleMap(const HandleMap&) = delete;
+	HandleMap& operator=(const HandleMap&) = delete;
+
+	iterator begin() const { return iterator(this, 0); }
+	iterator end() const { return iterator(this, m_entries.size()); }
+	bool empty() const { return m_entries.empty(); }
+	std::size_t size() const { return m_entries.size(); }
+
+	void clear()
+	{
+		m_entries.clear();
+		m_slots.assign(MIN_SLOT_COUNT, {});
+		m_shift = 32 - MIN_SLOT_BITS;
+	}
+
+	template <typename... Args>
+	std::pair<iterator, bool> emplace(Key key, Args&&... args)
+	{
+		return try_emplace(key, std::forward<Args>(args)...);
+	}
+
+	std::size_t erase(Key key)
+	{
+		const std::size_t slotIndex = findSlot(key);
+		if (0 == m_slots[slotIndex].entryIndex)
+		{
+			return 0;
+		}
+		eraseSlot(slotIndex);
+		return 1;
+	}
+
+	iterator erase(iterator it)
+	{
+		const std::size_t index = it.m_index;
+		eraseSlot(findSlot(m_entries[index]->first));
+		return iterator(this, index);
+	}
+
+	iterator find(Key key) const
+	{
+		const auto& slot = m_slots[findSlot(key)];
+		return 0 != slot.entryIndex ? iterator(this, slot.entryIndex - 1) : end();
+	}
+
+	template <typename... Args>
+	std::pair<iterator, bool> try_emplace(Key key, Args&&... args)
+	{
+		std::size_t slotIndex = findSlot(key);
+		if (0 != m_slots[slotIndex].entryIndex)
+		{
+			return { iterator(this, m_slots[slotIndex].entryIndex - 1), false };
+		}
+
+		if ((m_entries.size() + 1) * 2 > m_slots.size())
+		{
+			rehash(m_slots.size() * 2);
+			slotIndex = findSlot(key);
+		}
+
+		m_entries.push_back(std::make_unique<value_type>(std::piecewise_construct,
+			std::forward_as_tuple(key), std::forward_as_tuple(std::forward<Args>(args)...)));
+		m_slots[slotIndex] = { key, m_entries.size() };
+		return { iterator(this, m_entries.size() - 1), true };
+	}
+
+	Value& operator[](Key key)
+	{
+		return try_emplace(key).first->second;
+	}
+
+private:
+	static const std::size_t MIN_SLOT_BITS = 4;
+	static const std::size_t MIN_SLOT_COUNT = 1 << MIN_SLOT_BITS;
+
+	struct Slot
+	{
+		Key key;
+		std::size_t entryIndex;
+	};
+
+	void eraseSlot(std::size_t slotIndex)
+	{
+		const std::size_t entryIndex = m_slots[slotIndex].entryIndex - 1;
+		if (entryIndex + 1 != m_entries.size())
+		{
+			m_slots[findSlot(m_entries.back()->first)].entryIndex = entryIndex + 1;
+			std::swap(m_entries[entryIndex], m_entries.back());
+		}
+		m_entries.pop_back();
+
+		const std::size_t mask = m_slots.size() - 1;
+		std::size_t hole = slotIndex;
+		std::size_t i = slotIndex;
+		while (true)
+		{
+			i = (i + 1) & mask;
+			if (0 == m_slots[i].entryIndex)
+			{
+				break;
+			}
+
+			const std::size_t home = getHomeSlot(m_slots[i].key);
+			if (((i - home) & mask) >= ((i - hole) & mask))
+			{
+				m_slots[hole] = m_slots[i];
+				hole = i;
+			}
+		}
+		m_slots[hole] = {};
+	}
+
+	std::size_t findSlot(Key key) const
+	{
+		const std::size_t mask = m_slots.size() - 1;
+		std::size_t i = getHomeSlot(key);
+		while (0 != m_slots[i].entryIndex && m_slots[i].key != key)
+		{
+			i = (i + 1) & mask;
+		}
+		return i;
+	}
+
+	std::size_t getHomeSlot(Key key) const
+	{
+		UINT value = 0;
+		if constexpr (std::is_pointer_v<Key>)
+		{
+			value = static_cast<UINT>(reinterpret_cast<UINT_PTR>(key));
+		}
+		else
+		{
+			value = static_cast<UINT>(key);
+		}
+		return (value * 0x9E3779B9) >> m_shift;
+	}
+
+	void rehash(std::size_t slotCount)
+	{
+		m_slots.assign(slotCount, {});
+		m_shift = 32;
+		while (slotCount > 1)
+		{
+			--m_shift;
+			slotCount /= 2;
+		}
+
+		for (std::size_t i = 0; i < m_entries.size(); ++i)
+		{
+			m_slots[findSlot(m_entries[i]->first)] = { m_entries[i]->first, i + 1 };
+		}
+	}
+
+	std::vector<std::unique_ptr<value_type>> m_entries;
+	std::vector<Slot> m_slots;
+	UINT m_shift;
+};
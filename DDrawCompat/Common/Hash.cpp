@@ -0,0 +1,168 @@
+#include <algorithm>
+#include <cstring>
+
+#include <Common/Hash.h>
+
+// MurmurHash3_x86_128 (public domain, Austin Appleby), with a streaming interface
+
+namespace
+{
+	const std::size_t BLOCK_SIZE = 16;
+	const UINT C1 = 0x239B961B;
+	const UINT C2 = 0xAB0E9789;
+	const UINT C3 = 0x38B34AE5;
+	const UINT C4 = 0xA1E38B93;
+
+	UINT rotl(UINT x, int r)
+	{
+		return (x << r) | (x >> (32 - r));
+	}
+
+	UINT fmix(UINT h)
+	{
+		h ^= h >> 16;
+		h *= 0x85EBCA6B;
+		h ^= h >> 13;
+		h *= 0xC2B2AE35;
+		h ^= h >> 16;
+		return h;
+	}
+
+	UINT mixK1(UINT k) { return rotl(k * C1, 15) * C2; }
+	UINT mixK2(UINT k) { return rotl(k * C2, 16) * C3; }
+	UINT mixK3(UINT k) { return rotl(k * C3, 17) * C4; }
+	UINT mixK4(UINT k) { return rotl(k * C4, 18) * C1; }
+
+	void processBlock(UINT (&h)[4], const BYTE* block)
+	{
+		UINT k[4] = {};
+		memcpy(k, block, BLOCK_SIZE);
+
+		h[0] ^= mixK1(k[0]);
+		h[0] = (rotl(h[0], 19) + h[1]) * 5 + 0x561CCD1B;
+		h[1] ^= mixK2(k[1]);
+		h[1] = (rotl(h[1], 17) + h[2]) * 5 + 0x0BCAA747;
+		h[2] ^= mixK3(k[2]);
+		h[2] = (rotl(h[2], 15) + h[3]) * 5 + 0x96CD1C35;
+		h[3] ^= mixK4(k[3]);
+		h[3] = (rotl(h[3], 13) + h[0]) * 5 + 0x32AC3B17;
+	}
+}
+
+namespace Hash
+{
+	Hasher::Hasher(UINT seed)
+		: m_h{ seed, seed, seed, seed }
+		, m_buffer{}
+		, m_bufferSize(0)
+		, m_totalSize(0)
+	{
+	}
+
+	Digest Hasher::digest() const
+	{
+		UINT h[4] = {};
+		finalize(h);
+
+		Digest digest = {};
+		memcpy(digest.data(), h, sizeof(h));
+		return digest;
+	}
+
+	UINT64 Hasher::digest64() const
+	{
+		UINT h[4] = {};
+		finalize(h);
+		return (static_cast<UINT64>(h[1]) << 32) | h[0];
+	}
+
+	void Hasher::finalize(UINT (&h)[4]) const
+	{
+		memcpy(h, m_h, sizeof(h));
+
+		UINT k[4] = {};
+		memcpy(k, m_buffer, m_bufferSize);
+		if (m_bufferSize > 12)
+		{
+			h[3] ^= mixK4(k[3]);
+		}
+		if (m_bufferSize > 8)
+		{
+			h[2] ^= mixK3(k[2]);
+		}
+		if (m_bufferSize > 4)
+		{
+			h[1] ^= mixK2(k[1]);
+		}
+		if (m_bufferSize > 0)
+		{
+			h[0] ^= mixK1(k[0]);
+		}
+
+		const UINT size = static_cast<UINT>(m_totalSize);
+		for (auto& v : h)
+		{
+			v ^= size;
+		}
+
+		h[0] += h[1] + h[2] + h[3];
+		h[1] += h[0];
+		h[2] += h[0];
+		h[3] += h[0];
+
+		for (auto& v : h)
+		{
+			v = fmix(v);
+		}
+
+		h[0] += h[1] + h[2] + h[3];
+		h[1] += h[0];
+		h[2] += h[0];
+		h[3] += h[0];
+	}
+
+	void Hasher::update(const void* data, std::size_t size)
+	{
+		auto p = static_cast<const BYTE*>(data);
+		m_totalSize += size;
+
+		if (0 != m_bufferSize)
+		{
+			const std::size_t count = std::min(BLOCK_SIZE - m_bufferSize, size);
+			memcpy(m_buffer + m_bufferSize, p, count);
+			m_bufferSize += count;
+			p += count;
+			size -= count;
+			if (BLOCK_SIZE != m_bufferSize)
+			{
+				return;
+			}
+			processBlock(m_h, m_buffer);
+			m_bufferSize = 0;
+		}
+
+		while (size >= BLOCK_SIZE)
+		{
+			processBlock(m_h, p);
+			p += BLOCK_SIZE;
+			size -= BLOCK_SIZE;
+		}
+
+		memcpy(m_buffer, p, size);
+		m_bufferSize = size;
+	}
+
+	Digest hash128(const void* data, std::size_t size)
+	{
+		Hasher hasher;
+		hasher.update(data, size);
+		return hasher.digest();
+	}
+
+	UINT64 hash64(const void* data, std::size_t size)
+	{
+		Hasher hasher;
+		hasher.update(data, size);
+		return hasher.digest64();
+	}
+}
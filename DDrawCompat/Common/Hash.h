@@ -0,0 +1,32 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+
+#include <Windows.h>
+
+namespace Hash
+{
+	typedef std::array<BYTE, 16> Digest;
+
+	class Hasher
+	{
+	public:
+		Hasher(UINT seed = 0);
+
+		void update(const void* data, std::size_t size);
+		Digest digest() const;
+		UINT64 digest64() const;
+
+	private:
+		void finalize(UINT (&h)[4]) const;
+
+		UINT m_h[4];
+		BYTE m_buffer[16];
+		std::size_t m_bufferSize;
+		UINT64 m_totalSize;
+	};
+
+	Digest hash128(const void* data, std::size_t size);
+	UINT64 hash64(const void* data, std::size_t size);
+}
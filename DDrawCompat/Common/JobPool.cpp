@@ -0,0 +1,141 @@
+#include <queue>
+#include <vector>
+
+#include <Windows.h>
+#include <objbase.h>
+
+#include <Common/JobPool.h>
+#include <Common/Log.h>
+#include <Common/ScopedSrwLock.h>
+#include <Dll/Dll.h>
+
+namespace
+{
+	const DWORD SHUTDOWN_TIMEOUT = 1000;
+
+	struct Job
+	{
+		int priority;
+		unsigned long long sequence;
+		std::function<void()> func;
+
+		bool operator<(const Job& other) const
+		{
+			return priority != other.priority ? priority > other.priority : sequence > other.sequence;
+		}
+	};
+
+	CONDITION_VARIABLE g_jobCv = CONDITION_VARIABLE_INIT;
+	Compat::SrwLock g_jobSrwLock;
+	std::priority_queue<Job> g_jobs;
+	unsigned long long g_jobSequence = 0;
+	std::vector<HANDLE> g_threads;
+	bool g_isShutdown = false;
+
+	unsigned getPhysicalCoreCount()
+	{
+		DWORD size = 0;
+		GetLogicalProcessorInformation(nullptr, &size);
+		std::vector<SYSTEM_LOGICAL_PROCESSOR_INFORMATION> info(size / sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION));
+		if (info.empty() || !GetLogicalProcessorInformation(info.data(), &size))
+		{
+			return 1;
+		}
+
+		unsigned coreCount = 0;
+		for (const auto& i : info)
+		{
+			if (RelationProcessorCore == i.Relationship)
+			{
+				++coreCount;
+			}
+		}
+		return coreCount;
+	}
+
+	unsigned WINAPI workerThreadProc(LPVOID /*lpParameter*/)
+	{
+		CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+
+		while (true)
+		{
+			std::function<void()> func;
+			{
+				Compat::ScopedSrwLockExclusive lock(g_jobSrwLock);
+				while (g_jobs.empty() && !g_isShutdown)
+				{
+					SleepConditionVariableSRW(&g_jobCv, &g_jobSrwLock, INFINITE, 0);
+				}
+				if (g_isShutdown)
+				{
+					break;
+				}
+				func = std::move(const_cast<Job&>(g_jobs.top()).func);
+				g_jobs.pop();
+			}
+			func();
+		}
+
+		CoUninitialize();
+		return 0;
+	}
+}
+
+namespace JobPool
+{
+	void shutdown()
+	{
+		std::vector<HANDLE> threads;
+		{
+			Compat::ScopedSrwLockExclusive lock(g_jobSrwLock);
+			g_isShutdown = true;
+			g_jobs = {};
+			threads.swap(g_threads);
+		}
+		WakeAllConditionVariable(&g_jobCv);
+
+		const DWORD startTime = GetTickCount();
+		for (HANDLE thread : threads)
+		{
+			const DWORD elapsedTime = GetTickCount() - startTime;
+			WaitForSingleObject(thread, elapsedTime < SHUTDOWN_TIMEOUT ? SHUTDOWN_TIMEOUT - elapsedTime : 0);
+			CloseHandle(thread);
+		}
+	}
+
+	bool submit(int priority, std::function<void()> job)
+	{
+		{
+			Compat::ScopedSrwLockExclusive lock(g_jobSrwLock);
+			if (g_isShutdown)
+			{
+				return false;
+			}
+
+			if (g_threads.empty())
+			{
+				const unsigned coreCount = getPhysicalCoreCount();
+				const unsigned maxThreadCount = coreCount > 1 ? coreCount - 1 : 1;
+				for (unsigned i = 0; i < maxThreadCount; ++i)
+				{
+					HANDLE thread = Dll::createThread(&workerThreadProc, nullptr, THREAD_PRIORITY_BELOW_NORMAL);
+					if (thread)
+					{
+						g_threads.push_back(thread);
+					}
+				}
+				LOG_INFO << "Job pool threads: " << g_threads.size() << " (physical cores: " << coreCount << ')';
+			}
+
+			if (g_threads.empty())
+			{
+				return false;
+			}
+
+			g_jobs.push({ priority, g_jobSequence++, std::move(job) });
+		}
+
+		WakeConditionVariable(&g_jobCv);
+		return true;
+	}
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <functional>
+
+namespace JobPool
+{
+	void shutdown();
+	bool submit(int priority, std::function<void()> job);
+}
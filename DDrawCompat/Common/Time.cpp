@@ -1,12 +1,20 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+
 #include <Windows.h>
 
 #include <Common/Log.h>
+#include <Common/ScopedCriticalSection.h>
 #include <Common/ScopedSrwLock.h>
 #include <Common/Time.h>
 #include <Dll/Dll.h>
 
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+
 namespace
 {
 	CONDITION_VARIABLE g_tickCounterCv = CONDITION_VARIABLE_INIT;
@@ -14,6 +22,35 @@ namespace
 	DWORD g_tickCounter = 0;
 	HANDLE g_timer = nullptr;
 
+	Compat::CriticalSection g_waitTimerCs;
+	HANDLE g_waitTimer = nullptr;
+	std::atomic<long long> g_qpcWaitOvershoot = 0;
+	long long g_qpcMaxWaitOvershoot = 0;
+	long long g_qpcSpinMargin = 0;
+
+	bool sleepFor(long long qpcSleep)
+	{
+		LARGE_INTEGER due = {};
+		due.QuadPart = -std::max(qpcSleep * 10'000'000 / Time::g_qpcFrequency, 1LL);
+		return SetWaitableTimer(g_waitTimer, &due, 0, nullptr, nullptr, FALSE) &&
+			WAIT_OBJECT_0 == WaitForSingleObject(g_waitTimer, INFINITE);
+	}
+
+	void updateWaitOvershoot(long long qpcOvershoot)
+	{
+		qpcOvershoot = std::min(std::max(qpcOvershoot, 0LL), g_qpcMaxWaitOvershoot);
+		long long qpcWaitOvershoot = g_qpcWaitOvershoot;
+		if (qpcOvershoot > qpcWaitOvershoot)
+		{
+			qpcWaitOvershoot += (qpcOvershoot - qpcWaitOvershoot) / 4;
+		}
+		else
+		{
+			qpcWaitOvershoot -= (qpcWaitOvershoot - qpcOvershoot) / 32;
+		}
+		g_qpcWaitOvershoot = qpcWaitOvershoot;
+	}
+
 	void CALLBACK onTimer(UINT /*uTimerID*/, UINT /*uMsg*/, DWORD_PTR /*dwUser*/, DWORD_PTR /*dw1*/, DWORD_PTR /*dw2*/)
 	{
 		{
@@ -63,6 +100,20 @@ namespace Time
 		QueryPerformanceFrequency(&qpc);
 		g_qpcFrequency = qpc.QuadPart;
 
+		g_qpcWaitOvershoot = msToQpc(1);
+		g_qpcMaxWaitOvershoot = msToQpc(16);
+		g_qpcSpinMargin = g_qpcFrequency / 20000;
+
+		g_waitTimer = CreateWaitableTimerExW(nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+		if (g_waitTimer)
+		{
+			LOG_INFO << "Using a high resolution waitable timer for frame pacing";
+		}
+		else
+		{
+			g_waitTimer = CreateWaitableTimerExW(nullptr, nullptr, 0, TIMER_ALL_ACCESS);
+		}
+
 		Dll::createThread(&tickThreadProc, nullptr, THREAD_PRIORITY_TIME_CRITICAL);
 	}
 
@@ -88,4 +139,58 @@ namespace Time
 			}
 		}
 	}
+
+	void waitUntil(long long qpcWaitEnd, const std::function<void()>& onWake)
+	{
+		long long qpcNow = queryPerformanceCounter();
+		const bool useWaitTimer = g_waitTimer && TryEnterCriticalSection(&g_waitTimerCs);
+
+		long long qpcWaitMargin = g_qpcWaitOvershoot + g_qpcSpinMargin;
+		while (qpcWaitEnd - qpcNow > qpcWaitMargin)
+		{
+			if (useWaitTimer)
+			{
+				long long qpcSleep = qpcWaitEnd - qpcNow - qpcWaitMargin;
+				if (onWake)
+				{
+					qpcSleep = std::min(qpcSleep, msToQpc(1));
+				}
+
+				if (sleepFor(qpcSleep))
+				{
+					updateWaitOvershoot(queryPerformanceCounter() - qpcNow - qpcSleep);
+				}
+				else
+				{
+					Sleep(1);
+				}
+			}
+			else if (qpcToMs(qpcWaitEnd - qpcNow) > 0)
+			{
+				waitForNextTick();
+			}
+			else
+			{
+				break;
+			}
+
+			if (onWake)
+			{
+				onWake();
+			}
+			qpcNow = queryPerformanceCounter();
+			qpcWaitMargin = g_qpcWaitOvershoot + g_qpcSpinMargin;
+		}
+
+		if (useWaitTimer)
+		{
+			LeaveCriticalSection(&g_waitTimerCs);
+		}
+
+		while (qpcWaitEnd - qpcNow > 0)
+		{
+			YieldProcessor();
+			qpcNow = queryPerformanceCounter();
+		}
+	}
 }
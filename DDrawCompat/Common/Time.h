@@ -1,5 +1,7 @@
 #pragma once
 
+#include <functional>
+
 #include <Windows.h>
 
 namespace Time
@@ -26,4 +28,5 @@ namespace Time
 	}
 
 	void waitForNextTick();
+	void waitUntil(long long qpcWaitEnd, const std::function<void()>& onWake = {});
 }
@@ -1,6 +1,7 @@
 #include <Config/Settings/AlternatePixelCenter.h>
 #include <Config/Settings/AltTabFix.h>
 #include <Config/Settings/Antialiasing.h>
+#include <Config/Settings/AsyncPresent.h>
 #include <Config/Settings/BltFilter.h>
 #include <Config/Settings/CapsPatches.h>
 #include <Config/Settings/ColorKeyMethod.h>
@@ -26,6 +27,7 @@
 #include <Config/Settings/FullscreenMode.h>
 #include <Config/Settings/GdiInterops.h>
 #include <Config/Settings/LogLevel.h>
+#include <Config/Settings/MaxFrameLatency.h>
 #include <Config/Settings/MousePollingRate.h>
 #include <Config/Settings/MouseSensitivity.h>
 #include <Config/Settings/PalettizedTextures.h>
@@ -33,6 +35,8 @@
 #include <Config/Settings/RenderColorDepth.h>
 #include <Config/Settings/ResolutionScale.h>
 #include <Config/Settings/ResolutionScaleFilter.h>
+#include <Config/Settings/ShaderOptimizer.h>
+#include <Config/Settings/SkipDuplicateFrames.h>
 #include <Config/Settings/SoftwareDevice.h>
 #include <Config/Settings/SpriteAltPixelCenter.h>
 #include <Config/Settings/SpriteDetection.h>
@@ -66,6 +70,7 @@ namespace Config
 	Settings::AlternatePixelCenter alternatePixelCenter;
 	Settings::AltTabFix altTabFix;
 	Settings::Antialiasing antialiasing;
+	Settings::AsyncPresent asyncPresent;
 	Settings::BltFilter bltFilter;
 	Settings::CapsPatches capsPatches;
 	Settings::ColorKeyMethod colorKeyMethod;
@@ -91,6 +96,7 @@ namespace Config
 	Settings::FullscreenMode fullscreenMode;
 	Settings::GdiInterops gdiInterops;
 	Settings::LogLevel logLevel;
+	Settings::MaxFrameLatency maxFrameLatency;
 	Settings::MousePollingRate mousePollingRate;
 	Settings::MouseSensitivity mouseSensitivity;
 	Settings::PalettizedTextures palettizedTextures;
@@ -98,6 +104,8 @@ namespace Config
 	Settings::RenderColorDepth renderColorDepth;
 	Settings::ResolutionScale resolutionScale;
 	Settings::ResolutionScaleFilter resolutionScaleFilter;
+	Settings::ShaderOptimizer shaderOptimizer;
+	Settings::SkipDuplicateFrames skipDuplicateFrames;
 	Settings::SoftwareDevice softwareDevice;
 	Settings::SpriteAltPixelCenter spriteAltPixelCenter;
 	Settings::SpriteDetection spriteDetection;
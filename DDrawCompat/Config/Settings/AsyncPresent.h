@@ -0,0 +1,19 @@
+#pragma once
+
+#include <Config/BoolSetting.h>
+
+namespace Config
+{
+	namespace Settings
+	{
+		class AsyncPresent : public BoolSetting
+		{
+		public:
+			AsyncPresent() : BoolSetting("AsyncPresent", "off")
+			{
+			}
+		};
+	}
+
+	extern Settings::AsyncPresent asyncPresent;
+}
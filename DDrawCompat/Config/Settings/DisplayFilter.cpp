@@ -35,6 +35,16 @@ namespace
 						tmpFiles.push_back(p);
 					}
 				}
+				else if (p.extension() == ".dcc")
+				{
+					auto fn(p.filename());
+					fn.replace_extension();
+					if (fn.extension() != ".cgp")
+					{
+						// Compiled shaders are stored in the shader cache pack now
+						tmpFiles.push_back(p);
+					}
+				}
 			});
 	}
 }
@@ -5,7 +5,7 @@ namespace Config
 	namespace Settings
 	{
 		FpsLimiter::FpsLimiter()
-			: EnumSetting("FpsLimiter", "off", { "off", "flipstart", "flipend", "msgloop" })
+			: EnumSetting("FpsLimiter", "off", { "off", "flipstart", "flipend", "msgloop", "adaptive" })
 		{
 		}
 
@@ -9,7 +9,7 @@ namespace Config
 		class FpsLimiter : public EnumSetting
 		{
 		public:
-			enum Values { OFF, FLIPSTART, FLIPEND, MSGLOOP };
+			enum Values { OFF, FLIPSTART, FLIPEND, MSGLOOP, ADAPTIVE };
 
 			FpsLimiter();
 
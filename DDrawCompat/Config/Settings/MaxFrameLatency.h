@@ -0,0 +1,25 @@
+#pragma once
+
+#include <Config/IntSetting.h>
+
+namespace Config
+{
+	namespace Settings
+	{
+		class MaxFrameLatency : public IntSetting
+		{
+		public:
+			MaxFrameLatency()
+				: IntSetting("MaxFrameLatency", "1", 1, 3)
+			{
+			}
+
+			virtual std::vector<std::string> getDefaultValueStrings() override
+			{
+				return { "1", "2", "3" };
+			}
+		};
+	}
+
+	extern Settings::MaxFrameLatency maxFrameLatency;
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <Config/BoolSetting.h>
+
+namespace Config
+{
+	namespace Settings
+	{
+		class ShaderOptimizer : public BoolSetting
+		{
+		public:
+			ShaderOptimizer() : BoolSetting("ShaderOptimizer", "off")
+			{
+			}
+		};
+	}
+
+	extern Settings::ShaderOptimizer shaderOptimizer;
+}
@@ -0,0 +1,21 @@
+#include <Config/Settings/SkipDuplicateFrames.h>
+
+namespace Config
+{
+	namespace Settings
+	{
+		SkipDuplicateFrames::SkipDuplicateFrames()
+			: EnumSetting("SkipDuplicateFrames", "off", { "off", "on", "hash" })
+		{
+		}
+
+		Setting::ParamInfo SkipDuplicateFrames::getParamInfo() const
+		{
+			if (HASH == m_value)
+			{
+				return { "RowStep", 1, 16, 4 };
+			}
+			return {};
+		}
+	}
+}
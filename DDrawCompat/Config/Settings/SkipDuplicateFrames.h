@@ -0,0 +1,21 @@
+#pragma once
+
+#include <Config/EnumSetting.h>
+
+namespace Config
+{
+	namespace Settings
+	{
+		class SkipDuplicateFrames : public EnumSetting
+		{
+		public:
+			enum Values { OFF, ON, HASH };
+
+			SkipDuplicateFrames();
+
+			virtual ParamInfo getParamInfo() const override;
+		};
+	}
+
+	extern Settings::SkipDuplicateFrames skipDuplicateFrames;
+}
@@ -14,6 +14,7 @@ namespace Config
 				PRESENTCOUNT,
 				PRESENTRATE,
 				PRESENTTIME,
+				PRESENTSKIPS,
 				FLIPCOUNT,
 				FLIPRATE,
 				FLIPTIME,
@@ -26,7 +27,17 @@ namespace Config
 				VBLANKCOUNT,
 				VBLANKRATE,
 				VBLANKTIME,
+				VBLANKMISSES,
 				DDIUSAGE,
+				CONSTUPLOADS,
+				CGPSKIPPEDPASSES,
+				SURFACEALLOCS,
+				DRAWSPERBLIT,
+				PACINGJITTERP50,
+				PACINGJITTERP99,
+				INPUTLATENCY,
+				FRAMEQUEUEDEPTH,
+				FRAMEBLOCKTIME,
 				GDIOBJECTS,
 				DEBUG,
 				VALUE_COUNT
@@ -39,6 +50,7 @@ namespace Config
 						"presentcount",
 						"presentrate",
 						"presenttime",
+						"presentskips",
 						"flipcount",
 						"fliprate",
 						"fliptime",
@@ -51,7 +63,17 @@ namespace Config
 						"vblankcount",
 						"vblankrate",
 						"vblanktime",
+						"vblankmisses",
 						"ddiusage",
+						"constuploads",
+						"cgpskippedpasses",
+						"surfaceallocs",
+						"drawsperblit",
+						"pacingjitterp50",
+						"pacingjitterp99",
+						"inputlatency",
+						"framequeuedepth",
+						"frameblocktime",
 						"gdiobjects",
 						"debug"
 					})
@@ -556,6 +556,6 @@ namespace D3dDdi
 		return result;
 	}
 
-	std::map<HANDLE, Adapter> Adapter::s_adapters;
+	HandleMap<HANDLE, Adapter> Adapter::s_adapters;
 	std::map<LUID, Adapter::AdapterInfo> Adapter::s_adapterInfos;
 }
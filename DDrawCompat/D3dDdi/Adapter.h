@@ -7,6 +7,7 @@
 #include <d3dnthal.h>
 #include <d3dumddi.h>
 
+#include <Common/HandleMap.h>
 #include <Common/Vector.h>
 #include <Win32/DisplayMode.h>
 
@@ -77,7 +78,7 @@ namespace D3dDdi
 		std::wstring m_deviceName;
 		const AdapterInfo& m_info;
 
-		static std::map<HANDLE, Adapter> s_adapters;
+		static HandleMap<HANDLE, Adapter> s_adapters;
 		static std::map<LUID, AdapterInfo> s_adapterInfos;
 	};
 }
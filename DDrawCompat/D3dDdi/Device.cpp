@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <sstream>
 
 #include <d3d.h>
@@ -5,8 +6,11 @@
 #include <d3dkmthk.h>
 
 #include <Common/CompatVtable.h>
+#include <Common/ConcurrentHandleMap.h>
 #include <Common/HResultException.h>
 #include <Common/Log.h>
+#include <Common/Time.h>
+#include <Config/Settings/MaxFrameLatency.h>
 #include <D3dDdi/Adapter.h>
 #include <D3dDdi/Device.h>
 #include <D3dDdi/DeviceFuncs.h>
@@ -14,16 +18,40 @@
 #include <D3dDdi/Resource.h>
 #include <D3dDdi/ScopedCriticalSection.h>
 #include <D3dDdi/ShaderAssembler.h>
+#include <DDraw/RealPrimarySurface.h>
 #include <DDraw/Surfaces/PrimarySurface.h>
 #include <DDraw/ScopedThreadLock.h>
 #include <Direct3d/Direct3dDevice.h>
 #include <Gdi/DcFunctions.h>
+#include <Gdi/GuiThread.h>
+#include <Overlay/StatsWindow.h>
 
 namespace
 {
 	HANDLE g_gdiResourceHandle = nullptr;
 	D3dDdi::Resource* g_gdiResource = nullptr;
 	bool g_isConfigUpdatePending = false;
+
+	ConcurrentHandleMap<HANDLE, D3dDdi::Resource> g_resourceIndex;
+
+	void addFrameQueueStats(std::size_t queueDepth, long long qpcBlocked)
+	{
+		auto statsWindow = Gdi::GuiThread::getStatsWindow();
+		if (!statsWindow)
+		{
+			return;
+		}
+
+		const auto tickCount = StatsQueue::getTickCount();
+		if (statsWindow->m_frameQueueDepth.isEnabled())
+		{
+			statsWindow->m_frameQueueDepth.addSample(tickCount, queueDepth);
+		}
+		if (statsWindow->m_frameBlockTime.isEnabled())
+		{
+			statsWindow->m_frameBlockTime.addSample(tickCount, qpcBlocked * 1'000'000 / Time::g_qpcFrequency);
+		}
+	}
 }
 
 namespace D3dDdi
@@ -35,8 +63,7 @@ namespace D3dDdi
 		, m_guidBuf{}
 		, m_device(device)
 		, m_runtimeDevice(runtimeDevice)
-		, m_eventQuery(nullptr)
-		, m_isEventQueryPending(false)
+		, m_eventQueries{}
 		, m_depthStencil(nullptr)
 		, m_renderTarget(nullptr)
 		, m_renderTargetSubResourceIndex(0)
@@ -45,10 +72,13 @@ namespace D3dDdi
 		, m_state(*this)
 		, m_shaderBlitter(*this)
 	{
-		D3DDDIARG_CREATEQUERY createQuery = {};
-		createQuery.QueryType = D3DDDIQUERYTYPE_EVENT;
-		m_origVtable.pfnCreateQuery(m_device, &createQuery);
-		m_eventQuery = createQuery.hQuery;
+		for (auto& eventQuery : m_eventQueries)
+		{
+			D3DDDIARG_CREATEQUERY createQuery = {};
+			createQuery.QueryType = D3DDDIQUERYTYPE_EVENT;
+			m_origVtable.pfnCreateQuery(m_device, &createQuery);
+			eventQuery = createQuery.hQuery;
+		}
 	}
 
 	void Device::add(Adapter& adapter, HANDLE device, HANDLE runtimeDevice)
@@ -147,27 +177,13 @@ namespace D3dDdi
 
 	Device* Device::findDeviceByResource(HANDLE resource)
 	{
-		for (auto& device : s_devices)
-		{
-			if (device.second.m_resources.find(resource) != device.second.m_resources.end())
-			{
-				return &device.second;
-			}
-		}
-		return nullptr;
+		auto res = findResource(resource);
+		return res ? &res->getDevice() : nullptr;
 	}
 
 	Resource* Device::findResource(HANDLE resource)
 	{
-		for (auto& device : s_devices)
-		{
-			auto res = device.second.getResource(resource);
-			if (res)
-			{
-				return res;
-			}
-		}
-		return nullptr;
+		return g_resourceIndex.find(resource);
 	}
 
 	Resource* Device::getGdiResource()
@@ -320,7 +336,11 @@ namespace D3dDdi
 		try
 		{
 			auto resource(std::make_unique<Resource>(*this, *data));
-			m_resources.emplace(*resource, std::move(resource));
+			auto res = resource.get();
+			if (m_resources.emplace(*res, std::move(resource)).second)
+			{
+				g_resourceIndex.insert(*res, res);
+			}
 			if (data->Flags.VertexBuffer &&
 				D3DDDIPOOL_SYSTEMMEM == data->Pool &&
 				data->pSurfList[0].pSysMem)
@@ -358,6 +378,11 @@ namespace D3dDdi
 	{
 		auto device = m_device;
 		auto pfnDestroyDevice = m_origVtable.pfnDestroyDevice;
+		for (const auto& resource : m_resources)
+		{
+			g_resourceIndex.erase(resource.first);
+		}
+		g_resourceIndex.synchronize();
 		s_devices.erase(device);
 		return pfnDestroyDevice(device);
 	}
@@ -392,6 +417,9 @@ namespace D3dDdi
 			if (it != m_resources.end())
 			{
 				res = it->second.get();
+				g_resourceIndex.erase(resource);
+				g_resourceIndex.synchronize();
+				DDraw::RealPrimarySurface::onDestroyResource(resource);
 				m_resources.erase(it);
 			}
 			if (resource == m_sharedPrimary)
@@ -404,7 +432,7 @@ namespace D3dDdi
 				g_gdiResource = nullptr;
 				DDraw::PrimarySurface::onLost();
 			}
-			m_drawPrimitive.removeSysMemVertexBuffer(resource);
+			m_drawPrimitive.onDestroyResource(resource);
 			m_state.onDestroyResource(res, resource);
 		}
 
@@ -646,23 +674,52 @@ namespace D3dDdi
 			m_origVtable.pfnFlush(m_device);
 		}
 
-		if (m_isEventQueryPending)
+		const std::size_t maxFrameLatency = std::min<std::size_t>(Config::maxFrameLatency.get(), m_eventQueries.size());
+		long long qpcBlocked = 0;
+		while (!m_pendingEventQueries.empty())
 		{
 			BOOL result = FALSE;
 			D3DDDIARG_GETQUERYDATA getQueryData = {};
-			getQueryData.hQuery = m_eventQuery;
+			getQueryData.hQuery = m_pendingEventQueries.front();
 			getQueryData.pData = &result;
-			while (S_FALSE == m_origVtable.pfnGetQueryData(m_device, &getQueryData))
+			if (m_pendingEventQueries.size() < maxFrameLatency)
 			{
+				if (S_FALSE == m_origVtable.pfnGetQueryData(m_device, &getQueryData))
+				{
+					break;
+				}
+			}
+			else
+			{
+				const auto qpcStart = Time::queryPerformanceCounter();
+				while (S_FALSE == m_origVtable.pfnGetQueryData(m_device, &getQueryData))
+				{
+				}
+				qpcBlocked += Time::queryPerformanceCounter() - qpcStart;
+			}
+			m_pendingEventQueries.pop_front();
+		}
+
+		HANDLE eventQuery = m_eventQueries[0];
+		for (auto query : m_eventQueries)
+		{
+			if (std::find(m_pendingEventQueries.begin(), m_pendingEventQueries.end(), query) == m_pendingEventQueries.end())
+			{
+				eventQuery = query;
+				break;
 			}
 		}
 
 		D3DDDIARG_ISSUEQUERY issueQuery = {};
-		issueQuery.hQuery = m_eventQuery;
+		issueQuery.hQuery = eventQuery;
 		issueQuery.Flags.End = 1;
-		m_isEventQueryPending = SUCCEEDED(m_origVtable.pfnIssueQuery(m_device, &issueQuery));
+		if (SUCCEEDED(m_origVtable.pfnIssueQuery(m_device, &issueQuery)))
+		{
+			m_pendingEventQueries.push_back(eventQuery);
+		}
+		addFrameQueueStats(m_pendingEventQueries.size(), qpcBlocked);
 	}
 
-	std::map<HANDLE, Device> Device::s_devices;
+	HandleMap<HANDLE, Device> Device::s_devices;
 	bool Device::s_isFlushEnabled = true;
 }
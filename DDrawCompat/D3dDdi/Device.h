@@ -1,7 +1,7 @@
 #pragma once
 
 #include <array>
-#include <map>
+#include <deque>
 #include <memory>
 #include <vector>
 
@@ -9,6 +9,7 @@
 #include <d3dnthal.h>
 #include <d3dumddi.h>
 
+#include <Common/HandleMap.h>
 #include <D3dDdi/DeviceState.h>
 #include <D3dDdi/DrawPrimitive.h>
 #include <D3dDdi/ShaderBlitter.h>
@@ -77,13 +78,15 @@ namespace D3dDdi
 
 		static void add(Adapter& adapter, HANDLE device, HANDLE runtimeDevice);
 		static Device& get(HANDLE device) { return s_devices.find(device)->second; }
-		static std::map<HANDLE, Device>& getDevices() { return s_devices; }
+		static HandleMap<HANDLE, Device>& getDevices() { return s_devices; }
 
 		static void enableFlush(bool enable) { s_isFlushEnabled = enable; }
 		static Device* findDeviceByDd(CompatRef<IDirectDraw7> dd);
 		static Device* findDeviceByName(const std::wstring& deviceName);
 		static Device* findDeviceByRuntimeHandle(HANDLE runtimeDevice);
 		static Device* findDeviceByResource(HANDLE resource);
+		// Lock-free. Resources are destroyed only after concurrent lookups have finished, so the returned pointer stays
+		// valid until the resource is destroyed, which cannot happen while the caller holds ScopedCriticalSection.
 		static Resource* findResource(HANDLE resource);
 		static Resource* getGdiResource();
 		static void setGdiResourceHandle(HANDLE resource);
@@ -101,9 +104,9 @@ namespace D3dDdi
 		std::shared_ptr<SurfaceRepository> m_repository;
 		HANDLE m_device;
 		HANDLE m_runtimeDevice;
-		HANDLE m_eventQuery;
-		bool m_isEventQueryPending;
-		std::map<HANDLE, std::unique_ptr<Resource>> m_resources;
+		std::array<HANDLE, 3> m_eventQueries;
+		std::deque<HANDLE> m_pendingEventQueries;
+		HandleMap<HANDLE, std::unique_ptr<Resource>> m_resources;
 		Resource* m_depthStencil;
 		Resource* m_renderTarget;
 		UINT m_renderTargetSubResourceIndex;
@@ -113,7 +116,7 @@ namespace D3dDdi
 		ShaderBlitter m_shaderBlitter;
 		std::vector<std::array<RGBQUAD, 256>> m_palettes;
 
-		static std::map<HANDLE, Device> s_devices;
+		static HandleMap<HANDLE, Device> s_devices;
 		static bool s_isFlushEnabled;
 	};
 }
@@ -3,6 +3,7 @@
 
 #include <Config/Settings/AlternatePixelCenter.h>
 #include <Config/Settings/ColorKeyMethod.h>
+#include <Config/Settings/ShaderOptimizer.h>
 #include <Config/Settings/SpriteAltPixelCenter.h>
 #include <Config/Settings/SpriteFilter.h>
 #include <Config/Settings/SpriteTexCoord.h>
@@ -16,6 +17,8 @@
 #include <D3dDdi/Log/DeviceFuncsLog.h>
 #include <D3dDdi/Resource.h>
 #include <D3dDdi/ShaderAssembler.h>
+#include <Gdi/GuiThread.h>
+#include <Overlay/StatsWindow.h>
 #include <Overlay/Steam.h>
 #include <Shaders/VertexFixup.h>
 #include <Config/Settings/ViewportEdgeFix.h>
@@ -26,6 +29,15 @@ namespace
 {
 	const HANDLE DELETED_RESOURCE = reinterpret_cast<HANDLE>(0xBAADBAAD);
 
+	void addShaderConstUploads(UINT count)
+	{
+		auto statsWindow = Gdi::GuiThread::getStatsWindow();
+		if (0 != count && statsWindow && statsWindow->m_shaderConstUploads.isEnabled())
+		{
+			statsWindow->m_shaderConstUploads.add(StatsQueue::getTickCount(), count);
+		}
+	}
+
 	RECT makeRect(const D3DDDIARG_VIEWPORTINFO& vp)
 	{
 		return {
@@ -58,8 +70,8 @@ namespace D3dDdi
 		, m_changedTextureStageStates{}
 		, m_textureResource{}
 		, m_pixelShader(nullptr)
-		, m_invalidatedPsConstCount{}
-		, m_invalidatedVsConstCount{}
+		, m_dirtyPsConsts{}
+		, m_dirtyVsConsts{}
 		, m_spriteMode(NON_SPRITE)
 	{
 		const UINT D3DBLENDOP_ADD = 1;
@@ -370,10 +382,35 @@ namespace D3dDdi
 
 		if (!it->second.isModified)
 		{
-			ShaderAssembler shaderAssembler(it->second.tokens.data(), it->second.tokens.size());
-			if (shaderAssembler.addAlphaTest(Config::colorKeyMethod.getParam()))
+			it->second.isModified = true;
+			const auto key = PixelShaderCache::makeKey(it->second.tokens, Config::colorKeyMethod.getParam());
+			auto preloaded = m_preloadedPixelShaders.find(key);
+			if (preloaded != m_preloadedPixelShaders.end())
+			{
+				it->second.modifiedPixelShader = std::move(preloaded->second);
+				m_preloadedPixelShaders.erase(preloaded);
+				return it->second.modifiedPixelShader.get();
+			}
+
+			const auto& cacheEntries = PixelShaderCache::getEntries();
+			auto cacheEntry = cacheEntries.find(key);
+			std::vector<UINT> tokens;
+			if (cacheEntry != cacheEntries.end())
+			{
+				tokens = cacheEntry->second;
+			}
+			else
+			{
+				ShaderAssembler shaderAssembler(it->second.tokens.data(), it->second.tokens.size());
+				if (shaderAssembler.addAlphaTest(Config::colorKeyMethod.getParam()))
+				{
+					tokens = shaderAssembler.getTokens();
+				}
+				PixelShaderCache::add(key, tokens);
+			}
+
+			if (!tokens.empty())
 			{
-				const auto& tokens = shaderAssembler.getTokens();
 				D3DDDIARG_CREATEPIXELSHADER data = {};
 				data.CodeSize = tokens.size() * 4;
 				HRESULT result = m_device.getOrigVtable().pfnCreatePixelShader(m_device, &data, tokens.data());
@@ -386,7 +423,6 @@ namespace D3dDdi
 					LOG_ONCE("ERROR: failed to create modified pixel shader: " << Compat::hex(result));
 				}
 			}
-			it->second.isModified = true;
 		}
 
 		return it->second.modifiedPixelShader ? it->second.modifiedPixelShader.get() : m_app.pixelShader;
@@ -489,11 +525,34 @@ namespace D3dDdi
 		ShaderAssembler shaderAssembler(code, data->CodeSize / 4);
 		LOG_DEBUG << "Pixel shader bytecode: " << Compat::hexDump(code, data->CodeSize);
 		LOG_DEBUG << shaderAssembler.disassemble();
-		HRESULT result = m_device.getOrigVtable().pfnCreatePixelShader(m_device, data, code);
+
+		HRESULT result = E_FAIL;
+		if (Config::shaderOptimizer.get() && shaderAssembler.optimize())
+		{
+			D3DDDIARG_CREATEPIXELSHADER optimizedData = *data;
+			optimizedData.CodeSize = shaderAssembler.getTokens().size() * 4;
+			result = m_device.getOrigVtable().pfnCreatePixelShader(
+				m_device, &optimizedData, shaderAssembler.getTokens().data());
+			if (SUCCEEDED(result))
+			{
+				data->ShaderHandle = optimizedData.ShaderHandle;
+			}
+			else
+			{
+				LOG_ONCE("ERROR: failed to create optimized pixel shader: " << Compat::hex(result));
+				shaderAssembler = ShaderAssembler(code, data->CodeSize / 4);
+			}
+		}
+
+		if (FAILED(result))
+		{
+			result = m_device.getOrigVtable().pfnCreatePixelShader(m_device, data, code);
+		}
+
 		if (SUCCEEDED(result))
 		{
 			m_pixelShaders.emplace(data->ShaderHandle,
-				PixelShader{ std::vector<UINT>(code, code + data->CodeSize / 4),
+				PixelShader{ shaderAssembler.getTokens(),
 				std::unique_ptr<void, ResourceDeleter>(
 					nullptr, ResourceDeleter(m_device, m_device.getOrigVtable().pfnDeletePixelShader)),
 				    shaderAssembler.getTextureStageCount(), false });
@@ -607,17 +666,20 @@ namespace D3dDdi
 
 	HRESULT DeviceState::pfnSetPixelShaderConst(const D3DDDIARG_SETPIXELSHADERCONST* data, const FLOAT* registers)
 	{
-		return setShaderConst(data, registers, m_pixelShaderConst, m_device.getOrigVtable().pfnSetPixelShaderConst);
+		return setShaderConst(data, registers, m_pixelShaderConst, m_dirtyPsConsts.floats,
+			m_device.getOrigVtable().pfnSetPixelShaderConst);
 	}
 
 	HRESULT DeviceState::pfnSetPixelShaderConstB(const D3DDDIARG_SETPIXELSHADERCONSTB* data, const BOOL* registers)
 	{
-		return setShaderConst(data, registers, m_pixelShaderConstB, m_device.getOrigVtable().pfnSetPixelShaderConstB);
+		return setShaderConst(data, registers, m_pixelShaderConstB, m_dirtyPsConsts.bools,
+			m_device.getOrigVtable().pfnSetPixelShaderConstB);
 	}
 
 	HRESULT DeviceState::pfnSetPixelShaderConstI(const D3DDDIARG_SETPIXELSHADERCONSTI* data, const INT* registers)
 	{
-		return setShaderConst(data, registers, m_pixelShaderConstI, m_device.getOrigVtable().pfnSetPixelShaderConstI);
+		return setShaderConst(data, registers, m_pixelShaderConstI, m_dirtyPsConsts.ints,
+			m_device.getOrigVtable().pfnSetPixelShaderConstI);
 	}
 
 	HRESULT DeviceState::pfnSetRenderState(const D3DDDIARG_RENDERSTATE* data)
@@ -707,17 +769,20 @@ namespace D3dDdi
 
 	HRESULT DeviceState::pfnSetVertexShaderConst(const D3DDDIARG_SETVERTEXSHADERCONST* data, const void* registers)
 	{
-		return setShaderConst(data, registers, m_vertexShaderConst, m_device.getOrigVtable().pfnSetVertexShaderConst);
+		return setShaderConst(data, registers, m_vertexShaderConst, m_dirtyVsConsts.floats,
+			m_device.getOrigVtable().pfnSetVertexShaderConst);
 	}
 
 	HRESULT DeviceState::pfnSetVertexShaderConstB(const D3DDDIARG_SETVERTEXSHADERCONSTB* data, const BOOL* registers)
 	{
-		return setShaderConst(data, registers, m_vertexShaderConstB, m_device.getOrigVtable().pfnSetVertexShaderConstB);
+		return setShaderConst(data, registers, m_vertexShaderConstB, m_dirtyVsConsts.bools,
+			m_device.getOrigVtable().pfnSetVertexShaderConstB);
 	}
 
 	HRESULT DeviceState::pfnSetVertexShaderConstI(const D3DDDIARG_SETVERTEXSHADERCONSTI* data, const INT* registers)
 	{
-		return setShaderConst(data, registers, m_vertexShaderConstI, m_device.getOrigVtable().pfnSetVertexShaderConstI);
+		return setShaderConst(data, registers, m_vertexShaderConstI, m_dirtyVsConsts.ints,
+			m_device.getOrigVtable().pfnSetVertexShaderConstI);
 	}
 
 	HRESULT DeviceState::pfnSetVertexShaderDecl(HANDLE shader)
@@ -762,6 +827,36 @@ namespace D3dDdi
 		return S_OK;
 	}
 
+	void DeviceState::preloadPixelShaders()
+	{
+		if (Config::Settings::ColorKeyMethod::ALPHATEST != Config::colorKeyMethod.get())
+		{
+			m_preloadedPixelShaders.clear();
+			m_preloadedAlphaRef.reset();
+			return;
+		}
+
+		const UINT alphaRef = Config::colorKeyMethod.getParam();
+		if (m_preloadedAlphaRef == alphaRef)
+		{
+			return;
+		}
+
+		m_preloadedPixelShaders.clear();
+		m_preloadedAlphaRef = alphaRef;
+		for (const auto& entry : PixelShaderCache::getEntries())
+		{
+			if (entry.first.alphaRef == alphaRef && !entry.second.empty())
+			{
+				auto shader = createPixelShader(entry.second.data(), entry.second.size() * 4);
+				if (shader)
+				{
+					m_preloadedPixelShaders.emplace(entry.first, std::move(shader));
+				}
+			}
+		}
+	}
+
 	void DeviceState::prepareTextures()
 	{
 		UINT textureStageCount = getTextureStageCount();
@@ -822,11 +917,20 @@ namespace D3dDdi
 		}
 	}
 
-	void DeviceState::setInvalidatedShaderConstCount(InvalidatedShaderConstCount& count, const TempShader& shader)
+	void DeviceState::setDirtyShaderConsts(DirtyShaderConsts& dirty, const TempShader& shader)
 	{
-		count.floatCount = std::max(count.floatCount, shader.floatConstCount);
-		count.boolCount = std::max(count.boolCount, shader.boolConstCount);
-		count.intCount = std::max(count.intCount, shader.intConstCount);
+		for (UINT i = 0; i < shader.floatConstCount; ++i)
+		{
+			dirty.floats.set(i);
+		}
+		for (UINT i = 0; i < shader.boolConstCount; ++i)
+		{
+			dirty.bools.set(i);
+		}
+		for (UINT i = 0; i < shader.intConstCount; ++i)
+		{
+			dirty.ints.set(i);
+		}
 	}
 
 	void DeviceState::setPixelShader(HANDLE shader)
@@ -957,20 +1061,26 @@ namespace D3dDdi
 	void DeviceState::setTempPixelShader(const TempShader& shader)
 	{
 		setPixelShader(shader.shader.get());
-		setInvalidatedShaderConstCount(m_invalidatedPsConstCount, shader);
+		setDirtyShaderConsts(m_dirtyPsConsts, shader);
 		m_changedStates |= CS_SHADER | CS_SHADER_CONST;
 	}
 
+	void DeviceState::setTempPixelShaderConst(const D3DDDIARG_SETPIXELSHADERCONST& data, const FLOAT* registers)
+	{
+		setTempShaderConst(data, registers, m_pixelShaderConst, m_dirtyPsConsts.floats,
+			m_device.getOrigVtable().pfnSetPixelShaderConst);
+	}
+
 	void DeviceState::setTempPixelShaderConstB(const D3DDDIARG_SETPIXELSHADERCONSTB& data, const BOOL* registers)
 	{
-		m_device.getOrigVtable().pfnSetPixelShaderConstB(m_device, &data, registers);
-		m_invalidatedPsConstCount.boolCount = std::max(m_invalidatedPsConstCount.boolCount, data.Register + data.Count);
+		setTempShaderConst(data, registers, m_pixelShaderConstB, m_dirtyPsConsts.bools,
+			m_device.getOrigVtable().pfnSetPixelShaderConstB);
 	}
 
 	void DeviceState::setTempPixelShaderConstI(const D3DDDIARG_SETPIXELSHADERCONSTI& data, const INT* registers)
 	{
-		m_device.getOrigVtable().pfnSetPixelShaderConstI(m_device, &data, registers);
-		m_invalidatedPsConstCount.intCount = std::max(m_invalidatedPsConstCount.intCount, data.Register + data.Count);
+		setTempShaderConst(data, registers, m_pixelShaderConstI, m_dirtyPsConsts.ints,
+			m_device.getOrigVtable().pfnSetPixelShaderConstI);
 	}
 
 	void DeviceState::setTempRenderState(const D3DDDIARG_RENDERSTATE& renderState)
@@ -986,6 +1096,49 @@ namespace D3dDdi
 		m_changedStates |= CS_RENDER_TARGET;
 	}
 
+	void DeviceState::setTempScissorRect(const RECT& rect)
+	{
+		setScissorRect(rect);
+		m_changedStates |= CS_RENDER_TARGET;
+	}
+
+	template <typename SetShaderConstData, typename ShaderConstArray, typename DirtyBitSet, typename Register>
+	void DeviceState::setTempShaderConst(const SetShaderConstData& data, const Register* registers,
+		const ShaderConstArray& shaderConstArray, DirtyBitSet& dirty,
+		HRESULT(APIENTRY* origSetShaderConstFunc)(HANDLE, const SetShaderConstData*, const Register*))
+	{
+		typedef typename ShaderConstArray::value_type ShaderConst;
+		auto values = reinterpret_cast<const ShaderConst*>(registers);
+		const UINT trackedEnd = std::min<UINT>(data.Register + data.Count, shaderConstArray.size());
+
+		bool isUploadNeeded = data.Register + data.Count > trackedEnd;
+		for (UINT i = data.Register; i < trackedEnd && !isUploadNeeded; ++i)
+		{
+			isUploadNeeded = dirty.test(i) || 0 != memcmp(&values[i - data.Register], &shaderConstArray[i], sizeof(ShaderConst));
+		}
+
+		if (!isUploadNeeded)
+		{
+			return;
+		}
+
+		origSetShaderConstFunc(m_device, &data, registers);
+		addShaderConstUploads(1);
+
+		for (UINT i = data.Register; i < trackedEnd; ++i)
+		{
+			if (0 == memcmp(&values[i - data.Register], &shaderConstArray[i], sizeof(ShaderConst)))
+			{
+				dirty.reset(i);
+			}
+			else
+			{
+				dirty.set(i);
+				m_changedStates |= CS_SHADER_CONST;
+			}
+		}
+	}
+
 	void DeviceState::setTempStreamSourceUm(const D3DDDIARG_SETSTREAMSOURCEUM& streamSourceUm, const void* umBuffer)
 	{
 		setStreamSourceUm(streamSourceUm, umBuffer, true);
@@ -1013,10 +1166,16 @@ namespace D3dDdi
 		m_changedStates |= CS_SHADER;
 	}
 
+	void DeviceState::setTempVertexShaderConst(const D3DDDIARG_SETVERTEXSHADERCONST& data, const void* registers)
+	{
+		setTempShaderConst(data, registers, m_vertexShaderConst, m_dirtyVsConsts.floats,
+			m_device.getOrigVtable().pfnSetVertexShaderConst);
+	}
+
 	void DeviceState::setTempVertexShaderFunc(const TempShader& shader)
 	{
 		setVertexShaderFunc(shader.shader.get());
-		setInvalidatedShaderConstCount(m_invalidatedVsConstCount, shader);
+		setDirtyShaderConsts(m_dirtyVsConsts, shader);
 		m_changedStates |= CS_SHADER | CS_SHADER_CONST;
 	}
 
@@ -1116,16 +1275,21 @@ namespace D3dDdi
 		return false;
 	}
 
-	template <typename SetShaderConstData, typename ShaderConstArray, typename Register>
+	template <typename SetShaderConstData, typename ShaderConstArray, typename DirtyBitSet, typename Register>
 	HRESULT DeviceState::setShaderConst(const SetShaderConstData* data, const Register* registers,
-		ShaderConstArray& shaderConstArray,
+		ShaderConstArray& shaderConstArray, DirtyBitSet& dirty,
 		HRESULT(APIENTRY* origSetShaderConstFunc)(HANDLE, const SetShaderConstData*, const Register*))
 	{
 		m_device.flushPrimitives();
 		HRESULT result = origSetShaderConstFunc(m_device, data, registers);
+		addShaderConstUploads(1);
 		if (SUCCEEDED(result))
 		{
 			memcpy(&shaderConstArray[data->Register], registers, data->Count * sizeof(ShaderConstArray::value_type));
+			for (UINT i = data->Register; i < data->Register + data->Count; ++i)
+			{
+				dirty.reset(i);
+			}
 		}
 		return result;
 	}
@@ -1160,6 +1324,7 @@ namespace D3dDdi
 			}
 			ps.second.isModified = false;
 		}
+		preloadPixelShaders();
 
 		for (UINT i = 0; i < m_changedTextureStageStates.size(); ++i)
 		{
@@ -1269,44 +1434,62 @@ namespace D3dDdi
 		}
 	}
 
-	void DeviceState::updateShaderConstsPs()
+	template <typename SetShaderConstData, typename ShaderConstArray, typename DirtyBitSet, typename Register>
+	void DeviceState::updateShaderConsts(const ShaderConstArray& shaderConstArray, DirtyBitSet& dirty,
+		HRESULT(APIENTRY* origSetShaderConstFunc)(HANDLE, const SetShaderConstData*, const Register*))
 	{
-		if (0 != m_invalidatedPsConstCount.floatCount)
-		{
-			const D3DDDIARG_SETPIXELSHADERCONST data = { 0, m_invalidatedPsConstCount.floatCount };
-			m_device.getOrigVtable().pfnSetPixelShaderConst(m_device, &data, &m_pixelShaderConst[0][0]);
-		}
-		if (0 != m_invalidatedPsConstCount.boolCount)
-		{
-			const D3DDDIARG_SETPIXELSHADERCONSTB data = { 0, m_invalidatedPsConstCount.boolCount };
-			m_device.getOrigVtable().pfnSetPixelShaderConstB(m_device, &data, &m_pixelShaderConstB[0][0]);
-		}
-		if (0 != m_invalidatedPsConstCount.intCount)
+		const UINT MAX_CLEAN_GAP = 2;
+		UINT uploadCount = 0;
+		UINT first = 0;
+		UINT end = 0;
+
+		auto upload = [&]()
+			{
+				const SetShaderConstData data = { first, end - first };
+				origSetShaderConstFunc(m_device, &data, &shaderConstArray[first][0]);
+				++uploadCount;
+			};
+
+		dirty.forEach([&](UINT reg)
+			{
+				if (reg >= shaderConstArray.size())
+				{
+					return;
+				}
+
+				if (0 == end)
+				{
+					first = reg;
+				}
+				else if (reg > end + MAX_CLEAN_GAP)
+				{
+					upload();
+					first = reg;
+				}
+				end = reg + 1;
+			});
+
+		if (0 != end)
 		{
-			const D3DDDIARG_SETPIXELSHADERCONSTI data = { 0, m_invalidatedPsConstCount.intCount };
-			m_device.getOrigVtable().pfnSetPixelShaderConstI(m_device, &data, &m_pixelShaderConstI[0][0]);
+			upload();
 		}
-		m_invalidatedPsConstCount = {};
+
+		dirty.reset();
+		addShaderConstUploads(uploadCount);
+	}
+
+	void DeviceState::updateShaderConstsPs()
+	{
+		updateShaderConsts(m_pixelShaderConst, m_dirtyPsConsts.floats, m_device.getOrigVtable().pfnSetPixelShaderConst);
+		updateShaderConsts(m_pixelShaderConstB, m_dirtyPsConsts.bools, m_device.getOrigVtable().pfnSetPixelShaderConstB);
+		updateShaderConsts(m_pixelShaderConstI, m_dirtyPsConsts.ints, m_device.getOrigVtable().pfnSetPixelShaderConstI);
 	}
 
 	void DeviceState::updateShaderConstsVs()
 	{
-		if (0 != m_invalidatedVsConstCount.floatCount)
-		{
-			const D3DDDIARG_SETVERTEXSHADERCONST data = { 0, m_invalidatedVsConstCount.floatCount };
-			m_device.getOrigVtable().pfnSetVertexShaderConst(m_device, &data, &m_vertexShaderConst[0][0]);
-		}
-		if (0 != m_invalidatedVsConstCount.boolCount)
-		{
-			const D3DDDIARG_SETVERTEXSHADERCONSTB data = { 0, m_invalidatedVsConstCount.boolCount };
-			m_device.getOrigVtable().pfnSetVertexShaderConstB(m_device, &data, &m_vertexShaderConstB[0][0]);
-		}
-		if (0 != m_invalidatedVsConstCount.intCount)
-		{
-			const D3DDDIARG_SETVERTEXSHADERCONSTI data = { 0, m_invalidatedVsConstCount.intCount };
-			m_device.getOrigVtable().pfnSetVertexShaderConstI(m_device, &data, &m_vertexShaderConstI[0][0]);
-		}
-		m_invalidatedVsConstCount = {};
+		updateShaderConsts(m_vertexShaderConst, m_dirtyVsConsts.floats, m_device.getOrigVtable().pfnSetVertexShaderConst);
+		updateShaderConsts(m_vertexShaderConstB, m_dirtyVsConsts.bools, m_device.getOrigVtable().pfnSetVertexShaderConstB);
+		updateShaderConsts(m_vertexShaderConstI, m_dirtyVsConsts.ints, m_device.getOrigVtable().pfnSetVertexShaderConstI);
 	}
 
 	void DeviceState::updateShaders()
@@ -1363,7 +1546,8 @@ namespace D3dDdi
 				D3DDDIARG_SETPIXELSHADERCONSTB data = {};
 				data.Register = stage;
 				data.Count = 1;
-				setShaderConst(&data, &colorKeyEnabled, m_pixelShaderConstB, m_device.getOrigVtable().pfnSetPixelShaderConstB);
+				setShaderConst(&data, &colorKeyEnabled, m_pixelShaderConstB, m_dirtyPsConsts.bools,
+					m_device.getOrigVtable().pfnSetPixelShaderConstB);
 			}
 			return;
 		}
@@ -6,9 +6,12 @@
 #include <array>
 #include <map>
 #include <memory>
+#include <optional>
 #include <vector>
 
 #include <Common/BitSet.h>
+#include <Common/HandleMap.h>
+#include <D3dDdi/PixelShaderCache.h>
 #include <D3dDdi/ResourceDeleter.h>
 
 const UINT D3DTEXF_NONE = 0;
@@ -112,14 +115,17 @@ namespace D3dDdi
 		void setSpriteMode(SpriteMode spriteMode);
 		void setTempDepthStencil(const D3DDDIARG_SETDEPTHSTENCIL& depthStencil);
 		void setTempPixelShader(const TempShader& shader);
+		void setTempPixelShaderConst(const D3DDDIARG_SETPIXELSHADERCONST& data, const FLOAT* registers);
 		void setTempPixelShaderConstB(const D3DDDIARG_SETPIXELSHADERCONSTB& data, const BOOL* registers);
 		void setTempPixelShaderConstI(const D3DDDIARG_SETPIXELSHADERCONSTI& data, const INT* registers);
 		void setTempRenderState(const D3DDDIARG_RENDERSTATE& renderState);
 		void setTempRenderTarget(const D3DDDIARG_SETRENDERTARGET& renderTarget);
+		void setTempScissorRect(const RECT& rect);
 		void setTempStreamSourceUm(const D3DDDIARG_SETSTREAMSOURCEUM& streamSourceUm, const void* umBuffer);
 		void setTempTexture(UINT stage, HANDLE texture);
 		void setTempTextureStageState(const D3DDDIARG_TEXTURESTAGESTATE& tss);
 		void setTempVertexShaderDecl(HANDLE decl);
+		void setTempVertexShaderConst(const D3DDDIARG_SETVERTEXSHADERCONST& data, const void* registers);
 		void setTempVertexShaderFunc(const TempShader& shader);
 		void setTempViewport(const D3DDDIARG_VIEWPORTINFO& viewport);
 		void setTempZRange(const D3DDDIARG_ZRANGE& zRange);
@@ -152,11 +158,11 @@ namespace D3dDdi
 			CS_VERTEX_FIXUP  = 1 << 6
 		};
 
-		struct InvalidatedShaderConstCount
+		struct DirtyShaderConsts
 		{
-			UINT floatCount;
-			UINT boolCount;
-			UINT intCount;
+			BitSet<0, 255> floats;
+			BitSet<0, 15> bools;
+			BitSet<0, 15> ints;
 		};
 
 		struct PixelShader
@@ -184,6 +190,7 @@ namespace D3dDdi
 		HANDLE mapPixelShader(HANDLE shader);
 		UINT mapRsValue(D3DDDIRENDERSTATETYPE state, UINT value);
 		UINT mapTssValue(UINT stage, D3DDDITEXTURESTAGESTATETYPE state, UINT value);
+		void preloadPixelShaders();
 		void prepareTextures();
 
 		template <typename Data>
@@ -195,13 +202,18 @@ namespace D3dDdi
 
 		bool setShader(HANDLE shader, HANDLE& currentShader, HRESULT(APIENTRY* origSetShaderFunc)(HANDLE, HANDLE));
 
-		template <typename SetShaderConstData, typename ShaderConstArray, typename Register>
+		template <typename SetShaderConstData, typename ShaderConstArray, typename DirtyBitSet, typename Register>
 		HRESULT setShaderConst(const SetShaderConstData* data, const Register* registers,
-			ShaderConstArray& shaderConstArray,
+			ShaderConstArray& shaderConstArray, DirtyBitSet& dirty,
+			HRESULT(APIENTRY* origSetShaderConstFunc)(HANDLE, const SetShaderConstData*, const Register*));
+
+		template <typename SetShaderConstData, typename ShaderConstArray, typename DirtyBitSet, typename Register>
+		void setTempShaderConst(const SetShaderConstData& data, const Register* registers,
+			const ShaderConstArray& shaderConstArray, DirtyBitSet& dirty,
 			HRESULT(APIENTRY* origSetShaderConstFunc)(HANDLE, const SetShaderConstData*, const Register*));
 
 		void setDepthStencil(const D3DDDIARG_SETDEPTHSTENCIL& depthStencil);
-		void setInvalidatedShaderConstCount(InvalidatedShaderConstCount& count, const TempShader& shader);
+		void setDirtyShaderConsts(DirtyShaderConsts& dirty, const TempShader& shader);
 		void setPixelShader(HANDLE shader);
 		void setRenderState(const D3DDDIARG_RENDERSTATE& renderState);
 		void setRenderTarget(const D3DDDIARG_SETRENDERTARGET& renderTarget);
@@ -218,6 +230,10 @@ namespace D3dDdi
 
 		void updateRenderStates();
 		void updateRenderTarget();
+		template <typename SetShaderConstData, typename ShaderConstArray, typename DirtyBitSet, typename Register>
+		void updateShaderConsts(const ShaderConstArray& shaderConstArray, DirtyBitSet& dirty,
+			HRESULT(APIENTRY* origSetShaderConstFunc)(HANDLE, const SetShaderConstData*, const Register*));
+
 		void updateShaderConstsPs();
 		void updateShaderConstsVs();
 		void updateShaders();
@@ -235,7 +251,7 @@ namespace D3dDdi
 		std::array<ShaderConstF, 256> m_vertexShaderConst;
 		std::array<ShaderConstB, 16> m_vertexShaderConstB;
 		std::array<ShaderConstI, 16> m_vertexShaderConstI;
-		std::map<HANDLE, VertexDecl> m_vertexShaderDecls;
+		HandleMap<HANDLE, VertexDecl> m_vertexShaderDecls;
 		VertexDecl* m_vertexDecl;
 		UINT m_vertexFixupConfig;
 		VertexFixupData m_vertexFixupData;
@@ -244,12 +260,14 @@ namespace D3dDdi
 		UINT m_texCoordIndexes;
 		BitSet<D3DDDIRS_ZENABLE, D3DDDIRS_BLENDOPALPHA> m_changedRenderStates;
 		std::array<BitSet<D3DDDITSS_TEXTUREMAP, D3DDDITSS_TEXTURECOLORKEYVAL>, 8> m_changedTextureStageStates;
-		std::map<UINT, std::unique_ptr<void, ResourceDeleter>> m_vsVertexFixups;
+		HandleMap<UINT, std::unique_ptr<void, ResourceDeleter>> m_vsVertexFixups;
 		std::array<Resource*, 8> m_textureResource;
-		std::map<HANDLE, PixelShader> m_pixelShaders;
+		HandleMap<HANDLE, PixelShader> m_pixelShaders;
+		std::map<PixelShaderCache::Key, std::unique_ptr<void, ResourceDeleter>> m_preloadedPixelShaders;
+		std::optional<UINT> m_preloadedAlphaRef;
 		PixelShader* m_pixelShader;
-		InvalidatedShaderConstCount m_invalidatedPsConstCount;
-		InvalidatedShaderConstCount m_invalidatedVsConstCount;
+		DirtyShaderConsts m_dirtyPsConsts;
+		DirtyShaderConsts m_dirtyVsConsts;
 		SpriteMode m_spriteMode;
 	};
 }
@@ -1,6 +1,10 @@
 #include <algorithm>
 #include <cstdlib>
+#include <cstring>
 
+#include <intrin.h>
+
+#include <Common/Hash.h>
 #include <Common/Log.h>
 #include <Config/Settings/SpriteDetection.h>
 #include <Config/Settings/SpriteTexCoord.h>
@@ -18,6 +22,13 @@ namespace
 		VF_TEXCOORD = 1 << 3
 	};
 
+	const UINT SPRITE_CACHE_MAX_VERTEX_COUNT = 16;
+
+	const BYTE* getVertex(const BYTE* vertices, UINT stride, const UINT16* indices, UINT i)
+	{
+		return vertices + (indices ? indices[i] : i) * stride;
+	}
+
 	UINT getVertexCount(D3DPRIMITIVETYPE primitiveType, UINT primitiveCount)
 	{
 		switch (primitiveType)
@@ -37,6 +48,49 @@ namespace
 		return 0;
 	}
 
+	bool isConstZ(const BYTE* vertices, UINT stride, const UINT16* indices, UINT count)
+	{
+		const float z0 = reinterpret_cast<const D3DTLVERTEX*>(getVertex(vertices, stride, indices, 0))->sz;
+		for (UINT i = 1; i < count; ++i)
+		{
+			if (reinterpret_cast<const D3DTLVERTEX*>(getVertex(vertices, stride, indices, i))->sz != z0)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool isTexCoordInRange(const BYTE* vertices, UINT stride, const UINT16* indices, UINT count,
+		UINT texCoordOffset, float minU, float maxU, float minV, float maxV)
+	{
+		auto getTexCoord = [&](UINT i) {
+			return reinterpret_cast<const float*>(getVertex(vertices, stride, indices, i) + texCoordOffset); };
+		const __m128 minUv = _mm_setr_ps(minU, minV, minU, minV);
+		const __m128 maxUv = _mm_setr_ps(maxU, maxV, maxU, maxV);
+
+		UINT i = 0;
+		for (; i + 2 <= count; i += 2)
+		{
+			__m128 uv = _mm_loadl_pi(_mm_setzero_ps(), reinterpret_cast<const __m64*>(getTexCoord(i)));
+			uv = _mm_loadh_pi(uv, reinterpret_cast<const __m64*>(getTexCoord(i + 1)));
+			if (0 != _mm_movemask_ps(_mm_or_ps(_mm_cmplt_ps(uv, minUv), _mm_cmpgt_ps(uv, maxUv))))
+			{
+				return false;
+			}
+		}
+
+		if (i < count)
+		{
+			const float* texCoord = getTexCoord(i);
+			if (texCoord[0] < minU || texCoord[0] > maxU || texCoord[1] < minV || texCoord[1] > maxV)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
 	void updateMax(UINT& max, UINT value)
 	{
 		if (value > max)
@@ -62,6 +116,8 @@ namespace D3dDdi
 		, m_streamSource{}
 		, m_batched{}
 		, m_vertexFixupFlags(0)
+		, m_spriteCache{}
+		, m_spriteCacheEntry(nullptr)
 	{
 	}
 
@@ -681,8 +737,65 @@ namespace D3dDdi
 		return m_batched.vertices.size() / m_streamSource.stride;
 	}
 
+	UINT64 DrawPrimitive::getSpriteCacheKey(INT baseVertexIndex, UINT count, const UINT16* indices)
+	{
+		auto& state = m_device.getState();
+		const auto& appState = state.getAppState();
+		const auto& decl = state.getVertexDecl();
+		const UINT params[] = {
+			Config::spriteDetection.get(),
+			static_cast<UINT>(Config::spriteDetection.getParam()),
+			Config::spriteTexCoord.get(),
+			count
+		};
+
+		Hash::Hasher hasher;
+		hasher.update(params, sizeof(params));
+
+		std::array<UINT, 8> texCoordOffsets = {};
+		UINT texCoordCount = 0;
+		if (Config::Settings::SpriteTexCoord::CLAMP == Config::spriteTexCoord.get())
+		{
+			const UINT D3DDECLTYPE_FLOAT2 = 1;
+			const UINT textureStageCount = state.getTextureStageCount();
+			for (UINT stage = 0; stage < textureStageCount; ++stage)
+			{
+				auto resource = appState.textures[stage] ? state.getTextureResource(stage) : nullptr;
+				if (resource && D3DDECLTYPE_FLOAT2 == decl.texCoordType[stage])
+				{
+					const UINT stageParams[] = {
+						stage,
+						decl.texCoordOffset[stage],
+						resource->getFixedDesc().pSurfList[0].Width,
+						resource->getFixedDesc().pSurfList[0].Height
+					};
+					hasher.update(stageParams, sizeof(stageParams));
+					texCoordOffsets[texCoordCount] = decl.texCoordOffset[stage];
+					++texCoordCount;
+				}
+			}
+		}
+
+		auto v = m_streamSource.vertices + baseVertexIndex * m_streamSource.stride;
+		std::array<float, 1 + 2 * 8> values = {};
+		for (UINT i = 0; i < count; ++i)
+		{
+			auto vertex = getVertex(v, m_streamSource.stride, indices, i);
+			values[0] = reinterpret_cast<const D3DTLVERTEX*>(vertex)->sz;
+			for (UINT j = 0; j < texCoordCount; ++j)
+			{
+				memcpy(&values[1 + 2 * j], vertex + texCoordOffsets[j], 2 * sizeof(float));
+			}
+			hasher.update(values.data(), (1 + 2 * texCoordCount) * sizeof(float));
+		}
+
+		const UINT64 key = hasher.digest64();
+		return 0 != key ? key : 1;
+	}
+
 	bool DrawPrimitive::isSprite(INT baseVertexIndex, UINT count, const UINT16* indices)
 	{
+		m_spriteCacheEntry = nullptr;
 		auto spriteDetection = Config::spriteDetection.get();
 		if (Config::Settings::SpriteDetection::OFF == spriteDetection ||
 			Config::Settings::SpriteDetection::POINT == spriteDetection && (
@@ -692,6 +805,18 @@ namespace D3dDdi
 			return false;
 		}
 
+		if (count <= SPRITE_CACHE_MAX_VERTEX_COUNT)
+		{
+			const auto key = getSpriteCacheKey(baseVertexIndex, count, indices);
+			auto& entry = m_spriteCache[static_cast<UINT>(key) & (m_spriteCache.size() - 1)];
+			m_spriteCacheEntry = &entry;
+			if (entry.key == key)
+			{
+				return entry.isSprite;
+			}
+			entry = { key, m_streamSource.vertexBuffer, 0, 0, false };
+		}
+
 		auto v = m_streamSource.vertices + baseVertexIndex * m_streamSource.stride;
 		auto v0 = reinterpret_cast<const D3DTLVERTEX*>(v + (indices ? indices[0] * m_streamSource.stride : 0));
 		if (Config::Settings::SpriteDetection::ZMAX == spriteDetection &&
@@ -700,28 +825,12 @@ namespace D3dDdi
 			return false;
 		}
 
-		if (indices)
+		const bool isSprite = isConstZ(v, m_streamSource.stride, indices, count);
+		if (m_spriteCacheEntry)
 		{
-			for (UINT i = 1; i < count; ++i)
-			{
-				if (reinterpret_cast<const D3DTLVERTEX*>(v + indices[i] * m_streamSource.stride)->sz != v0->sz)
-				{
-					return false;
-				}
-			}
+			m_spriteCacheEntry->isSprite = isSprite;
 		}
-		else
-		{
-			for (UINT i = 1; i < count; ++i)
-			{
-				v += m_streamSource.stride;
-				if (reinterpret_cast<const D3DTLVERTEX*>(v)->sz != v0->sz)
-				{
-					return false;
-				}
-			}
-		}
-		return true;
+		return isSprite;
 	}
 
 	void DrawPrimitive::loadVertices()
@@ -767,9 +876,17 @@ namespace D3dDdi
 		}
 	}
 
-	void DrawPrimitive::removeSysMemVertexBuffer(HANDLE resource)
+	void DrawPrimitive::onDestroyResource(HANDLE resource)
 	{
 		m_sysMemVertexBuffers.erase(resource);
+		for (auto& entry : m_spriteCache)
+		{
+			if (entry.vertexBuffer == resource)
+			{
+				entry = {};
+			}
+		}
+		m_spriteCacheEntry = nullptr;
 	}
 
 	void DrawPrimitive::resetStreamSource()
@@ -786,24 +903,24 @@ namespace D3dDdi
 		auto it = m_sysMemVertexBuffers.find(data.hVertexBuffer);
 		if (it != m_sysMemVertexBuffers.end())
 		{
-			return setSysMemStreamSource(it->second, data.Stride);
+			return setSysMemStreamSource(it->second, data.Stride, data.hVertexBuffer);
 		}
 
 		flushPrimitives();
 		HRESULT result = m_origVtable.pfnSetStreamSource(m_device, &data);
 		if (SUCCEEDED(result))
 		{
-			m_streamSource = { nullptr, data.Stride };
+			m_streamSource = { nullptr, data.Stride, data.hVertexBuffer };
 		}
 		return result;
 	}
 
 	HRESULT DrawPrimitive::setStreamSourceUm(const D3DDDIARG_SETSTREAMSOURCEUM& data, const void* umBuffer)
 	{
-		return setSysMemStreamSource(static_cast<const BYTE*>(umBuffer), data.Stride);
+		return setSysMemStreamSource(static_cast<const BYTE*>(umBuffer), data.Stride, nullptr);
 	}
 
-	HRESULT DrawPrimitive::setSysMemStreamSource(const BYTE* vertices, UINT stride)
+	HRESULT DrawPrimitive::setSysMemStreamSource(const BYTE* vertices, UINT stride, HANDLE vertexBuffer)
 	{
 		HRESULT result = S_OK;
 		if (!m_streamSource.vertices || stride != m_streamSource.stride)
@@ -813,7 +930,7 @@ namespace D3dDdi
 
 		if (SUCCEEDED(result))
 		{
-			m_streamSource = { vertices, stride };
+			m_streamSource = { vertices, stride, vertexBuffer };
 		}
 		return result;
 	}
@@ -855,15 +972,30 @@ namespace D3dDdi
 			const float minV = -texelHeight;
 			const float maxV = 1 + texelHeight;
 
-			for (UINT i = 0; i < count; ++i)
+			if (!m_spriteCacheEntry)
 			{
-				auto vertex = vertices + (indices ? indices[i] : i) * m_streamSource.stride;
-				const float* texCoord = reinterpret_cast<const float*>(vertex + decl.texCoordOffset[stage]);
-				if (texCoord[0] < minU || texCoord[0] > maxU || texCoord[1] < minV || texCoord[1] > maxV)
+				if (!isTexCoordInRange(vertices, m_streamSource.stride, indices, count,
+					decl.texCoordOffset[stage], minU, maxU, minV, maxV))
 				{
 					state.disableTextureClamp(stage);
-					break;
 				}
+				continue;
+			}
+
+			const UINT stageBit = 1 << stage;
+			if (!(m_spriteCacheEntry->checkedStages & stageBit))
+			{
+				m_spriteCacheEntry->checkedStages |= stageBit;
+				if (!isTexCoordInRange(vertices, m_streamSource.stride, indices, count,
+					decl.texCoordOffset[stage], minU, maxU, minV, maxV))
+				{
+					m_spriteCacheEntry->unclampedStages |= stageBit;
+				}
+			}
+
+			if (m_spriteCacheEntry->unclampedStages & stageBit)
+			{
+				state.disableTextureClamp(stage);
 			}
 		}
 	}
@@ -1,11 +1,13 @@
 #pragma once
 
-#include <map>
+#include <array>
 #include <vector>
 
 #include <d3d.h>
 #include <d3dumddi.h>
 
+#include <Common/HandleMap.h>
+
 namespace D3dDdi
 {
 	class Device;
@@ -16,7 +18,7 @@ namespace D3dDdi
 		DrawPrimitive(Device& device);
 
 		void addSysMemVertexBuffer(HANDLE resource, BYTE* vertices);
-		void removeSysMemVertexBuffer(HANDLE resource);
+		void onDestroyResource(HANDLE resource);
 
 		HRESULT flushPrimitives(const UINT* flagBuffer = nullptr);
 
@@ -38,10 +40,20 @@ namespace D3dDdi
 			std::vector<UINT16> indices;
 		};
 
+		struct SpriteCacheEntry
+		{
+			UINT64 key;
+			HANDLE vertexBuffer;
+			UINT checkedStages;
+			UINT unclampedStages;
+			bool isSprite;
+		};
+
 		struct StreamSource
 		{
 			const BYTE* vertices;
 			UINT stride;
+			HANDLE vertexBuffer;
 		};
 
 		void appendIndexedVertices(const UINT16* indices, UINT count,
@@ -69,13 +81,14 @@ namespace D3dDdi
 		void convertToTriangleList();
 		HRESULT flush(const UINT* flagBuffer);
 		HRESULT flushIndexed(const UINT* flagBuffer);
+		UINT64 getSpriteCacheKey(INT baseVertexIndex, UINT count, const UINT16* indices);
 		bool isSprite(INT baseVertexIndex, UINT count, const UINT16* indices);
 		void setVertexFixupFlags(INT baseVertexIndex, UINT16 index);
 		void loadVertices();
 		UINT getBatchedVertexCount() const;
 		void rebaseIndices();
 		void repeatLastBatchedVertex();
-		HRESULT setSysMemStreamSource(const BYTE* vertices, UINT stride);
+		HRESULT setSysMemStreamSource(const BYTE* vertices, UINT stride, HANDLE vertexBuffer);
 		void setTextureClampMode(INT baseVertexIndex, const UINT16* indices, UINT count);
 		void setupDraw(D3DPRIMITIVETYPE primitiveType, INT baseVertexIndex, UINT count, const UINT16* indices);
 		void transformLines();
@@ -84,8 +97,10 @@ namespace D3dDdi
 		Device& m_device;
 		const D3DDDI_DEVICEFUNCS& m_origVtable;
 		StreamSource m_streamSource;
-		std::map<HANDLE, BYTE*> m_sysMemVertexBuffers;
+		HandleMap<HANDLE, BYTE*> m_sysMemVertexBuffers;
 		BatchedPrimitives m_batched;
 		UINT m_vertexFixupFlags;
+		std::array<SpriteCacheEntry, 256> m_spriteCache;
+		SpriteCacheEntry* m_spriteCacheEntry;
 	};
 }
@@ -40,16 +40,26 @@ namespace
 	decltype(&D3DKMTSubmitPresentToHwQueue) g_origSubmitPresentToHwQueue = nullptr;
 
 	D3DKMT_HANDLE g_exclusiveDevice = 0;
+	RECT g_presentDirtyRect = {};
 	UINT g_exclusiveVidPnSourceId = 0;
-	int g_vsyncCounter = 0;
 	int g_pendingFlipCount = 0;
 	int g_finishedFlipCount = 0;
-	int g_presentEndVsyncCount = 0;
-	int g_flipEndVSyncCount = 0;
+	Compat::SrwLock g_flipCountSrwLock;
+
+	std::atomic<int> g_vsyncCounter = 0;
+	std::atomic<int> g_presentEndVsyncCount = 0;
+	std::atomic<int> g_flipEndVSyncCount = 0;
+	std::atomic<int> g_vsyncWakeCount = 0;
+	std::atomic<long long> g_qpcLastVsync = 0;
+	std::atomic<long long> g_qpcVsyncInterval = 0;
+	long long g_qpcSoftwareVsync = 0;
+	decltype(&WaitOnAddress) g_waitOnAddress = nullptr;
+	decltype(&WakeByAddressAll) g_wakeByAddressAll = nullptr;
 	CONDITION_VARIABLE g_vsyncCounterCv = CONDITION_VARIABLE_INIT;
 	Compat::SrwLock g_vsyncCounterSrwLock;
 
 	void getVidPnSource(D3DKMT_HANDLE& adapter, UINT& vidPnSourceId);
+	void notifyVsyncWaiters();
 	void updateGdiAdapterInfo();
 	void waitForVerticalBlank();
 
@@ -205,6 +215,21 @@ namespace
 		return isEnabled;
 	}
 
+	void notifyVsyncWaiters()
+	{
+		++g_vsyncWakeCount;
+		if (g_wakeByAddressAll)
+		{
+			g_wakeByAddressAll(&g_vsyncWakeCount);
+			return;
+		}
+
+		{
+			Compat::ScopedSrwLockExclusive lock(g_vsyncCounterSrwLock);
+		}
+		WakeAllConditionVariable(&g_vsyncCounterCv);
+	}
+
 	NTSTATUS APIENTRY openAdapterFromHdc(D3DKMT_OPENADAPTERFROMHDC* pData)
 	{
 		LOG_FUNC("D3DKMTOpenAdapterFromHdc", pData);
@@ -293,7 +318,7 @@ namespace
 		NTSTATUS result = D3DKMTReleaseProcessVidPnSourceOwners(hProcess);
 		if (SUCCEEDED(result))
 		{
-			Compat::ScopedSrwLockExclusive lock(g_vsyncCounterSrwLock);
+			Compat::ScopedSrwLockExclusive lock(g_flipCountSrwLock);
 			g_isExclusiveFullscreen = false;
 			g_exclusiveDevice = 0;
 			g_exclusiveVidPnSourceId = 0;
@@ -331,7 +356,7 @@ namespace
 		NTSTATUS result = D3DKMTSetVidPnSourceOwner(pData);
 		if (SUCCEEDED(result))
 		{
-			Compat::ScopedSrwLockExclusive lock(g_vsyncCounterSrwLock);
+			Compat::ScopedSrwLockExclusive lock(g_flipCountSrwLock);
 			g_isExclusiveFullscreen = 0 != pData->VidPnSourceCount;
 			if (g_isExclusiveFullscreen)
 			{
@@ -413,23 +438,61 @@ namespace
 		while (true)
 		{
 			waitForVerticalBlank();
+			const auto qpcNow = Time::queryPerformanceCounter();
+			const auto qpcLastVsync = g_qpcLastVsync.load();
+			const auto qpcInterval = qpcNow - qpcLastVsync;
+			auto qpcVsyncInterval = g_qpcVsyncInterval.load();
 
+			int vblankMisses = 0;
+			if (0 == qpcVsyncInterval)
+			{
+				qpcVsyncInterval = 0 != qpcLastVsync ? qpcInterval : 0;
+			}
+			else if (qpcInterval > qpcVsyncInterval / 2 && qpcInterval < qpcVsyncInterval * 3 / 2)
 			{
-				Compat::ScopedSrwLockExclusive lock(g_vsyncCounterSrwLock);
-				++g_vsyncCounter;
+				if (qpcInterval > qpcVsyncInterval * 5 / 4)
+				{
+					vblankMisses = 1;
+				}
+				qpcVsyncInterval += (qpcInterval - qpcVsyncInterval) / 16;
+			}
+			else if (qpcInterval >= qpcVsyncInterval * 3 / 2)
+			{
+				vblankMisses = static_cast<int>((qpcInterval + qpcVsyncInterval / 2) / qpcVsyncInterval) - 1;
 			}
 
-			WakeAllConditionVariable(&g_vsyncCounterCv);
+			g_qpcVsyncInterval = qpcVsyncInterval;
+			g_qpcLastVsync = qpcNow;
+			++g_vsyncCounter;
+			notifyVsyncWaiters();
 
 			auto statsWindow = Gdi::GuiThread::getStatsWindow();
 			if (statsWindow)
 			{
 				statsWindow->m_vblank.add();
+				if (0 != vblankMisses)
+				{
+					statsWindow->m_vblankMisses.add(StatsQueue::getTickCount(), vblankMisses);
+				}
 			}
 		}
 		return 0;
 	}
 
+	void waitForSoftwareVerticalBlank()
+	{
+		const DWORD refreshRate = Win32::DisplayMode::getEmulatedDisplayMode().refreshRate;
+		const long long qpcInterval = Time::g_qpcFrequency / (refreshRate > 1 ? refreshRate : 60);
+		const auto qpcNow = Time::queryPerformanceCounter();
+
+		if (0 == g_qpcSoftwareVsync || qpcNow - g_qpcSoftwareVsync > Time::g_qpcFrequency)
+		{
+			g_qpcSoftwareVsync = qpcNow;
+		}
+		g_qpcSoftwareVsync += ((qpcNow - g_qpcSoftwareVsync) / qpcInterval + 1) * qpcInterval;
+		Time::waitUntil(g_qpcSoftwareVsync);
+	}
+
 	void waitForVerticalBlank()
 	{
 		if (!g_isExclusiveFullscreen && !Config::compatFixes.get().nodwmflush &&
@@ -438,7 +501,6 @@ namespace
 			return;
 		}
 
-		auto qpcStart = Time::queryPerformanceCounter();
 		int scanLine = getScanLine();
 		int prevScanLine = 0;
 		while (scanLine >= prevScanLine)
@@ -448,19 +510,19 @@ namespace
 				bool finished = false;
 
 				{
-					Compat::ScopedSrwLockExclusive lock(g_vsyncCounterSrwLock);
+					Compat::ScopedSrwLockExclusive lock(g_flipCountSrwLock);
 					updateFinishedFlipCount();
 					if (g_finishedFlipCount - g_pendingFlipCount >= 0)
 					{
-						g_presentEndVsyncCount = g_vsyncCounter;
-						g_flipEndVSyncCount = g_vsyncCounter;
+						g_presentEndVsyncCount = g_vsyncCounter.load();
+						g_flipEndVSyncCount = g_vsyncCounter.load();
 						finished = true;
 					}
 				}
 
 				if (finished)
 				{
-					WakeAllConditionVariable(&g_vsyncCounterCv);
+					notifyVsyncWaiters();
 				}
 			}
 
@@ -471,11 +533,28 @@ namespace
 
 		if (scanLine < 0)
 		{
-			auto msElapsed = static_cast<DWORD>(Time::qpcToMs(Time::queryPerformanceCounter() - qpcStart));
-			if (msElapsed < 16)
+			waitForSoftwareVerticalBlank();
+		}
+	}
+
+	void waitForVsyncCount(const std::atomic<int>& endVsyncCount)
+	{
+		if (g_waitOnAddress)
+		{
+			int wakeCount = g_vsyncWakeCount;
+			while (g_vsyncCounter - endVsyncCount < 0)
 			{
-				Sleep(16 - msElapsed);
+				g_waitOnAddress(&g_vsyncWakeCount, &wakeCount, sizeof(wakeCount), INFINITE);
+				wakeCount = g_vsyncWakeCount;
 			}
+			return;
+		}
+
+		Compat::ScopedSrwLockShared lock(g_vsyncCounterSrwLock);
+		while (g_vsyncCounter - endVsyncCount < 0)
+		{
+			SleepConditionVariableSRW(&g_vsyncCounterCv, &g_vsyncCounterSrwLock, INFINITE,
+				CONDITION_VARIABLE_LOCKMODE_SHARED);
 		}
 	}
 }
@@ -487,6 +566,7 @@ namespace D3dDdi
 		void fixPresent(D3DKMT_PRESENT& data)
 		{
 			static RECT rect = {};
+			static RECT subRect = {};
 			HWND presentationWindow = DDraw::RealPrimarySurface::getPresentationWindow();
 			if (presentationWindow && data.hWindow == presentationWindow)
 			{
@@ -497,13 +577,19 @@ namespace D3dDdi
 				data.DstRect = rect;
 				if (1 == data.SubRectCnt)
 				{
-					data.pSrcSubRects = &rect;
+					subRect = rect;
+					if (!data.Flags.Flip && !IsRectEmpty(&g_presentDirtyRect) && isCompositionEnabled())
+					{
+						IntersectRect(&subRect, &subRect, &g_presentDirtyRect);
+					}
+					data.pSrcSubRects = &subRect;
 				}
 			}
+			g_presentDirtyRect = {};
 
 			if (data.Flags.Flip)
 			{
-				Compat::ScopedSrwLockExclusive lock(g_vsyncCounterSrwLock);
+				Compat::ScopedSrwLockExclusive lock(g_flipCountSrwLock);
 				++g_pendingFlipCount;
 				data.PresentCount = g_pendingFlipCount;
 				data.Flags.PresentCountValid = 1;
@@ -529,9 +615,18 @@ namespace D3dDdi
 			return g_lastOpenAdapterInfo;
 		}
 
+		long long getQpcLastVsync()
+		{
+			return g_qpcLastVsync;
+		}
+
+		long long getQpcVsyncInterval()
+		{
+			return g_qpcVsyncInterval;
+		}
+
 		int getVsyncCounter()
 		{
-			Compat::ScopedSrwLockShared lock(g_vsyncCounterSrwLock);
 			return g_vsyncCounter;
 		}
 
@@ -560,18 +655,24 @@ namespace D3dDdi
 				Compat::hookIatFunction(Dll::g_origDDrawModule, "D3DKMTSubmitPresentToHwQueue", submitPresentToHwQueue);
 			}
 
+			g_waitOnAddress = GET_PROC_ADDRESS(kernelbase, WaitOnAddress);
+			g_wakeByAddressAll = GET_PROC_ADDRESS(kernelbase, WakeByAddressAll);
+			if (!g_waitOnAddress || !g_wakeByAddressAll)
+			{
+				g_waitOnAddress = nullptr;
+				g_wakeByAddressAll = nullptr;
+			}
+
 			Dll::createThread(&vsyncThreadProc, nullptr, THREAD_PRIORITY_TIME_CRITICAL);
 		}
 
 		bool isFlipPending()
 		{
-			Compat::ScopedSrwLockShared lock(g_vsyncCounterSrwLock);
 			return g_vsyncCounter - g_flipEndVSyncCount < 0;
 		}
 
 		bool isPresentPending()
 		{
-			Compat::ScopedSrwLockShared lock(g_vsyncCounterSrwLock);
 			return g_vsyncCounter - g_presentEndVsyncCount < 0;
 		}
 
@@ -582,24 +683,25 @@ namespace D3dDdi
 
 		void setFlipEndVsyncCount()
 		{
-			Compat::ScopedSrwLockExclusive lock(g_vsyncCounterSrwLock);
+			Compat::ScopedSrwLockExclusive lock(g_flipCountSrwLock);
 			g_flipEndVSyncCount = g_vsyncCounter + 1;
 		}
 
+		void setPresentDirtyRect(const RECT& rect)
+		{
+			g_presentDirtyRect = rect;
+		}
+
 		void setPresentEndVsyncCount()
 		{
-			Compat::ScopedSrwLockExclusive lock(g_vsyncCounterSrwLock);
-			g_presentEndVsyncCount = g_vsyncCounter + (allowTearing() ? 0 : 1);
+			const bool isTearingAllowed = allowTearing();
+			Compat::ScopedSrwLockExclusive lock(g_flipCountSrwLock);
+			g_presentEndVsyncCount = g_vsyncCounter + (isTearingAllowed ? 0 : 1);
 		}
 
 		void waitForFlipEnd()
 		{
-			Compat::ScopedSrwLockShared lock(g_vsyncCounterSrwLock);
-			while (g_vsyncCounter - g_flipEndVSyncCount < 0)
-			{
-				SleepConditionVariableSRW(&g_vsyncCounterCv, &g_vsyncCounterSrwLock, INFINITE,
-					CONDITION_VARIABLE_LOCKMODE_SHARED);
-			}
+			waitForVsyncCount(g_flipEndVSyncCount);
 		}
 
 		void enableWaitForGammaRamp(bool enable)
@@ -609,12 +711,7 @@ namespace D3dDdi
 
 		void waitForPresentEnd()
 		{
-			Compat::ScopedSrwLockShared lock(g_vsyncCounterSrwLock);
-			while (g_vsyncCounter - g_presentEndVsyncCount < 0)
-			{
-				SleepConditionVariableSRW(&g_vsyncCounterCv, &g_vsyncCounterSrwLock, INFINITE,
-					CONDITION_VARIABLE_LOCKMODE_SHARED);
-			}
+			waitForVsyncCount(g_presentEndVsyncCount);
 		}
 	}
 }
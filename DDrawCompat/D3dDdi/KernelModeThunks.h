@@ -26,12 +26,15 @@ namespace D3dDdi
 		void fixPresent(D3DKMT_PRESENT& data);
 		AdapterInfo getAdapterInfo(CompatRef<IDirectDraw7> dd);
 		AdapterInfo getLastOpenAdapterInfo();
+		long long getQpcLastVsync();
+		long long getQpcVsyncInterval();
 		int getVsyncCounter();
 		void installHooks();
 		bool isFlipPending();
 		bool isPresentPending();
 		void setDcFormatOverride(UINT format);
 		void setFlipEndVsyncCount();
+		void setPresentDirtyRect(const RECT& rect);
 		void setPresentEndVsyncCount();
 		void waitForFlipEnd();
 		void waitForPresentEnd();
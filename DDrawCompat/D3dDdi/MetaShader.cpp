@@ -1,13 +1,17 @@
 #include <algorithm>
+#include <cfloat>
 #include <cmath>
+#include <fstream>
 #include <regex>
 #include <sstream>
+#include <type_traits>
 
 #include <Windows.h>
 #include <mmsystem.h>
 #include <winnt.h>
 
 #include <Common/Comparison.h>
+#include <Common/JobPool.h>
 #include <Common/Log.h>
 #include <Common/Path.h>
 #include <Common/Rect.h>
@@ -16,24 +20,42 @@
 #include <Config/Parser.h>
 #include <D3dDdi/Adapter.h>
 #include <D3dDdi/Device.h>
+#include <D3dDdi/FormatInfo.h>
 #include <D3dDdi/MetaShader.h>
 #include <D3dDdi/Resource.h>
 #include <D3dDdi/ScopedCriticalSection.h>
+#include <D3dDdi/ShaderAssembler.h>
 #include <D3dDdi/ShaderBlitter.h>
 #include <DDraw/RealPrimarySurface.h>
-#include <Dll/Dll.h>
 #include <Gdi/GuiThread.h>
 #include <Overlay/ConfigWindow.h>
+#include <Overlay/StatsWindow.h>
 
 namespace
 {
 	const int FRAME_INTERVAL = 20;
+	const UINT PRESET_CACHE_MAGIC = 0x50474344;
+	const UINT PRESET_CACHE_VERSION = 4;
+	const UINT PRESET_CACHE_MAX_ELEMENT_COUNT = 0x1000000;
 
-	UINT g_runningThreads = 0;
-	UINT g_maxThreads = 0;
+	struct PresetCacheHeader
+	{
+		UINT magic;
+		UINT version;
+		Hash::Digest compilerHash;
+	};
 
 	std::string_view getNextCommentLine(const std::string& assembly, std::string_view prev);
 
+	void addSkippedPasses(int count)
+	{
+		auto statsWindow = Gdi::GuiThread::getStatsWindow();
+		if (0 != count && statsWindow && statsWindow->m_cgpSkippedPasses.isEnabled())
+		{
+			statsWindow->m_cgpSkippedPasses.add(StatsQueue::getTickCount(), count);
+		}
+	}
+
 	std::string_view getFirstRegisterCommentFromAssembly(const std::string& assembly)
 	{
 		auto comment = getNextCommentLine(assembly, {});
@@ -167,6 +189,122 @@ namespace
 		}
 		throw D3dDdi::MetaShader::ShaderStatus::ParseError;
 	}
+
+	template <typename T>
+	void readValue(std::istream& is, T& value)
+	{
+		static_assert(std::is_trivially_copyable_v<T>);
+		is.read(reinterpret_cast<char*>(&value), sizeof(value));
+	}
+
+	UINT readSize(std::istream& is)
+	{
+		UINT size = 0;
+		readValue(is, size);
+		if (size > PRESET_CACHE_MAX_ELEMENT_COUNT)
+		{
+			is.setstate(std::ios::failbit);
+		}
+		return is ? size : 0;
+	}
+
+	template <typename Char>
+	void readValue(std::istream& is, std::basic_string<Char>& value)
+	{
+		value.resize(readSize(is));
+		is.read(reinterpret_cast<char*>(value.data()), value.size() * sizeof(Char));
+	}
+
+	void readValue(std::istream& is, std::filesystem::path& value)
+	{
+		std::filesystem::path::string_type str;
+		readValue(is, str);
+		value = str;
+	}
+
+	void readValue(std::istream& is, D3dDdi::ShaderCompiler::Parameter& value)
+	{
+		readValue(is, value.name);
+		readValue(is, value.description);
+		readValue(is, value.defaultValue);
+		readValue(is, value.min);
+		readValue(is, value.max);
+		readValue(is, value.step);
+		value.currentValue = value.defaultValue;
+	}
+
+	template <typename T>
+	void readValue(std::istream& is, std::vector<T>& value)
+	{
+		value.resize(readSize(is));
+		for (auto& elem : value)
+		{
+			readValue(is, elem);
+		}
+	}
+
+	template <typename Key, typename Value>
+	void readValue(std::istream& is, std::map<Key, Value>& value)
+	{
+		value.clear();
+		const UINT size = readSize(is);
+		for (UINT i = 0; i < size && is; ++i)
+		{
+			Key key = {};
+			readValue(is, key);
+			readValue(is, value[key]);
+		}
+	}
+
+	template <typename T>
+	void writeValue(std::ostream& os, const T& value)
+	{
+		static_assert(std::is_trivially_copyable_v<T>);
+		os.write(reinterpret_cast<const char*>(&value), sizeof(value));
+	}
+
+	template <typename Char>
+	void writeValue(std::ostream& os, const std::basic_string<Char>& value)
+	{
+		writeValue<UINT>(os, value.size());
+		os.write(reinterpret_cast<const char*>(value.data()), value.size() * sizeof(Char));
+	}
+
+	void writeValue(std::ostream& os, const std::filesystem::path& value)
+	{
+		writeValue(os, value.native());
+	}
+
+	void writeValue(std::ostream& os, const D3dDdi::ShaderCompiler::Parameter& value)
+	{
+		writeValue(os, value.name);
+		writeValue(os, value.description);
+		writeValue(os, value.defaultValue);
+		writeValue(os, value.min);
+		writeValue(os, value.max);
+		writeValue(os, value.step);
+	}
+
+	template <typename T>
+	void writeValue(std::ostream& os, const std::vector<T>& value)
+	{
+		writeValue<UINT>(os, value.size());
+		for (const auto& elem : value)
+		{
+			writeValue(os, elem);
+		}
+	}
+
+	template <typename Key, typename Value>
+	void writeValue(std::ostream& os, const std::map<Key, Value>& value)
+	{
+		writeValue<UINT>(os, value.size());
+		for (const auto& elem : value)
+		{
+			writeValue(os, elem.first);
+			writeValue(os, elem.second);
+		}
+	}
 }
 
 namespace D3dDdi
@@ -178,6 +316,30 @@ namespace D3dDdi
 		init();
 	}
 
+	void MetaShader::checkDirectOutputPass()
+	{
+		const auto& pass = m_passes[m_passCount - 1];
+		m_isOutputPassDirect = ScaleType::Viewport == pass.scale_type_x && 1.0f == pass.scale_x &&
+			ScaleType::Viewport == pass.scale_type_y && 1.0f == pass.scale_y;
+		LOG_DEBUG << "Output pass rendered directly: " << m_isOutputPassDirect;
+	}
+
+	void MetaShader::checkFusablePasses()
+	{
+		for (int i = 1; i < m_passCount; ++i)
+		{
+			const auto& prevPass = m_passes[i - 1];
+			auto& pass = m_passes[i];
+			pass.isFusable = !prevPass.isFusable &&
+				ScaleType::Source == pass.scale_type_x && 1.0f == pass.scale_x &&
+				ScaleType::Source == pass.scale_type_y && 1.0f == pass.scale_y &&
+				!pass.filter_linear && !pass.mipmap_input &&
+				prevPass.float_framebuffer == pass.float_framebuffer &&
+				prevPass.srgb_framebuffer == pass.srgb_framebuffer &&
+				prevPass.frame_count_mod == pass.frame_count_mod;
+		}
+	}
+
 	void MetaShader::clearUnusedBitmaps()
 	{
 		std::set<std::filesystem::path> usedBitmaps;
@@ -210,19 +372,6 @@ namespace D3dDdi
 			return;
 		}
 
-		if (0 == g_maxThreads)
-		{
-			DWORD_PTR processAffinityMask = 0;
-			DWORD_PTR systemAffinityMask = 0;
-			GetProcessAffinityMask(GetCurrentProcess(), &processAffinityMask, &systemAffinityMask);
-			while (0 != processAffinityMask)
-			{
-				g_maxThreads += processAffinityMask & 1;
-				processAffinityMask >>= 1;
-			}
-			g_maxThreads = g_maxThreads > 2 ? g_maxThreads - 2 : 1;
-		}
-
 		auto status = ShaderStatus::Compiled;
 		for (int i = 0; i < m_passCount; ++i)
 		{
@@ -238,29 +387,23 @@ namespace D3dDdi
 					throw ShaderStatus::CompileError;
 				}
 				m_passes[i].shader->second.parameters = *parameters;
+				m_passes[i].shader->second.sourceFiles = compiler.getSourceFiles();
 				m_passes[i].shader->second.status = ShaderStatus::Preprocessed;
 			}
 			[[fallthrough]];
 
 			case ShaderStatus::Preprocessed:
-				if (g_runningThreads < g_maxThreads)
+			{
+				auto shader = &*m_passes[i].shader;
+				shader->second.status = ShaderStatus::Compiling;
+				if (!JobPool::submit(getCompilePriority(i), [=]() { compileShader(*shader); }))
 				{
-					HANDLE thread = Dll::createThread(&compileThreadProc, nullptr, THREAD_PRIORITY_TIME_CRITICAL, 0,
-						const_cast<void*>(reinterpret_cast<const void*>(&*m_passes[i].shader)));
-					if (thread)
-					{
-						m_passes[i].shader->second.status = ShaderStatus::Compiling;
-						++g_runningThreads;
-						CloseHandle(thread);
-					}
-					else
-					{
-						m_passes[i].shader->second.status = ShaderStatus::CompileError;
-						throw ShaderStatus::CompileError;
-					}
+					shader->second.status = ShaderStatus::CompileError;
+					throw ShaderStatus::CompileError;
 				}
 				status = ShaderStatus::Compiling;
 				break;
+			}
 
 			case ShaderStatus::Compiling:
 				status = ShaderStatus::Compiling;
@@ -271,15 +414,22 @@ namespace D3dDdi
 			}
 		}
 
-		bool startBitmapLoad = false;
 		for (const auto& texture : m_textures)
 		{
 			switch (texture.second.bitmap->second.status)
 			{
 			case ShaderStatus::Init:
+			{
+				const auto path = texture.second.bitmap->first;
 				texture.second.bitmap->second.status = ShaderStatus::Compiling;
-				startBitmapLoad = true;
+				if (!JobPool::submit(getCompilePriority(m_passCount), [=]() { loadBitmap(path); }))
+				{
+					texture.second.bitmap->second.status = ShaderStatus::CompileError;
+					throw ShaderStatus::CompileError;
+				}
+				status = ShaderStatus::Compiling;
 				break;
+			}
 
 			case ShaderStatus::Compiling:
 				status = ShaderStatus::Compiling;
@@ -290,27 +440,40 @@ namespace D3dDdi
 			};
 		}
 
-		if (startBitmapLoad)
+		if (ShaderStatus::Compiled == status && fusePasses())
 		{
 			status = ShaderStatus::Compiling;
-			Gdi::GuiThread::executeAsyncFunc([]()
-				{
-					D3dDdi::ScopedCriticalSection lock;
-					loadBitmaps();
-				});
 		}
 
 		if (ShaderStatus::Compiled == status)
 		{
 			setup();
 			setStatus(ShaderStatus::Compiled);
+			if (!m_isCached)
+			{
+				saveToCache();
+			}
 		}
 	}
 
-	unsigned WINAPI MetaShader::compileThreadProc(LPVOID lpParameter)
+	void MetaShader::compileFusedShader(std::pair<const std::filesystem::path, Shader>& shader,
+		const std::filesystem::path& prevPath, const std::filesystem::path& path,
+		const std::string& prevInputSampler, const std::set<std::string>& inputSamplers)
+	{
+		D3dDdi::ShaderCompiler prevCompiler(prevPath);
+		D3dDdi::ShaderCompiler compiler(path);
+		compiler.fuse(prevCompiler, prevInputSampler, inputSamplers);
+		compileShader(shader, compiler);
+	}
+
+	void MetaShader::compileShader(std::pair<const std::filesystem::path, Shader>& shader)
 	{
-		auto& shader = *reinterpret_cast<decltype(&*s_shaders.begin())>(lpParameter);
 		D3dDdi::ShaderCompiler compiler(shader.first);
+		compileShader(shader, compiler);
+	}
+
+	void MetaShader::compileShader(std::pair<const std::filesystem::path, Shader>& shader, ShaderCompiler& compiler)
+	{
 		compiler.compile();
 
 		shader.second.vs = getCompiledShader(compiler.getVs());
@@ -334,25 +497,7 @@ namespace D3dDdi
 		}
 
 		D3dDdi::ScopedCriticalSection lock;
-		--g_runningThreads;
-
-		for (auto& device : D3dDdi::Device::getDevices())
-		{
-			auto& metaShader = device.second.getShaderBlitter().getMetaShader();
-			if (ShaderStatus::Compiling == metaShader.m_status)
-			{
-				try
-				{
-					metaShader.compile();
-				}
-				catch (ShaderStatus status)
-				{
-					metaShader.setStatus(status);
-				}
-			}
-		}
-
-		return 0;
+		resumeCompile();
 	}
 
 	void MetaShader::createShaders(Pass& pass)
@@ -407,6 +552,74 @@ namespace D3dDdi
 		}
 	}
 
+	bool MetaShader::fusePasses()
+	{
+		bool isCompiling = false;
+		for (int i = 1; i < m_passCount; ++i)
+		{
+			auto& pass = m_passes[i];
+			if (!pass.isFusable)
+			{
+				continue;
+			}
+
+			if (pass.fusedShader == s_shaders.end())
+			{
+				std::string prevInputSampler;
+				std::set<std::string> inputSamplers;
+				if (!getFusionInputs(i, prevInputSampler, inputSamplers))
+				{
+					pass.isFusable = false;
+					continue;
+				}
+
+				const auto& prevShader = *m_passes[i - 1].shader;
+				const auto& shader = *pass.shader;
+				auto fusedPath(prevShader.first);
+				fusedPath += "|";
+				fusedPath += shader.first;
+				pass.fusedShader = s_shaders.emplace(fusedPath, Shader{}).first;
+
+				auto fusedShader = &*pass.fusedShader;
+				if (ShaderStatus::Init == fusedShader->second.status)
+				{
+					fusedShader->second.parameters = shader.second.parameters;
+					fusedShader->second.sourceFiles = shader.second.sourceFiles;
+					fusedShader->second.sourceFiles.insert(
+						prevShader.second.sourceFiles.begin(), prevShader.second.sourceFiles.end());
+					fusedShader->second.status = ShaderStatus::Compiling;
+
+					const auto prevPath(prevShader.first);
+					const auto path(shader.first);
+					if (!JobPool::submit(getCompilePriority(i), [=]()
+						{ compileFusedShader(*fusedShader, prevPath, path, prevInputSampler, inputSamplers); }))
+					{
+						fusedShader->second.status = ShaderStatus::CompileError;
+					}
+				}
+			}
+
+			switch (pass.fusedShader->second.status)
+			{
+			case ShaderStatus::Compiling:
+				isCompiling = true;
+				break;
+
+			case ShaderStatus::Compiled:
+				LOG_DEBUG << "Fused pass " << i - 1 << " into pass " << i;
+				m_passes[i - 1].isFused = true;
+				pass.shader = pass.fusedShader;
+				pass.isFusable = false;
+				break;
+
+			default:
+				pass.isFusable = false;
+				break;
+			}
+		}
+		return isCompiling;
+	}
+
 	void MetaShader::generateMipSubLevels(const Resource& resource)
 	{
 		for (unsigned i = 1; i < resource.getFixedDesc().SurfCount; ++i)
@@ -455,6 +668,42 @@ namespace D3dDdi
 		return compiledShader;
 	}
 
+	int MetaShader::getCompilePriority(int passIndex) const
+	{
+		if (passIndex < m_passCount &&
+			ScaleType::Source == m_passes[passIndex].scale_type_x &&
+			ScaleType::Source == m_passes[passIndex].scale_type_y)
+		{
+			return passIndex;
+		}
+		return m_passCount + passIndex;
+	}
+
+	int MetaShader::getFirstChangedPass(bool isSrcUnchanged, const RECT& dstRect, bool isOutputPassDirect) const
+	{
+		if (!isSrcUnchanged || 0 != m_maxPrevInputFrames ||
+			m_srcPass.outputSize != m_prevInputSize || dstRect != m_prevDstRect)
+		{
+			return 0;
+		}
+
+		const int cachedPassCount = isOutputPassDirect ? m_passCount - 1 : m_passCount;
+		for (int i = 0; i < cachedPassCount; ++i)
+		{
+			const auto& pass = m_passes[i];
+			if (pass.isFused)
+			{
+				continue;
+			}
+			if (pass.vsConsts.frameCountReg || pass.psConsts.frameCountReg ||
+				!pass.rtt.surface || FAILED(pass.rtt.surface->IsLost(pass.rtt.surface)))
+			{
+				return i;
+			}
+		}
+		return cachedPassCount;
+	}
+
 	D3DDDIFORMAT MetaShader::getFormat(bool float_framebuffer)
 	{
 		if (float_framebuffer)
@@ -480,6 +729,139 @@ namespace D3dDdi
 		return m_srcPass.rtt.format;
 	}
 
+	bool MetaShader::getFusionInputs(int passIndex, std::string& prevInputSampler, std::set<std::string>& inputSamplers)
+	{
+		// The fused shader evaluates the previous pass in place of sampling its output, which gives the same result
+		// only if the input is sampled at the pixel centers of this pass, and both passes have the same vertex positions
+		const auto& prevShader = m_passes[passIndex - 1].shader->second;
+		const auto& shader = m_passes[passIndex].shader->second;
+		if (!prevShader.vs.samplers.empty() || !shader.vs.samplers.empty())
+		{
+			return false;
+		}
+
+		try
+		{
+			const std::pair<const CompiledShader*, int> compiledShaders[] = {
+				{ &prevShader.vs, passIndex - 1 }, { &prevShader.ps, passIndex - 1 },
+				{ &shader.vs, passIndex }, { &shader.ps, passIndex } };
+			for (const auto& [compiledShader, index] : compiledShaders)
+			{
+				for (const auto& registers : { &compiledShader->samplers, &compiledShader->uniforms })
+				{
+					for (const auto& reg : *registers)
+					{
+						const auto pos = reg.first.find("__");
+						if (std::string::npos != pos && "IN" != reg.first.substr(0, pos) &&
+							getPassIndexFromStructName(reg.first.substr(0, pos), index) < 0)
+						{
+							return false;
+						}
+					}
+				}
+			}
+
+			for (int i = passIndex + 1; i < m_passCount; ++i)
+			{
+				const auto& laterShader = m_passes[i].shader->second;
+				for (const auto samplers : { &laterShader.vs.samplers, &laterShader.ps.samplers })
+				{
+					for (const auto& sampler : *samplers)
+					{
+						const auto pos = sampler.first.find("__");
+						if (std::string::npos != pos && "IN" != sampler.first.substr(0, pos) &&
+							passIndex == getSamplerInputPassIndex(sampler.first, i))
+						{
+							return false;
+						}
+					}
+				}
+			}
+
+			prevInputSampler.clear();
+			for (const auto& sampler : prevShader.ps.samplers)
+			{
+				if (0 == sampler.second.index && std::string::npos == sampler.first.find("__") &&
+					m_textures.find(sampler.first) == m_textures.end())
+				{
+					prevInputSampler = sampler.first;
+				}
+			}
+
+			std::set<UINT> inputSamplerRegs;
+			inputSamplers.clear();
+			for (const auto& sampler : shader.ps.samplers)
+			{
+				if (passIndex == getSamplerInputPassIndex(sampler.first, passIndex))
+				{
+					inputSamplers.insert(sampler.first);
+					inputSamplerRegs.insert(sampler.second.index);
+				}
+			}
+			if (inputSamplers.empty())
+			{
+				return false;
+			}
+
+			auto getPositionTransform = [](const CompiledShader& vs)
+				{
+					ShaderAssembler shaderAssembler(reinterpret_cast<const UINT*>(vs.code.data()), vs.code.size() / 4);
+					const auto it = vs.uniforms.find("modelViewProj");
+					return it == vs.uniforms.end() ? shaderAssembler.getPositionTransform(0, 0)
+						: shaderAssembler.getPositionTransform(it->second.index, it->second.count);
+				};
+
+			const auto prevTransform = getPositionTransform(prevShader.vs);
+			if (!prevTransform || prevTransform != getPositionTransform(shader.vs))
+			{
+				return false;
+			}
+
+			ShaderAssembler psAssembler(reinterpret_cast<const UINT*>(shader.ps.code.data()), shader.ps.code.size() / 4);
+			const auto psTexCoords = psAssembler.getSamplerTexCoords(inputSamplerRegs);
+			if (!psTexCoords)
+			{
+				return false;
+			}
+
+			ShaderAssembler vsAssembler(reinterpret_cast<const UINT*>(shader.vs.code.data()), shader.vs.code.size() / 4);
+			const auto passThroughTexCoords = vsAssembler.getPassThroughTexCoords();
+			for (auto psTexCoord : *psTexCoords)
+			{
+				const auto vsTexCoord = passThroughTexCoords.find(psTexCoord);
+				if (vsTexCoord == passThroughTexCoords.end() ||
+					shader.texCoords.end() == std::find_if(shader.texCoords.begin(), shader.texCoords.end(),
+						[&](const auto& texCoord)
+						{
+							if (texCoord.second != vsTexCoord->second)
+							{
+								return false;
+							}
+							const auto pos = texCoord.first.find("__");
+							if (std::string::npos == pos)
+							{
+								return 0 == texCoord.second;
+							}
+							if ("tex_coord" != texCoord.first.substr(pos + 2))
+							{
+								return false;
+							}
+							const auto prevPassIndex = getPassIndexFromStructName(texCoord.first.substr(0, pos), passIndex);
+							return MAXINT == prevPassIndex ? 0 == texCoord.second : passIndex == prevPassIndex;
+						}))
+				{
+					return false;
+				}
+			}
+		}
+		catch (ShaderStatus)
+		{
+			return false;
+		}
+
+		return true;
+	}
+
 	int MetaShader::getOutputSize(int inputSize, int vpSize, ScaleType scale_type, float scale) const
 	{
 		switch (scale_type)
@@ -621,46 +1003,41 @@ namespace D3dDdi
 		}
 	}
 
+	int MetaShader::getSamplerInputPassIndex(const std::string& name, int passIndex) const
+	{
+		if (m_textures.find(name) != m_textures.end())
+		{
+			return MAXINT;
+		}
+
+		const auto pos = name.find("__");
+		if (std::string::npos == pos || "IN" == name.substr(0, pos))
+		{
+			return passIndex;
+		}
+		return getPassIndexFromStructName(name.substr(0, pos), passIndex);
+	}
+
 	MetaShader::Vertex& MetaShader::getVertex(int index)
 	{
 		return reinterpret_cast<Vertex&>(m_vertices[index * m_vertexSize]);
 	}
 
-	void MetaShader::loadBitmaps()
+	void MetaShader::loadBitmap(const std::filesystem::path& path)
 	{
-		LOG_FUNC("MetaShader::loadBitmaps");
-		ShaderStatus status = ShaderStatus::Compiled;
-		for (auto& bitmap : s_bitmaps)
-		{
-			if (ShaderStatus::Compiling == bitmap.second.status)
-			{
-				bitmap.second.bitmap = { Gdi::GuiThread::wicLoadImage(bitmap.first), &DeleteObject };
-				if (!bitmap.second.bitmap)
-				{
-					status = ShaderStatus::CompileError;
-					break;
-				}
-			}
-			else if (ShaderStatus::CompileError == bitmap.second.status)
-			{
-				status = ShaderStatus::CompileError;
-				break;
-			}
-		}
+		LOG_FUNC("MetaShader::loadBitmap", path.string());
+		std::shared_ptr<HBITMAP__> bitmap(Gdi::GuiThread::wicLoadImage(path), &DeleteObject);
 
-		for (auto& bitmap : s_bitmaps)
+		D3dDdi::ScopedCriticalSection lock;
+		auto it = s_bitmaps.find(path);
+		if (it == s_bitmaps.end() || ShaderStatus::Compiling != it->second.status)
 		{
-			bitmap.second.status = status;
-			if (ShaderStatus::CompileError == status)
-			{
-				bitmap.second.bitmap.reset();
-			}
+			return;
 		}
 
-		for (auto& device : D3dDdi::Device::getDevices())
-		{
-			device.second.getShaderBlitter().getMetaShader().compile();
-		}
+		it->second.bitmap = bitmap;
+		it->second.status = bitmap ? ShaderStatus::Compiled : ShaderStatus::CompileError;
+		resumeCompile();
 	}
 
 	void MetaShader::loadCgp(const std::filesystem::path& relPath)
@@ -675,7 +1052,7 @@ namespace D3dDdi
 
 		for (const auto& baseDir : getBaseDirs())
 		{
-			if (parseCgp(baseDir))
+			if (loadFromCache(baseDir) || parseCgp(baseDir))
 			{
 				break;
 			}
@@ -692,6 +1069,160 @@ namespace D3dDdi
 		{
 			validatePass(i);
 		}
+
+		checkDirectOutputPass();
+		if (!m_isCached)
+		{
+			checkFusablePasses();
+		}
+	}
+
+	bool MetaShader::loadFromCache(const std::filesystem::path& baseDir)
+	{
+		LOG_FUNC("MetaShader::loadFromCache", baseDir.string());
+		const auto absPath((baseDir / m_relPath).lexically_normal());
+		auto cachePath(absPath);
+		cachePath += ".dcc";
+		std::ifstream f(cachePath, std::ios::binary);
+		if (f.fail())
+		{
+			return LOG_RESULT(false);
+		}
+
+		PresetCacheHeader header = {};
+		readValue(f, header);
+		if (f.fail() || PRESET_CACHE_MAGIC != header.magic || PRESET_CACHE_VERSION != header.version)
+		{
+			LOG_DEBUG << "Invalid file header";
+			return LOG_RESULT(false);
+		}
+
+		if (ShaderCompiler::getCompilerHash() != header.compilerHash)
+		{
+			LOG_DEBUG << "Compiler hash mismatch";
+			return LOG_RESULT(false);
+		}
+
+		std::map<std::filesystem::path, Hash::Digest> sourceFiles;
+		readValue(f, sourceFiles);
+		if (f.fail() || sourceFiles.find(absPath) == sourceFiles.end())
+		{
+			LOG_DEBUG << "Failed to read source file list";
+			return LOG_RESULT(false);
+		}
+
+		for (const auto& sourceFile : sourceFiles)
+		{
+			if (ShaderCompiler::getFileHash(sourceFile.first) != sourceFile.second)
+			{
+				LOG_DEBUG << "Source file hash mismatch: " << sourceFile.first.string();
+				return LOG_RESULT(false);
+			}
+		}
+
+		std::vector<std::pair<std::filesystem::path, Shader>> shaders(readSize(f));
+		for (auto& shader : shaders)
+		{
+			readValue(f, shader.first);
+			for (auto compiledShader : { &shader.second.vs, &shader.second.ps })
+			{
+				readValue(f, compiledShader->code);
+				readValue(f, compiledShader->samplers);
+				readValue(f, compiledShader->uniforms);
+				readValue(f, compiledShader->minRegisterIndex);
+				readValue(f, compiledShader->maxRegisterIndex);
+			}
+			readValue(f, shader.second.parameters);
+			readValue(f, shader.second.texCoords);
+			readValue(f, shader.second.sourceFiles);
+			shader.second.status = ShaderStatus::Compiled;
+		}
+
+		int passCount = 0;
+		readValue(f, passCount);
+		if (f.fail() || passCount <= 0 || passCount > static_cast<int>(m_passes.size()))
+		{
+			LOG_DEBUG << "Invalid pass count";
+			return LOG_RESULT(false);
+		}
+
+		std::vector<UINT> shaderIndexes(passCount);
+		std::vector<Pass> passes(passCount);
+		for (int i = 0; i < passCount; ++i)
+		{
+			auto& pass = passes[i];
+			readValue(f, shaderIndexes[i]);
+			readValue(f, pass.alias);
+			readValue(f, pass.filter_linear);
+			readValue(f, pass.float_framebuffer);
+			readValue(f, pass.frame_count_mod);
+			readValue(f, pass.mipmap_input);
+			readValue(f, pass.scale_type);
+			readValue(f, pass.scale_type_x);
+			readValue(f, pass.scale_type_y);
+			readValue(f, pass.scale);
+			readValue(f, pass.scale_x);
+			readValue(f, pass.scale_y);
+			readValue(f, pass.srgb_framebuffer);
+			readValue(f, pass.wrap_mode);
+			readValue(f, pass.isFused);
+			if (shaderIndexes[i] >= shaders.size())
+			{
+				f.setstate(std::ios::failbit);
+			}
+		}
+
+		std::map<std::string, float> parameters;
+		readValue(f, parameters);
+
+		std::vector<std::string> textureNames(readSize(f));
+		std::vector<std::filesystem::path> texturePaths(textureNames.size());
+		std::vector<Texture> textures(textureNames.size());
+		for (std::size_t i = 0; i < textures.size(); ++i)
+		{
+			readValue(f, textureNames[i]);
+			readValue(f, texturePaths[i]);
+			readValue(f, textures[i].linear);
+			readValue(f, textures[i].mipmap);
+			readValue(f, textures[i].wrap_mode);
+		}
+
+		char c = 0;
+		if (f.fail() || f.read(&c, 1) || !f.eof())
+		{
+			LOG_DEBUG << "Failed to read cache data";
+			return LOG_RESULT(false);
+		}
+
+		std::vector<decltype(s_shaders)::iterator> shaderIters;
+		for (auto& shader : shaders)
+		{
+			auto it = s_shaders.emplace(shader.first, Shader{}).first;
+			if (ShaderStatus::Init == it->second.status || ShaderStatus::Preprocessed == it->second.status)
+			{
+				it->second = std::move(shader.second);
+			}
+			shaderIters.push_back(it);
+		}
+
+		for (int i = 0; i < passCount; ++i)
+		{
+			m_passes[i] = std::move(passes[i]);
+			m_passes[i].shader = shaderIters[shaderIndexes[i]];
+		}
+
+		for (std::size_t i = 0; i < textures.size(); ++i)
+		{
+			auto& texture = m_textures[textureNames[i]];
+			texture = textures[i];
+			texture.bitmap = s_bitmaps.emplace(texturePaths[i], Bitmap{}).first;
+		}
+
+		m_absPath = absPath;
+		m_parameters = parameters;
+		m_passCount = passCount;
+		m_isCached = true;
+		return LOG_RESULT(true);
 	}
 
 	void MetaShader::loadTexture(Texture& texture)
@@ -885,6 +1416,7 @@ namespace D3dDdi
 	{
 		LOG_FUNC("MetaShader::init");
 
+		const auto initQpc = Time::queryPerformanceCounter();
 		reset();
 
 		if (Config::Settings::DisplayFilter::CGP != Config::displayFilter.get())
@@ -895,6 +1427,7 @@ namespace D3dDdi
 		try
 		{
 			loadCgp(Config::displayFilter.getCgpPath());
+			m_initQpc = initQpc;
 			m_status = ShaderStatus::Compiling;
 			compile();
 			updateParameters();
@@ -906,10 +1439,10 @@ namespace D3dDdi
 	}
 
 	void MetaShader::render(const Resource& dstResource, UINT dstSubResourceIndex, const RECT& dstRect,
-		const Resource& srcResource, UINT srcSubResourceIndex, const RECT& srcRect)
+		const Resource& srcResource, UINT srcSubResourceIndex, const RECT& srcRect, bool isSrcUnchanged)
 	{
 		LOG_FUNC("MetaShader::render", static_cast<HANDLE>(dstResource), dstSubResourceIndex, dstRect,
-			static_cast<HANDLE>(srcResource), srcSubResourceIndex, srcRect);
+			static_cast<HANDLE>(srcResource), srcSubResourceIndex, srcRect, isSrcUnchanged);
 
 		try
 		{
@@ -933,15 +1466,30 @@ namespace D3dDdi
 
 				setupPrevInputFrames();
 
-				for (int i = 0; i < m_passCount; ++i)
+				const bool isOutputPassDirect = m_isOutputPassDirect && 0 == dstSubResourceIndex;
+				const int firstChangedPass = getFirstChangedPass(isSrcUnchanged, dstRect, isOutputPassDirect);
+				for (int i = firstChangedPass; i < m_passCount; ++i)
 				{
-					renderPass(dstRect, i);
+					renderPass(dstRect, i, isOutputPassDirect && i == m_passCount - 1);
 				}
 				m_prevInputSize = m_srcPass.outputSize;
+				m_prevDstRect = dstRect;
+				addSkippedPasses(firstChangedPass);
 
-				const auto& lastPass = m_passes[m_passCount - 1];
-				dstResource.getDevice().getShaderBlitter().bilinearBlt(dstResource, dstSubResourceIndex, dstRect,
-					*lastPass.rtt.resource, 0, { 0, 0, lastPass.outputSize.cx, lastPass.outputSize.cy }, 100);
+				if (!isOutputPassDirect)
+				{
+					const auto& lastPass = m_passes[m_passCount - 1];
+					dstResource.getDevice().getShaderBlitter().bilinearBlt(dstResource, dstSubResourceIndex, dstRect,
+						*lastPass.rtt.resource, 0, { 0, 0, lastPass.outputSize.cx, lastPass.outputSize.cy }, 100);
+				}
+
+				if (0 != m_initQpc)
+				{
+					LOG_INFO << "Time to first filtered frame: "
+						<< Time::qpcToMs(Time::queryPerformanceCounter() - m_initQpc) << " ms"
+						<< (m_isCached ? " (cached preset)" : "");
+					m_initQpc = 0;
+				}
 
 				if (m_prevInputFrameCandidate.rtt.surface)
 				{
@@ -960,7 +1508,7 @@ namespace D3dDdi
 			srcResource, srcSubResourceIndex, srcRect, 0);
 	}
 
-	void MetaShader::renderPass(const RECT& dstRect, int passIndex)
+	void MetaShader::renderPass(const RECT& dstRect, int passIndex, bool isOutputPass)
 	{
 		auto& pass = m_passes[passIndex];
 		const auto& prevPass = getPass(passIndex - 1);
@@ -972,9 +1520,12 @@ namespace D3dDdi
 			pass.outputSize.cy = getOutputSize(prevPass.outputSize.cy, m_dstPass.outputSize.cy,
 				pass.scale_type_y, pass.scale_y);
 
-			setupUniforms(pass.shader->second.vs, pass.vsConsts, passIndex);
-			setupUniforms(pass.shader->second.ps, pass.psConsts, passIndex);
-			setupVertices(passIndex);
+			if (!pass.isFused)
+			{
+				updateUniforms(pass.vsUniforms, pass.vsConsts);
+				updateUniforms(pass.psUniforms, pass.psConsts);
+				setupVertices(passIndex);
+			}
 		}
 
 		if (pass.mipmap_input)
@@ -982,9 +1533,29 @@ namespace D3dDdi
 			generateMipSubLevels(*prevPass.rtt.resource);
 		}
 
-		getSurface(pass.rtt, getFormat(pass.float_framebuffer), pass.outputSize,
-			DDSCAPS_TEXTURE | DDSCAPS_3DDEVICE | DDSCAPS_VIDEOMEMORY |
-			(getPass(passIndex + 1).mipmap_input ? DDSCAPS_MIPMAP : 0));
+		if (pass.isFused)
+		{
+			// The next pass evaluates this pass inline, only the size of its render target is needed
+			pass.rtt.width = pass.outputSize.cx;
+			pass.rtt.height = pass.outputSize.cy;
+			pass.rtt.format = getFormat(pass.float_framebuffer);
+			return;
+		}
+
+		if (isOutputPass)
+		{
+			m_device.getRepo().release(pass.rtt);
+			pass.rtt.resource = m_dstPass.rtt.resource;
+			pass.rtt.width = m_dstPass.rtt.width;
+			pass.rtt.height = m_dstPass.rtt.height;
+			pass.rtt.format = m_dstPass.rtt.format;
+		}
+		else
+		{
+			getSurface(pass.rtt, getFormat(pass.float_framebuffer), pass.outputSize,
+				DDSCAPS_TEXTURE | DDSCAPS_3DDEVICE | DDSCAPS_VIDEOMEMORY |
+				(getPass(passIndex + 1).mipmap_input ? DDSCAPS_MIPMAP : 0));
+		}
 
 		auto& state = m_device.getState();
 		state.setTempRenderTarget({ 0, *pass.rtt.resource, 0 });
@@ -1028,7 +1599,10 @@ namespace D3dDdi
 		state.setTempRenderState({ D3DDDIRS_SCISSORTESTENABLE, FALSE });
 		state.setTempRenderState({ D3DDDIRS_SRGBWRITEENABLE, pass.srgb_framebuffer });
 
-		setTexture(0, *prevPass.rtt.resource, pass.wrap_mode, pass.filter_linear, prevPass.srgb_framebuffer);
+		const auto& inputPass = prevPass.isFused ? prevPass : pass;
+		const auto& inputPrevPass = prevPass.isFused ? getPass(passIndex - 2) : prevPass;
+		setTexture(0, *inputPrevPass.rtt.resource, inputPass.wrap_mode, inputPass.filter_linear,
+			inputPrevPass.srgb_framebuffer);
 		updateSamplers(pass.vsSamplers);
 		updateSamplers(pass.psSamplers);
 
@@ -1037,13 +1611,13 @@ namespace D3dDdi
 		if (!pass.vsConsts.consts.empty())
 		{
 			const D3DDDIARG_SETVERTEXSHADERCONST vsConst = { pass.vsConsts.firstConst, pass.vsConsts.consts.size() };
-			m_device.getOrigVtable().pfnSetVertexShaderConst(m_device, &vsConst, &pass.vsConsts.consts[0][0]);
+			state.setTempVertexShaderConst(vsConst, &pass.vsConsts.consts[0][0]);
 		}
 
 		if (!pass.psConsts.consts.empty())
 		{
 			const D3DDDIARG_SETPIXELSHADERCONST psConst = { pass.psConsts.firstConst, pass.psConsts.consts.size() };
-			m_device.getOrigVtable().pfnSetPixelShaderConst(m_device, &psConst, &pass.psConsts.consts[0][0]);
+			state.setTempPixelShaderConst(psConst, &pass.psConsts.consts[0][0]);
 		}
 
 		D3DDDIARG_DRAWPRIMITIVE dp = {};
@@ -1095,9 +1669,153 @@ namespace D3dDdi
 		}
 		m_frameCount = 0;
 		m_prevInputSize = {};
+		m_prevDstRect = {};
+		m_isOutputPassDirect = false;
+		m_initQpc = 0;
+		m_isCached = false;
 		m_status = ShaderStatus::Init;
 	}
 
+	void MetaShader::resumeCompile()
+	{
+		for (auto& device : D3dDdi::Device::getDevices())
+		{
+			auto& metaShader = device.second.getShaderBlitter().getMetaShader();
+			if (ShaderStatus::Compiling == metaShader.m_status)
+			{
+				try
+				{
+					metaShader.compile();
+				}
+				catch (ShaderStatus status)
+				{
+					metaShader.setStatus(status);
+				}
+			}
+		}
+	}
+
+	void MetaShader::saveToCache()
+	{
+		LOG_FUNC("MetaShader::saveToCache");
+		PresetCacheHeader header = {};
+		header.magic = PRESET_CACHE_MAGIC;
+		header.version = PRESET_CACHE_VERSION;
+		header.compilerHash = ShaderCompiler::getCompilerHash();
+		if (Hash::Digest{} == header.compilerHash)
+		{
+			LOG_DEBUG << "Missing compiler hash";
+			return;
+		}
+
+		std::map<std::filesystem::path, Hash::Digest> sourceFiles;
+		sourceFiles[m_absPath] = ShaderCompiler::getFileHash(m_absPath);
+
+		std::vector<decltype(s_shaders)::iterator> shaders;
+		std::vector<UINT> shaderIndexes;
+		for (int i = 0; i < m_passCount; ++i)
+		{
+			const auto it = std::find(shaders.begin(), shaders.end(), m_passes[i].shader);
+			shaderIndexes.push_back(it - shaders.begin());
+			if (it == shaders.end())
+			{
+				shaders.push_back(m_passes[i].shader);
+				sourceFiles.insert(m_passes[i].shader->second.sourceFiles.begin(),
+					m_passes[i].shader->second.sourceFiles.end());
+			}
+		}
+
+		for (const auto& sourceFile : sourceFiles)
+		{
+			if (Hash::Digest{} == sourceFile.second)
+			{
+				LOG_DEBUG << "Missing hash: " << sourceFile.first.string();
+				return;
+			}
+		}
+
+		auto cachePath(m_absPath);
+		cachePath += ".dcc";
+		auto tmpPath(cachePath);
+		tmpPath += ".tmp";
+		std::ofstream f(tmpPath, std::ios::binary);
+		if (f.fail())
+		{
+			LOG_DEBUG << "Failed to open temporary file";
+			return;
+		}
+
+		writeValue(f, header);
+		writeValue(f, sourceFiles);
+
+		writeValue<UINT>(f, shaders.size());
+		for (const auto& shader : shaders)
+		{
+			writeValue(f, shader->first);
+			for (auto compiledShader : { &shader->second.vs, &shader->second.ps })
+			{
+				writeValue(f, compiledShader->code);
+				writeValue(f, compiledShader->samplers);
+				writeValue(f, compiledShader->uniforms);
+				writeValue(f, compiledShader->minRegisterIndex);
+				writeValue(f, compiledShader->maxRegisterIndex);
+			}
+			writeValue(f, shader->second.parameters);
+			writeValue(f, shader->second.texCoords);
+			writeValue(f, shader->second.sourceFiles);
+		}
+
+		writeValue(f, m_passCount);
+		for (int i = 0; i < m_passCount; ++i)
+		{
+			const auto& pass = m_passes[i];
+			writeValue(f, shaderIndexes[i]);
+			writeValue(f, pass.alias);
+			writeValue(f, pass.filter_linear);
+			writeValue(f, pass.float_framebuffer);
+			writeValue(f, pass.frame_count_mod);
+			writeValue(f, pass.mipmap_input);
+			writeValue(f, pass.scale_type);
+			writeValue(f, pass.scale_type_x);
+			writeValue(f, pass.scale_type_y);
+			writeValue(f, pass.scale);
+			writeValue(f, pass.scale_x);
+			writeValue(f, pass.scale_y);
+			writeValue(f, pass.srgb_framebuffer);
+			writeValue(f, pass.wrap_mode);
+			writeValue(f, pass.isFused);
+		}
+
+		writeValue(f, m_parameters);
+
+		writeValue<UINT>(f, m_textures.size());
+		for (const auto& texture : m_textures)
+		{
+			writeValue(f, texture.first);
+			writeValue(f, texture.second.bitmap->first);
+			writeValue(f, texture.second.linear);
+			writeValue(f, texture.second.mipmap);
+			writeValue(f, texture.second.wrap_mode);
+		}
+
+		if (f)
+		{
+			f.close();
+			if (MoveFileExW(tmpPath.c_str(), cachePath.c_str(), MOVEFILE_REPLACE_EXISTING))
+			{
+				return;
+			}
+			LOG_DEBUG << "MoveFileEx failed: " << Compat::hex(GetLastError());
+		}
+		else
+		{
+			f.close();
+			LOG_DEBUG << "Failed to write into temporary file";
+		}
+
+		DeleteFileW(tmpPath.c_str());
+	}
+
 	void MetaShader::setExternalPass(Pass& pass, const Resource& resource, UINT subResourceIndex, const RECT& rect)
 	{
 		const auto resourceSize = Rect::getSize(resource.getRect(subResourceIndex));
@@ -1147,7 +1865,7 @@ namespace D3dDdi
 		{
 			if (texture.first == key)
 			{
-				const auto path((m_absPath.remove_filename() / value).lexically_normal());
+				const auto path((m_absPath.parent_path() / value).lexically_normal());
 				texture.second.bitmap = s_bitmaps.emplace(path, Bitmap{}).first;
 				return true;
 			}
@@ -1232,7 +1950,7 @@ namespace D3dDdi
 		}
 		else if ("shader" == keyBase)
 		{
-			const auto path((m_absPath.remove_filename() / value).lexically_normal());
+			const auto path((m_absPath.parent_path() / value).lexically_normal());
 			pass.shader = s_shaders.emplace(path, Shader{}).first;
 		}
 		else if ("srgb_framebuffer" == keyBase)
@@ -1310,50 +2028,45 @@ namespace D3dDdi
 			return;
 		}
 
+		const DWORD caps = DDSCAPS_TEXTURE | DDSCAPS_3DDEVICE | DDSCAPS_VIDEOMEMORY |
+			(m_passes[0].mipmap_input ? DDSCAPS_MIPMAP : 0);
+		const auto qpcNow = Time::queryPerformanceCounter();
+
 		if (!m_prevInputFrameCandidate.rtt.surface ||
 			m_prevInputFrameCandidate.rtt.width != m_srcPass.rtt.width ||
 			m_prevInputFrameCandidate.rtt.height != m_srcPass.rtt.height ||
 			m_prevInputFrameCandidate.rtt.format != m_srcPass.rtt.format ||
 			FAILED(m_prevInputFrameCandidate.rtt.surface->IsLost(m_prevInputFrameCandidate.rtt.surface)))
 		{
-			m_prevInputFrameCandidate = {};
-			m_prevInputFrames = {};
+			getSurface(m_prevInputFrameCandidate.rtt, m_srcPass.rtt.format, m_srcPass.outputSize, caps);
+			for (int i = 0; i < m_maxPrevInputFrames; ++i)
+			{
+				getSurface(m_prevInputFrames[i].rtt, m_srcPass.rtt.format, m_srcPass.outputSize, caps);
+			}
 			m_prevInputFrameCount = 0;
+			m_prevInputFrameCandidate.qpc = qpcNow;
+			return;
 		}
 
-		const auto qpcNow = Time::queryPerformanceCounter();
-		if (m_prevInputFrameCandidate.rtt.surface)
+		auto qpcIdeal = m_prevInputFrameCandidate.qpc;
+		if (0 != m_prevInputFrameCount)
+		{
+			const auto& qpcOldestPrevFrame = getPrevInputFrame(m_prevInputFrameCount - 1).qpc;
+			qpcIdeal = qpcOldestPrevFrame + Time::msToQpc(m_prevInputFrameCount * FRAME_INTERVAL);
+		}
+
+		if (std::abs(m_prevInputFrameCandidate.qpc - qpcIdeal) <= std::abs(qpcNow - qpcIdeal))
 		{
-			auto qpcIdeal = m_prevInputFrameCandidate.qpc;
-			if (0 != m_prevInputFrameCount)
+			if (m_prevInputFrameCount < m_maxPrevInputFrames)
 			{
-				const auto& qpcOldestPrevFrame = getPrevInputFrame(m_prevInputFrameCount - 1).qpc;
-				qpcIdeal = qpcOldestPrevFrame + Time::msToQpc(m_prevInputFrameCount * FRAME_INTERVAL);
+				++m_prevInputFrameCount;
 			}
-
-			if (std::abs(m_prevInputFrameCandidate.qpc - qpcIdeal) <= std::abs(qpcNow - qpcIdeal))
+			--m_prevInputFrameIndex;
+			if (m_prevInputFrameIndex < 0)
 			{
-				if (m_prevInputFrameCount < m_maxPrevInputFrames)
-				{
-					++m_prevInputFrameCount;
-				}
-				--m_prevInputFrameIndex;
-				if (m_prevInputFrameIndex < 0)
-				{
-					m_prevInputFrameIndex = m_maxPrevInputFrames - 1;
-				}
-
-				std::swap(m_prevInputFrameCandidate, getPrevInputFrame(0));
-				getSurface(m_prevInputFrameCandidate.rtt, m_srcPass.rtt.format, m_srcPass.outputSize,
-					DDSCAPS_TEXTURE | DDSCAPS_3DDEVICE | DDSCAPS_VIDEOMEMORY |
-					(m_passes[0].mipmap_input ? DDSCAPS_MIPMAP : 0));
+				m_prevInputFrameIndex = m_maxPrevInputFrames - 1;
 			}
-		}
-		else
-		{
-			getSurface(m_prevInputFrameCandidate.rtt, m_srcPass.rtt.format, m_srcPass.outputSize,
-				DDSCAPS_TEXTURE | DDSCAPS_3DDEVICE | DDSCAPS_VIDEOMEMORY |
-				(m_passes[0].mipmap_input ? DDSCAPS_MIPMAP : 0));
+			std::swap(m_prevInputFrameCandidate, getPrevInputFrame(0));
 		}
 		m_prevInputFrameCandidate.qpc = qpcNow;
 	}
@@ -1428,39 +2141,42 @@ namespace D3dDdi
 	}
 
 	bool MetaShader::setupUniformForPassInput(const std::string& field, unsigned regIndex,
-		ShaderConsts& consts, int passIndex)
+		std::vector<Uniform>& uniforms, int passIndex)
 	{
-		auto& prevPass = getPass(passIndex - 1);
-		auto dst = &consts.consts[regIndex][0];
+		Uniform uniform = {};
+		uniform.regIndex = regIndex;
+		uniform.passIndex = passIndex;
 
 		if ("texture_size" == field)
 		{
-			dst[0] = static_cast<float>(prevPass.rtt.width);
-			dst[1] = static_cast<float>(prevPass.rtt.height);
+			uniform.source = UniformSource::TextureSize;
+			uniforms.push_back(uniform);
 			return true;
 		}
 
 		if ("video_size" == field)
 		{
-			dst[0] = static_cast<float>(prevPass.outputSize.cx);
-			dst[1] = static_cast<float>(prevPass.outputSize.cy);
+			uniform.source = UniformSource::VideoSize;
+			uniforms.push_back(uniform);
 			return true;
 		}
 
 		return false;
 	}
 
-	bool MetaShader::setupUniform(const std::string& name, const RegisterRange& reg, ShaderConsts& consts, int passIndex)
+	bool MetaShader::setupUniform(const std::string& name, const RegisterRange& reg,
+		std::vector<Uniform>& uniforms, ShaderConsts& consts, int passIndex)
 	{
+		Uniform uniform = {};
+		uniform.regIndex = reg.index;
+		uniform.passIndex = passIndex;
+
 		if (4 == reg.count)
 		{
 			if ("modelViewProj" == name)
 			{
-				auto dstMatrix = &consts.consts[reg.index];
-				dstMatrix[0] = { 1, 0, 0, -1.0f / m_passes[passIndex].outputSize.cx };
-				dstMatrix[1] = { 0, 1, 0, 1.0f / m_passes[passIndex].outputSize.cy };
-				dstMatrix[2] = { 0, 0, 1, 0 };
-				dstMatrix[3] = { 0, 0, 0, 1 };
+				uniform.source = UniformSource::ModelViewProj;
+				uniforms.push_back(uniform);
 				return true;
 			}
 			return false;
@@ -1471,7 +2187,13 @@ namespace D3dDdi
 			return false;
 		}
 
-		auto dst = &consts.consts[reg.index][0];
+		if ("_fused_color_min" == name || "_fused_color_max" == name)
+		{
+			uniform.source = "_fused_color_min" == name ? UniformSource::FusedColorMin : UniformSource::FusedColorMax;
+			uniforms.push_back(uniform);
+			return true;
+		}
+
 		const auto& configParameters = Config::displayFilter.getCgpParameters();
 		for (int i = 0; i < m_passCount; ++i)
 		{
@@ -1495,7 +2217,8 @@ namespace D3dDdi
 
 				value = std::max(value, it->min);
 				value = std::min(value, it->max);
-				*dst = value;
+				uniform.value = value;
+				uniforms.push_back(uniform);
 				return true;
 			}
 		}
@@ -1513,7 +2236,7 @@ namespace D3dDdi
 		{
 			if ("frame_count" == fieldName)
 			{
-				consts.frameCountReg = dst;
+				consts.frameCountReg = &consts.consts[reg.index - consts.firstConst][0];
 				if (0 == m_frameTimer)
 				{
 					m_frameTimer = timeSetEvent(FRAME_INTERVAL, 1, &frameTimerCallback,
@@ -1524,20 +2247,21 @@ namespace D3dDdi
 
 			if ("frame_direction" == fieldName)
 			{
-				*dst = 1;
+				uniform.value = 1;
+				uniforms.push_back(uniform);
 				return true;
 			}
 
 			if ("output_size" == fieldName)
 			{
-				dst[0] = static_cast<float>(m_passes[passIndex].outputSize.cx);
-				dst[1] = static_cast<float>(m_passes[passIndex].outputSize.cy);
+				uniform.source = UniformSource::OutputSize;
+				uniforms.push_back(uniform);
 				return true;
 			}
 
 			if ("texture_size" == fieldName || "video_size" == fieldName)
 			{
-				return setupUniformForPassInput(fieldName, reg.index, consts, passIndex);
+				return setupUniformForPassInput(fieldName, reg.index, uniforms, passIndex);
 			}
 
 			return false;
@@ -1546,14 +2270,16 @@ namespace D3dDdi
 		const auto prevPassIndex = getPassIndexFromStructName(structName, passIndex);
 		if (MAXINT != prevPassIndex)
 		{
-			return setupUniformForPassInput(fieldName, reg.index, consts, prevPassIndex);
+			return setupUniformForPassInput(fieldName, reg.index, uniforms, prevPassIndex);
 		}
 
 		return false;
 	}
 
-	void MetaShader::setupUniforms(const CompiledShader& compiledShader, ShaderConsts& consts, int passIndex)
+	void MetaShader::setupUniforms(const CompiledShader& compiledShader,
+		std::vector<Uniform>& uniforms, ShaderConsts& consts, int passIndex)
 	{
+		uniforms.clear();
 		if (compiledShader.uniforms.empty())
 		{
 			return;
@@ -1562,15 +2288,21 @@ namespace D3dDdi
 		consts.firstConst = compiledShader.minRegisterIndex;
 		consts.consts.clear();
 		consts.consts.resize(compiledShader.maxRegisterIndex - compiledShader.minRegisterIndex + 1, {});
+		consts.frameCountReg = nullptr;
 
 		for (const auto& uniform : compiledShader.uniforms)
 		{
-			if (!setupUniform(uniform.first, uniform.second, consts, passIndex))
+			if (!setupUniform(uniform.first, uniform.second, uniforms, consts, passIndex))
 			{
 				LOG_DEBUG << "Unsupported uniform: " << uniform.first << " (register count: " << uniform.second.count << ')';
 				throw ShaderStatus::SetupError;
 			}
 		}
+
+		for (auto& uniform : uniforms)
+		{
+			uniform.regIndex -= consts.firstConst;
+		}
 	}
 
 	void MetaShader::setupVertexShaderDecl()
@@ -1671,9 +2403,15 @@ namespace D3dDdi
 		for (int i = 0; i < m_passCount; ++i)
 		{
 			auto& pass = m_passes[i];
+			if (pass.isFused)
+			{
+				continue;
+			}
 			createShaders(pass);
 			setupSamplers(pass.shader->second.vs, pass.vsSamplers, i);
 			setupSamplers(pass.shader->second.ps, pass.psSamplers, i);
+			setupUniforms(pass.shader->second.vs, pass.vsUniforms, pass.vsConsts, i);
+			setupUniforms(pass.shader->second.ps, pass.psUniforms, pass.psConsts, i);
 		}
 
 		if (0 != m_maxPrevInputFrames && 0 == m_frameTimer)
@@ -1685,10 +2423,18 @@ namespace D3dDdi
 
 	void MetaShader::updateParameters()
 	{
+		m_prevDstRect = {};
 		for (int i = 0; i < m_passCount; ++i)
 		{
-			setupUniforms(m_passes[i].shader->second.vs, m_passes[i].vsConsts, i);
-			setupUniforms(m_passes[i].shader->second.ps, m_passes[i].psConsts, i);
+			auto& pass = m_passes[i];
+			if (pass.isFused)
+			{
+				continue;
+			}
+			setupUniforms(pass.shader->second.vs, pass.vsUniforms, pass.vsConsts, i);
+			setupUniforms(pass.shader->second.ps, pass.psUniforms, pass.psConsts, i);
+			updateUniforms(pass.vsUniforms, pass.vsConsts);
+			updateUniforms(pass.psUniforms, pass.psConsts);
 		}
 	}
 
@@ -1712,6 +2458,73 @@ namespace D3dDdi
 		}
 	}
 
+	void MetaShader::updateUniforms(const std::vector<Uniform>& uniforms, ShaderConsts& consts)
+	{
+		for (const auto& uniform : uniforms)
+		{
+			auto dst = &consts.consts[uniform.regIndex][0];
+			switch (uniform.source)
+			{
+			case UniformSource::Constant:
+				*dst = uniform.value;
+				break;
+
+			case UniformSource::FusedColorMax:
+			case UniformSource::FusedColorMin:
+			{
+				const bool isMin = UniformSource::FusedColorMin == uniform.source;
+				const auto format = getFormat(getPass(uniform.passIndex - 1).float_framebuffer);
+				if (D3DDDIFMT_A32B32G32R32F == format || D3DDDIFMT_A16B16G16R16F == format)
+				{
+					const float value = isMin ? -FLT_MAX : FLT_MAX;
+					consts.consts[uniform.regIndex] = { value, value, value, value };
+				}
+				else if (isMin)
+				{
+					consts.consts[uniform.regIndex] = { 0, 0, 0, 0 != getFormatInfo(format).alpha.bitCount ? 0.0f : 1.0f };
+				}
+				else
+				{
+					consts.consts[uniform.regIndex] = { 1, 1, 1, 1 };
+				}
+				break;
+			}
+
+			case UniformSource::ModelViewProj:
+			{
+				const auto& pass = m_passes[uniform.passIndex];
+				auto dstMatrix = &consts.consts[uniform.regIndex];
+				dstMatrix[0] = { 1, 0, 0, -1.0f / pass.outputSize.cx };
+				dstMatrix[1] = { 0, 1, 0, 1.0f / pass.outputSize.cy };
+				dstMatrix[2] = { 0, 0, 1, 0 };
+				dstMatrix[3] = { 0, 0, 0, 1 };
+				break;
+			}
+
+			case UniformSource::OutputSize:
+				dst[0] = static_cast<float>(m_passes[uniform.passIndex].outputSize.cx);
+				dst[1] = static_cast<float>(m_passes[uniform.passIndex].outputSize.cy);
+				break;
+
+			case UniformSource::TextureSize:
+			{
+				const auto& prevPass = getPass(uniform.passIndex - 1);
+				dst[0] = static_cast<float>(prevPass.rtt.width);
+				dst[1] = static_cast<float>(prevPass.rtt.height);
+				break;
+			}
+
+			case UniformSource::VideoSize:
+			{
+				const auto& prevPass = getPass(uniform.passIndex - 1);
+				dst[0] = static_cast<float>(prevPass.outputSize.cx);
+				dst[1] = static_cast<float>(prevPass.outputSize.cy);
+				break;
+			}
+			}
+		}
+	}
+
 	void MetaShader::validateScale(int index, ScaleType& scale_type_xy, float& scale_xy)
 	{
 		if (ScaleType::Undefined == scale_type_xy || std::isnan(scale_xy))
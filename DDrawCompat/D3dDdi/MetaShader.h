@@ -4,6 +4,7 @@
 #include <filesystem>
 #include <map>
 #include <memory>
+#include <set>
 #include <string>
 
 #include <Windows.h>
@@ -41,7 +42,6 @@ namespace D3dDdi
 
 		static void clearUnusedBitmaps();
 		static const std::vector<std::filesystem::path>& getBaseDirs();
-		static void loadBitmaps();
 
 		std::vector<ShaderCompiler::Parameter> getParameters() const;
 		const std::filesystem::path& getRelPath() const { return m_relPath; }
@@ -49,7 +49,7 @@ namespace D3dDdi
 
 		void init();
 		void render(const Resource& dstResource, UINT dstSubResourceIndex, const RECT& dstRect,
-			const Resource& srcResource, UINT srcSubResourceIndex, const RECT& srcRect);
+			const Resource& srcResource, UINT srcSubResourceIndex, const RECT& srcRect, bool isSrcUnchanged);
 		void reset();
 		void updateParameters();
 
@@ -89,6 +89,7 @@ namespace D3dDdi
 			CompiledShader ps;
 			std::vector<ShaderCompiler::Parameter> parameters;
 			std::map<std::string, unsigned> texCoords;
+			std::map<std::filesystem::path, Hash::Digest> sourceFiles;
 			ShaderStatus status = ShaderStatus::Init;
 		};
 
@@ -99,6 +100,25 @@ namespace D3dDdi
 			float* frameCountReg = nullptr;
 		};
 
+		enum class UniformSource
+		{
+			Constant,
+			FusedColorMax,
+			FusedColorMin,
+			ModelViewProj,
+			OutputSize,
+			TextureSize,
+			VideoSize
+		};
+
+		struct Uniform
+		{
+			unsigned regIndex = 0;
+			UniformSource source = UniformSource::Constant;
+			int passIndex = 0;
+			float value = 0;
+		};
+
 		struct Texture;
 
 		struct Sampler
@@ -121,9 +141,14 @@ namespace D3dDdi
 			ShaderConsts psConsts;
 			std::vector<Sampler> vsSamplers;
 			std::vector<Sampler> psSamplers;
+			std::vector<Uniform> vsUniforms;
+			std::vector<Uniform> psUniforms;
 			SurfaceRepository::Surface rtt;
 			int frameCount = 0;
 			SIZE outputSize = {};
+			std::map<std::filesystem::path, Shader>::iterator fusedShader = s_shaders.end();
+			bool isFusable = false;
+			bool isFused = false;
 			std::string alias;
 			bool filter_linear = true;
 			bool float_framebuffer = false;
@@ -160,27 +185,42 @@ namespace D3dDdi
 			std::array<float, 2> texCoord[1];
 		};
 
-		static unsigned WINAPI compileThreadProc(LPVOID lpParameter);
+		static void compileFusedShader(std::pair<const std::filesystem::path, Shader>& shader,
+			const std::filesystem::path& prevPath, const std::filesystem::path& path,
+			const std::string& prevInputSampler, const std::set<std::string>& inputSamplers);
+		static void compileShader(std::pair<const std::filesystem::path, Shader>& shader);
+		static void compileShader(std::pair<const std::filesystem::path, Shader>& shader, ShaderCompiler& compiler);
 		static void CALLBACK frameTimerCallback(UINT uTimerID, UINT uMsg, DWORD_PTR dwUser, DWORD_PTR dw1, DWORD_PTR dw2);
 		static CompiledShader getCompiledShader(const ShaderCompiler::Shader& shader);
+		static void loadBitmap(const std::filesystem::path& path);
 		static bool parseRegisterComment(const std::string& comment, CompiledShader& compiledShader);
 		static ScaleType parseScaleType(const std::string& value);
+		static void resumeCompile();
 
+		void checkDirectOutputPass();
+		void checkFusablePasses();
 		void compile();
 		void createShaders(Pass& pass);
+		bool fusePasses();
 		void generateMipSubLevels(const Resource& resource);
+		int getCompilePriority(int passIndex) const;
+		int getFirstChangedPass(bool isSrcUnchanged, const RECT& dstRect, bool isOutputPassDirect) const;
 		D3DDDIFORMAT getFormat(bool float_framebuffer);
+		bool getFusionInputs(int passIndex, std::string& prevInputSampler, std::set<std::string>& inputSamplers);
 		int getOutputSize(int inputSize, int vpSize, ScaleType scale_type, float scale) const;
 		int getPassIndexFromStructName(const std::string& structName, int passIndex) const;
 		SurfaceRepository::Surface& getPassRtt(int passIndex);
 		Pass& getPass(int passIndex);
 		InputFrame& getPrevInputFrame(int prevIndex);
 		void getSurface(SurfaceRepository::Surface& surface, D3DDDIFORMAT format, SIZE size, DWORD caps);
+		int getSamplerInputPassIndex(const std::string& name, int passIndex) const;
 		Vertex& getVertex(int index);
 		void loadCgp(const std::filesystem::path& relPath);
+		bool loadFromCache(const std::filesystem::path& baseDir);
 		void loadTexture(Texture& texture);
 		bool parseCgp(const std::filesystem::path& baseDir);
-		void renderPass(const RECT& srcRect, int passIndex);
+		void renderPass(const RECT& srcRect, int passIndex, bool isOutputPass);
+		void saveToCache();
 		void setExternalPass(Pass& pass, const Resource& resource, UINT subResourceIndex, const RECT& rect);
 		bool setKey(const std::string& key, const std::string& value);
 		void setStatus(ShaderStatus status);
@@ -194,13 +234,16 @@ namespace D3dDdi
 		void setupSamplers(const CompiledShader& compiledShader,
 			std::vector<Sampler>& samplers, int passIndex);
 		bool setupUniformForPassInput(const std::string& field, unsigned regIndex,
-			ShaderConsts& consts, int passIndex);
-		bool setupUniform(const std::string& name, const RegisterRange& reg, ShaderConsts& consts, int passIndex);
-		void setupUniforms(const CompiledShader& compiledShader, ShaderConsts& consts, int passIndex);
+			std::vector<Uniform>& uniforms, int passIndex);
+		bool setupUniform(const std::string& name, const RegisterRange& reg,
+			std::vector<Uniform>& uniforms, ShaderConsts& consts, int passIndex);
+		void setupUniforms(const CompiledShader& compiledShader,
+			std::vector<Uniform>& uniforms, ShaderConsts& consts, int passIndex);
 		void setupVertexShaderDecl();
 		void setupVertices(int passIndex);
 		void setup();
 		void updateSamplers(const std::vector<Sampler>& samplers);
+		void updateUniforms(const std::vector<Uniform>& uniforms, ShaderConsts& consts);
 		void validateScale(int passIndex, ScaleType& scale_type_xy, float& scale_xy);
 		void validatePass(int passIndex);
 
@@ -225,6 +268,10 @@ namespace D3dDdi
 		UINT m_frameTimer;
 		int m_frameCount;
 		SIZE m_prevInputSize;
+		RECT m_prevDstRect;
+		bool m_isOutputPassDirect;
+		long long m_initQpc;
+		bool m_isCached;
 		ShaderStatus m_status;
 	};
 };
@@ -0,0 +1,183 @@
+#include <fstream>
+
+#include <Common/Hash.h>
+#include <Common/Log.h>
+#include <Common/Path.h>
+#include <D3dDdi/PixelShaderCache.h>
+
+namespace
+{
+	const UINT CACHE_MAGIC = 0x43535044;
+	const UINT CACHE_VERSION = 4;
+	const UINT MAX_ENTRY_COUNT = 4096;
+	const UINT MAX_TOKEN_COUNT = 0x10000;
+
+	struct CacheFileHeader
+	{
+		UINT magic;
+		UINT version;
+	};
+
+	struct CacheEntryHeader
+	{
+		D3dDdi::PixelShaderCache::Key key;
+		UINT patchedTokenCount;
+		UINT64 checksum;
+	};
+
+	std::map<D3dDdi::PixelShaderCache::Key, std::vector<UINT>> g_entries;
+	bool g_isLoaded = false;
+
+	UINT64 getChecksum(const CacheEntryHeader& entryHeader, const std::vector<UINT>& patchedTokens)
+	{
+		Hash::Hasher hasher(CACHE_MAGIC);
+		hasher.update(&entryHeader.key, sizeof(entryHeader.key));
+		hasher.update(&entryHeader.patchedTokenCount, sizeof(entryHeader.patchedTokenCount));
+		hasher.update(patchedTokens.data(), patchedTokens.size() * sizeof(UINT));
+		return hasher.digest64();
+	}
+
+	std::filesystem::path getCachePath()
+	{
+		auto processPath(Compat::getModulePath(nullptr));
+		if (processPath.empty())
+		{
+			return {};
+		}
+
+		if (Compat::isEqual(processPath.extension(), ".exe"))
+		{
+			processPath.replace_extension();
+		}
+		return Compat::getEnvPath("LOCALAPPDATA") / "DDrawCompat" / "ShaderCache" /
+			(L"PixelShaders-" + processPath.filename().native() + L".dcc");
+	}
+
+	void load()
+	{
+		LOG_FUNC("PixelShaderCache::load");
+		const auto cachePath = getCachePath();
+		std::ifstream f(cachePath, std::ios::binary);
+		if (f.fail())
+		{
+			LOG_DEBUG << "Failed to open file: " << cachePath.string();
+			return;
+		}
+
+		CacheFileHeader fileHeader = {};
+		f.read(reinterpret_cast<char*>(&fileHeader), sizeof(fileHeader));
+		if (f.fail() || CACHE_MAGIC != fileHeader.magic || CACHE_VERSION != fileHeader.version)
+		{
+			LOG_DEBUG << "Invalid file header";
+			f.close();
+			std::error_code ec;
+			std::filesystem::remove(cachePath, ec);
+			return;
+		}
+
+		std::error_code ec;
+		const auto fileSize = std::filesystem::file_size(cachePath, ec);
+		if (ec)
+		{
+			LOG_DEBUG << "Failed to get file size";
+			return;
+		}
+
+		UINT64 goodSize = sizeof(fileHeader);
+		CacheEntryHeader entryHeader = {};
+		while (goodSize < fileSize && g_entries.size() < MAX_ENTRY_COUNT)
+		{
+			if (!f.read(reinterpret_cast<char*>(&entryHeader), sizeof(entryHeader)) ||
+				entryHeader.patchedTokenCount > MAX_TOKEN_COUNT ||
+				entryHeader.patchedTokenCount * sizeof(UINT) > fileSize - goodSize - sizeof(entryHeader))
+			{
+				LOG_DEBUG << "Invalid entry header at offset " << goodSize;
+				break;
+			}
+
+			std::vector<UINT> tokens(entryHeader.patchedTokenCount);
+			if (!f.read(reinterpret_cast<char*>(tokens.data()), tokens.size() * sizeof(UINT)) ||
+				getChecksum(entryHeader, tokens) != entryHeader.checksum)
+			{
+				LOG_DEBUG << "Invalid entry at offset " << goodSize;
+				break;
+			}
+
+			g_entries[entryHeader.key] = std::move(tokens);
+			goodSize += sizeof(entryHeader) + entryHeader.patchedTokenCount * sizeof(UINT);
+		}
+		f.close();
+
+		if (goodSize < fileSize)
+		{
+			std::filesystem::resize_file(cachePath, goodSize, ec);
+			if (ec)
+			{
+				LOG_DEBUG << "Failed to truncate file: " << ec.message();
+			}
+		}
+		LOG_DEBUG << "Loaded " << g_entries.size() << " pixel shaders from " << cachePath.string();
+	}
+
+	void save(const D3dDdi::PixelShaderCache::Key& key, const std::vector<UINT>& patchedTokens)
+	{
+		const auto cachePath = getCachePath();
+		if (cachePath.empty())
+		{
+			return;
+		}
+
+		std::error_code ec;
+		std::filesystem::create_directories(cachePath.parent_path(), ec);
+		const bool isNewFile = !std::filesystem::exists(cachePath, ec);
+
+		std::ofstream f(cachePath, std::ios::binary | std::ios::app);
+		if (f.fail())
+		{
+			LOG_ONCE("Failed to open pixel shader cache file: " << cachePath.string());
+			return;
+		}
+
+		if (isNewFile)
+		{
+			const CacheFileHeader fileHeader = { CACHE_MAGIC, CACHE_VERSION };
+			f.write(reinterpret_cast<const char*>(&fileHeader), sizeof(fileHeader));
+		}
+
+		CacheEntryHeader entryHeader = { key, patchedTokens.size() };
+		entryHeader.checksum = getChecksum(entryHeader, patchedTokens);
+		f.write(reinterpret_cast<const char*>(&entryHeader), sizeof(entryHeader));
+		f.write(reinterpret_cast<const char*>(patchedTokens.data()), patchedTokens.size() * sizeof(UINT));
+	}
+}
+
+namespace D3dDdi
+{
+	namespace PixelShaderCache
+	{
+		void add(const Key& key, const std::vector<UINT>& patchedTokens)
+		{
+			if (g_entries.size() >= MAX_ENTRY_COUNT ||
+				!g_entries.emplace(key, patchedTokens).second)
+			{
+				return;
+			}
+			save(key, patchedTokens);
+		}
+
+		const std::map<Key, std::vector<UINT>>& getEntries()
+		{
+			if (!g_isLoaded)
+			{
+				g_isLoaded = true;
+				load();
+			}
+			return g_entries;
+		}
+
+		Key makeKey(const std::vector<UINT>& tokens, UINT alphaRef)
+		{
+			return { Hash::hash64(tokens.data(), tokens.size() * sizeof(UINT)), tokens.size(), alphaRef };
+		}
+	}
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <map>
+#include <tuple>
+#include <vector>
+
+#include <Windows.h>
+
+namespace D3dDdi
+{
+	namespace PixelShaderCache
+	{
+		struct Key
+		{
+			UINT64 tokenHash;
+			UINT tokenCount;
+			UINT alphaRef;
+
+			bool operator<(const Key& other) const
+			{
+				return std::tie(tokenHash, tokenCount, alphaRef) < std::tie(other.tokenHash, other.tokenCount, other.alphaRef);
+			}
+		};
+
+		void add(const Key& key, const std::vector<UINT>& patchedTokens);
+		const std::map<Key, std::vector<UINT>>& getEntries();
+		Key makeKey(const std::vector<UINT>& tokens, UINT alphaRef);
+	}
+}
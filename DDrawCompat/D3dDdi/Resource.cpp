@@ -1,4 +1,7 @@
+#include <cmath>
+
 #include <Common/Comparison.h>
+#include <Common/Hash.h>
 #include <Common/HResultException.h>
 #include <Common/Log.h>
 #include <Common/Rect.h>
@@ -7,13 +10,16 @@
 #include <Config/Settings/ColorKeyMethod.h>
 #include <Config/Settings/CompatFixes.h>
 #include <Config/Settings/DepthFormat.h>
+#include <Config/Settings/DisplayFilter.h>
 #include <Config/Settings/GdiInterops.h>
 #include <Config/Settings/ResolutionScaleFilter.h>
 #include <Config/Settings/SurfacePatches.h>
 #include <D3dDdi/Adapter.h>
 #include <D3dDdi/Device.h>
+#include <D3dDdi/KernelModeThunks.h>
 #include <D3dDdi/Log/DeviceFuncsLog.h>
 #include <D3dDdi/Resource.h>
+#include <D3dDdi/ShaderBlitter.h>
 #include <D3dDdi/SurfaceRepository.h>
 #include <DDraw/Blitter.h>
 #include <DDraw/RealPrimarySurface.h>
@@ -26,6 +32,32 @@
 
 namespace
 {
+	struct DamageScope
+	{
+		const D3dDdi::Resource* resource;
+		UINT subResourceIndex;
+	};
+
+	struct PresentationSource
+	{
+		HANDLE resource;
+		UINT subResourceIndex;
+		UINT writeCount;
+		HCURSOR cursor;
+		POINT cursorPos;
+		std::vector<PALETTEENTRY> palette;
+	};
+
+	struct PresentationTarget
+	{
+		HANDLE resource;
+		UINT subResourceIndex;
+		RECT dstRect;
+		HANDLE srcRtt;
+		UINT displayFilter;
+		UINT displayFilterParam;
+	};
+
 	D3DDDI_RESOURCEFLAGS getResourceTypeFlags();
 
 	const UINT g_resourceTypeFlags = getResourceTypeFlags().Value;
@@ -34,12 +66,52 @@ namespace
 	D3DDDIFORMAT g_formatOverride = D3DDDIFMT_UNKNOWN;
 	std::pair<D3DDDIMULTISAMPLE_TYPE, UINT> g_msaaOverride = {};
 	bool g_readOnlyLock = false;
+	PresentationSource g_presentationSource = {};
+	PresentationTarget g_presentationTarget = {};
+	RECT g_presentationCursorRect = {};
+	DamageScope g_damageScope = {};
+
+	class ScopedDamage
+	{
+	public:
+		ScopedDamage(const D3dDdi::Resource& resource, UINT subResourceIndex)
+			: m_prevScope(g_damageScope)
+		{
+			g_damageScope = { &resource, subResourceIndex };
+		}
+
+		~ScopedDamage()
+		{
+			g_damageScope = m_prevScope;
+		}
+
+	private:
+		DamageScope m_prevScope;
+	};
 
 	LONG divCeil(LONG n, LONG d)
 	{
 		return (n + d - 1) / d;
 	}
 
+	RECT getDstDamageRect(RECT srcDamageRect, const RECT& srcRect, const RECT& dstRect)
+	{
+		const LONG support = D3dDdi::ShaderBlitter::getDisplayFilterSupport(dstRect, srcRect);
+		InflateRect(&srcDamageRect, support, support);
+		if (!IntersectRect(&srcDamageRect, &srcDamageRect, &srcRect))
+		{
+			return {};
+		}
+
+		RectF rect = Rect::toRectF(srcDamageRect);
+		Rect::transform(rect, srcRect, dstRect);
+		RECT dstDamageRect = {
+			static_cast<LONG>(std::floor(rect.left)), static_cast<LONG>(std::floor(rect.top)),
+			static_cast<LONG>(std::ceil(rect.right)), static_cast<LONG>(std::ceil(rect.bottom)) };
+		IntersectRect(&dstDamageRect, &dstDamageRect, &dstRect);
+		return dstDamageRect;
+	}
+
 	D3DDDI_RESOURCEFLAGS getResourceTypeFlags()
 	{
 		D3DDDI_RESOURCEFLAGS flags = {};
@@ -69,6 +141,33 @@ namespace
 	{
 		HeapFree(GetProcessHeap(), 0, p);
 	}
+
+	bool isEqualPalette(const std::vector<PALETTEENTRY>& palette1, const std::vector<PALETTEENTRY>& palette2)
+	{
+		return palette1.size() == palette2.size() &&
+			0 == memcmp(palette1.data(), palette2.data(), palette1.size() * sizeof(PALETTEENTRY));
+	}
+
+	bool isPartialPresentationAllowed(const PresentationTarget& target, bool hasOverlays)
+	{
+		return 0 == memcmp(&target, &g_presentationTarget, sizeof(target)) &&
+			Config::Settings::DisplayFilter::CGP != target.displayFilter &&
+			D3dDdi::ShaderBlitter::isGammaRampDefault() &&
+			!hasOverlays &&
+			!Overlay::Steam::isOverlayOpen();
+	}
+
+	bool updatePresentationSource(PresentationSource&& src)
+	{
+		const bool isUnchanged = src.resource == g_presentationSource.resource &&
+			src.subResourceIndex == g_presentationSource.subResourceIndex &&
+			src.writeCount == g_presentationSource.writeCount &&
+			src.cursor == g_presentationSource.cursor &&
+			src.cursorPos == g_presentationSource.cursorPos &&
+			isEqualPalette(src.palette, g_presentationSource.palette);
+		g_presentationSource = std::move(src);
+		return isUnchanged;
+	}
 }
 
 namespace D3dDdi
@@ -134,6 +233,14 @@ namespace D3dDdi
 
 		m_isPaletteResolvedSurfaceUpToDate.resize(m_fixedData.SurfCount);
 		m_isColorKeyedSurfaceUpToDate.resize(m_fixedData.SurfCount);
+		m_writeCounts.resize(m_fixedData.SurfCount);
+		m_damageRects.resize(m_fixedData.SurfCount);
+		m_lockCounts.resize(m_fixedData.SurfCount);
+		m_lockDamageRects.resize(m_fixedData.SurfCount);
+		for (UINT i = 0; i < m_fixedData.SurfCount; ++i)
+		{
+			m_damageRects[i] = getRect(i);
+		}
 
 		if (D3DDDIPOOL_SYSTEMMEM == m_fixedData.Pool && 0 != m_formatInfo.bytesPerPixel)
 		{
@@ -181,6 +288,12 @@ namespace D3dDdi
 		}
 	}
 
+	void Resource::addDamage(UINT subResourceIndex, const RECT& rect)
+	{
+		auto& damageRect = m_damageRects[subResourceIndex];
+		UnionRect(&damageRect, &damageRect, &rect);
+	}
+
 	HRESULT Resource::blt(D3DDDIARG_BLT data)
 	{
 		if (m_origData.Flags.ZBuffer && Config::compatFixes.get().nodepthblt)
@@ -195,6 +308,9 @@ namespace D3dDdi
 
 		m_isPaletteResolvedSurfaceUpToDate[data.DstSubResourceIndex] = false;
 		m_isColorKeyedSurfaceUpToDate[data.DstSubResourceIndex] = false;
+		++m_writeCounts[data.DstSubResourceIndex];
+		addDamage(data.DstSubResourceIndex, data.DstRect);
+		ScopedDamage scopedDamage(*this, data.DstSubResourceIndex);
 
 		auto srcResource = m_device.getResource(data.hSrcResource);
 		if (!srcResource)
@@ -465,6 +581,9 @@ namespace D3dDdi
 
 		m_isPaletteResolvedSurfaceUpToDate[data.SubResourceIndex] = false;
 		m_isColorKeyedSurfaceUpToDate[data.SubResourceIndex] = false;
+		++m_writeCounts[data.SubResourceIndex];
+		addDamage(data.SubResourceIndex, data.DstRect);
+		ScopedDamage scopedDamage(*this, data.SubResourceIndex);
 
 		if (m_lockResource)
 		{
@@ -859,6 +978,25 @@ namespace D3dDdi
 		return size;
 	}
 
+	std::optional<UINT64> Resource::getSysMemHash(UINT subResourceIndex, UINT rowStep) const
+	{
+		if (subResourceIndex >= m_lockData.size() || !m_lockData[subResourceIndex].isSysMemUpToDate ||
+			0 == m_formatInfo.bytesPerPixel)
+		{
+			return {};
+		}
+
+		const auto& lockData = m_lockData[subResourceIndex];
+		const auto& si = m_fixedData.pSurfList[subResourceIndex];
+		const std::size_t rowSize = si.Width * m_formatInfo.bytesPerPixel;
+		Hash::Hasher hasher;
+		for (UINT y = 0; y < si.Height; y += rowStep)
+		{
+			hasher.update(static_cast<const BYTE*>(lockData.data) + y * lockData.pitch, rowSize);
+		}
+		return hasher.digest64();
+	}
+
 	void Resource::invalidatePalettizedTexture()
 	{
 		m_isPaletteResolvedSurfaceUpToDate.assign(m_fixedData.SurfCount, false);
@@ -1054,18 +1192,35 @@ namespace D3dDdi
 			data.Flags.ReadOnly = true;
 		}
 
+		ScopedDamage scopedDamage(*this, data.SubResourceIndex);
+		HRESULT result = S_OK;
 		if (m_lockResource || m_isOversized)
 		{
-			return bltLock(data);
+			result = bltLock(data);
 		}
-
-		if (!data.Flags.ReadOnly)
+		else
 		{
-			m_isPaletteResolvedSurfaceUpToDate[data.SubResourceIndex] = false;
-			m_isColorKeyedSurfaceUpToDate[data.SubResourceIndex] = false;
+			if (!data.Flags.ReadOnly)
+			{
+				m_isPaletteResolvedSurfaceUpToDate[data.SubResourceIndex] = false;
+				m_isColorKeyedSurfaceUpToDate[data.SubResourceIndex] = false;
+				++m_writeCounts[data.SubResourceIndex];
+			}
+			result = m_device.getOrigVtable().pfnLock(m_device, &data);
 		}
 
-		return m_device.getOrigVtable().pfnLock(m_device, &data);
+		if (SUCCEEDED(result) && data.SubResourceIndex < m_lockCounts.size())
+		{
+			++m_lockCounts[data.SubResourceIndex];
+			if (!data.Flags.ReadOnly)
+			{
+				const RECT rect = data.Flags.AreaValid ? data.Area : getRect(data.SubResourceIndex);
+				auto& lockDamageRect = m_lockDamageRects[data.SubResourceIndex];
+				UnionRect(&lockDamageRect, &lockDamageRect, &rect);
+				addDamage(data.SubResourceIndex, rect);
+			}
+		}
+		return result;
 	}
 
 	void Resource::notifyLock(UINT subResourceIndex)
@@ -1151,6 +1306,12 @@ namespace D3dDdi
 	{
 		m_isPaletteResolvedSurfaceUpToDate[subResourceIndex] = false;
 		m_isColorKeyedSurfaceUpToDate[subResourceIndex] = false;
+		++m_writeCounts[subResourceIndex];
+		if (this != g_damageScope.resource || subResourceIndex != g_damageScope.subResourceIndex)
+		{
+			addDamage(subResourceIndex, getRect(subResourceIndex));
+		}
+
 		if (m_lockResource)
 		{
 			if (m_lockRefSurface.resource &&
@@ -1198,6 +1359,12 @@ namespace D3dDdi
 	Resource& Resource::prepareForGpuWrite(UINT subResourceIndex)
 	{
 		m_isColorKeyedSurfaceUpToDate[subResourceIndex] = false;
+		++m_writeCounts[subResourceIndex];
+		if (this != g_damageScope.resource || subResourceIndex != g_damageScope.subResourceIndex)
+		{
+			addDamage(subResourceIndex, getRect(subResourceIndex));
+		}
+
 		if (m_lockResource || m_msaaResolvedSurface.resource)
 		{
 			if (m_msaaSurface.resource)
@@ -1293,6 +1460,7 @@ namespace D3dDdi
 
 		if (!srcResource)
 		{
+			g_presentationTarget = {};
 			clearRectInterior(data.DstSubResourceIndex, data.DstRect);
 			presentLayeredWindows(*this, data.DstSubResourceIndex, getRect(data.DstSubResourceIndex),
 				Gdi::Window::getVisibleOverlayWindows(), m_device.getAdapter().getMonitorInfo().rcMonitor);
@@ -1323,12 +1491,6 @@ namespace D3dDdi
 		data.DstRect = m_device.getAdapter().applyDisplayAspectRatio(data.DstRect, { srcWidth, srcHeight });
 
 		auto& repo = m_device.getRepo();
-		auto& srcRtt = repo.getPresentationSourceRtt(srcWidth, srcHeight, srcResource->m_fixedData.Format);
-		if (!srcRtt.resource)
-		{
-			return LOG_RESULT(E_OUTOFMEMORY);
-		}
-
 		if (D3DDDIPOOL_SYSTEMMEM == srcResource->m_fixedData.Pool)
 		{
 			srcResource = repo.getTempTexture(srcWidth, srcHeight, srcResource->m_fixedData.Format).resource;
@@ -1339,59 +1501,151 @@ namespace D3dDdi
 			copySubResourceRegion(*srcResource, 0, data.SrcRect, data.hSrcResource, data.SrcSubResourceIndex, data.SrcRect);
 		}
 
-		if (D3DDDIFMT_P8 == srcResource->m_origData.Format ||
-			D3DDDIFMT_L8 == srcResource->m_origData.Format)
-		{
-			auto entries(Gdi::Palette::getHardwarePalette());
-			RGBQUAD pal[256] = {};
-			for (UINT i = 0; i < 256; ++i)
-			{
-				pal[i].rgbRed = entries[i].peRed;
-				pal[i].rgbGreen = entries[i].peGreen;
-				pal[i].rgbBlue = entries[i].peBlue;
-				pal[i].rgbReserved = 0xFF;
+		const auto cursorInfo = Gdi::Cursor::getEmulatedCursorInfo();
+		const bool isCursorEmulated = cursorInfo.flags == CURSOR_SHOWING && cursorInfo.hCursor;
+		const bool isPalettized = D3DDDIFMT_P8 == srcResource->m_origData.Format ||
+			D3DDDIFMT_L8 == srcResource->m_origData.Format;
+		auto& mi = m_device.getAdapter().getMonitorInfo();
+		const auto layeredWindows(Gdi::Window::getVisibleLayeredWindows());
+		const auto overlayWindows(Gdi::Window::getVisibleOverlayWindows());
+		auto palette(isPalettized ? Gdi::Palette::getHardwarePalette() : std::vector<PALETTEENTRY>());
+
+		RECT srcDamageRect = origSrcResource->m_damageRects[data.SrcSubResourceIndex];
+		origSrcResource->m_damageRects[data.SrcSubResourceIndex] = {};
+		if (*origSrcResource != g_presentationSource.resource ||
+			data.SrcSubResourceIndex != g_presentationSource.subResourceIndex ||
+			!isEqualPalette(palette, g_presentationSource.palette) ||
+			!layeredWindows.empty() ||
+			origSrcResource->m_msaaResolvedSurface.resource ||
+			m_fixedData.Flags.Primary)
+		{
+			srcDamageRect = data.SrcRect;
+		}
+
+		const bool isSrcUnchanged = updatePresentationSource({
+			*origSrcResource,
+			data.SrcSubResourceIndex,
+			origSrcResource->m_writeCounts[data.SrcSubResourceIndex],
+			isCursorEmulated ? cursorInfo.hCursor : nullptr,
+			isCursorEmulated ? cursorInfo.ptScreenPos : POINT{},
+			std::move(palette) }) &&
+			layeredWindows.empty() &&
+			0 == origSrcResource->m_lockCounts[data.SrcSubResourceIndex];
+
+		PresentationTarget target = {};
+		target.resource = m_handle;
+		target.subResourceIndex = data.DstSubResourceIndex;
+		target.dstRect = data.DstRect;
+		target.displayFilter = Config::displayFilter.get();
+		target.displayFilterParam = Config::displayFilter.getParam();
+
+		if (!isPalettized && !isCursorEmulated && layeredWindows.empty() &&
+			!origSrcResource->m_msaaResolvedSurface.resource && srcResource->m_fixedData.Flags.Texture)
+		{
+			const RECT clipRect = isPartialPresentationAllowed(target, !overlayWindows.empty())
+				? getDstDamageRect(srcDamageRect, data.SrcRect, data.DstRect) : data.DstRect;
+			if (m_device.getShaderBlitter().integerScaleBlt(*this, data.DstSubResourceIndex, data.DstRect,
+				*srcResource, data.SrcSubResourceIndex, data.SrcRect, clipRect))
+			{
+				g_presentationTarget = target;
+				KernelModeThunks::setPresentDirtyRect(clipRect);
+				clearRectExterior(data.DstSubResourceIndex, data.DstRect);
+				presentLayeredWindows(*this, data.DstSubResourceIndex, getRect(data.DstSubResourceIndex),
+					overlayWindows, m_device.getAdapter().getMonitorInfo().rcMonitor);
+				Overlay::Steam::render(*this, data.DstSubResourceIndex);
+				return LOG_RESULT(S_OK);
 			}
-			m_device.getShaderBlitter().palettizedBlt(
-				*srcRtt.resource, 0, data.SrcRect, *srcResource, data.SrcSubResourceIndex, data.SrcRect, pal);
 		}
-		else if (origSrcResource->m_msaaResolvedSurface.resource)
+
+		auto& srcRtt = repo.getPresentationSourceRtt(srcWidth, srcHeight, srcResource->m_fixedData.Format);
+		if (!srcRtt.resource)
+		{
+			return LOG_RESULT(E_OUTOFMEMORY);
+		}
+
+		RECT cursorRect = {};
+		if (isCursorEmulated)
 		{
-			const auto lockData = origSrcResource->m_lockData[data.SrcSubResourceIndex];
-			const bool isSysMemOnly = lockData.isSysMemUpToDate && !lockData.isVidMemUpToDate;
-			if (isSysMemOnly)
+			const auto cursor = repo.getCursor(cursorInfo.hCursor);
+			cursorRect.left = cursorInfo.ptScreenPos.x - cursor.hotspot.x;
+			cursorRect.top = cursorInfo.ptScreenPos.y - cursor.hotspot.y;
+			cursorRect.right = cursorRect.left + cursor.size.cx;
+			cursorRect.bottom = cursorRect.top + cursor.size.cy;
+			Rect::transform(cursorRect, mi.rcEmulated, data.SrcRect);
+			InflateRect(&cursorRect, 1, 1);
+		}
+
+		target.srcRtt = *srcRtt.resource;
+		RECT dstDamageRect = data.DstRect;
+		if (isPartialPresentationAllowed(target, !overlayWindows.empty()))
+		{
+			UnionRect(&srcDamageRect, &srcDamageRect, &cursorRect);
+			UnionRect(&srcDamageRect, &srcDamageRect, &g_presentationCursorRect);
+			IntersectRect(&srcDamageRect, &srcDamageRect, &data.SrcRect);
+			dstDamageRect = getDstDamageRect(srcDamageRect, data.SrcRect, data.DstRect);
+		}
+		else
+		{
+			srcDamageRect = data.SrcRect;
+		}
+		g_presentationTarget = target;
+		g_presentationCursorRect = cursorRect;
+
+		if (!IsRectEmpty(&srcDamageRect))
+		{
+			if (isPalettized)
 			{
-				copySubResourceRegion(*srcRtt.resource, 0, data.SrcRect, *srcResource, data.SrcSubResourceIndex, data.SrcRect);
-				std::swap(origSrcResource->m_msaaResolvedSurface.resource, srcRtt.resource);
-				origSrcResource->prepareForGpuRead(data.SrcSubResourceIndex);
-				std::swap(origSrcResource->m_msaaResolvedSurface.resource, srcRtt.resource);
-				origSrcResource->m_lockData[data.SrcSubResourceIndex] = lockData;
+				const auto& entries = g_presentationSource.palette;
+				RGBQUAD pal[256] = {};
+				for (UINT i = 0; i < 256; ++i)
+				{
+					pal[i].rgbRed = entries[i].peRed;
+					pal[i].rgbGreen = entries[i].peGreen;
+					pal[i].rgbBlue = entries[i].peBlue;
+					pal[i].rgbReserved = 0xFF;
+				}
+				m_device.getShaderBlitter().palettizedBlt(
+					*srcRtt.resource, 0, srcDamageRect, *srcResource, data.SrcSubResourceIndex, srcDamageRect, pal);
+			}
+			else if (origSrcResource->m_msaaResolvedSurface.resource)
+			{
+				const auto lockData = origSrcResource->m_lockData[data.SrcSubResourceIndex];
+				const bool isSysMemOnly = lockData.isSysMemUpToDate && !lockData.isVidMemUpToDate;
+				if (isSysMemOnly)
+				{
+					copySubResourceRegion(*srcRtt.resource, 0, data.SrcRect, *srcResource, data.SrcSubResourceIndex, data.SrcRect);
+					std::swap(origSrcResource->m_msaaResolvedSurface.resource, srcRtt.resource);
+					origSrcResource->prepareForGpuRead(data.SrcSubResourceIndex);
+					std::swap(origSrcResource->m_msaaResolvedSurface.resource, srcRtt.resource);
+					origSrcResource->m_lockData[data.SrcSubResourceIndex] = lockData;
+				}
+				else
+				{
+					origSrcResource->prepareForGpuRead(data.SrcSubResourceIndex);
+					copySubResourceRegion(*srcRtt.resource, 0, data.SrcRect, *srcResource, data.SrcSubResourceIndex, data.SrcRect);
+				}
 			}
 			else
 			{
-				origSrcResource->prepareForGpuRead(data.SrcSubResourceIndex);
-				copySubResourceRegion(*srcRtt.resource, 0, data.SrcRect, *srcResource, data.SrcSubResourceIndex, data.SrcRect);
+				copySubResourceRegion(*srcRtt.resource, 0, srcDamageRect,
+					*srcResource, data.SrcSubResourceIndex, srcDamageRect);
 			}
-		}
-		else
-		{
-			copySubResourceRegion(*srcRtt.resource, 0, data.SrcRect, *srcResource, data.SrcSubResourceIndex, data.SrcRect);
-		}
 
-		auto& mi = m_device.getAdapter().getMonitorInfo();
-		presentLayeredWindows(*srcRtt.resource, 0, data.SrcRect, Gdi::Window::getVisibleLayeredWindows(), mi.rcEmulated);
+			presentLayeredWindows(*srcRtt.resource, 0, data.SrcRect, layeredWindows, mi.rcEmulated);
 
-		const auto cursorInfo = Gdi::Cursor::getEmulatedCursorInfo();
-		const bool isCursorEmulated = cursorInfo.flags == CURSOR_SHOWING && cursorInfo.hCursor;
-		if (isCursorEmulated)
-		{
-			m_device.getShaderBlitter().cursorBlt(*srcRtt.resource, 0, data.SrcRect, cursorInfo.hCursor, cursorInfo.ptScreenPos);
+			if (isCursorEmulated)
+			{
+				m_device.getShaderBlitter().cursorBlt(*srcRtt.resource, 0, data.SrcRect, cursorInfo.hCursor, cursorInfo.ptScreenPos);
+			}
 		}
 
-		m_device.getShaderBlitter().displayBlt(*this, data.DstSubResourceIndex, data.DstRect, *srcRtt.resource, 0, data.SrcRect);
+		m_device.getShaderBlitter().displayBlt(*this, data.DstSubResourceIndex, data.DstRect,
+			*srcRtt.resource, 0, data.SrcRect, isSrcUnchanged, dstDamageRect);
+		KernelModeThunks::setPresentDirtyRect(dstDamageRect);
 		clearRectExterior(data.DstSubResourceIndex, data.DstRect);
 
 		presentLayeredWindows(*this, data.DstSubResourceIndex, getRect(data.DstSubResourceIndex),
-			Gdi::Window::getVisibleOverlayWindows(), m_device.getAdapter().getMonitorInfo().rcMonitor);
+			overlayWindows, m_device.getAdapter().getMonitorInfo().rcMonitor);
 
 		Overlay::Steam::render(*this, data.DstSubResourceIndex);
 
@@ -1773,6 +2027,22 @@ namespace D3dDdi
 
 	HRESULT Resource::unlock(const D3DDDIARG_UNLOCK& data)
 	{
+		if (data.SubResourceIndex < m_lockCounts.size() && 0 != m_lockCounts[data.SubResourceIndex])
+		{
+			auto& lockDamageRect = m_lockDamageRects[data.SubResourceIndex];
+			if (!IsRectEmpty(&lockDamageRect))
+			{
+				addDamage(data.SubResourceIndex, lockDamageRect);
+				m_isPaletteResolvedSurfaceUpToDate[data.SubResourceIndex] = false;
+				m_isColorKeyedSurfaceUpToDate[data.SubResourceIndex] = false;
+				++m_writeCounts[data.SubResourceIndex];
+			}
+			if (0 == --m_lockCounts[data.SubResourceIndex])
+			{
+				lockDamageRect = {};
+			}
+		}
+
 		if (m_lockResource && m_origData.Flags.Texture)
 		{
 			m_device.getState().unlockTexture(*this);
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <memory>
+#include <optional>
 #include <vector>
 
 #include <ddraw.h>
@@ -34,6 +35,7 @@ namespace D3dDdi
 		HANDLE getNullRtHandle() const { return m_nullRt.resource ? *m_nullRt.resource : nullptr; }
 		const D3DDDIARG_CREATERESOURCE2& getOrigDesc() const { return m_origData; }
 		UINT getPaletteHandle() const { return m_paletteHandle; }
+		UINT getWriteCount(UINT subResourceIndex) const { return m_writeCounts[subResourceIndex]; }
 		bool isClampable() const { return m_isClampable; }
 		void invalidatePalettizedTexture();
 
@@ -46,6 +48,7 @@ namespace D3dDdi
 		void* getLockPtr(UINT subResourceIndex);
 		UINT getMappedColorKey(UINT colorKey) const;
 		RECT getRect(UINT subResourceIndex) const;
+		std::optional<UINT64> getSysMemHash(UINT subResourceIndex, UINT rowStep) const;
 		HRESULT lock(D3DDDIARG_LOCK& data);
 		void onDestroyResource(HANDLE resource);
 		Resource& prepareForBltSrc(const D3DDDIARG_BLT& data);
@@ -100,6 +103,7 @@ namespace D3dDdi
 			LockData() { memset(this, 0, sizeof(*this)); }
 		};
 
+		void addDamage(UINT subResourceIndex, const RECT& rect);
 		HRESULT bltLock(D3DDDIARG_LOCK& data);
 		HRESULT bltViaCpu(D3DDDIARG_BLT data, Resource& srcResource);
 		HRESULT bltViaGpu(D3DDDIARG_BLT data, Resource& srcResource);
@@ -156,6 +160,10 @@ namespace D3dDdi
 		UINT m_paletteHandle;
 		std::vector<bool> m_isPaletteResolvedSurfaceUpToDate;
 		std::vector<bool> m_isColorKeyedSurfaceUpToDate;
+		std::vector<UINT> m_writeCounts;
+		std::vector<RECT> m_damageRects;
+		std::vector<UINT> m_lockCounts;
+		std::vector<RECT> m_lockDamageRects;
 		bool m_isOversized;
 		bool m_isSurfaceRepoResource;
 		bool m_isClampable;
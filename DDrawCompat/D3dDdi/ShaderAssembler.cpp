@@ -1,5 +1,7 @@
 #include <algorithm>
 #include <array>
+#include <cmath>
+#include <cstring>
 #include <map>
 #include <sstream>
 
@@ -12,9 +14,16 @@ namespace
 {
 	const UINT BEGIN_BLOCK = 1;
 	const UINT END_BLOCK = 2;
+	const UINT MAX_OPTIMIZATION_PASSES = 8;
 	const UINT32 PARAMETER_TOKEN_RESERVED_BIT = 0x80000000;
+	const UINT VERSION_1_1 = 0x101;
+	const UINT VERSION_1_4 = 0x104;
+	const UINT VERSION_2_0 = 0x200;
+	const UINT VERSION_3_0 = 0x300;
 
 	typedef std::array<const char*, 7> Controls;
+	typedef D3dDdi::ShaderAssembler::LinearTerms LinearTerms;
+	typedef std::array<float, 4> Vector;
 
 	const Controls CMP_CONTROLS = { nullptr, "gt", "eq", "ge", "lt", "ne", "le" };
 	const Controls TEXLD_CONTROLS = { "", "p", "b" };
@@ -42,7 +51,20 @@ namespace
 		UINT32 control : 8;
 		UINT32 tokenCount : 4;
 		UINT32 isPredicated : 1;
-		UINT32 : 3;
+		UINT32 : 1;
+		UINT32 isCoIssued : 1;
+		UINT32 : 1;
+	};
+
+	struct IrInstruction
+	{
+		UINT16 opcode;
+		UINT dstCount;
+		UINT srcCount;
+		bool isRemoved;
+		bool isCoIssued;
+		bool isPaired;
+		std::vector<UINT> tokens;
 	};
 
 	struct VersionToken
@@ -63,6 +85,25 @@ namespace
 		UINT m_origPos;
 	};
 
+	template <typename Func>
+	void forEachSourceRegister(const IrInstruction& inst, Func func);
+	template <typename Func>
+	void forEachTempRead(const IrInstruction& inst, Func func);
+	bool getConstantSourceValue(const Vector& value, UINT32 token, Vector& result);
+	UINT getFreeRegisterNumber(const std::set<UINT>& usedRegisterNumbers);
+	UINT getMatrixRowCount(UINT16 opcode);
+	UINT getReadMask(UINT32 token);
+	D3DSHADER_PARAM_REGISTER_TYPE getRegisterType(UINT32 token);
+	UINT getWriteMask(UINT32 token);
+	bool isPureTempWrite(const IrInstruction& inst);
+	bool isTempRegister(UINT32 token);
+	bool isTextureInstruction(UINT16 opcode);
+	UINT32 makeConstToken(FLOAT value);
+	UINT32 makeDestinationParameterToken(D3DSHADER_PARAM_REGISTER_TYPE registerType, UINT32 registerNumber,
+		UINT32 writeMask, UINT32 modifiers);
+	UINT32 makeInstructionToken(D3DSHADER_INSTRUCTION_OPCODE_TYPE opcode, UINT version);
+	UINT32 makeSourceParameterToken(D3DSHADER_PARAM_REGISTER_TYPE registerType, UINT32 registerNumber,
+		UINT32 swizzle, D3DSHADER_PARAM_SRCMOD_TYPE modifier);
 	void setRegisterType(UINT32& token, D3DSHADER_PARAM_REGISTER_TYPE registerType);
 
 	std::map<UINT16, Instruction> g_instructionMap = {
@@ -115,11 +156,13 @@ namespace
 		{ D3DSIO_MOVA, { "mova", 1, 1 } },
 		{ D3DSIO_DEFB, { "defb", 1, 0, 1 } },
 		{ D3DSIO_DEFI, { "defi", 1, 0, 4 } },
+		{ D3DSIO_TEXCOORD, { "texcoord", 1 } },
 		{ D3DSIO_TEXKILL, { "texkill", 1 } },
 		{ D3DSIO_TEX, { "texld", 1, 2, 0, 0, &TEXLD_CONTROLS } },
 		{ D3DSIO_TEXBEM, { "texbem", 1, 1 } },
 		{ D3DSIO_TEXBEML, { "texbeml", 1, 1 } },
 		{ D3DSIO_TEXREG2AR, { "texreg2ar", 1, 1 } },
+		{ D3DSIO_TEXREG2GB, { "texreg2gb", 1, 1 } },
 		{ D3DSIO_TEXM3x2PAD, { "texm3x2pad", 1, 1 } },
 		{ D3DSIO_TEXM3x2TEX, { "texm3x2tex", 1, 1 } },
 		{ D3DSIO_TEXM3x3PAD, { "texm3x3pad", 1, 1 } },
@@ -208,6 +251,398 @@ namespace
 		{ D3DDECLUSAGE_SAMPLE, "sample" }
 	};
 
+	std::optional<LinearTerms> addLinearTerms(const std::optional<LinearTerms>& lhs, const std::optional<LinearTerms>& rhs)
+	{
+		if (!lhs || !rhs)
+		{
+			return {};
+		}
+
+		LinearTerms result = *lhs;
+		for (const auto& [key, coefficient] : *rhs)
+		{
+			result[key] += coefficient;
+		}
+		std::erase_if(result, [](const auto& term) { return 0 == term.second; });
+		return result;
+	}
+
+	bool canPropagateTo(const IrInstruction& inst, UINT srcIndex, D3DSHADER_PARAM_REGISTER_TYPE registerType, UINT version)
+	{
+		if (inst.isPaired || (1 == srcIndex && 0 != getMatrixRowCount(inst.opcode)))
+		{
+			return false;
+		}
+
+		if (isTextureInstruction(inst.opcode))
+		{
+			// ps_1_x texture instructions have fixed register semantics, and no texture coordinates come from constants
+			return D3DSPR_TEMP == registerType && version >= VERSION_2_0;
+		}
+
+		if (version < VERSION_2_0)
+		{
+			if (D3DSIO_BEM == inst.opcode || (D3DSIO_CND == inst.opcode && 0 == srcIndex))
+			{
+				return false;
+			}
+
+			const auto modifier = inst.tokens[1 + inst.dstCount + srcIndex] & D3DSP_SRCMOD_MASK;
+			return D3DSPR_CONST != registerType || D3DSPSM_NONE == modifier || D3DSPSM_NEG == modifier;
+		}
+		return true;
+	}
+
+	bool eliminateDeadCode(std::vector<IrInstruction>& instructions, UINT version)
+	{
+		std::array<UINT, 32> liveMasks = {};
+		if (version < VERSION_2_0)
+		{
+			liveMasks[0] = 0xF;
+		}
+
+		auto killWrite = [&](const IrInstruction& inst)
+			{
+				if (isPureTempWrite(inst))
+				{
+					liveMasks[inst.tokens[1] & D3DSP_REGNUM_MASK] &= ~getWriteMask(inst.tokens[1]);
+				}
+			};
+
+		auto addReads = [&](const IrInstruction& inst)
+			{
+				forEachTempRead(inst, [&](UINT regNum, UINT mask)
+					{
+						if (regNum < liveMasks.size())
+						{
+							liveMasks[regNum] |= mask;
+						}
+					});
+			};
+
+		bool isModified = false;
+		for (auto it = instructions.rbegin(); it != instructions.rend(); ++it)
+		{
+			if (it->isRemoved)
+			{
+				continue;
+			}
+
+			if (it->isCoIssued && it + 1 != instructions.rend())
+			{
+				// Both halves of a co-issued pair read their sources before either one writes
+				auto first = it + 1;
+				killWrite(*it);
+				killWrite(*first);
+				addReads(*it);
+				addReads(*first);
+				it = first;
+				continue;
+			}
+
+			if (isPureTempWrite(*it) &&
+				0 == (liveMasks[it->tokens[1] & D3DSP_REGNUM_MASK] & getWriteMask(it->tokens[1])))
+			{
+				it->isRemoved = true;
+				isModified = true;
+				continue;
+			}
+
+			killWrite(*it);
+			addReads(*it);
+		}
+		return isModified;
+	}
+
+	bool evaluateConstant(UINT16 opcode, const std::array<Vector, 3>& src, Vector& result)
+	{
+		const auto& a = src[0];
+		const auto& b = src[1];
+		const auto& c = src[2];
+
+		switch (opcode)
+		{
+		case D3DSIO_DP2ADD:
+			result.fill(a[0] * b[0] + a[1] * b[1] + c[3]);
+			return true;
+		case D3DSIO_DP3:
+			result.fill(a[0] * b[0] + a[1] * b[1] + a[2] * b[2]);
+			return true;
+		case D3DSIO_DP4:
+			result.fill(a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + a[3] * b[3]);
+			return true;
+		}
+
+		for (UINT i = 0; i < 4; ++i)
+		{
+			switch (opcode)
+			{
+			case D3DSIO_ABS:
+				result[i] = std::abs(a[i]);
+				break;
+			case D3DSIO_ADD:
+				result[i] = a[i] + b[i];
+				break;
+			case D3DSIO_CMP:
+				result[i] = a[i] >= 0 ? b[i] : c[i];
+				break;
+			case D3DSIO_CND:
+				result[i] = a[i] > 0.5f ? b[i] : c[i];
+				break;
+			case D3DSIO_FRC:
+				result[i] = a[i] - std::floor(a[i]);
+				break;
+			case D3DSIO_LRP:
+				result[i] = a[i] * (b[i] - c[i]) + c[i];
+				break;
+			case D3DSIO_MAD:
+				result[i] = a[i] * b[i] + c[i];
+				break;
+			case D3DSIO_MAX:
+				result[i] = std::max(a[i], b[i]);
+				break;
+			case D3DSIO_MIN:
+				result[i] = std::min(a[i], b[i]);
+				break;
+			case D3DSIO_MOV:
+				result[i] = a[i];
+				break;
+			case D3DSIO_MUL:
+				result[i] = a[i] * b[i];
+				break;
+			case D3DSIO_SGE:
+				result[i] = a[i] >= b[i] ? 1.0f : 0.0f;
+				break;
+			case D3DSIO_SLT:
+				result[i] = a[i] < b[i] ? 1.0f : 0.0f;
+				break;
+			case D3DSIO_SUB:
+				result[i] = a[i] - b[i];
+				break;
+			default:
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool foldConstants(std::vector<IrInstruction>& instructions, UINT version)
+	{
+		std::map<UINT, Vector> defs;
+		std::set<UINT> usedConstRegNums;
+		for (const auto& inst : instructions)
+		{
+			if (D3DSIO_DEF == inst.opcode)
+			{
+				const UINT regNum = inst.tokens[1] & D3DSP_REGNUM_MASK;
+				Vector value = {};
+				std::memcpy(value.data(), inst.tokens.data() + 2, sizeof(value));
+				defs[regNum] = value;
+				usedConstRegNums.insert(regNum);
+			}
+
+			forEachSourceRegister(inst, [&](UINT32 token, UINT regNum)
+				{
+					if (D3DSPR_CONST == getRegisterType(token))
+					{
+						usedConstRegNums.insert(regNum);
+					}
+				});
+		}
+
+		const UINT constRegCount = version < VERSION_2_0 ? 8 : (version < VERSION_3_0 ? 32 : 224);
+		std::vector<IrInstruction> newDefs;
+		bool isModified = false;
+
+		for (auto& inst : instructions)
+		{
+			if (inst.isRemoved || inst.isPaired || !isPureTempWrite(inst) || 0 == inst.srcCount || inst.srcCount > 3 ||
+				0 != getMatrixRowCount(inst.opcode) || isTextureInstruction(inst.opcode))
+			{
+				continue;
+			}
+
+			const auto dst = inst.tokens[1];
+			if (D3DSIO_MOV == inst.opcode && 0 == (dst & (D3DSP_DSTMOD_MASK | D3DSP_DSTSHIFT_MASK)) &&
+				D3DSPSM_NONE == (inst.tokens[2] & D3DSP_SRCMOD_MASK) &&
+				D3DSP_NOSWIZZLE == (inst.tokens[2] & D3DVS_SWIZZLE_MASK))
+			{
+				continue;
+			}
+
+			std::array<Vector, 3> src = {};
+			bool isConstant = true;
+			for (UINT i = 0; i < inst.srcCount && isConstant; ++i)
+			{
+				const auto token = inst.tokens[1 + inst.dstCount + i];
+				const auto def = defs.find(token & D3DSP_REGNUM_MASK);
+				isConstant = D3DSPR_CONST == getRegisterType(token) && def != defs.end() &&
+					getConstantSourceValue(def->second, token, src[i]);
+			}
+
+			Vector result = {};
+			if (!isConstant || !evaluateConstant(inst.opcode, src, result))
+			{
+				continue;
+			}
+
+			const UINT shift = (dst & D3DSP_DSTSHIFT_MASK) >> D3DSP_DSTSHIFT_SHIFT;
+			const float scale = shift < 8 ? static_cast<float>(1 << shift) : 1.0f / (1 << (16 - shift));
+			const UINT writeMask = getWriteMask(dst);
+			Vector value = {};
+			bool isInRange = true;
+			for (UINT i = 0; i < 4; ++i)
+			{
+				if (writeMask & (1 << i))
+				{
+					value[i] = result[i] * scale;
+					if (dst & D3DSPDM_SATURATE)
+					{
+						value[i] = std::clamp(value[i], 0.0f, 1.0f);
+					}
+					isInRange = isInRange && std::abs(result[i]) <= 1 && std::abs(value[i]) <= 1;
+				}
+			}
+
+			// ps_1_x constants are limited to [-1, 1], and intermediate results may be clamped to it by the hardware
+			if (version < VERSION_2_0 && !isInRange)
+			{
+				continue;
+			}
+
+			auto def = std::find_if(defs.begin(), defs.end(), [&](const auto& d)
+				{
+					for (UINT i = 0; i < 4; ++i)
+					{
+						if ((writeMask & (1 << i)) && makeConstToken(d.second[i]) != makeConstToken(value[i]))
+						{
+							return false;
+						}
+					}
+					return true;
+				});
+
+			UINT regNum = 0;
+			if (def != defs.end())
+			{
+				regNum = def->first;
+			}
+			else
+			{
+				regNum = getFreeRegisterNumber(usedConstRegNums);
+				if (regNum >= constRegCount)
+				{
+					continue;
+				}
+
+				usedConstRegNums.insert(regNum);
+				defs[regNum] = value;
+				IrInstruction defInst = { D3DSIO_DEF, 1, 0, false, false, false, {
+					makeInstructionToken(D3DSIO_DEF, version),
+					makeDestinationParameterToken(D3DSPR_CONST, regNum, D3DSP_WRITEMASK_ALL, D3DSPDM_NONE) } };
+				for (auto c : value)
+				{
+					defInst.tokens.push_back(makeConstToken(c));
+				}
+				newDefs.push_back(std::move(defInst));
+			}
+
+			inst.opcode = D3DSIO_MOV;
+			inst.srcCount = 1;
+			inst.tokens = {
+				makeInstructionToken(D3DSIO_MOV, version),
+				dst & ~(D3DSP_DSTMOD_MASK | D3DSP_DSTSHIFT_MASK),
+				makeSourceParameterToken(D3DSPR_CONST, regNum, D3DSP_NOSWIZZLE, D3DSPSM_NONE) };
+			isModified = true;
+		}
+
+		instructions.insert(instructions.begin(), newDefs.begin(), newDefs.end());
+		return isModified;
+	}
+
+	template <typename Func>
+	void forEachSourceRegister(const IrInstruction& inst, Func func)
+	{
+		for (UINT i = 0; i < inst.srcCount; ++i)
+		{
+			const auto token = inst.tokens[1 + inst.dstCount + i];
+			const UINT regCount = 1 == i && 0 != getMatrixRowCount(inst.opcode) ? getMatrixRowCount(inst.opcode) : 1;
+			for (UINT j = 0; j < regCount; ++j)
+			{
+				func(token, (token & D3DSP_REGNUM_MASK) + j);
+			}
+		}
+	}
+
+	template <typename Func>
+	void forEachTempRead(const IrInstruction& inst, Func func)
+	{
+		if (D3DSIO_TEXKILL == inst.opcode || D3DSIO_TEXDEPTH == inst.opcode)
+		{
+			if (isTempRegister(inst.tokens[1]))
+			{
+				func(inst.tokens[1] & D3DSP_REGNUM_MASK, 0xF);
+			}
+			return;
+		}
+
+		forEachSourceRegister(inst, [&](UINT32 token, UINT regNum)
+			{
+				if (isTempRegister(token))
+				{
+					func(regNum, getReadMask(token));
+				}
+			});
+	}
+
+	bool getConstantSourceValue(const Vector& value, UINT32 token, Vector& result)
+	{
+		const UINT swizzle = (token & D3DVS_SWIZZLE_MASK) >> D3DVS_SWIZZLE_SHIFT;
+		for (UINT i = 0; i < 4; ++i)
+		{
+			const float c = value[(swizzle >> (2 * i)) & 3];
+			switch (token & D3DSP_SRCMOD_MASK)
+			{
+			case D3DSPSM_NONE:
+				result[i] = c;
+				break;
+			case D3DSPSM_NEG:
+				result[i] = -c;
+				break;
+			case D3DSPSM_BIAS:
+				result[i] = c - 0.5f;
+				break;
+			case D3DSPSM_BIASNEG:
+				result[i] = -(c - 0.5f);
+				break;
+			case D3DSPSM_SIGN:
+				result[i] = 2 * c - 1;
+				break;
+			case D3DSPSM_SIGNNEG:
+				result[i] = -(2 * c - 1);
+				break;
+			case D3DSPSM_COMP:
+				result[i] = 1 - c;
+				break;
+			case D3DSPSM_X2:
+				result[i] = 2 * c;
+				break;
+			case D3DSPSM_X2NEG:
+				result[i] = -2 * c;
+				break;
+			case D3DSPSM_ABS:
+				result[i] = std::abs(c);
+				break;
+			case D3DSPSM_ABSNEG:
+				result[i] = -std::abs(c);
+				break;
+			default:
+				return false;
+			}
+		}
+		return true;
+	}
+
 	UINT getFreeRegisterNumber(const std::set<UINT>& usedRegisterNumbers)
 	{
 		UINT prev = UINT_MAX;
@@ -217,10 +652,72 @@ namespace
 			{
 				return prev + 1;
 			}
+			prev = num;
 		}
 		return usedRegisterNumbers.empty() ? 0 : (*usedRegisterNumbers.rbegin() + 1);
 	}
 
+	Instruction getInstruction(UINT16 opcode, UINT version)
+	{
+		auto it = g_instructionMap.find(opcode);
+		if (it == g_instructionMap.end())
+		{
+			return {};
+		}
+
+		if (version < VERSION_2_0)
+		{
+			switch (opcode)
+			{
+			case D3DSIO_TEX:
+				return version < VERSION_1_4 ? Instruction{ "tex", 1 } : Instruction{ "texld", 1, 1 };
+			case D3DSIO_TEXCOORD:
+				return version < VERSION_1_4 ? Instruction{ "texcoord", 1 } : Instruction{ "texcrd", 1, 1 };
+			}
+		}
+		return it->second;
+	}
+
+	UINT getMatrixRowCount(UINT16 opcode)
+	{
+		switch (opcode)
+		{
+		case D3DSIO_M3x2:
+			return 2;
+		case D3DSIO_M3x3:
+		case D3DSIO_M4x3:
+			return 3;
+		case D3DSIO_M3x4:
+		case D3DSIO_M4x4:
+			return 4;
+		}
+		return 0;
+	}
+
+	UINT getReadMask(UINT32 token)
+	{
+		const UINT swizzle = (token & D3DVS_SWIZZLE_MASK) >> D3DVS_SWIZZLE_SHIFT;
+		UINT mask = 0;
+		for (UINT i = 0; i < 4; ++i)
+		{
+			mask |= 1 << ((swizzle >> (2 * i)) & 3);
+		}
+		return mask;
+	}
+
+	UINT getReadPortCount(const IrInstruction& inst, D3DSHADER_PARAM_REGISTER_TYPE registerType)
+	{
+		std::set<UINT> regNums;
+		forEachSourceRegister(inst, [&](UINT32 token, UINT regNum)
+			{
+				if (registerType == getRegisterType(token))
+				{
+					regNums.insert(regNum);
+				}
+			});
+		return regNums.size();
+	}
+
 	D3DSHADER_PARAM_REGISTER_TYPE getRegisterType(UINT32 token)
 	{
 		return static_cast<D3DSHADER_PARAM_REGISTER_TYPE>(
@@ -228,6 +725,71 @@ namespace
 			((token & D3DSP_REGTYPE_MASK2) >> D3DSP_REGTYPE_SHIFT2));
 	}
 
+	UINT getUsageKey(UINT32 dclToken)
+	{
+		return (dclToken & D3DSP_DCL_USAGE_MASK) * 16 +
+			((dclToken & D3DSP_DCL_USAGEINDEX_MASK) >> D3DSP_DCL_USAGEINDEX_SHIFT);
+	}
+
+	UINT getWriteMask(UINT32 token)
+	{
+		return (token & D3DSP_WRITEMASK_ALL) >> 16;
+	}
+
+	bool isPureTempWrite(const IrInstruction& inst)
+	{
+		return 1 == inst.dstCount &&
+			D3DSIO_TEXKILL != inst.opcode &&
+			D3DSIO_TEXDEPTH != inst.opcode &&
+			D3DSIO_DCL != inst.opcode &&
+			isTempRegister(inst.tokens[1]);
+	}
+
+	bool isTempRegister(UINT32 token)
+	{
+		return D3DSPR_TEMP == getRegisterType(token);
+	}
+
+	bool isTextureInstruction(UINT16 opcode)
+	{
+		switch (opcode)
+		{
+		case D3DSIO_TEX:
+		case D3DSIO_TEXBEM:
+		case D3DSIO_TEXBEML:
+		case D3DSIO_TEXCOORD:
+		case D3DSIO_TEXDEPTH:
+		case D3DSIO_TEXDP3:
+		case D3DSIO_TEXDP3TEX:
+		case D3DSIO_TEXKILL:
+		case D3DSIO_TEXLDD:
+		case D3DSIO_TEXLDL:
+		case D3DSIO_TEXM3x2DEPTH:
+		case D3DSIO_TEXM3x2PAD:
+		case D3DSIO_TEXM3x2TEX:
+		case D3DSIO_TEXM3x3:
+		case D3DSIO_TEXM3x3PAD:
+		case D3DSIO_TEXM3x3SPEC:
+		case D3DSIO_TEXM3x3TEX:
+		case D3DSIO_TEXM3x3VSPEC:
+		case D3DSIO_TEXREG2AR:
+		case D3DSIO_TEXREG2GB:
+		case D3DSIO_TEXREG2RGB:
+			return true;
+		}
+		return false;
+	}
+
+	bool isWritten(const IrInstruction& inst, D3DSHADER_PARAM_REGISTER_TYPE registerType, UINT regNum)
+	{
+		return 1 == inst.dstCount &&
+			D3DSIO_TEXKILL != inst.opcode &&
+			D3DSIO_TEXDEPTH != inst.opcode &&
+			D3DSIO_DCL != inst.opcode &&
+			registerType == getRegisterType(inst.tokens[1]) &&
+			(inst.tokens[1] & D3DSP_REGNUM_MASK) == regNum;
+	}
+
 	UINT32 makeConstToken(FLOAT value)
 	{
 		return *reinterpret_cast<UINT32*>(&value);
@@ -248,6 +810,12 @@ namespace
 		return opcode | (tokenCount << D3DSI_INSTLENGTH_SHIFT);
 	}
 
+	UINT32 makeInstructionToken(D3DSHADER_INSTRUCTION_OPCODE_TYPE opcode, UINT version)
+	{
+		const auto token = makeInstructionToken(opcode);
+		return version < VERSION_2_0 ? (token & ~D3DSI_INSTLENGTH_MASK) : token;
+	}
+
 	UINT32 makeSourceParameterToken(D3DSHADER_PARAM_REGISTER_TYPE registerType, UINT32 registerNumber,
 		UINT32 swizzle, D3DSHADER_PARAM_SRCMOD_TYPE modifier)
 	{
@@ -256,6 +824,171 @@ namespace
 		return token;
 	}
 
+	std::optional<LinearTerms> multiplyLinearTerms(const std::optional<LinearTerms>& lhs, const std::optional<LinearTerms>& rhs)
+	{
+		if (!lhs || !rhs)
+		{
+			return {};
+		}
+
+		LinearTerms result;
+		for (const auto& [lhsKey, lhsCoefficient] : *lhs)
+		{
+			for (const auto& [rhsKey, rhsCoefficient] : *rhs)
+			{
+				if ((UINT_MAX != lhsKey.first && UINT_MAX != rhsKey.first) ||
+					(UINT_MAX != lhsKey.second && UINT_MAX != rhsKey.second))
+				{
+					return {};
+				}
+				const std::pair<UINT, UINT> key(std::min(lhsKey.first, rhsKey.first), std::min(lhsKey.second, rhsKey.second));
+				result[key] += lhsCoefficient * rhsCoefficient;
+			}
+		}
+		std::erase_if(result, [](const auto& term) { return 0 == term.second; });
+		return result;
+	}
+
+	bool propagateCopies(std::vector<IrInstruction>& instructions, UINT version)
+	{
+		bool isModified = false;
+		for (auto it = instructions.begin(); it != instructions.end(); ++it)
+		{
+			if (it->isRemoved || it->isPaired || D3DSIO_MOV != it->opcode || !isPureTempWrite(*it))
+			{
+				continue;
+			}
+
+			const auto dst = it->tokens[1];
+			const auto src = it->tokens[2];
+			const auto srcRegType = getRegisterType(src);
+			const UINT dstRegNum = dst & D3DSP_REGNUM_MASK;
+			const UINT srcRegNum = src & D3DSP_REGNUM_MASK;
+			if (0 != (dst & (D3DSP_DSTMOD_MASK | D3DSP_DSTSHIFT_MASK)) ||
+				(D3DSPR_TEMP != srcRegType && D3DSPR_CONST != srcRegType) ||
+				(D3DSPR_TEMP == srcRegType && dstRegNum == srcRegNum) ||
+				D3DSPSM_NONE != (src & D3DSP_SRCMOD_MASK) || D3DSP_NOSWIZZLE != (src & D3DVS_SWIZZLE_MASK))
+			{
+				continue;
+			}
+
+			const UINT readPortLimit = D3DSPR_CONST == srcRegType || version < VERSION_1_4 ? 2 : 3;
+			for (auto next = it + 1; next != instructions.end(); ++next)
+			{
+				if (next->isRemoved)
+				{
+					continue;
+				}
+
+				if (D3DSIO_PHASE == next->opcode)
+				{
+					break;
+				}
+
+				for (UINT i = 0; i < next->srcCount; ++i)
+				{
+					auto& token = next->tokens[1 + next->dstCount + i];
+					if (!isTempRegister(token) || (token & D3DSP_REGNUM_MASK) != dstRegNum ||
+						getReadMask(token) != (getReadMask(token) & getWriteMask(dst)) ||
+						!canPropagateTo(*next, i, srcRegType, version))
+					{
+						continue;
+					}
+
+					const auto origToken = token;
+					token = (token & ~D3DSP_REGNUM_MASK) | srcRegNum;
+					setRegisterType(token, srcRegType);
+					if (getReadPortCount(*next, srcRegType) > readPortLimit)
+					{
+						token = origToken;
+						continue;
+					}
+					isModified = true;
+				}
+
+				if (isWritten(*next, D3DSPR_TEMP, dstRegNum) || isWritten(*next, srcRegType, srcRegNum))
+				{
+					break;
+				}
+			}
+		}
+		return isModified;
+	}
+
+	bool removeRedundantInstructions(std::vector<IrInstruction>& instructions)
+	{
+		bool isModified = false;
+		for (auto it = instructions.begin(); it != instructions.end(); ++it)
+		{
+			if (it->isRemoved)
+			{
+				continue;
+			}
+
+			if (D3DSIO_NOP == it->opcode)
+			{
+				it->isRemoved = true;
+				isModified = true;
+				continue;
+			}
+
+			if (it->isPaired || !isPureTempWrite(*it) || 0 != getMatrixRowCount(it->opcode))
+			{
+				continue;
+			}
+
+			const auto dst = it->tokens[1];
+			const UINT dstRegNum = dst & D3DSP_REGNUM_MASK;
+			if (D3DSIO_MOV == it->opcode && 0 == (dst & (D3DSP_DSTMOD_MASK | D3DSP_DSTSHIFT_MASK)) &&
+				it->tokens[2] == makeSourceParameterToken(D3DSPR_TEMP, dstRegNum, D3DSP_NOSWIZZLE, D3DSPSM_NONE))
+			{
+				it->isRemoved = true;
+				isModified = true;
+				continue;
+			}
+
+			std::vector<std::pair<D3DSHADER_PARAM_REGISTER_TYPE, UINT>> srcRegs;
+			bool isSelfReferencing = false;
+			forEachSourceRegister(*it, [&](UINT32 token, UINT regNum)
+				{
+					srcRegs.push_back({ getRegisterType(token), regNum });
+					isSelfReferencing |= isTempRegister(token) && regNum == dstRegNum;
+				});
+			if (isSelfReferencing)
+			{
+				continue;
+			}
+
+			for (auto next = it + 1; next != instructions.end(); ++next)
+			{
+				if (next->isRemoved)
+				{
+					continue;
+				}
+
+				if (D3DSIO_PHASE == next->opcode)
+				{
+					break;
+				}
+
+				if (!next->isPaired && next->tokens == it->tokens)
+				{
+					next->isRemoved = true;
+					isModified = true;
+					continue;
+				}
+
+				if (isWritten(*next, D3DSPR_TEMP, dstRegNum) ||
+					std::any_of(srcRegs.begin(), srcRegs.end(),
+						[&](const auto& reg) { return isWritten(*next, reg.first, reg.second); }))
+				{
+					break;
+				}
+			}
+		}
+		return isModified;
+	}
+
 	UINT reserveRegisterNumber(std::set<UINT>& usedRegisterNumbers)
 	{
 		auto num = getFreeRegisterNumber(usedRegisterNumbers);
@@ -285,6 +1018,12 @@ namespace D3dDdi
 		LOG_DEBUG << "Original bytecode: " << Compat::hexDump(m_tokens.data(), m_tokens.size() * 4);
 		LOG_DEBUG << disassemble();
 
+		if (getVersion() < VERSION_2_0)
+		{
+			LOG_DEBUG << "Unsupported shader version";
+			return false;
+		}
+
 		RestorePos restorePos(m_pos);
 		m_pos = 0;
 		UINT constRegNum = UINT_MAX;
@@ -527,6 +1266,12 @@ namespace D3dDdi
 			os << "_centroid";
 		}
 
+		const UINT shift = (token & D3DSP_DSTSHIFT_MASK) >> D3DSP_DSTSHIFT_SHIFT;
+		if (0 != shift)
+		{
+			os << (shift < 8 ? "_x" : "_d") << (shift < 8 ? 1 << shift : 1 << (16 - shift));
+		}
+
 		os << ' ';
 		disassembleRegister(os, token);
 
@@ -556,20 +1301,20 @@ namespace D3dDdi
 	UINT ShaderAssembler::disassembleInstruction(std::ostream& os, UINT& indent)
 	{
 		auto token = readToken<InstructionToken>();
-		auto it = g_instructionMap.find(token.opcode);
-		if (it == g_instructionMap.end())
+		const auto inst = getInstruction(token.opcode, getVersion());
+		if (!inst.name)
 		{
 			throw std::runtime_error("Unknown opcode: " + std::to_string(token.opcode));
 		}
 
-		if ((it->second.indent & END_BLOCK) && indent > 0)
+		if ((inst.indent & END_BLOCK) && indent > 0)
 		{
 			--indent;
 		}
 
-		os << std::string(2 * indent, ' ') << it->second.name;
+		os << std::string(2 * indent, ' ') << (token.isCoIssued && getVersion() < VERSION_2_0 ? "+" : "") << inst.name;
 
-		if (it->second.indent & BEGIN_BLOCK)
+		if (inst.indent & BEGIN_BLOCK)
 		{
 			++indent;
 		}
@@ -580,10 +1325,10 @@ namespace D3dDdi
 			return token.opcode;
 		}
 
-		if (0 != token.control || it->second.controls)
+		if (0 != token.control || inst.controls)
 		{
-			auto control = (it->second.controls && token.control < it->second.controls->size())
-				? it->second.controls->at(token.control)
+			auto control = (inst.controls && token.control < inst.controls->size())
+				? inst.controls->at(token.control)
 				: nullptr;
 			if (!control)
 			{
@@ -593,10 +1338,9 @@ namespace D3dDdi
 			os << control;
 		}
 
-		auto inst = it->second;
-		auto extraCount = it->second.extraCount;
+		auto extraCount = inst.extraCount;
 		auto tokenCount = inst.dstCount + inst.srcCount + extraCount;
-		if (token.tokenCount != tokenCount)
+		if (getVersion() >= VERSION_2_0 && token.tokenCount != tokenCount)
 		{
 			throw std::runtime_error("Instruction length mismatch: expected " + std::to_string(token.tokenCount) +
 				", got " + std::to_string(tokenCount) + ", opcode: " + std::to_string(token.opcode));
@@ -616,13 +1360,13 @@ namespace D3dDdi
 		}
 
 		const char* separator = " ";
-		if (it->second.dstCount)
+		if (inst.dstCount)
 		{
 			disassembleDestinationParameter(os);
 			separator = ", ";
 		}
 
-		for (UINT i = 0; i < it->second.srcCount; ++i)
+		for (UINT i = 0; i < inst.srcCount; ++i)
 		{
 			os << separator;
 			disassembleSourceParameter(os);
@@ -742,12 +1486,211 @@ namespace D3dDdi
 		os << ((Pixel == version.type) ? "ps" : "vs")
 			<< '_' << static_cast<UINT>(version.major)
 			<< '_' << static_cast<UINT>(version.minor);
-		if (2 != version.major || 0 != version.minor)
+		if ((2 != version.major || 0 != version.minor) && (Pixel != version.type || 1 != version.major))
 		{
 			throw std::runtime_error("Unsupported shader version");
 		}
 	}
 
+	std::map<UINT, std::array<std::optional<ShaderAssembler::LinearTerms>, 4>> ShaderAssembler::evaluateVertexShaderOutputs(
+		UINT firstConst, UINT constCount)
+	{
+		typedef std::array<std::optional<LinearTerms>, 4> Register;
+		if (m_tokens.empty() || Vertex != getShaderType() || VERSION_3_0 != getVersion())
+		{
+			return {};
+		}
+
+		RestorePos restorePos(m_pos);
+		m_pos = 0;
+		std::map<UINT, UINT> inputUsages;
+		std::map<UINT, UINT> outputUsages;
+		std::map<UINT, Vector> defs;
+		std::map<UINT, Register> temps;
+		std::map<UINT, Register> outputs;
+		UINT depth = 0;
+
+		while (nextInstruction())
+		{
+			const auto token = getToken<InstructionToken>();
+			const auto info = getInstruction(token.opcode, VERSION_3_0);
+			if (!info.name || getInstructionTokenCount() != info.dstCount + info.srcCount + info.extraCount ||
+				D3DSIO_CALL == token.opcode || D3DSIO_CALLNZ == token.opcode ||
+				D3DSIO_LABEL == token.opcode || D3DSIO_RET == token.opcode)
+			{
+				return {};
+			}
+
+			if (info.indent & END_BLOCK)
+			{
+				--depth;
+			}
+			if (info.indent & BEGIN_BLOCK)
+			{
+				++depth;
+			}
+
+			if (D3DSIO_DCL == token.opcode)
+			{
+				const auto dst = getToken<UINT32>(2);
+				auto& usages = D3DSPR_INPUT == getRegisterType(dst) ? inputUsages : outputUsages;
+				usages[dst & D3DSP_REGNUM_MASK] = getUsageKey(getToken<UINT32>(1));
+				continue;
+			}
+
+			if (D3DSIO_DEF == token.opcode)
+			{
+				auto& def = defs[getToken<UINT32>(1) & D3DSP_REGNUM_MASK];
+				std::memcpy(def.data(), &m_tokens[m_pos + 2], sizeof(def));
+				continue;
+			}
+
+			if (0 == info.dstCount || D3DSIO_DEFB == token.opcode || D3DSIO_DEFI == token.opcode)
+			{
+				continue;
+			}
+
+			const auto dst = getToken<UINT32>(1);
+			const auto dstRegType = getRegisterType(dst);
+			if (D3DSPR_TEMP != dstRegType && D3DSPR_OUTPUT != dstRegType)
+			{
+				continue;
+			}
+
+			auto getSource = [&](UINT srcIndex, UINT component, UINT regOffset) -> std::optional<LinearTerms>
+				{
+					const auto src = getToken<UINT32>(1 + info.dstCount + srcIndex);
+					const auto modifier = src & D3DSP_SRCMOD_MASK;
+					const UINT regNum = (src & D3DSP_REGNUM_MASK) + regOffset;
+					const UINT swizzledComponent = (src >> (D3DVS_SWIZZLE_SHIFT + 2 * component)) & 3;
+					if (D3DSPSM_NONE != modifier && D3DSPSM_NEG != modifier)
+					{
+						return {};
+					}
+
+					std::optional<LinearTerms> value;
+					switch (getRegisterType(src))
+					{
+					case D3DSPR_TEMP:
+					{
+						auto it = temps.find(regNum);
+						if (it != temps.end())
+						{
+							value = it->second[swizzledComponent];
+						}
+						break;
+					}
+
+					case D3DSPR_INPUT:
+					{
+						auto it = inputUsages.find(regNum);
+						if (it != inputUsages.end())
+						{
+							value = LinearTerms{ { { it->second * 4 + swizzledComponent, UINT_MAX }, 1.0f } };
+						}
+						break;
+					}
+
+					case D3DSPR_CONST:
+					{
+						auto it = defs.find(regNum);
+						if (it != defs.end())
+						{
+							value = LinearTerms{};
+							if (0 != it->second[swizzledComponent])
+							{
+								(*value)[{ UINT_MAX, UINT_MAX }] = it->second[swizzledComponent];
+							}
+						}
+						else if (regNum - firstConst < constCount)
+						{
+							value = LinearTerms{ { { UINT_MAX, (regNum - firstConst) * 4 + swizzledComponent }, 1.0f } };
+						}
+						break;
+					}
+					}
+
+					if (value && D3DSPSM_NEG == modifier)
+					{
+						for (auto& term : *value)
+						{
+							term.second = -term.second;
+						}
+					}
+					return value;
+				};
+
+			auto getDotProduct = [&](UINT componentCount, UINT regOffset)
+				{
+					std::optional<LinearTerms> result = LinearTerms{};
+					for (UINT i = 0; i < componentCount; ++i)
+					{
+						result = addLinearTerms(result, multiplyLinearTerms(getSource(0, i, 0), getSource(1, i, regOffset)));
+					}
+					return result;
+				};
+
+			Register result = {};
+			if (0 == depth && !token.isPredicated && 0 == (dst & (D3DSP_DSTMOD_MASK | D3DSP_DSTSHIFT_MASK)))
+			{
+				const UINT matrixRowCount = getMatrixRowCount(token.opcode);
+				for (UINT i = 0; i < 4; ++i)
+				{
+					switch (token.opcode)
+					{
+					case D3DSIO_MOV:
+						result[i] = getSource(0, i, 0);
+						break;
+					case D3DSIO_ADD:
+						result[i] = addLinearTerms(getSource(0, i, 0), getSource(1, i, 0));
+						break;
+					case D3DSIO_MUL:
+						result[i] = multiplyLinearTerms(getSource(0, i, 0), getSource(1, i, 0));
+						break;
+					case D3DSIO_MAD:
+						result[i] = addLinearTerms(
+							multiplyLinearTerms(getSource(0, i, 0), getSource(1, i, 0)), getSource(2, i, 0));
+						break;
+					case D3DSIO_DP3:
+						result[i] = getDotProduct(3, 0);
+						break;
+					case D3DSIO_DP4:
+						result[i] = getDotProduct(4, 0);
+						break;
+					case D3DSIO_M3x2:
+					case D3DSIO_M3x3:
+					case D3DSIO_M3x4:
+					case D3DSIO_M4x3:
+					case D3DSIO_M4x4:
+						if (i < matrixRowCount)
+						{
+							const bool isM4 = D3DSIO_M4x3 == token.opcode || D3DSIO_M4x4 == token.opcode;
+							result[i] = getDotProduct(isM4 ? 4 : 3, i);
+						}
+						break;
+					}
+				}
+			}
+
+			auto& reg = D3DSPR_TEMP == dstRegType ? temps[dst & D3DSP_REGNUM_MASK] : outputs[dst & D3DSP_REGNUM_MASK];
+			const UINT writeMask = getWriteMask(dst);
+			for (UINT i = 0; i < 4; ++i)
+			{
+				if (writeMask & (1 << i))
+				{
+					reg[i] = result[i];
+				}
+			}
+		}
+
+		std::map<UINT, Register> outputsByUsage;
+		for (const auto& [regNum, usageKey] : outputUsages)
+		{
+			outputsByUsage[usageKey] = outputs[regNum];
+		}
+		return outputsByUsage;
+	}
+
 	void ShaderAssembler::getDefCounts(UINT& floats, UINT& bools, UINT& ints)
 	{
 		LOG_FUNC("ShaderAssembler::getDefCounts", floats, bools, ints);
@@ -789,11 +1732,129 @@ namespace D3dDdi
 		}
 	}
 
+	UINT ShaderAssembler::getInstructionTokenCount() const
+	{
+		const auto token = getToken<InstructionToken>();
+		if (getVersion() >= VERSION_2_0)
+		{
+			return token.tokenCount;
+		}
+
+		// Instruction lengths are only encoded since shader model 2
+		const auto inst = getInstruction(token.opcode, getVersion());
+		return inst.dstCount + inst.srcCount + inst.extraCount;
+	}
+
+	std::map<UINT, UINT> ShaderAssembler::getPassThroughTexCoords()
+	{
+		const UINT texCoordKey = D3DDECLUSAGE_TEXCOORD * 16;
+		std::map<UINT, UINT> texCoords;
+		for (const auto& [usageKey, output] : evaluateVertexShaderOutputs(0, 0))
+		{
+			if (usageKey - texCoordKey >= 16 || !output[0] || !output[1] || 1 != output[0]->size())
+			{
+				continue;
+			}
+
+			const auto inputComponent = output[0]->begin()->first.first;
+			const UINT inputKey = inputComponent / 4;
+			if (inputKey - texCoordKey < 16 && 0 == inputComponent % 4 &&
+				*output[0] == LinearTerms{ { { inputComponent, UINT_MAX }, 1.0f } } &&
+				*output[1] == LinearTerms{ { { inputComponent + 1, UINT_MAX }, 1.0f } })
+			{
+				texCoords[usageKey - texCoordKey] = inputKey - texCoordKey;
+			}
+		}
+		return texCoords;
+	}
+
+	std::optional<ShaderAssembler::PositionTransform> ShaderAssembler::getPositionTransform(UINT firstConst, UINT constCount)
+	{
+		const UINT positionKey = D3DDECLUSAGE_POSITION * 16;
+		const auto outputs = evaluateVertexShaderOutputs(firstConst, constCount);
+		auto it = outputs.find(positionKey);
+		if (it == outputs.end())
+		{
+			return {};
+		}
+
+		PositionTransform transform = {};
+		for (UINT i = 0; i < 4; ++i)
+		{
+			if (!it->second[i])
+			{
+				return {};
+			}
+
+			for (const auto& term : *it->second[i])
+			{
+				if (UINT_MAX != term.first.first && positionKey != term.first.first / 4)
+				{
+					return {};
+				}
+			}
+			transform[i] = *it->second[i];
+		}
+		return transform;
+	}
+
 	UINT ShaderAssembler::getRemainingTokenCount() const
 	{
 		return m_tokens.size() - m_pos;
 	}
 
+	std::optional<std::set<UINT>> ShaderAssembler::getSamplerTexCoords(const std::set<UINT>& samplers)
+	{
+		if (m_tokens.empty() || Pixel != getShaderType() || VERSION_3_0 != getVersion())
+		{
+			return {};
+		}
+
+		RestorePos restorePos(m_pos);
+		m_pos = 0;
+		std::map<UINT, UINT> texCoordRegs;
+		std::set<UINT> texCoords;
+
+		while (nextInstruction())
+		{
+			const auto token = getToken<InstructionToken>();
+			if (D3DSIO_DCL == token.opcode)
+			{
+				const auto usage = getToken<UINT32>(1);
+				const auto dst = getToken<UINT32>(2);
+				if (D3DSPR_INPUT == getRegisterType(dst) && D3DDECLUSAGE_TEXCOORD == (usage & D3DSP_DCL_USAGE_MASK) &&
+					(getWriteMask(dst) & 3) == 3)
+				{
+					texCoordRegs[dst & D3DSP_REGNUM_MASK] = (usage & D3DSP_DCL_USAGEINDEX_MASK) >> D3DSP_DCL_USAGEINDEX_SHIFT;
+				}
+				continue;
+			}
+
+			if (D3DSIO_TEX != token.opcode && D3DSIO_TEXLDL != token.opcode && D3DSIO_TEXLDD != token.opcode)
+			{
+				continue;
+			}
+
+			const auto coords = getToken<UINT32>(2);
+			const auto sampler = getToken<UINT32>(3);
+			if (samplers.find(sampler & D3DSP_REGNUM_MASK) == samplers.end())
+			{
+				continue;
+			}
+
+			auto it = texCoordRegs.find(coords & D3DSP_REGNUM_MASK);
+			if ((D3DSIO_TEX == token.opcode && 1 == token.control) ||
+				D3DSPR_INPUT != getRegisterType(coords) || it == texCoordRegs.end() ||
+				(coords & (D3DSP_SRCMOD_MASK | D3DSHADER_ADDRESSMODE_MASK)) ||
+				((coords & D3DVS_SWIZZLE_MASK) >> D3DVS_SWIZZLE_SHIFT & 0xF) != 0x4)
+			{
+				return {};
+			}
+			texCoords.insert(it->second);
+		}
+		return texCoords;
+	}
+
 	ShaderAssembler::ShaderType ShaderAssembler::getShaderType() const
 	{
 		return static_cast<ShaderType>(m_tokens.front() >> 16);
@@ -819,14 +1880,15 @@ namespace D3dDdi
 		std::set<UINT> usedRegisterNumbers;
 		while (nextInstruction())
 		{
-			auto it = g_instructionMap.find(getToken<InstructionToken>().opcode);
-			if (it == g_instructionMap.end())
+			const auto opcode = getToken<InstructionToken>().opcode;
+			const auto inst = getInstruction(opcode, getVersion());
+			if (!inst.name)
 			{
 				continue;
 			}
 
-			const UINT offset = D3DSIO_DCL == it->first ? 2 : 1;
-			const auto tokenCount = it->second.dstCount + it->second.srcCount;
+			const UINT offset = D3DSIO_DCL == opcode ? 2 : 1;
+			const auto tokenCount = inst.dstCount + inst.srcCount;
 			for (UINT i = 0; i < tokenCount; ++i)
 			{
 				auto token = getToken<UINT32>(offset + i);
@@ -839,6 +1901,11 @@ namespace D3dDdi
 		return usedRegisterNumbers;
 	}
 
+	UINT ShaderAssembler::getVersion() const
+	{
+		return m_tokens.empty() ? 0 : (m_tokens.front() & 0xFFFF);
+	}
+
 	void ShaderAssembler::insertToken(UINT32 token)
 	{
 		m_tokens.insert(m_tokens.begin() + m_pos, token);
@@ -853,8 +1920,7 @@ namespace D3dDdi
 		}
 		else
 		{
-			auto token = readToken<InstructionToken>();
-			readTokens(token.tokenCount);
+			readTokens(1 + getInstructionTokenCount());
 		}
 
 		while (D3DSIO_COMMENT == getToken<InstructionToken>().opcode)
@@ -865,6 +1931,115 @@ namespace D3dDdi
 		return m_pos < m_tokens.size() && D3DSIO_END != getToken<InstructionToken>().opcode;
 	}
 
+	bool ShaderAssembler::optimize()
+	{
+		LOG_FUNC("ShaderAssembler::optimize");
+		const UINT version = getVersion();
+		if (m_tokens.empty() || Pixel != getShaderType() || version < VERSION_1_1 || version > VERSION_3_0)
+		{
+			LOG_DEBUG << "Unsupported shader version";
+			return LOG_RESULT(false);
+		}
+
+		RestorePos restorePos(m_pos);
+		m_pos = 0;
+		std::vector<IrInstruction> instructions;
+
+		while (nextInstruction())
+		{
+			const auto token = getToken<InstructionToken>();
+			const auto info = getInstruction(token.opcode, version);
+			const UINT tokenCount = getInstructionTokenCount();
+			if (!info.name || 0 != info.indent || token.isPredicated ||
+				tokenCount != info.dstCount + info.srcCount + info.extraCount ||
+				tokenCount >= getRemainingTokenCount())
+			{
+				LOG_DEBUG << "Unsupported instruction: " << token.opcode;
+				return LOG_RESULT(false);
+			}
+
+			switch (token.opcode)
+			{
+			case D3DSIO_BREAK:
+			case D3DSIO_BREAKC:
+			case D3DSIO_BREAKP:
+			case D3DSIO_CALL:
+			case D3DSIO_CALLNZ:
+			case D3DSIO_LABEL:
+			case D3DSIO_RET:
+				LOG_DEBUG << "Unsupported flow control instruction: " << token.opcode;
+				return LOG_RESULT(false);
+			}
+
+			IrInstruction inst = { static_cast<UINT16>(token.opcode), info.dstCount, info.srcCount, false,
+				version < VERSION_2_0 && token.isCoIssued, false,
+				std::vector<UINT>(m_tokens.begin() + m_pos, m_tokens.begin() + m_pos + 1 + tokenCount) };
+
+			if (D3DSIO_DCL != inst.opcode && D3DSIO_DEF != inst.opcode &&
+				D3DSIO_DEFB != inst.opcode && D3DSIO_DEFI != inst.opcode)
+			{
+				for (UINT i = 0; i < inst.dstCount + inst.srcCount; ++i)
+				{
+					const auto param = inst.tokens[1 + i];
+					if ((param & D3DSHADER_ADDRESSMODE_MASK) ||
+						(isTempRegister(param) && (param & D3DSP_REGNUM_MASK) >= 32))
+					{
+						LOG_DEBUG << "Unsupported parameter: " << Compat::hex(param);
+						return LOG_RESULT(false);
+					}
+				}
+			}
+
+			if (inst.isCoIssued && !instructions.empty())
+			{
+				instructions.back().isPaired = true;
+				inst.isPaired = true;
+			}
+			instructions.push_back(std::move(inst));
+		}
+
+		bool isModified = false;
+		for (UINT i = 0; i < MAX_OPTIMIZATION_PASSES; ++i)
+		{
+			bool isPassModified = foldConstants(instructions, version);
+			isPassModified |= removeRedundantInstructions(instructions);
+			isPassModified |= propagateCopies(instructions, version);
+			isPassModified |= eliminateDeadCode(instructions, version);
+			if (!isPassModified)
+			{
+				break;
+			}
+			isModified = true;
+		}
+
+		if (!isModified)
+		{
+			LOG_DEBUG << "No optimizations applied";
+			return LOG_RESULT(false);
+		}
+
+		std::vector<UINT> tokens = { m_tokens.front() };
+		UINT removedCount = 0;
+		for (const auto& inst : instructions)
+		{
+			if (inst.isRemoved)
+			{
+				++removedCount;
+			}
+			else
+			{
+				tokens.insert(tokens.end(), inst.tokens.begin(), inst.tokens.end());
+			}
+		}
+		tokens.insert(tokens.end(), m_tokens.begin() + m_pos, m_tokens.end());
+		m_tokens = std::move(tokens);
+
+		LOG_DEBUG << "Removed instructions: " << removedCount << '/' << instructions.size();
+		LOG_DEBUG << "Optimized bytecode: " << Compat::hexDump(m_tokens.data(), m_tokens.size() * 4);
+		LOG_DEBUG << disassemble();
+		return LOG_RESULT(true);
+	}
+
 	UINT ShaderAssembler::readToken()
 	{
 		return *readTokens(1);
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <array>
+#include <map>
+#include <optional>
 #include <ostream>
 #include <set>
 #include <string>
@@ -13,14 +15,24 @@ namespace D3dDdi
 	class ShaderAssembler
 	{
 	public:
+		// A value that is linear in the shader inputs and in a range of float constants, as a sum of
+		// coefficient * input * constant terms keyed by (input component, constant component) indexes,
+		// where UINT_MAX stands for a factor of 1
+		typedef std::map<std::pair<UINT, UINT>, float> LinearTerms;
+		typedef std::array<LinearTerms, 4> PositionTransform;
+
 		ShaderAssembler(const UINT* code, DWORD size);
 
 		bool addAlphaTest(UINT alphaRef);
 		void applyTexCoordIndexes(const std::array<UINT, 8>& texCoordIndexes);
 		std::string disassemble();
 		void getDefCounts(UINT& floats, UINT& bools, UINT& ints);
+		std::map<UINT, UINT> getPassThroughTexCoords();
+		std::optional<PositionTransform> getPositionTransform(UINT firstConst, UINT constCount);
+		std::optional<std::set<UINT>> getSamplerTexCoords(const std::set<UINT>& samplers);
 		UINT getTextureStageCount();
 		const std::vector<UINT>& getTokens() const { return m_tokens; }
+		bool optimize();
 
 	private:
 		enum ShaderType
@@ -39,9 +51,13 @@ namespace D3dDdi
 		void disassembleSourceParameter(std::ostream& os);
 		void disassembleSourceSwizzle(std::ostream& os, UINT token);
 		void disassembleVersion(std::ostream& os);
+		std::map<UINT, std::array<std::optional<LinearTerms>, 4>> evaluateVertexShaderOutputs(
+			UINT firstConst, UINT constCount);
+		UINT getInstructionTokenCount() const;
 		UINT getRemainingTokenCount() const;
 		ShaderType getShaderType() const;
 		std::set<UINT> getUsedRegisterNumbers(int registerType);
+		UINT getVersion() const;
 		void insertToken(UINT32 token);
 		bool nextInstruction();
 		UINT readToken();
@@ -1,3 +1,8 @@
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <Common/Hash.h>
 #include <Common/Log.h>
 #include <Common/Rect.h>
 #include <Config/Settings/DisplayFilter.h>
@@ -7,10 +12,13 @@
 #include <D3dDdi/Resource.h>
 #include <D3dDdi/ShaderBlitter.h>
 #include <D3dDdi/SurfaceRepository.h>
+#include <Gdi/GuiThread.h>
+#include <Overlay/StatsWindow.h>
 #include <Shaders/AlphaBlend.h>
 #include <Shaders/Bilinear.h>
 #include <Shaders/ColorKey.h>
 #include <Shaders/ColorKeyBlend.h>
+#include <Shaders/ConvolutionTable.h>
 #include <Shaders/CubicConvolution2.h>
 #include <Shaders/CubicConvolution3.h>
 #include <Shaders/CubicConvolution4.h>
@@ -46,10 +54,25 @@ namespace
 	const UINT CF_GAMMARAMP = 2;
 	const UINT CF_DITHERING = 4;
 
+	const UINT KERNEL_BICUBIC = 1;
+	const UINT KERNEL_LANCZOS = 2;
+	const UINT KERNEL_SPLINE = 3;
+
+	const UINT WEIGHT_TABLE_PHASE_COUNT = 64;
+
 	D3DDDI_GAMMA_RAMP_RGB256x3x16 g_gammaRamp;
 	bool g_isGammaRampDefault = true;
 	bool g_isGammaRampInvalidated = false;
 
+	void addDrawsPerBlit(UINT count)
+	{
+		auto statsWindow = Gdi::GuiThread::getStatsWindow();
+		if (statsWindow && statsWindow->m_drawsPerBlit.isEnabled())
+		{
+			statsWindow->m_drawsPerBlit.addSample(StatsQueue::getTickCount(), count);
+		}
+	}
+
 	std::array<D3dDdi::DeviceState::ShaderConstF, 2> convertToShaderConst(D3dDdi::ShaderBlitter::ColorKeyInfo colorKeyInfo)
 	{
 		if (D3DDDIFMT_UNKNOWN == colorKeyInfo.format)
@@ -73,6 +96,31 @@ namespace
 		} };
 	}
 
+	float getCubicWeight(float x, const std::array<D3dDdi::DeviceState::ShaderConstF, 4>& coefficients, UINT lobes)
+	{
+		x = std::min(std::abs(x), static_cast<float>(lobes));
+		const auto& c = coefficients[std::min(static_cast<UINT>(x), lobes - 1)];
+		return ((c[0] * x + c[1]) * x + c[2]) * x + c[3];
+	}
+
+	BYTE getMaxBpcDiff(const D3dDdi::FormatInfo& dstFi, const D3dDdi::FormatInfo& srcFi)
+	{
+		BYTE maxBpcDiff = 0;
+		maxBpcDiff = std::max<BYTE>(maxBpcDiff, srcFi.red.bitCount - dstFi.red.bitCount);
+		maxBpcDiff = std::max<BYTE>(maxBpcDiff, srcFi.green.bitCount - dstFi.green.bitCount);
+		maxBpcDiff = std::max<BYTE>(maxBpcDiff, srcFi.blue.bitCount - dstFi.blue.bitCount);
+		return maxBpcDiff;
+	}
+
+	float getLanczosWeight(float x, float support)
+	{
+		const float PI = 3.14159265f;
+		x = std::min(std::abs(x), support);
+		const float piX = PI * x;
+		const float piX2 = piX * piX;
+		return 0 == piX2 ? 1 : (support * std::sin(piX) * std::sin(piX / support) / piX2);
+	}
+
 	constexpr D3dDdi::DeviceState::ShaderConstF getSplineWeights(int n, float a, float b, float c, float d)
 	{
 		return {
@@ -82,6 +130,47 @@ namespace
 			-n * n * n * a + n * n * b - n * c + d
 		};
 	}
+
+	DWORD packWeight(float weight)
+	{
+		return static_cast<DWORD>(std::clamp((weight + 0.5f) / 2, 0.0f, 1.0f) * 0xFFFF + 0.5f);
+	}
+
+	DWORD packWeights(float weight0, float weight1)
+	{
+		const DWORD w0 = packWeight(weight0);
+		const DWORD w1 = packWeight(weight1);
+		return ((w1 & 0xFF) << 24) | ((w0 >> 8) << 16) | ((w0 & 0xFF) << 8) | (w1 >> 8);
+	}
+
+	void initWeightTable(const DDSURFACEDESC2& desc, const std::function<float(float)>& kernel,
+		UINT sampleCountHalf, float kernelCoordStep)
+	{
+		std::vector<float> weights(2 * sampleCountHalf);
+		auto row = static_cast<BYTE*>(desc.lpSurface);
+		for (UINT phase = 0; phase <= WEIGHT_TABLE_PHASE_COUNT; ++phase)
+		{
+			const float firstSampleOffset = 1.0f - sampleCountHalf - static_cast<float>(phase) / WEIGHT_TABLE_PHASE_COUNT;
+			float sum = 0;
+			for (UINT i = 0; i < weights.size(); ++i)
+			{
+				weights[i] = kernel((firstSampleOffset + i) * kernelCoordStep);
+				sum += weights[i];
+			}
+
+			if (0 == sum)
+			{
+				sum = 1;
+			}
+
+			auto texels = reinterpret_cast<DWORD*>(row);
+			for (UINT i = 0; i < sampleCountHalf; ++i)
+			{
+				texels[i] = packWeights(weights[2 * i] / sum, weights[2 * i + 1] / sum);
+			}
+			row += desc.lPitch;
+		}
+	}
 }
 
 namespace D3dDdi
@@ -100,6 +189,7 @@ namespace D3dDdi
 		, m_psBilinear(createPixelShader(g_psBilinear))
 		, m_psColorKey(createPixelShader(g_psColorKey))
 		, m_psColorKeyBlend(createPixelShader(g_psColorKeyBlend))
+		, m_psConvolutionTable(createPixelShader(g_psConvolutionTable))
 		, m_psCubicConvolution{
 			createPixelShader(g_psCubicConvolution2),
 			createPixelShader(g_psCubicConvolution3),
@@ -126,6 +216,8 @@ namespace D3dDdi
 		, m_vertexShaderDecl(createVertexShaderDecl())
 		, m_convolutionParams{}
 		, m_vertices{}
+		, m_clipResource(nullptr)
+		, m_clipRect{}
 	{
 		for (std::size_t i = 0; i < m_vertices.size(); ++i)
 		{
@@ -144,7 +236,7 @@ namespace D3dDdi
 		auto ck = convertToShaderConst(srcColorKey);
 		ck[0][3] = alpha / 255.0f;
 		const D3DDDIARG_SETPIXELSHADERCONST psConst = { 200, 2 };
-		m_device.getOrigVtable().pfnSetPixelShaderConst(m_device, &psConst, &ck[0][0]);
+		m_device.getState().setTempPixelShaderConst(psConst, &ck[0][0]);
 
 		blt(dstResource, dstSubResourceIndex, dstRect,
 			srcResource, srcSubResourceIndex, srcRect,
@@ -160,11 +252,14 @@ namespace D3dDdi
 		const float B = blurPercent / 100.0f;
 		const float C = (1 - B) / 2;
 
-		m_convolutionParams.extra[0] = { (12 - 9 * B - 6 * C) / 6, (-18 + 12 * B + 6 * C) / 6, 0, (6 - 2 * B) / 6 };
-		m_convolutionParams.extra[1] = { (-B - 6 * C) / 6, (6 * B + 30 * C) / 6, (-12 * B - 48 * C) / 6, (8 * B + 24 * C) / 6 };
+		std::array<DeviceState::ShaderConstF, 4> coefficients = {};
+		coefficients[0] = { (12 - 9 * B - 6 * C) / 6, (-18 + 12 * B + 6 * C) / 6, 0, (6 - 2 * B) / 6 };
+		coefficients[1] = { (-B - 6 * C) / 6, (6 * B + 30 * C) / 6, (-12 * B - 48 * C) / 6, (8 * B + 24 * C) / 6 };
 
 		convolutionBlt(dstResource, dstSubResourceIndex, dstRect, srcResource, srcSubResourceIndex, srcRect,
-			2, m_psCubicConvolution[0]);
+			2, m_psCubicConvolution[0],
+			[&](bool /*isHorizontal*/) { m_convolutionParams.extra = coefficients; },
+			{ KERNEL_BICUBIC, blurPercent, [=](float x) { return getCubicWeight(x, coefficients, 2); } });
 	}
 
 	void ShaderBlitter::bilinearBlt(const Resource& dstResource, UINT dstSubResourceIndex, const RECT& dstRect,
@@ -243,8 +338,8 @@ namespace D3dDdi
 		state.setTempRenderState({ D3DDDIRS_CLIPPLANEENABLE, 0 });
 		state.setTempRenderState({ D3DDDIRS_MULTISAMPLEANTIALIAS, FALSE });
 		state.setTempRenderState({ D3DDDIRS_COLORWRITEENABLE, 0xF });
-		state.setTempRenderState({ D3DDDIRS_SCISSORTESTENABLE, FALSE });
 		state.setTempRenderState({ D3DDDIRS_SRGBWRITEENABLE, srgbWrite });
+		setTempClipRect(dstResource);
 
 		if (alpha)
 		{
@@ -270,18 +365,12 @@ namespace D3dDdi
 
 		if (srcRgn)
 		{
-			auto srcRects(srcRgn.getRects());
-			for (const auto& sr : srcRects)
-			{
-				RectF dr = Rect::toRectF(sr);
-				Rect::transform(dr, srcRect, dstRect);
-				setTextureCoords(0, sr, srcSurface.Width, srcSurface.Height);
-				drawRect(dr);
-			}
+			drawRegion(srcRgn.getRects(), srcRect, dstRect, srcSurface.Width, srcSurface.Height);
 		}
 		else
 		{
 			drawRect(Rect::toRectF(dstRect));
+			addDrawsPerBlit(1);
 		}
 	}
 
@@ -290,7 +379,7 @@ namespace D3dDdi
 	{
 		const auto ck = convertToShaderConst(srcColorKey);
 		const D3DDDIARG_SETPIXELSHADERCONST psConst = { 200, 2 };
-		m_device.getOrigVtable().pfnSetPixelShaderConst(m_device, &psConst, &ck[0][0]);
+		m_device.getState().setTempPixelShaderConst(psConst, &ck[0][0]);
 
 		blt(dstResource, dstSubResourceIndex, dstResource.getRect(dstSubResourceIndex),
 			srcResource, srcSubResourceIndex, srcResource.getRect(srcSubResourceIndex),
@@ -299,11 +388,12 @@ namespace D3dDdi
 
 	void ShaderBlitter::convolution(const Resource& dstResource, UINT dstSubResourceIndex, const RECT& dstRect,
 		const Resource& srcResource, UINT srcSubResourceIndex, const RECT& srcRect,
-		Float2 support, const DeviceState::TempShader& ps, const std::function<void(bool)> setExtraParams, DWORD flags)
+		Float2 support, const DeviceState::TempShader& ps, const std::function<void(bool)> setExtraParams,
+		const ConvolutionKernel& kernel, DWORD flags)
 	{
 		LOG_FUNC("ShaderBlitter::convolution", static_cast<HANDLE>(dstResource), dstSubResourceIndex, dstRect,
 			static_cast<HANDLE>(srcResource), srcSubResourceIndex, srcRect,
-			support, ps.shader.get(), static_cast<bool>(setExtraParams), flags);
+			support, ps.shader.get(), static_cast<bool>(setExtraParams), kernel.type, flags);
 
 		const auto& srcDesc = srcResource.getFixedDesc().pSurfList[0];
 		const Float2 dstSize(dstRect.right - dstRect.left, dstRect.bottom - dstRect.top);
@@ -344,6 +434,19 @@ namespace D3dDdi
 			setExtraParams(isHorizontal);
 		}
 
+		const DeviceState::TempShader* shader = &ps;
+		if (kernel.func)
+		{
+			const UINT sampleCountHalfPri = dot(sampleCountHalf, Int2(compMaskPri));
+			auto weightTexture = getConvolutionWeightTexture(kernel, sampleCountHalfPri, dot(p.kernelCoordStep, compMaskPri));
+			if (weightTexture && m_psConvolutionTable.shader)
+			{
+				setTempTextureStage(3, *weightTexture, 0, weightTexture->getRect(0), D3DTEXF_POINT);
+				p.extra[0] = { 1.0f / sampleCountHalfPri, 1.0f / (WEIGHT_TABLE_PHASE_COUNT + 1), WEIGHT_TABLE_PHASE_COUNT, 0 };
+				shader = &m_psConvolutionTable;
+			}
+		}
+
 		struct BoolParams
 		{
 			BOOL useSrgbRead;
@@ -368,7 +471,7 @@ namespace D3dDdi
 
 		const D3DDDIARG_SETPIXELSHADERCONST psConst = {
 			200, sizeof(m_convolutionParams) / sizeof(DeviceState::ShaderConstF) };
-		m_device.getOrigVtable().pfnSetPixelShaderConst(m_device, &psConst, reinterpret_cast<float*>(&m_convolutionParams));
+		m_device.getState().setTempPixelShaderConst(psConst, reinterpret_cast<float*>(&m_convolutionParams));
 
 		UINT filter = (p.support > 0 && p.support <= 1 && !boolParams.useSrgbRead) ? D3DTEXF_LINEAR : D3DTEXF_POINT;
 		if (!boolParams.useSrgbRead && 0 != support.x)
@@ -380,16 +483,17 @@ namespace D3dDdi
 			filter |= D3DTEXF_SRGBWRITE;
 		}
 
-		blt(dstResource, dstSubResourceIndex, dstRect, srcResource, srcSubResourceIndex, srcRect, ps, filter);
+		blt(dstResource, dstSubResourceIndex, dstRect, srcResource, srcSubResourceIndex, srcRect, *shader, filter);
 	}
 
 	void ShaderBlitter::convolutionBlt(const Resource& dstResource, UINT dstSubResourceIndex, const RECT& dstRect,
 		const Resource& srcResource, UINT srcSubResourceIndex, const RECT& srcRect,
-		Float2 support, const DeviceState::TempShader& ps, const std::function<void(bool)> setExtraParams)
+		Float2 support, const DeviceState::TempShader& ps, const std::function<void(bool)> setExtraParams,
+		const ConvolutionKernel& kernel)
 	{
 		LOG_FUNC("ShaderBlitter::convolutionBlt", static_cast<HANDLE>(dstResource), dstSubResourceIndex, dstRect,
 			static_cast<HANDLE>(srcResource), srcSubResourceIndex, srcRect, support, ps.shader.get(),
-			static_cast<bool>(setExtraParams));
+			static_cast<bool>(setExtraParams), kernel.type);
 
 		const Int2 dstSize(dstRect.right - dstRect.left, dstRect.bottom - dstRect.top);
 		const Int2 srcSize(srcRect.right - srcRect.left, srcRect.bottom - srcRect.top);
@@ -407,11 +511,7 @@ namespace D3dDdi
 		}
 
 		const auto& dstFi = getFormatInfo(m_device.getAdapter().getRenderColorDepthDstFormat());
-		const auto& srcFi = getFormatInfo(srcResource.getFixedDesc().Format);
-		BYTE maxBpcDiff = 0;
-		maxBpcDiff = std::max<BYTE>(maxBpcDiff, srcFi.red.bitCount - dstFi.red.bitCount);
-		maxBpcDiff = std::max<BYTE>(maxBpcDiff, srcFi.green.bitCount - dstFi.green.bitCount);
-		maxBpcDiff = std::max<BYTE>(maxBpcDiff, srcFi.blue.bitCount - dstFi.blue.bitCount);
+		const BYTE maxBpcDiff = getMaxBpcDiff(dstFi, getFormatInfo(srcResource.getFixedDesc().Format));
 
 		Resource* ditherTexture = nullptr;
 		DWORD ditherSize = std::min(1 << maxBpcDiff, 16);
@@ -446,13 +546,13 @@ namespace D3dDdi
 			sampleCountHalf.y <= 1 && (srcResource.getFormatOp().Operations & FORMATOP_SRGBREAD))
 		{
 			return convolution(dstResource, dstSubResourceIndex, dstRect, srcResource, srcSubResourceIndex, srcRect,
-				support, ps, setExtraParams, flags | CF_HORIZONTAL);
+				support, ps, setExtraParams, kernel, flags | CF_HORIZONTAL);
 		}
 		if (srcSize.x == dstSize.x ||
 			sampleCountHalf.x <= 1 && (srcResource.getFormatOp().Operations & FORMATOP_SRGBREAD))
 		{
 			return convolution(dstResource, dstSubResourceIndex, dstRect, srcResource, srcSubResourceIndex, srcRect,
-				support, ps, setExtraParams, flags);
+				support, ps, setExtraParams, kernel, flags);
 		}
 
 		const bool isHorizontalFirst = dstSize.x * srcSize.y <= srcSize.x * dstSize.y;
@@ -474,9 +574,9 @@ namespace D3dDdi
 		}
 
 		convolution(*rt, 0, rect, srcResource, srcSubResourceIndex, srcRect,
-			support, ps, setExtraParams, isHorizontalFirst ? CF_HORIZONTAL : 0);
+			support, ps, setExtraParams, kernel, isHorizontalFirst ? CF_HORIZONTAL : 0);
 		convolution(dstResource, dstSubResourceIndex, dstRect, *rt, 0, rect,
-			support, ps, setExtraParams, flags | (isHorizontalFirst ? 0 : CF_HORIZONTAL));
+			support, ps, setExtraParams, kernel, flags | (isHorizontalFirst ? 0 : CF_HORIZONTAL));
 	}
 
 	DeviceState::TempShader ShaderBlitter::createPixelShader(const BYTE* code, UINT size)
@@ -656,8 +756,8 @@ namespace D3dDdi
 		state.setTempRenderState({ D3DDDIRS_CLIPPLANEENABLE, 0 });
 		state.setTempRenderState({ D3DDDIRS_MULTISAMPLEANTIALIAS, FALSE });
 		state.setTempRenderState({ D3DDDIRS_COLORWRITEENABLE, 0 });
-		state.setTempRenderState({ D3DDDIRS_SCISSORTESTENABLE, FALSE });
 		state.setTempRenderState({ D3DDDIRS_SRGBWRITEENABLE, FALSE });
+		setTempClipRect(dstResource);
 
 		setTempTextureStage(0, srcResource, 0, srcRect, D3DTEXF_POINT);
 
@@ -675,8 +775,20 @@ namespace D3dDdi
 	}
 
 	void ShaderBlitter::displayBlt(Resource& dstResource, UINT dstSubResourceIndex, const RECT& dstRect,
-		const Resource& srcResource, UINT srcSubResourceIndex, const RECT& srcRect)
+		const Resource& srcResource, UINT srcSubResourceIndex, const RECT& srcRect, bool isSrcUnchanged,
+		const RECT& clipRect)
 	{
+		if (IsRectEmpty(&clipRect))
+		{
+			return;
+		}
+
+		if (!EqualRect(&clipRect, &dstRect))
+		{
+			m_clipResource = &dstResource;
+			m_clipRect = clipRect;
+		}
+
 		auto filter = Config::displayFilter.get();
 		if (Config::Settings::DisplayFilter::CGP != filter && Rect::isEqualSize(dstRect, srcRect))
 		{
@@ -711,18 +823,17 @@ namespace D3dDdi
 			break;
 
 		case Config::Settings::DisplayFilter::CGP:
-			m_metaShader.render(dstResource, dstSubResourceIndex, dstRect, srcResource, srcSubResourceIndex, srcRect);
+			m_metaShader.render(dstResource, dstSubResourceIndex, dstRect,
+				srcResource, srcSubResourceIndex, srcRect, isSrcUnchanged);
 			break;
 		}
+
+		m_clipResource = nullptr;
 	}
 
 	void ShaderBlitter::drawRect(const RectF& rect)
 	{
-		m_vertices[0].xy = { rect.left - 0.5f, rect.top - 0.5f };
-		m_vertices[1].xy = { rect.right - 0.5f, rect.top - 0.5f };
-		m_vertices[2].xy = { rect.left - 0.5f, rect.bottom - 0.5f };
-		m_vertices[3].xy = { rect.right - 0.5f, rect.bottom - 0.5f };
-
+		setVertexCoords(rect);
 		m_device.getState().setTempStreamSourceUm({ 0, sizeof(Vertex) }, m_vertices.data());
 
 		D3DDDIARG_DRAWPRIMITIVE dp = {};
@@ -732,14 +843,145 @@ namespace D3dDdi
 		m_device.getOrigVtable().pfnDrawPrimitive(m_device, &dp, nullptr);
 	}
 
+	void ShaderBlitter::drawRegion(const std::vector<RECT>& srcRects, const RECT& srcRect, const RECT& dstRect,
+		UINT srcWidth, UINT srcHeight)
+	{
+		if (srcRects.empty())
+		{
+			addDrawsPerBlit(0);
+			return;
+		}
+
+		m_regionVertices.clear();
+		m_regionVertices.reserve(srcRects.size() * 6);
+		for (const auto& sr : srcRects)
+		{
+			RectF dr = Rect::toRectF(sr);
+			Rect::transform(dr, srcRect, dstRect);
+			setTextureCoords(0, sr, srcWidth, srcHeight);
+			setVertexCoords(dr);
+
+			m_regionVertices.push_back(m_vertices[0]);
+			m_regionVertices.push_back(m_vertices[1]);
+			m_regionVertices.push_back(m_vertices[2]);
+			m_regionVertices.push_back(m_vertices[2]);
+			m_regionVertices.push_back(m_vertices[1]);
+			m_regionVertices.push_back(m_vertices[3]);
+		}
+
+		m_device.getState().setTempStreamSourceUm({ 0, sizeof(Vertex) }, m_regionVertices.data());
+
+		D3DDDIARG_DRAWPRIMITIVE dp = {};
+		dp.PrimitiveType = D3DPT_TRIANGLELIST;
+		dp.VStart = 0;
+		dp.PrimitiveCount = static_cast<UINT>(srcRects.size() * 2);
+		m_device.getOrigVtable().pfnDrawPrimitive(m_device, &dp, nullptr);
+		addDrawsPerBlit(1);
+	}
+
+	Resource* ShaderBlitter::getConvolutionWeightTexture(
+		const ConvolutionKernel& kernel, UINT sampleCountHalf, float kernelCoordStep)
+	{
+		const struct
+		{
+			UINT type;
+			UINT param;
+			UINT sampleCountHalf;
+			float kernelCoordStep;
+		} key = { kernel.type, kernel.param, sampleCountHalf, kernelCoordStep };
+
+		return m_device.getRepo().getConvolutionWeightTexture(Hash::hash64(&key, sizeof(key)),
+			sampleCountHalf, WEIGHT_TABLE_PHASE_COUNT + 1,
+			[&](const DDSURFACEDESC2& desc) { initWeightTable(desc, kernel.func, sampleCountHalf, kernelCoordStep); });
+	}
+
+	LONG ShaderBlitter::getDisplayFilterSupport(const RECT& dstRect, const RECT& srcRect)
+	{
+		float support = 0;
+		switch (Config::displayFilter.get())
+		{
+		case Config::Settings::DisplayFilter::POINT:
+		case Config::Settings::DisplayFilter::INTEGER:
+			support = 0.5f;
+			break;
+
+		case Config::Settings::DisplayFilter::BILINEAR:
+			support = 1;
+			break;
+
+		case Config::Settings::DisplayFilter::BICUBIC:
+			support = 2;
+			break;
+
+		case Config::Settings::DisplayFilter::LANCZOS:
+		case Config::Settings::DisplayFilter::SPLINE:
+			support = static_cast<float>(Config::displayFilter.getParam());
+			break;
+		}
+
+		const auto dstSize = Rect::getSize(dstRect);
+		const auto srcSize = Rect::getSize(srcRect);
+		const float scale = std::min(static_cast<float>(dstSize.cx) / srcSize.cx,
+			static_cast<float>(dstSize.cy) / srcSize.cy);
+		return static_cast<LONG>(std::ceil(support / std::min(scale, 1.0f))) + 1;
+	}
+
+	bool ShaderBlitter::integerScaleBlt(const Resource& dstResource, UINT dstSubResourceIndex, const RECT& dstRect,
+		const Resource& srcResource, UINT srcSubResourceIndex, const RECT& srcRect, const RECT& clipRect)
+	{
+		LOG_FUNC("ShaderBlitter::integerScaleBlt", static_cast<HANDLE>(dstResource), dstSubResourceIndex, dstRect,
+			static_cast<HANDLE>(srcResource), srcSubResourceIndex, srcRect);
+
+		const auto filter = Config::displayFilter.get();
+		if (Config::Settings::DisplayFilter::INTEGER != filter && Config::Settings::DisplayFilter::POINT != filter)
+		{
+			return LOG_RESULT(false);
+		}
+
+		const auto dstSize = Rect::getSize(dstRect);
+		const auto srcSize = Rect::getSize(srcRect);
+		if (dstSize.cx < srcSize.cx || dstSize.cy < srcSize.cy ||
+			0 != dstSize.cx % srcSize.cx || 0 != dstSize.cy % srcSize.cy)
+		{
+			return LOG_RESULT(false);
+		}
+
+		if (!g_isGammaRampDefault ||
+			0 != getMaxBpcDiff(getFormatInfo(m_device.getAdapter().getRenderColorDepthDstFormat()),
+				getFormatInfo(srcResource.getFixedDesc().Format)))
+		{
+			return LOG_RESULT(false);
+		}
+
+		if (!IsRectEmpty(&clipRect))
+		{
+			if (!EqualRect(&clipRect, &dstRect))
+			{
+				m_clipResource = &dstResource;
+				m_clipRect = clipRect;
+			}
+			blt(dstResource, dstSubResourceIndex, dstRect, srcResource, srcSubResourceIndex, srcRect,
+				m_psTextureSampler, D3DTEXF_POINT);
+			m_clipResource = nullptr;
+		}
+		return LOG_RESULT(true);
+	}
+
+	bool ShaderBlitter::isGammaRampDefault()
+	{
+		return g_isGammaRampDefault;
+	}
+
 	void ShaderBlitter::lanczosBlt(const Resource& dstResource, UINT dstSubResourceIndex, const RECT& dstRect,
 		const Resource& srcResource, UINT srcSubResourceIndex, const RECT& srcRect, UINT lobes)
 	{
 		LOG_FUNC("ShaderBlitter::lanczosBlt", static_cast<HANDLE>(dstResource), dstSubResourceIndex, dstRect,
 			static_cast<HANDLE>(srcResource), srcSubResourceIndex, srcRect, lobes);
 
+		const float support = static_cast<float>(lobes);
 		convolutionBlt(dstResource, dstSubResourceIndex, dstRect, srcResource, srcSubResourceIndex, srcRect,
-			lobes, m_psLanczos);
+			support, m_psLanczos, {},
+			{ KERNEL_LANCZOS, lobes, [=](float x) { return getLanczosWeight(x, support); } });
 	}
 
 	void ShaderBlitter::lockRefBlt(const Resource& dstResource, UINT dstSubResourceIndex, const RECT& dstRect,
@@ -825,6 +1067,17 @@ namespace D3dDdi
 		g_isGammaRampInvalidated = !g_isGammaRampDefault;
 	}
 
+	void ShaderBlitter::setTempClipRect(const Resource& dstResource)
+	{
+		auto& state = m_device.getState();
+		const bool isClipped = &dstResource == m_clipResource;
+		state.setTempRenderState({ D3DDDIRS_SCISSORTESTENABLE, isClipped });
+		if (isClipped)
+		{
+			state.setTempScissorRect(m_clipRect);
+		}
+	}
+
 	void ShaderBlitter::setTempTextureStage(UINT stage, const Resource& texture, UINT subResourceIndex,
 		const RECT& rect, UINT filter, UINT textureAddress)
 	{
@@ -853,35 +1106,46 @@ namespace D3dDdi
 		m_vertices[3].tc[stage] = { rect.right / w, rect.bottom / h };
 	}
 
+	void ShaderBlitter::setVertexCoords(const RectF& rect)
+	{
+		m_vertices[0].xy = { rect.left - 0.5f, rect.top - 0.5f };
+		m_vertices[1].xy = { rect.right - 0.5f, rect.top - 0.5f };
+		m_vertices[2].xy = { rect.left - 0.5f, rect.bottom - 0.5f };
+		m_vertices[3].xy = { rect.right - 0.5f, rect.bottom - 0.5f };
+	}
+
 	void ShaderBlitter::splineBlt(const Resource& dstResource, UINT dstSubResourceIndex, const RECT& dstRect,
 		const Resource& srcResource, UINT srcSubResourceIndex, const RECT& srcRect, UINT lobes)
 	{
 		LOG_FUNC("ShaderBlitter::splineBlt", static_cast<HANDLE>(dstResource), dstSubResourceIndex, dstRect,
 			static_cast<HANDLE>(srcResource), srcSubResourceIndex, srcRect, lobes);
 
+		std::array<DeviceState::ShaderConstF, 4> coefficients = {};
 		switch (lobes)
 		{
 		case 2:
-			m_convolutionParams.extra[0] = getSplineWeights(0, 1.0f, -9.0f / 5.0f, -1.0f / 5.0f, 1.0f);
-			m_convolutionParams.extra[1] = getSplineWeights(1, -1.0f / 3.0f, 4.0f / 5.0f, -7.0f / 15.0f, 0.0f);
+			coefficients[0] = getSplineWeights(0, 1.0f, -9.0f / 5.0f, -1.0f / 5.0f, 1.0f);
+			coefficients[1] = getSplineWeights(1, -1.0f / 3.0f, 4.0f / 5.0f, -7.0f / 15.0f, 0.0f);
 			break;
 
 		case 3:
-			m_convolutionParams.extra[0] = getSplineWeights(0, 13.0f / 11.0f, -453.0f / 209.0f, -3.0f / 209.0f, 1.0f);
-			m_convolutionParams.extra[1] = getSplineWeights(1, -6.0f / 11.0f, 270.0f / 209.0f, -156.0f / 209.0f, 0.0f);
-			m_convolutionParams.extra[2] = getSplineWeights(2, 1.0f / 11.0f, -45.0f / 209.0f, 26.0f / 209.0f, 0.0f);
+			coefficients[0] = getSplineWeights(0, 13.0f / 11.0f, -453.0f / 209.0f, -3.0f / 209.0f, 1.0f);
+			coefficients[1] = getSplineWeights(1, -6.0f / 11.0f, 270.0f / 209.0f, -156.0f / 209.0f, 0.0f);
+			coefficients[2] = getSplineWeights(2, 1.0f / 11.0f, -45.0f / 209.0f, 26.0f / 209.0f, 0.0f);
 			break;
 
 		case 4:
-			m_convolutionParams.extra[0] = getSplineWeights(0, 49.0f / 41.0f, -6387.0f / 2911.0f, -3.0f / 2911.0f, 1.0f);
-			m_convolutionParams.extra[1] = getSplineWeights(1, -24.0f / 41.0f, 4032.0f / 2911.0f, -2328.0f / 2911.0f, 0.0f);
-			m_convolutionParams.extra[2] = getSplineWeights(2, 6.0f / 41.0f, -1008.0f / 2911.0f, 582.0f / 2911.0f, 0.0f);
-			m_convolutionParams.extra[3] = getSplineWeights(3, -1.0f / 41.0f, 168.0f / 2911.0f, -97.0f / 2911.0f, 0.0f);
+			coefficients[0] = getSplineWeights(0, 49.0f / 41.0f, -6387.0f / 2911.0f, -3.0f / 2911.0f, 1.0f);
+			coefficients[1] = getSplineWeights(1, -24.0f / 41.0f, 4032.0f / 2911.0f, -2328.0f / 2911.0f, 0.0f);
+			coefficients[2] = getSplineWeights(2, 6.0f / 41.0f, -1008.0f / 2911.0f, 582.0f / 2911.0f, 0.0f);
+			coefficients[3] = getSplineWeights(3, -1.0f / 41.0f, 168.0f / 2911.0f, -97.0f / 2911.0f, 0.0f);
 			break;
 		}
 
 		convolutionBlt(dstResource, dstSubResourceIndex, dstRect, srcResource, srcSubResourceIndex, srcRect,
-			lobes, m_psCubicConvolution[lobes - 2]);
+			lobes, m_psCubicConvolution[lobes - 2],
+			[&](bool /*isHorizontal*/) { m_convolutionParams.extra = coefficients; },
+			{ KERNEL_SPLINE, lobes, [=](float x) { return getCubicWeight(x, coefficients, lobes); } });
 	}
 
 	void ShaderBlitter::textureBlt(const Resource& dstResource, UINT dstSubResourceIndex, const RECT& dstRect,
@@ -892,7 +1156,7 @@ namespace D3dDdi
 		{
 			const auto ck = convertToShaderConst(srcColorKey);
 			const D3DDDIARG_SETPIXELSHADERCONST psConst = { 200, 2 };
-			m_device.getOrigVtable().pfnSetPixelShaderConst(m_device, &psConst, &ck[0][0]);
+			m_device.getState().setTempPixelShaderConst(psConst, &ck[0][0]);
 			blt(dstResource, dstSubResourceIndex, dstRect, srcResource, srcSubResourceIndex, srcRect,
 				m_psColorKey, filter, 0, alpha, srcRgn);
 		}
@@ -1,7 +1,9 @@
 #pragma once
 
 #include <array>
+#include <functional>
 #include <memory>
+#include <vector>
 
 #include <Windows.h>
 
@@ -54,7 +56,10 @@ namespace D3dDdi
 		void depthWrite(const Resource& dstResource, UINT dstSubResourceIndex, const RECT& dstRect,
 			const Resource& srcResource, UINT srcSubResourceIndex, const RECT& srcRect);
 		void displayBlt(Resource& dstResource, UINT dstSubResourceIndex, const RECT& dstRect,
-			const Resource& srcResource, UINT srcSubResourceIndex, const RECT& srcRect);
+			const Resource& srcResource, UINT srcSubResourceIndex, const RECT& srcRect, bool isSrcUnchanged,
+			const RECT& clipRect);
+		bool integerScaleBlt(const Resource& dstResource, UINT dstSubResourceIndex, const RECT& dstRect,
+			const Resource& srcResource, UINT srcSubResourceIndex, const RECT& srcRect, const RECT& clipRect);
 		void lanczosBlt(const Resource& dstResource, UINT dstSubResourceIndex, const RECT& dstRect,
 			const Resource& srcResource, UINT srcSubResourceIndex, const RECT& srcRect, UINT lobes);
 		void lockRefBlt(const Resource& dstResource, UINT dstSubResourceIndex, const RECT& dstRect,
@@ -73,10 +78,19 @@ namespace D3dDdi
 
 		MetaShader& getMetaShader() { return m_metaShader; }
 
+		static LONG getDisplayFilterSupport(const RECT& dstRect, const RECT& srcRect);
+		static bool isGammaRampDefault();
 		static void resetGammaRamp();
 		static void setGammaRamp(const D3DDDI_GAMMA_RAMP_RGB256x3x16& ramp);
 
 	private:
+		struct ConvolutionKernel
+		{
+			UINT type;
+			UINT param;
+			std::function<float(float)> func;
+		};
+
 		struct ConvolutionParams
 		{
 			Float2 textureSize;
@@ -111,10 +125,12 @@ namespace D3dDdi
 			UINT filter, UINT flags = 0, const BYTE* alpha = nullptr, const Gdi::Region& srcRgn = nullptr);
 		void convolution(const Resource& dstResource, UINT dstSubResourceIndex, const RECT& dstRect,
 			const Resource& srcResource, UINT srcSubResourceIndex, const RECT& srcRect,
-			Float2 support, const DeviceState::TempShader& ps, const std::function<void(bool)> setExtraParams, DWORD flags);
+			Float2 support, const DeviceState::TempShader& ps, const std::function<void(bool)> setExtraParams,
+			const ConvolutionKernel& kernel, DWORD flags);
 		void convolutionBlt(const Resource& dstResource, UINT dstSubResourceIndex, const RECT& dstRect,
 			const Resource& srcResource, UINT srcSubResourceIndex, const RECT& srcRect,
-			Float2 support, const DeviceState::TempShader& ps, const std::function<void(bool)> setExtraParams = {});
+			Float2 support, const DeviceState::TempShader& ps, const std::function<void(bool)> setExtraParams = {},
+			const ConvolutionKernel& kernel = {});
 		void depthWrite(const Resource& dstResource, UINT dstSubResourceIndex, const RECT& dstRect,
 			const Resource& srcResource, UINT srcSubResourceIndex, const RECT& srcRect, const DeviceState::TempShader& ps);
 
@@ -127,9 +143,14 @@ namespace D3dDdi
 		DeviceState::TempShader createPixelShader(const BYTE* code, UINT size);
 		std::unique_ptr<void, ResourceDeleter> createVertexShaderDecl();
 		void drawRect(const RectF& rect);
+		void drawRegion(const std::vector<RECT>& srcRects, const RECT& srcRect, const RECT& dstRect,
+			UINT srcWidth, UINT srcHeight);
+		Resource* getConvolutionWeightTexture(const ConvolutionKernel& kernel, UINT sampleCountHalf, float kernelCoordStep);
+		void setTempClipRect(const Resource& dstResource);
 		void setTempTextureStage(UINT stage, const Resource& texture, UINT subResourceIndex,
 			const RECT& rect, UINT filter, UINT textureAddress = D3DTADDRESS_CLAMP);
 		void setTextureCoords(UINT stage, const RECT& rect, UINT width, UINT height);
+		void setVertexCoords(const RectF& rect);
 
 		Device& m_device;
 		MetaShader m_metaShader;
@@ -137,6 +158,7 @@ namespace D3dDdi
 		DeviceState::TempShader m_psBilinear;
 		DeviceState::TempShader m_psColorKey;
 		DeviceState::TempShader m_psColorKeyBlend;
+		DeviceState::TempShader m_psConvolutionTable;
 		DeviceState::TempShader m_psCubicConvolution[3];
 		DeviceState::TempShader m_psDepthCopy;
 		DeviceState::TempShader m_psDepthCopyPcf16;
@@ -160,6 +182,9 @@ namespace D3dDdi
 		std::unique_ptr<void, ResourceDeleter> m_vertexShaderDecl;
 		ConvolutionParams m_convolutionParams;
 		std::array<Vertex, 4> m_vertices;
+		std::vector<Vertex> m_regionVertices;
+		const Resource* m_clipResource;
+		RECT m_clipRect;
 	};
 
 	std::ostream& operator<<(std::ostream& os, ShaderBlitter::ColorKeyInfo ck);
@@ -0,0 +1,652 @@
+#include <algorithm>
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <map>
+#include <sstream>
+#include <string>
+
+#include <Common/Hash.h>
+#include <Common/Log.h>
+#include <Common/Path.h>
+#include <Common/ScopedSrwLock.h>
+#include <D3dDdi/ShaderCachePack.h>
+
+namespace
+{
+	const UINT CACHE_MAGIC = 0x50534344;
+	const UINT CACHE_VERSION = 5;
+	const UINT MAX_DATA_SIZE = 64 * 1024 * 1024;
+	const UINT COMPACTED_DATA_SIZE = MAX_DATA_SIZE / 2;
+
+	struct FileHeader
+	{
+		UINT magic;
+		UINT version;
+		D3dDdi::ShaderCachePack::Key compilerHash;
+		UINT compilerFlags;
+	};
+
+	struct RecordHeader
+	{
+		D3dDdi::ShaderCachePack::Key key;
+		UINT vsSize;
+		UINT psSize;
+		UINT64 checksum;
+	};
+
+	struct IndexEntry
+	{
+		D3dDdi::ShaderCachePack::Key key;
+		UINT offset;
+	};
+
+	class ScopedFileLock
+	{
+	public:
+		ScopedFileLock(HANDLE file)
+			: m_file(file)
+			, m_overlapped{}
+			, m_isLocked(INVALID_HANDLE_VALUE != file && LockFileEx(file, LOCKFILE_EXCLUSIVE_LOCK, 0, 1, 0, &m_overlapped))
+		{
+		}
+
+		~ScopedFileLock()
+		{
+			if (m_isLocked)
+			{
+				UnlockFileEx(m_file, 0, 1, 0, &m_overlapped);
+			}
+		}
+
+		bool isLocked() const { return m_isLocked; }
+
+	private:
+		HANDLE m_file;
+		OVERLAPPED m_overlapped;
+		bool m_isLocked;
+	};
+
+	Compat::SrwLock g_srwLock;
+	bool g_isInitialized = false;
+	FileHeader g_fileHeader = {};
+	std::wstring g_packName;
+	HANDLE g_lockFile = INVALID_HANDLE_VALUE;
+	UINT g_generation = 0;
+	HANDLE g_dataFile = INVALID_HANDLE_VALUE;
+	HANDLE g_dataMapping = nullptr;
+	const BYTE* g_dataView = nullptr;
+	UINT g_dataViewSize = 0;
+	std::vector<IndexEntry> g_index;
+	std::map<D3dDdi::ShaderCachePack::Key, std::vector<BYTE>> g_newRecords;
+
+	std::filesystem::path getCacheDir()
+	{
+		return Compat::getEnvPath("LOCALAPPDATA") / "DDrawCompat" / "ShaderCache";
+	}
+
+	std::filesystem::path getDataPath(UINT generation)
+	{
+		return getCacheDir() / (g_packName + L'.' + std::to_wstring(generation) + L".dat");
+	}
+
+	std::filesystem::path getIndexPath()
+	{
+		return getCacheDir() / (g_packName + L".idx");
+	}
+
+	std::filesystem::path getLockPath()
+	{
+		return getCacheDir() / (g_packName + L".lck");
+	}
+
+	std::wstring getPackName(const D3dDdi::ShaderCachePack::Key& compilerHash, UINT compilerFlags)
+	{
+		std::wostringstream oss;
+		oss << L"Shaders-" << std::hex << std::setfill(L'0');
+		for (auto b : compilerHash)
+		{
+			oss << std::setw(2) << static_cast<UINT>(b);
+		}
+		oss << L'-' << std::setw(8) << compilerFlags;
+		return oss.str();
+	}
+
+	std::filesystem::path getTempPath(const std::filesystem::path& path)
+	{
+		auto tmpPath(path);
+		tmpPath += '.' + std::to_string(GetCurrentProcessId()) + ".tmp";
+		return tmpPath;
+	}
+
+	UINT64 getRecordChecksum(const RecordHeader& record)
+	{
+		Hash::Hasher hasher;
+		hasher.update(&record, offsetof(RecordHeader, checksum));
+		hasher.update(&record + 1, record.vsSize + record.psSize);
+		return hasher.digest64();
+	}
+
+	UINT getRecordSize(const RecordHeader& record)
+	{
+		return sizeof(RecordHeader) + record.vsSize + record.psSize;
+	}
+
+	const RecordHeader* getRecord(const BYTE* data, UINT dataSize, UINT offset)
+	{
+		if (offset < sizeof(FileHeader) || offset > dataSize || dataSize - offset < sizeof(RecordHeader))
+		{
+			return nullptr;
+		}
+
+		auto record = reinterpret_cast<const RecordHeader*>(data + offset);
+		const UINT64 recordSize = sizeof(RecordHeader) + static_cast<UINT64>(record->vsSize) + record->psSize;
+		return recordSize <= dataSize - offset ? record : nullptr;
+	}
+
+	const IndexEntry* findIndexEntry(const D3dDdi::ShaderCachePack::Key& key)
+	{
+		auto it = std::lower_bound(g_index.begin(), g_index.end(), key,
+			[](const IndexEntry& entry, const D3dDdi::ShaderCachePack::Key& key) { return entry.key < key; });
+		return it != g_index.end() && it->key == key ? &*it : nullptr;
+	}
+
+	UINT readGeneration()
+	{
+		UINT generation = 0;
+		DWORD bytesRead = 0;
+		if (!SetFilePointerEx(g_lockFile, {}, nullptr, FILE_BEGIN) ||
+			!ReadFile(g_lockFile, &generation, sizeof(generation), &bytesRead, nullptr) ||
+			sizeof(generation) != bytesRead)
+		{
+			return 0;
+		}
+		return generation;
+	}
+
+	bool isDataFileReplaced()
+	{
+		return readGeneration() != g_generation;
+	}
+
+	bool isValidHeader(const BYTE* data, UINT dataSize)
+	{
+		return data && dataSize >= sizeof(FileHeader) && 0 == memcmp(data, &g_fileHeader, sizeof(FileHeader));
+	}
+
+	bool isValidRecord(const RecordHeader* record)
+	{
+		return record && getRecordChecksum(*record) == record->checksum;
+	}
+
+	bool hasValidRecord(const D3dDdi::ShaderCachePack::Key& key)
+	{
+		auto entry = findIndexEntry(key);
+		return entry && isValidRecord(getRecord(g_dataView, g_dataViewSize, entry->offset));
+	}
+
+	bool replaceFile(const std::filesystem::path& tmpPath, const std::filesystem::path& path)
+	{
+		if (MoveFileExW(tmpPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING))
+		{
+			return true;
+		}
+		LOG_DEBUG << "MoveFileEx failed: " << Compat::hex(GetLastError());
+		DeleteFileW(tmpPath.c_str());
+		return false;
+	}
+
+	void closeDataFile()
+	{
+		if (g_dataView)
+		{
+			UnmapViewOfFile(g_dataView);
+			g_dataView = nullptr;
+			g_dataViewSize = 0;
+		}
+		if (g_dataMapping)
+		{
+			CloseHandle(g_dataMapping);
+			g_dataMapping = nullptr;
+		}
+		if (INVALID_HANDLE_VALUE != g_dataFile)
+		{
+			CloseHandle(g_dataFile);
+			g_dataFile = INVALID_HANDLE_VALUE;
+		}
+	}
+
+	void openDataFile()
+	{
+		g_dataFile = CreateFileW(getDataPath(g_generation).c_str(), GENERIC_READ | FILE_APPEND_DATA,
+			FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (INVALID_HANDLE_VALUE == g_dataFile)
+		{
+			LOG_DEBUG << "Failed to open data file: " << Compat::hex(GetLastError());
+			return;
+		}
+
+		LARGE_INTEGER size = {};
+		if (!GetFileSizeEx(g_dataFile, &size) || size.QuadPart < sizeof(FileHeader) || size.QuadPart > MAXDWORD)
+		{
+			return;
+		}
+
+		g_dataMapping = CreateFileMappingW(g_dataFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (!g_dataMapping)
+		{
+			LOG_DEBUG << "CreateFileMapping failed: " << Compat::hex(GetLastError());
+			return;
+		}
+
+		g_dataView = static_cast<const BYTE*>(MapViewOfFile(g_dataMapping, FILE_MAP_READ, 0, 0, 0));
+		if (!g_dataView)
+		{
+			LOG_DEBUG << "MapViewOfFile failed: " << Compat::hex(GetLastError());
+			return;
+		}
+		g_dataViewSize = size.LowPart;
+	}
+
+	void rebuildIndex()
+	{
+		std::map<D3dDdi::ShaderCachePack::Key, UINT> offsets;
+		UINT offset = sizeof(FileHeader);
+		const RecordHeader* record = nullptr;
+		while (nullptr != (record = getRecord(g_dataView, g_dataViewSize, offset)))
+		{
+			if (isValidRecord(record))
+			{
+				offsets[record->key] = offset;
+			}
+			offset += getRecordSize(*record);
+		}
+
+		g_index.clear();
+		for (const auto& entry : offsets)
+		{
+			g_index.push_back({ entry.first, entry.second });
+		}
+	}
+
+	void saveIndex()
+	{
+		const auto indexPath(getIndexPath());
+		const auto tmpPath(getTempPath(indexPath));
+		std::ofstream f(tmpPath, std::ios::binary);
+		f.write(reinterpret_cast<const char*>(&g_fileHeader), sizeof(g_fileHeader));
+		f.write(reinterpret_cast<const char*>(g_index.data()), g_index.size() * sizeof(IndexEntry));
+		const bool isWritten = !f.fail();
+		f.close();
+
+		if (!isWritten)
+		{
+			LOG_DEBUG << "Failed to write index file";
+			DeleteFileW(tmpPath.c_str());
+			return;
+		}
+		replaceFile(tmpPath, indexPath);
+	}
+
+	std::vector<IndexEntry> readIndexFile()
+	{
+		std::vector<IndexEntry> index;
+		HANDLE file = CreateFileW(getIndexPath().c_str(), GENERIC_READ,
+			FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (INVALID_HANDLE_VALUE != file)
+		{
+			LARGE_INTEGER size = {};
+			HANDLE mapping = GetFileSizeEx(file, &size) && size.QuadPart >= sizeof(FileHeader) && size.QuadPart <= MAXDWORD
+				? CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+			if (mapping)
+			{
+				auto view = static_cast<const BYTE*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+				if (isValidHeader(view, size.LowPart))
+				{
+					auto begin = reinterpret_cast<const IndexEntry*>(view + sizeof(FileHeader));
+					index.assign(begin, begin + (size.LowPart - sizeof(FileHeader)) / sizeof(IndexEntry));
+				}
+				if (view)
+				{
+					UnmapViewOfFile(view);
+				}
+				CloseHandle(mapping);
+			}
+			CloseHandle(file);
+		}
+		return index;
+	}
+
+	void loadIndex()
+	{
+		g_index = readIndexFile();
+		auto it = std::remove_if(g_index.begin(), g_index.end(), [](const IndexEntry& entry)
+			{
+				auto record = getRecord(g_dataView, g_dataViewSize, entry.offset);
+				return !record || record->key != entry.key;
+			});
+		const bool isStale = it != g_index.end() || (g_index.empty() && g_dataViewSize > sizeof(FileHeader)) ||
+			!std::is_sorted(g_index.begin(), g_index.end(),
+				[](const IndexEntry& lhs, const IndexEntry& rhs) { return lhs.key < rhs.key; });
+		if (isStale)
+		{
+			LOG_DEBUG << "Rebuilding stale index file";
+			rebuildIndex();
+			saveIndex();
+		}
+	}
+
+	void mergeIndex()
+	{
+		LARGE_INTEGER size = {};
+		if (!GetFileSizeEx(g_dataFile, &size))
+		{
+			return;
+		}
+
+		std::map<D3dDdi::ShaderCachePack::Key, UINT> offsets;
+		for (const auto& entry : readIndexFile())
+		{
+			if (entry.offset >= g_dataViewSize)
+			{
+				if (entry.offset < size.QuadPart)
+				{
+					offsets[entry.key] = entry.offset;
+				}
+			}
+			else
+			{
+				auto record = getRecord(g_dataView, g_dataViewSize, entry.offset);
+				if (record && record->key == entry.key)
+				{
+					offsets[entry.key] = entry.offset;
+				}
+			}
+		}
+
+		for (const auto& entry : g_index)
+		{
+			offsets[entry.key] = entry.offset;
+		}
+
+		g_index.clear();
+		for (const auto& entry : offsets)
+		{
+			g_index.push_back({ entry.first, entry.second });
+		}
+		saveIndex();
+	}
+
+	void reopenDataFile()
+	{
+		LOG_DEBUG << "Reopening shader cache pack replaced by another process";
+		closeDataFile();
+		g_index.clear();
+		g_generation = readGeneration();
+		openDataFile();
+		if (!isValidHeader(g_dataView, g_dataViewSize))
+		{
+			closeDataFile();
+			return;
+		}
+		loadIndex();
+	}
+
+	bool writeGeneration(UINT generation)
+	{
+		DWORD bytesWritten = 0;
+		return SetFilePointerEx(g_lockFile, {}, nullptr, FILE_BEGIN) &&
+			WriteFile(g_lockFile, &generation, sizeof(generation), &bytesWritten, nullptr) &&
+			sizeof(generation) == bytesWritten;
+	}
+
+	bool writeDataFile(const std::vector<UINT>& offsets)
+	{
+		const UINT generation = g_generation + 1;
+		const auto dataPath(getDataPath(generation));
+		std::ofstream f(dataPath, std::ios::binary | std::ios::trunc);
+		f.write(reinterpret_cast<const char*>(&g_fileHeader), sizeof(g_fileHeader));
+		for (auto offset : offsets)
+		{
+			auto record = getRecord(g_dataView, g_dataViewSize, offset);
+			f.write(reinterpret_cast<const char*>(record), getRecordSize(*record));
+		}
+		const bool isWritten = !f.fail();
+		f.close();
+
+		if (!isWritten || !writeGeneration(generation))
+		{
+			LOG_DEBUG << "Failed to write data file: " << Compat::hex(GetLastError());
+			DeleteFileW(dataPath.c_str());
+			return false;
+		}
+
+		const auto prevDataPath(getDataPath(g_generation));
+		closeDataFile();
+		g_generation = generation;
+		openDataFile();
+		if (!DeleteFileW(prevDataPath.c_str()))
+		{
+			LOG_DEBUG << "Previous data file is still in use: " << Compat::hex(GetLastError());
+		}
+		rebuildIndex();
+		saveIndex();
+		return true;
+	}
+
+	void deleteUnusedDataFiles()
+	{
+		const std::wstring prefix(g_packName + L'.');
+		const auto dataFileName(getDataPath(g_generation).filename());
+		std::error_code ec;
+		for (const auto& entry : std::filesystem::directory_iterator(getCacheDir(), ec))
+		{
+			const auto fileName(entry.path().filename());
+			if (L".dat" == entry.path().extension() && 0 == fileName.wstring().rfind(prefix, 0) &&
+				fileName != dataFileName)
+			{
+				DeleteFileW(entry.path().c_str());
+			}
+		}
+	}
+
+	void compact()
+	{
+		LOG_FUNC("ShaderCachePack::compact", g_dataViewSize);
+		std::vector<UINT> offsets;
+		for (const auto& entry : g_index)
+		{
+			if (isValidRecord(getRecord(g_dataView, g_dataViewSize, entry.offset)))
+			{
+				offsets.push_back(entry.offset);
+			}
+		}
+		std::sort(offsets.begin(), offsets.end(), std::greater<UINT>());
+
+		UINT size = sizeof(FileHeader);
+		std::size_t count = 0;
+		while (count < offsets.size())
+		{
+			const UINT recordSize = getRecordSize(*getRecord(g_dataView, g_dataViewSize, offsets[count]));
+			if (size + recordSize > COMPACTED_DATA_SIZE)
+			{
+				break;
+			}
+			size += recordSize;
+			++count;
+		}
+
+		offsets.resize(count);
+		std::reverse(offsets.begin(), offsets.end());
+		if (!writeDataFile(offsets))
+		{
+			LOG_ONCE("Failed to compact shader cache pack, size: " << g_dataViewSize);
+		}
+	}
+}
+
+namespace D3dDdi
+{
+	namespace ShaderCachePack
+	{
+		void init(const Key& compilerHash, UINT compilerFlags)
+		{
+			LOG_FUNC("ShaderCachePack::init", Compat::HexDump(compilerHash.data(), compilerHash.size()), compilerFlags);
+			Compat::ScopedSrwLockExclusive lock(g_srwLock);
+			if (g_isInitialized)
+			{
+				return;
+			}
+			g_isInitialized = true;
+			g_fileHeader = { CACHE_MAGIC, CACHE_VERSION, compilerHash, compilerFlags };
+			g_packName = getPackName(compilerHash, compilerFlags);
+
+			std::error_code ec;
+			std::filesystem::create_directories(getCacheDir(), ec);
+			DeleteFileW((getCacheDir() / "Shaders.dat").c_str());
+			DeleteFileW((getCacheDir() / "Shaders.idx").c_str());
+			DeleteFileW((getCacheDir() / (g_packName + L".dat")).c_str());
+
+			g_lockFile = CreateFileW(getLockPath().c_str(), GENERIC_READ | GENERIC_WRITE,
+				FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+			ScopedFileLock fileLock(g_lockFile);
+			if (!fileLock.isLocked())
+			{
+				LOG_DEBUG << "Failed to lock shader cache pack: " << Compat::hex(GetLastError());
+				return;
+			}
+
+			g_generation = readGeneration();
+			deleteUnusedDataFiles();
+			openDataFile();
+			if (INVALID_HANDLE_VALUE == g_dataFile)
+			{
+				return;
+			}
+
+			if (!isValidHeader(g_dataView, g_dataViewSize))
+			{
+				LOG_DEBUG << "Resetting shader cache pack due to missing or outdated header";
+				if (!writeDataFile({}))
+				{
+					closeDataFile();
+					return;
+				}
+			}
+			else
+			{
+				loadIndex();
+				if (g_dataViewSize > MAX_DATA_SIZE)
+				{
+					compact();
+				}
+			}
+
+			if (!isValidHeader(g_dataView, g_dataViewSize))
+			{
+				closeDataFile();
+				return;
+			}
+			LOG_DEBUG << "Shader cache pack entries: " << g_index.size() << ", size: " << g_dataViewSize;
+		}
+
+		bool load(const Key& key, std::vector<BYTE>& vs, std::vector<BYTE>& ps)
+		{
+			Compat::ScopedSrwLockShared lock(g_srwLock);
+			const RecordHeader* record = nullptr;
+			auto it = g_newRecords.find(key);
+			if (it != g_newRecords.end())
+			{
+				record = reinterpret_cast<const RecordHeader*>(it->second.data());
+			}
+			else
+			{
+				auto entry = findIndexEntry(key);
+				if (entry)
+				{
+					record = getRecord(g_dataView, g_dataViewSize, entry->offset);
+				}
+			}
+
+			if (!record || record->key != key)
+			{
+				return false;
+			}
+
+			if (!isValidRecord(record))
+			{
+				LOG_ONCE("Shader cache pack record checksum mismatch");
+				return false;
+			}
+
+			auto data = reinterpret_cast<const BYTE*>(record + 1);
+			vs.assign(data, data + record->vsSize);
+			ps.assign(data + record->vsSize, data + record->vsSize + record->psSize);
+			return true;
+		}
+
+		void save(const Key& key, const std::vector<BYTE>& vs, const std::vector<BYTE>& ps)
+		{
+			Compat::ScopedSrwLockExclusive lock(g_srwLock);
+			if (INVALID_HANDLE_VALUE == g_dataFile || hasValidRecord(key) || g_newRecords.find(key) != g_newRecords.end())
+			{
+				return;
+			}
+
+			ScopedFileLock fileLock(g_lockFile);
+			if (!fileLock.isLocked())
+			{
+				LOG_ONCE("Failed to lock shader cache pack: " << Compat::hex(GetLastError()));
+				return;
+			}
+
+			if (isDataFileReplaced())
+			{
+				reopenDataFile();
+				if (INVALID_HANDLE_VALUE == g_dataFile || hasValidRecord(key))
+				{
+					return;
+				}
+			}
+
+			LARGE_INTEGER offset = {};
+			const RecordHeader header = { key, vs.size(), ps.size() };
+			if (!SetFilePointerEx(g_dataFile, {}, &offset, FILE_END) ||
+				offset.QuadPart + getRecordSize(header) > MAX_DATA_SIZE)
+			{
+				LOG_ONCE("Shader cache pack size limit reached");
+				return;
+			}
+
+			std::vector<BYTE> record(getRecordSize(header));
+			memcpy(record.data(), &header, sizeof(header));
+			memcpy(record.data() + sizeof(header), vs.data(), vs.size());
+			memcpy(record.data() + sizeof(header) + vs.size(), ps.data(), ps.size());
+			auto recordHeader = reinterpret_cast<RecordHeader*>(record.data());
+			recordHeader->checksum = getRecordChecksum(*recordHeader);
+
+			DWORD bytesWritten = 0;
+			if (!WriteFile(g_dataFile, record.data(), record.size(), &bytesWritten, nullptr) ||
+				bytesWritten != record.size())
+			{
+				LOG_DEBUG << "Failed to append to shader cache pack: " << Compat::hex(GetLastError());
+				return;
+			}
+
+			auto it = std::lower_bound(g_index.begin(), g_index.end(), key,
+				[](const IndexEntry& entry, const Key& key) { return entry.key < key; });
+			if (it != g_index.end() && it->key == key)
+			{
+				it->offset = static_cast<UINT>(offset.QuadPart);
+			}
+			else
+			{
+				g_index.insert(it, { key, static_cast<UINT>(offset.QuadPart) });
+			}
+			g_newRecords[key] = std::move(record);
+			mergeIndex();
+		}
+	}
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <array>
+#include <vector>
+
+#include <Windows.h>
+
+namespace D3dDdi
+{
+	namespace ShaderCachePack
+	{
+		typedef std::array<BYTE, 16> Key;
+
+		void init(const Key& compilerHash, UINT compilerFlags);
+		bool load(const Key& key, std::vector<BYTE>& vs, std::vector<BYTE>& ps);
+		void save(const Key& key, const std::vector<BYTE>& vs, const std::vector<BYTE>& ps);
+	}
+}
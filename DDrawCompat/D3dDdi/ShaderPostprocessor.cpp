@@ -0,0 +1,1666 @@
+#include <algorithm>
+#include <cctype>
+#include <regex>
+#include <sstream>
+#include <stdexcept>
+
+#include <D3dDdi/ShaderPostprocessor.h>
+
+namespace
+{
+	typedef std::string_view Token;
+	typedef std::vector<Token>::const_iterator TokenIter;
+	typedef std::initializer_list<D3dDdi::ShaderPostprocessor::Pattern> PatternSeq;
+
+	const D3dDdi::ShaderPostprocessor::Regex IDENTIFIER("[A-Za-z_][A-Za-z0-9_]*");
+
+#define THROW_EXCEPTION(...) throw std::runtime_error((std::ostringstream() << __func__ << ": " << __VA_ARGS__).str())
+
+	std::pair<Token, unsigned> splitSemantic(Token semantic)
+	{
+		const auto indexPos = semantic.find_last_not_of("0123456789") + 1;
+		const auto index = indexPos < semantic.length() ? std::stoul(std::string(semantic.substr(indexPos))) : 0;
+		return { semantic.substr(0, indexPos), index };
+	}
+
+	Token tokenFromRange(TokenIter begin, TokenIter end)
+	{
+		if (begin >= end)
+		{
+			return {};
+		}
+		return Token(begin->data(), end->data() - begin->data());
+	}
+
+	Token substring(const std::string& str, std::size_t pos, std::size_t len = std::string::npos)
+	{
+		return Token(str.c_str() + pos, std::min(len, str.length() - pos));
+	}
+
+	char getClosingBracket(Token token)
+	{
+		if (1 == token.length())
+		{
+			switch (token[0])
+			{
+			case '(': return ')';
+			case '[': return ']';
+			case '{': return '}';
+			}
+		}
+		return 0;
+	}
+
+	bool isOpeningBracket(Token token)
+	{
+		return 0 != getClosingBracket(token);
+	}
+
+	const std::regex& getRegex(Token pattern)
+	{
+		thread_local std::map<std::string, std::regex, std::less<>> regexes;
+		auto it = regexes.find(pattern);
+		if (it == regexes.end())
+		{
+			it = regexes.emplace(pattern, std::regex(pattern.begin(), pattern.end())).first;
+		}
+		return it->second;
+	}
+
+	bool matchToken(Token token, D3dDdi::ShaderPostprocessor::Pattern pattern)
+	{
+		const bool match = pattern.isRegex
+			? std::regex_match(token.begin(), token.end(), getRegex(pattern.pattern))
+			: (token == pattern.pattern);
+		return match == !pattern.isNegated;
+	}
+
+	bool matchTokenSequence(TokenIter begin, TokenIter end, PatternSeq seq)
+	{
+		PatternSeq::iterator it;
+		for (it = seq.begin(); it < seq.end() && begin < end; ++it)
+		{
+			if (matchToken(*begin, *it))
+			{
+				++begin;
+			}
+			else if (!it->isOptional)
+			{
+				return false;
+			}
+		}
+		return it == seq.end();
+	}
+
+	TokenIter findTokenSequence(TokenIter begin, TokenIter end, PatternSeq seq)
+	{
+		auto last = end;
+		for (const auto& s : seq)
+		{
+			if (!s.isOptional)
+			{
+				--last;
+			}
+		}
+
+		for (auto it = begin; it <= last; ++it)
+		{
+			if (matchTokenSequence(it, end, seq))
+			{
+				return it;
+			}
+		}
+		return end;
+	}
+	std::string getFusedPrevName(Token name)
+	{
+		// Names that refer to the previous pass's input are shifted back by one pass, because the previous pass's
+		// input is the input of the pass before the fused pass
+		std::match_results<Token::const_iterator> match;
+		if (std::regex_match(name.begin(), name.end(), match, getRegex("IN__(.+)")))
+		{
+			const auto field = match.str(1);
+			if ("output_size" == field || "frame_count" == field || "frame_direction" == field || "frame_rotation" == field)
+			{
+				return std::string(name);
+			}
+			return "PASSPREV2__" + field;
+		}
+
+		if (std::regex_match(name.begin(), name.end(), match, getRegex("PASSPREV([1-9]|1[0-9]+)?__(.+)")))
+		{
+			const unsigned index = match[1].matched ? std::stoul(match.str(1)) : 1;
+			return "PASSPREV" + std::to_string(index + 1) + "__" + match.str(2);
+		}
+		return std::string(name);
+	}
+
+	Token getRangeText(TokenIter begin, TokenIter end)
+	{
+		if (begin >= end)
+		{
+			return {};
+		}
+		return Token(begin->data(), (end - 1)->data() + (end - 1)->length() - begin->data());
+	}
+
+	std::string toUpper(Token token)
+	{
+		std::string result(token);
+		std::transform(result.begin(), result.end(), result.begin(), [](char c) { return static_cast<char>(std::toupper(c)); });
+		return result;
+	}
+
+	std::string normalizeSemantic(Token semantic)
+	{
+		const auto [name, index] = splitSemantic(semantic);
+		return toUpper(name) + std::to_string(index);
+	}
+
+}
+
+namespace D3dDdi
+{
+	ShaderPostprocessor::ShaderPostprocessor(const std::string& content)
+		: m_content(content)
+	{
+	}
+
+	void ShaderPostprocessor::applyTokenPatches()
+	{
+		std::string patchedContent;
+		patchedContent.reserve(m_content.length());
+		std::size_t contentPos = 0;
+		for (std::size_t i = 0; i < m_tokens.size(); ++i)
+		{
+			if (m_tokenPatches[i])
+			{
+				const auto& token = m_tokens[i];
+				patchedContent.append(m_content.begin() + contentPos,
+					m_content.begin() + (token.data() - m_content.data()));
+				patchedContent.append(*m_tokenPatches[i]);
+				contentPos = token.data() + token.length() - m_content.data();
+			}
+		}
+		patchedContent.append(m_content.begin() + contentPos, m_content.end());
+
+		m_content.swap(patchedContent);
+		m_structs.clear();
+		m_bracketEnds.clear();
+		m_tokenIndex.clear();
+		m_tokenPatches.clear();
+		m_tokens.clear();
+	}
+
+	bool ShaderPostprocessor::exists(TokenIter it)
+	{
+		return it != m_tokens.end();
+	}
+
+	TokenIter ShaderPostprocessor::findBracketEnd(TokenIter begin, TokenIter end)
+	{
+		if (!isOpeningBracket(*begin))
+		{
+			THROW_EXCEPTION("Not an opening bracket: " << toString(begin));
+		}
+
+		const auto bracketEnd = m_bracketEnds[begin - m_tokens.begin()];
+		if (0 == bracketEnd || bracketEnd >= end - m_tokens.begin())
+		{
+			THROW_EXCEPTION("Unmatched opening bracket: " << toString(begin));
+		}
+		return m_tokens.begin() + bracketEnd;
+	}
+
+	TokenIter ShaderPostprocessor::findToken(Token token)
+	{
+		return std::lower_bound(m_tokens.begin(), m_tokens.end(), token,
+			[](Token lhs, Token rhs) { return lhs.data() < rhs.data(); });
+	}
+
+	TokenIter ShaderPostprocessor::findTokenSequence(TokenIter begin, TokenIter end, PatternSeq seq)
+	{
+		const auto& first = *seq.begin();
+		if (first.isNegated || first.isOptional || first.isRegex)
+		{
+			return ::findTokenSequence(begin, end, seq);
+		}
+
+		const auto occurrences = m_tokenIndex.find(first.pattern);
+		if (occurrences == m_tokenIndex.end())
+		{
+			return end;
+		}
+
+		const UINT beginIndex = begin - m_tokens.begin();
+		for (auto it = std::lower_bound(occurrences->second.begin(), occurrences->second.end(), beginIndex);
+			it != occurrences->second.end(); ++it)
+		{
+			const auto tokenIt = m_tokens.begin() + *it;
+			if (tokenIt >= end)
+			{
+				break;
+			}
+			if (matchTokenSequence(tokenIt, end, seq))
+			{
+				return tokenIt;
+			}
+		}
+		return end;
+	}
+
+	TokenIter ShaderPostprocessor::findUnnestedTokenSequence(TokenIter begin, TokenIter end, PatternSeq seq)
+	{
+		auto last = end;
+		for (const auto& s : seq)
+		{
+			if (!s.isOptional)
+			{
+				--last;
+			}
+		}
+
+		for (auto it = begin; it <= last; ++it)
+		{
+			if (isOpeningBracket(*it))
+			{
+				it = findBracketEnd(it, end);
+			}
+			else if (matchTokenSequence(it, end, seq))
+			{
+				return it;
+			}
+		}
+		return end;
+	}
+
+	void ShaderPostprocessor::fuse(const ShaderPostprocessor& prevPostprocessor, const std::string& prevInputSampler,
+		const std::set<std::string>& inputSamplers)
+	{
+		ShaderPostprocessor prev(prevPostprocessor.m_content);
+		prev.tokenize();
+		tokenize();
+
+		const auto prevDecls = prev.parseDeclarations();
+		const auto decls = parseDeclarations();
+
+		std::set<Token> functionTexts;
+		std::map<Token, Token> uniformTexts;
+		for (const auto& decl : decls)
+		{
+			const auto text = getRangeText(decl.range.begin, decl.range.end);
+			if (decl.isFunction)
+			{
+				functionTexts.insert(text);
+				continue;
+			}
+
+			if (!decl.isUniform)
+			{
+				continue;
+			}
+
+			for (const auto& name : decl.names)
+			{
+				uniformTexts[*name] = text;
+				if (inputSamplers.find(std::string(*name)) != inputSamplers.end())
+				{
+					if (1 != decl.names.size())
+					{
+						THROW_EXCEPTION("Unsupported input sampler declaration: " << toString(decl.range.begin, decl.range.end));
+					}
+					removeTokens(decl.range.begin, decl.range.end - 1);
+					patchToken(decl.range.begin) = "static _FusedTexture " + std::string(*name);
+				}
+			}
+		}
+
+		const std::string fusedPrevInputSampler = prevInputSampler.empty() ? std::string() : "_fused0_" + prevInputSampler;
+		std::map<Token, std::string> renames;
+		if (!prevInputSampler.empty())
+		{
+			renames[prevInputSampler] = fusedPrevInputSampler;
+		}
+		for (const auto& decl : prevDecls)
+		{
+			if (!decl.isFunction && !decl.isUniform)
+			{
+				for (const auto& name : decl.names)
+				{
+					renames[*name] = "_fused0_" + std::string(*name);
+				}
+			}
+		}
+
+		// Helper functions, such as those of the prelude, are shared if both passes define them identically
+		std::map<Token, bool> sharedFunctions;
+		for (const auto& decl : prevDecls)
+		{
+			if (decl.isFunction)
+			{
+				const bool isShared = '_' == decl.names[0]->front() &&
+					functionTexts.find(getRangeText(decl.range.begin, decl.range.end)) != functionTexts.end() &&
+					std::none_of(decl.range.begin, decl.range.end, [&](Token t) { return renames.find(t) != renames.end(); });
+				auto it = sharedFunctions.emplace(*decl.names[0], isShared).first;
+				it->second = it->second && isShared;
+			}
+		}
+
+		for (const auto& decl : prevDecls)
+		{
+			if (decl.isFunction)
+			{
+				if (sharedFunctions[*decl.names[0]])
+				{
+					prev.removeTokens(decl.range.begin, decl.range.end);
+				}
+				else
+				{
+					renames[*decl.names[0]] = "_fused0_" + std::string(*decl.names[0]);
+				}
+			}
+			else if (decl.isUniform)
+			{
+				const auto text = getRangeText(decl.range.begin, decl.range.end);
+				for (const auto& name : decl.names)
+				{
+					if (*name == prevInputSampler)
+					{
+						if (":" != *(name + 1))
+						{
+							prev.patchToken(name) = fusedPrevInputSampler + " : register(s0)";
+						}
+						continue;
+					}
+
+					auto it = uniformTexts.find(*name);
+					if (it != uniformTexts.end())
+					{
+						if (it->second != text)
+						{
+							THROW_EXCEPTION("Conflicting uniform declaration: " << prev.toString(decl.range.begin, decl.range.end));
+						}
+						prev.removeTokens(decl.range.begin, decl.range.end);
+					}
+				}
+			}
+		}
+
+		for (TokenIter it = prev.m_tokens.begin(); it != prev.m_tokens.end(); ++it)
+		{
+			if (prev.m_tokenPatches[it - prev.m_tokens.begin()] || (it != prev.m_tokens.begin() && "." == *(it - 1)))
+			{
+				continue;
+			}
+
+			const bool isField = std::any_of(prevDecls.begin(), prevDecls.end(), [&](const Declaration& decl)
+				{
+					return decl.isType && it >= decl.body.begin && it < decl.body.end;
+				});
+			if (isField && (it + 1 == prev.m_tokens.end() || !matchToken(*(it + 1), IDENTIFIER)))
+			{
+				continue;
+			}
+
+			auto rename = renames.find(*it);
+			const auto name = rename != renames.end() ? rename->second : getFusedPrevName(*it);
+			if (name != *it)
+			{
+				prev.patchToken(it) = name;
+			}
+		}
+
+		std::map<std::string, unsigned> texCoords = m_texCoords;
+		std::set<unsigned> usedTexCoords;
+		for (const auto& texCoord : m_texCoords)
+		{
+			usedTexCoords.insert(texCoord.second);
+		}
+
+		std::map<std::string, std::string> vsInputSemantics;
+		for (const auto& [name, index] : prevPostprocessor.m_texCoords)
+		{
+			auto fusedName = getFusedPrevName(name);
+			if (std::string::npos == name.find("__"))
+			{
+				if (1 == index)
+				{
+					for (const auto& texCoord : texCoords)
+					{
+						if (1 == texCoord.second && std::string::npos != texCoord.first.find("__"))
+						{
+							THROW_EXCEPTION("Conflicting texture coordinate argument: " << name);
+						}
+					}
+					if (usedTexCoords.insert(1).second)
+					{
+						texCoords["_fused0_" + name] = 1;
+					}
+					vsInputSemantics["TEXCOORD1"] = "TEXCOORD1";
+					continue;
+				}
+
+				if (0 != index)
+				{
+					THROW_EXCEPTION("Unsupported texture coordinate argument: " << name);
+				}
+				fusedName = "PASSPREV2__tex_coord";
+			}
+
+			auto it = texCoords.find(fusedName);
+			if (it == texCoords.end())
+			{
+				unsigned freeIndex = 0;
+				while (usedTexCoords.find(freeIndex) != usedTexCoords.end())
+				{
+					++freeIndex;
+				}
+				if (freeIndex >= 8)
+				{
+					THROW_EXCEPTION("Too many texture coordinate arguments");
+				}
+				usedTexCoords.insert(freeIndex);
+				it = texCoords.emplace(fusedName, freeIndex).first;
+			}
+			vsInputSemantics["TEXCOORD" + std::to_string(index)] = "TEXCOORD" + std::to_string(it->second);
+		}
+
+		const auto prevVs = prev.parseEntryPoint("main_vertex");
+		const auto prevPs = prev.parseEntryPoint("main_fragment");
+		const auto vs = parseEntryPoint("main_vertex");
+		const auto ps = parseEntryPoint("main_fragment");
+
+		std::map<std::string, std::set<unsigned>> usedOutputSemantics;
+		for (const auto* semantics : { &vs.usedOutputSemantics, &ps.usedInputSemantics })
+		{
+			for (const auto& [semantic, indexes] : *semantics)
+			{
+				usedOutputSemantics[toUpper(semantic)].insert(indexes.begin(), indexes.end());
+			}
+		}
+
+		std::map<std::string, std::string> psInputSemantics;
+		std::map<std::string, std::string> psOutputSemantics;
+		const auto vsWrapper = fuseEntryPoint(prev, prevVs, vs, vsInputSemantics, psInputSemantics,
+			usedOutputSemantics, {}, {});
+		const auto psWrapper = fuseEntryPoint(prev, prevPs, ps, psInputSemantics, psOutputSemantics,
+			usedOutputSemantics, fusedPrevInputSampler, inputSamplers);
+
+		prev.removeEntryPointSemantics(prevVs);
+		prev.removeEntryPointSemantics(prevPs);
+		removeEntryPointSemantics(vs);
+		removeEntryPointSemantics(ps);
+		patchToken(vs.name) = "_fused1_main_vertex";
+		patchToken(ps.name) = "_fused1_main_fragment";
+		for (const auto& arg : ps.args)
+		{
+			if (inputSamplers.find(std::string(*arg.name)) != inputSamplers.end())
+			{
+				patchToken(arg.type) = "_FusedTexture";
+			}
+		}
+
+		// The fused pass reads its input from the color computed by the previous pass instead of a texture
+		std::string header = "struct _FusedTexture\n{\n    float4 color;\n};\n\n"
+			"uniform float4 _fused_color_min;\nuniform float4 _fused_color_max;\n\n";
+		for (const auto& decl : decls)
+		{
+			if (decl.isFunction && matchToken(*decl.names[0], Regex("_tex2D[a-z]*")) &&
+				matchTokenSequence(decl.args.begin, decl.args.end, { "sampler2D", IDENTIFIER }))
+			{
+				const std::string sampler(*(decl.args.begin + 1));
+				header += std::string(*decl.type) + ' ' + std::string(*decl.names[0]) + "(_FusedTexture " + sampler +
+					std::string(tokenFromRange(decl.args.begin + 2, decl.args.end)) + ") { return " + sampler + ".color; }\n";
+			}
+		}
+
+		prev.applyTokenPatches();
+		applyTokenPatches();
+		m_content = header + '\n' + prev.m_content + '\n' + m_content + '\n' + vsWrapper + '\n' + psWrapper;
+		m_content = std::regex_replace(m_content, std::regex("[ \t]+\n"), "\n");
+		m_content = std::regex_replace(m_content, std::regex("\n{3,}"), "\n\n");
+		m_texCoords = texCoords;
+	}
+
+	std::string ShaderPostprocessor::fuseEntryPoint(ShaderPostprocessor& prev, const Function& prevFunc, const Function& func,
+		const std::map<std::string, std::string>& inputSemantics, std::map<std::string, std::string>& outputSemantics,
+		std::map<std::string, std::set<unsigned>>& usedOutputSemantics, const std::string& prevInputSampler,
+		const std::set<std::string>& inputSamplers)
+	{
+		const bool isVertexShader = "main_vertex" == *func.name;
+		std::vector<std::string> params;
+		std::map<std::string, std::string> uniforms;
+		std::map<std::string, std::string> inputs;
+		std::string args;
+		std::string body;
+
+		for (const auto& arg : func.args)
+		{
+			const std::string name(*arg.name);
+			if (inputSamplers.find(name) != inputSamplers.end())
+			{
+				args += ", _fused_input";
+				continue;
+			}
+
+			params.push_back(std::string(getRangeText(arg.begin, arg.end)));
+			args += ", " + name;
+			if (arg.uniform)
+			{
+				uniforms[name] = std::string(*arg.type) + ' ' + name + (arg.dim ? '[' + std::to_string(arg.dim) + ']' : "");
+			}
+			else if (!arg.out && exists(arg.semantic))
+			{
+				inputs[normalizeSemantic(*arg.semantic)] = name;
+			}
+		}
+
+		std::string prevResult;
+		auto addOutput = [&](const std::string& type, const std::string& name, Token semantic)
+			{
+				const auto normalizedSemantic = normalizeSemantic(semantic);
+				if (normalizedSemantic == (isVertexShader ? "POSITION0" : "COLOR0"))
+				{
+					body += "    " + type + ' ' + name + ";\n";
+					prevResult = name;
+					return;
+				}
+
+				if (!isVertexShader)
+				{
+					THROW_EXCEPTION("Unsupported fragment shader output: " << std::string(semantic));
+				}
+
+				const auto semanticName = toUpper(splitSemantic(semantic).first);
+				auto& usedIndexes = usedOutputSemantics[semanticName];
+				unsigned index = 0;
+				while (usedIndexes.find(index) != usedIndexes.end())
+				{
+					++index;
+				}
+				usedIndexes.insert(index);
+				outputSemantics[normalizedSemantic] = semanticName + std::to_string(index);
+				params.push_back("out " + type + ' ' + name + " : " + semanticName + std::to_string(index));
+			};
+
+		std::string prevArgs;
+		for (const auto& arg : prevFunc.args)
+		{
+			const std::string type(*arg.type);
+			const auto name = prev.toPatchedString(arg.name);
+			const auto fusedName = "_fused0_" + std::string(*arg.name);
+			if ("inout" == *arg.begin || (!arg.uniform && (0 != arg.dim || !prev.exists(arg.semantic))))
+			{
+				THROW_EXCEPTION("Unsupported entry point argument: " << prev.toString(arg.begin, arg.end));
+			}
+
+			if (arg.uniform)
+			{
+				const auto decl = type + ' ' + name + (arg.dim ? '[' + std::to_string(arg.dim) + ']' : "");
+				auto it = uniforms.find(name);
+				if (it == uniforms.end())
+				{
+					uniforms[name] = decl;
+					params.push_back("uniform " + decl + (name == prevInputSampler ? " : register(s0)" : ""));
+				}
+				else if (it->second != decl)
+				{
+					THROW_EXCEPTION("Conflicting uniform argument: " << prev.toString(arg.begin, arg.end));
+				}
+				prevArgs += ", " + name;
+			}
+			else if (arg.out)
+			{
+				addOutput(type, fusedName, *arg.semantic);
+				prevArgs += ", " + fusedName;
+			}
+			else
+			{
+				auto semantic = normalizeSemantic(*arg.semantic);
+				auto mappedSemantic = inputSemantics.find(semantic);
+				const auto paramSemantic = mappedSemantic != inputSemantics.end() ? mappedSemantic->second : std::string(*arg.semantic);
+				if (mappedSemantic != inputSemantics.end())
+				{
+					semantic = mappedSemantic->second;
+				}
+
+				auto it = inputs.find(semantic);
+				if (it == inputs.end())
+				{
+					it = inputs.emplace(semantic, fusedName).first;
+					params.push_back(type + ' ' + fusedName + " : " + paramSemantic);
+				}
+				prevArgs += ", " + it->second;
+			}
+		}
+
+		std::string prevCall = prev.toPatchedString(prevFunc.name) + '(' + (prevArgs.empty() ? "" : prevArgs.substr(2)) + ')';
+		if ("void" != *prevFunc.ret.type)
+		{
+			if (!prev.exists(prevFunc.ret.semantic))
+			{
+				THROW_EXCEPTION("Missing semantic for return value of " << prev.toString(prevFunc.name));
+			}
+			addOutput(std::string(*prevFunc.ret.type), "_fused0_ret", *prevFunc.ret.semantic);
+			prevCall = "_fused0_ret = " + prevCall;
+		}
+		body += "    " + prevCall + ";\n";
+
+		if (!isVertexShader)
+		{
+			if (prevResult.empty())
+			{
+				THROW_EXCEPTION("Missing color output in " << prev.toString(prevFunc.name));
+			}
+
+			body += "    _FusedTexture _fused_input = { clamp(_float4(" + prevResult + "), _fused_color_min, _fused_color_max) };\n";
+			for (const auto& inputSampler : inputSamplers)
+			{
+				if (std::none_of(func.args.begin(), func.args.end(), [&](const FunctionArg& arg) { return inputSampler == *arg.name; }))
+				{
+					body += "    " + inputSampler + " = _fused_input;\n";
+				}
+			}
+		}
+
+		const bool hasRet = "void" != *func.ret.type;
+		body += "    " + std::string(hasRet ? "return " : "") + "_fused1_" + std::string(*func.name) +
+			'(' + (args.empty() ? "" : args.substr(2)) + ");\n";
+
+		std::string signature = std::string(*func.ret.type) + ' ' + std::string(*func.name) + '(';
+		for (const auto& param : params)
+		{
+			signature += param + ", ";
+		}
+		if (!params.empty())
+		{
+			signature.resize(signature.length() - 2);
+		}
+		signature += ')';
+		if (exists(func.ret.semantic))
+		{
+			signature += " : " + std::string(*func.ret.semantic);
+		}
+		return signature + "\n{\n" + body + "}\n";
+	}
+
+	void ShaderPostprocessor::gatherUsedSemantics(const FunctionArg& arg, std::map<Token, std::set<unsigned>>& usedSemantics)
+	{
+		if (arg.uniform)
+		{
+			return;
+		}
+
+		auto [argSem, argSemInd] = exists(arg.semantic) ? splitSemantic(*arg.semantic) : std::pair<Token, unsigned>{};
+		const auto s = m_structs.find(*arg.type);
+		if (s == m_structs.end())
+		{
+			if (exists(arg.semantic))
+			{
+				usedSemantics[argSem].insert(argSemInd);
+			}
+			return;
+		}
+
+		for (const auto& field : s->second)
+		{
+			if (field.uniform)
+			{
+				continue;
+			}
+
+			if (exists(field.semantic))
+			{
+				auto [sem, semInd] = splitSemantic(*field.semantic);
+				usedSemantics[sem].insert(semInd);
+			}
+			else if (exists(arg.semantic))
+			{
+				usedSemantics[argSem].insert(argSemInd);
+				++argSemInd;
+			}
+		}
+	}
+
+	std::string ShaderPostprocessor::getNextUnusedSemantic(Token semantic, std::map<Token, std::set<unsigned>>& usedSemantics)
+	{
+		auto& usedIndexes = usedSemantics[semantic];
+		std::size_t index = 0;
+		while (usedIndexes.find(index) != usedIndexes.end())
+		{
+			++index;
+		}
+		usedIndexes.insert(index);
+		return std::string(semantic) + std::to_string(index);
+	}
+
+	bool ShaderPostprocessor::hasSampler(const std::vector<Field>& fields)
+	{
+		for (const auto& f : fields)
+		{
+			if ("sampler2D" == *f.type)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void ShaderPostprocessor::indexTokens()
+	{
+		m_tokenPatches.assign(m_tokens.size(), std::nullopt);
+		m_bracketEnds.assign(m_tokens.size(), 0);
+		m_tokenIndex.clear();
+
+		std::vector<UINT> openBrackets;
+		for (UINT i = 0; i < m_tokens.size(); ++i)
+		{
+			const auto& token = m_tokens[i];
+			m_tokenIndex[token].push_back(i);
+
+			if (isOpeningBracket(token))
+			{
+				openBrackets.push_back(i);
+			}
+			else if (!openBrackets.empty() && 1 == token.length() &&
+				getClosingBracket(m_tokens[openBrackets.back()]) == token[0])
+			{
+				m_bracketEnds[openBrackets.back()] = i;
+				openBrackets.pop_back();
+			}
+		}
+	}
+
+	std::string ShaderPostprocessor::initStruct(std::map<Token, std::vector<Field>>::const_iterator s)
+	{
+		std::string init;
+		for (const auto& f : s->second)
+		{
+			init += ',';
+			auto it = m_structs.find(*f.name);
+			if (it != m_structs.end())
+			{
+				init += initStruct(it);
+			}
+			else if (f.type->back() >= '1' && f.type->back() <= '4')
+			{
+				init += std::string(*f.type) + '(';
+				const unsigned dim = f.type->back() - '0';
+				for (unsigned i = 0; i < dim; ++i)
+				{
+					init += "0,";
+				}
+				init.back() = ')';
+			}
+			else
+			{
+				init += '0';
+			}
+		}
+		return '{' + init.substr(1) + '}';
+	}
+
+	std::string ShaderPostprocessor::makeUnique(Token token)
+	{
+		return std::string(token) + std::to_string(token.data() - m_content.data());
+	}
+
+	std::string& ShaderPostprocessor::patchToken(TokenIter it)
+	{
+		auto& patch = m_tokenPatches[it - m_tokens.begin()];
+		if (!patch)
+		{
+			patch.emplace();
+		}
+		return *patch;
+	}
+
+	ShaderPostprocessor::Function ShaderPostprocessor::parseFunction(TokenIter returnType)
+	{
+		Function func = {};
+		func.mods.begin = returnType;
+		while (func.mods.begin > m_tokens.begin() && matchToken(*(func.mods.begin - 1), IDENTIFIER))
+		{
+			--func.mods.begin;
+		}
+		func.mods.end = returnType;
+		func.ret.type = returnType;
+		func.ret.name = m_tokens.end();
+		func.ret.begin = func.mods.begin;
+		func.ret.end = returnType + 1;
+		func.ret.out = true;
+		func.name = returnType + 1;
+
+		const auto argsBegin = returnType + 3;
+		const auto argsEnd = findBracketEnd(argsBegin - 1, m_tokens.end());
+		for (auto begin = func.name + 2; begin < argsEnd;)
+		{
+			const auto end = findTokenSequence(begin, argsEnd, { "," });
+			func.args.push_back(parseFunctionArg(begin, end));
+			begin = end + 1;
+		}
+
+		func.ret.semantic = ":" == *(argsEnd + 1) ? argsEnd + 2 : m_tokens.end();
+		func.body.begin = argsEnd + (exists(func.ret.semantic) ? 4 : 2);
+		func.body.end = findBracketEnd(func.body.begin - 1, m_tokens.end());
+		func.isMain = "main_vertex" == *func.name || "main_fragment" == *func.name;
+
+		if (func.isMain)
+		{
+			if ("void" != *returnType)
+			{
+				gatherUsedSemantics(func.ret, func.usedOutputSemantics);
+			}
+
+			for (const auto& arg : func.args)
+			{
+				gatherUsedSemantics(arg, arg.out ? func.usedOutputSemantics : func.usedInputSemantics);
+			}
+		}
+
+		return func;
+	}
+
+	std::vector<ShaderPostprocessor::Declaration> ShaderPostprocessor::parseDeclarations()
+	{
+		std::vector<Declaration> decls;
+		for (TokenIter it = m_tokens.begin(); it < m_tokens.end();)
+		{
+			if (";" == *it)
+			{
+				++it;
+				continue;
+			}
+
+			Declaration decl = {};
+			decl.range.begin = it;
+			decl.args = { m_tokens.end(), m_tokens.end() };
+			decl.body = decl.args;
+
+			if (matchTokenSequence(it, m_tokens.end(), { "struct", IDENTIFIER, "{" }))
+			{
+				decl.type = it;
+				decl.names.push_back(it + 1);
+				decl.body = { it + 3, findBracketEnd(it + 2, m_tokens.end()) };
+				decl.isType = true;
+				it = decl.body.end + 1;
+			}
+			else
+			{
+				auto next = it;
+				while (next < m_tokens.end() && matchToken(*next, IDENTIFIER))
+				{
+					++next;
+				}
+				if (next == m_tokens.end() || next - it < 2)
+				{
+					THROW_EXCEPTION("Failed to parse declaration: " << toString(it));
+				}
+
+				decl.type = next - 2;
+				decl.names.push_back(next - 1);
+				if ("(" == *next)
+				{
+					decl.isFunction = true;
+					decl.args = { next + 1, findBracketEnd(next, m_tokens.end()) };
+					next = decl.args.end + 1;
+					if (matchTokenSequence(next, m_tokens.end(), { ":", IDENTIFIER }))
+					{
+						next += 2;
+					}
+
+					if (matchTokenSequence(next, m_tokens.end(), { "{" }))
+					{
+						decl.body = { next + 1, findBracketEnd(next, m_tokens.end()) };
+						it = decl.body.end + 1;
+					}
+					else if (matchTokenSequence(next, m_tokens.end(), { ";" }))
+					{
+						it = next + 1;
+					}
+					else
+					{
+						THROW_EXCEPTION("Failed to parse function declaration: " << toString(decl.names[0]));
+					}
+				}
+				else
+				{
+					decl.isType = "typedef" == *it;
+					decl.isUniform = !decl.isType && std::find(it, decl.type, "static") == decl.type;
+					const auto end = findUnnestedTokenSequence(next, m_tokens.end(), { ";" });
+					if (end == m_tokens.end())
+					{
+						THROW_EXCEPTION("Failed to find end of declaration: " << toString(decl.names[0]));
+					}
+
+					for (auto comma = findUnnestedTokenSequence(next, end, { "," }); comma < end;
+						comma = findUnnestedTokenSequence(comma + 1, end, { "," }))
+					{
+						if (!matchTokenSequence(comma + 1, end, { IDENTIFIER }))
+						{
+							THROW_EXCEPTION("Expected an identifier, found: " << toString(comma + 1));
+						}
+						decl.names.push_back(comma + 1);
+					}
+					it = end + 1;
+				}
+			}
+
+			decl.range.end = it;
+			decls.push_back(decl);
+		}
+		return decls;
+	}
+
+	ShaderPostprocessor::Function ShaderPostprocessor::parseEntryPoint(Token name)
+	{
+		const auto it = findTokenSequence(m_tokens.begin(), m_tokens.end(), { name, "(" });
+		if (it == m_tokens.end() || it == m_tokens.begin())
+		{
+			THROW_EXCEPTION("Entry point not found: " << std::string(name));
+		}
+		return parseFunction(it - 1);
+	}
+
+	ShaderPostprocessor::FunctionArg ShaderPostprocessor::parseFunctionArg(TokenIter begin, TokenIter end)
+	{
+		FunctionArg arg = {};
+		arg.begin = begin;
+		arg.end = end;
+
+		auto it = begin;
+		if ("static" == *it)
+		{
+			patchToken(it) = {};
+			++it;
+		}
+
+		if ("uniform" == *it)
+		{
+			arg.uniform = true;
+			++it;
+		}
+		else if ("in" == *it || "out" == *it || "inout" == *it)
+		{
+			arg.out = "out" == *it;
+			++it;
+		}
+		else if ("const" == *it)
+		{
+			++it;
+		}
+
+		if (matchTokenSequence(it, end, { IDENTIFIER, IDENTIFIER }))
+		{
+			arg.type = it;
+			arg.name = it + 1;
+			it += 2;
+
+			if (matchTokenSequence(it, end, { "[", Regex("[0-9]+"), "]" }))
+			{
+				arg.dim = std::stoul(std::string(*(it + 1)));
+				it += 3;
+			}
+
+			if (it == end)
+			{
+				arg.semantic = m_tokens.end();
+				return arg;
+			}
+
+			if ((it + 2 == end && matchTokenSequence(it, end, { ":", IDENTIFIER })) ||
+				(it + 5 == end && matchTokenSequence(it, end, { ":", "register", "(", IDENTIFIER, ")" })))
+			{
+				arg.semantic = it + 1;
+				return arg;
+			}
+		}
+
+		THROW_EXCEPTION("Failed to parse function argument: " << toString(begin, end));
+	}
+
+	ShaderPostprocessor::Field ShaderPostprocessor::parseStructField(TokenIter begin, TokenIter end, TokenIter type)
+	{
+		if (matchTokenSequence(begin, end, { IDENTIFIER }))
+		{
+			Field field = {};
+			field.type = type;
+			field.name = begin;
+
+			if (begin + 1 == end)
+			{
+				field.semantic = m_tokens.end();
+				return field;
+			}
+
+			if (3 == end - begin && matchTokenSequence(begin + 1, end, { ":", IDENTIFIER }))
+			{
+				field.semantic = begin + 2;
+				return field;
+			}
+		}
+
+		THROW_EXCEPTION("Failed to parse struct field: " << toString(begin, end));
+	}
+
+	void ShaderPostprocessor::parseStructs()
+	{
+		const PatternSeq seq = { "struct", IDENTIFIER, "{" };
+		for (auto it = findTokenSequence(m_tokens.begin(), m_tokens.end(), seq); it != m_tokens.end();)
+		{
+			const auto& structName = *(it + 1);
+			const auto bodyBegin = it + 3;
+			const auto bodyEnd = findBracketEnd(it + 2, m_tokens.end());
+
+			if (m_structs.find(structName) != m_structs.end())
+			{
+				removeTokens(it, bodyEnd + 2);
+				it = findTokenSequence(bodyEnd + 2, m_tokens.end(), seq);
+				continue;
+			}
+
+			for (auto declStart = bodyBegin; declStart < bodyEnd;)
+			{
+				const auto declEnd = findTokenSequence(declStart, bodyEnd, { ";" });
+				const bool uniform = "uniform" == *declStart;
+				if (!matchTokenSequence(declStart + uniform, declEnd, { IDENTIFIER }))
+				{
+					THROW_EXCEPTION("Expected a type, found: " << toString(declStart + uniform));
+				}
+				const auto type = declStart + uniform;
+
+				for (auto fieldStart = declStart + uniform + 1; fieldStart < declEnd;)
+				{
+					const auto fieldEnd = findTokenSequence(fieldStart, declEnd, { "," });
+					auto field = parseStructField(fieldStart, fieldEnd, type);
+					field.uniform = uniform;
+					m_structs[structName].push_back(field);
+					fieldStart = fieldEnd + 1;
+				}
+				declStart = declEnd + 1;
+			}
+
+			if (m_structs[structName].empty())
+			{
+				THROW_EXCEPTION("Empty struct is not supported: " + toString(structName));
+			}
+
+			it = findTokenSequence(bodyEnd + 1, m_tokens.end(), seq);
+		}
+	}
+
+	void ShaderPostprocessor::patchTokenSequence(TokenIter begin, TokenIter end, PatternSeq seq, const std::string& patch)
+	{
+		for (auto it = findTokenSequence(begin, end, seq); it < end; it = findTokenSequence(it + seq.size(), end, seq))
+		{
+			patchToken(it) = patch;
+			removeTokens(it + 1, it + seq.size());
+		}
+	}
+
+	void ShaderPostprocessor::postprocessArrayCtors()
+	{
+		const PatternSeq& seq = { Regex("float[1-4]?"), "[", "]", "(" };
+		for (auto begin = findTokenSequence(m_tokens.begin(), m_tokens.end(), seq);
+			begin < m_tokens.end();)
+		{
+			const auto end = findBracketEnd(begin + 3, m_tokens.end());
+			removeTokens(begin, begin + 3);
+			patchToken(begin + 3) = '{';
+			patchToken(end) = '}';
+			begin = findTokenSequence(end + 1, m_tokens.end(), seq);
+		}
+	}
+
+	void ShaderPostprocessor::postprocessDeadBranches(TokenRange body)
+	{
+		const PatternSeq seq = { "const", Optional("static"), "bool", IDENTIFIER, "=", Regex("true|false"), ";" };
+		for (auto begin = findTokenSequence(body.begin, body.end, seq);
+			begin < body.end;
+			begin = findTokenSequence(begin + 6, body.end, seq))
+		{
+			const auto end = findUnnestedTokenSequence(begin, body.end + 1, { "}" });
+			const bool hasStatic = "static" == *(begin + 1);
+			const auto& boolName = *(begin + 2 + hasStatic);
+
+			const PatternSeq& ifSeq = { "if", "(", boolName, ")", "{" };
+			for (auto ifBegin = findTokenSequence(begin, end, ifSeq);
+				ifBegin < end;
+				ifBegin = findTokenSequence(ifBegin + 5, end, ifSeq))
+			{
+				const auto ifEnd = findBracketEnd(ifBegin + 4, end);
+				const bool boolValue = "true" == *(begin + 4 + hasStatic);
+				const bool hasElse = matchTokenSequence(ifEnd + 1, end, { "else", "{" });
+				if (!boolValue)
+				{
+					removeTokens(ifBegin + 5, ifEnd - 1);
+				}
+				else if (hasElse)
+				{
+					const auto elseEnd = findBracketEnd(ifEnd + 2, end);
+					removeTokens(ifEnd + 1, elseEnd + 1);
+				}
+			}
+		}
+	}
+
+	void ShaderPostprocessor::postprocessFunctionArg(Function& func, const FunctionArg& arg)
+	{
+		const auto s = m_structs.find(*arg.type);
+		if (s == m_structs.end())
+		{
+			if ("sampler2D" == *arg.type)
+			{
+				if (exists(arg.semantic))
+				{
+					auto [argSem, argSemInd] = splitSemantic(*arg.semantic);
+					if ("TEXUNIT" == argSem)
+					{
+						patchToken(arg.semantic) = "register(s" + std::to_string(argSemInd) + ')';
+					}
+				}
+			}
+			else if (func.isMain)
+			{
+				const auto semantic = exists(arg.semantic)
+					? std::string(*arg.semantic)
+					: getNextUnusedSemantic("TEXCOORD", arg.out ? func.usedOutputSemantics : func.usedInputSemantics);
+				if (!exists(arg.semantic))
+				{
+					patchToken(arg.name) = std::string(*arg.name) + " : " + semantic;
+				}
+
+				if (!arg.out && "main_vertex" == *func.name)
+				{
+					const auto [sem, semInd] = splitSemantic(semantic);
+					if ("TEXCOORD" == sem)
+					{
+						m_texCoords[std::string(*arg.name)] = semInd;
+					}
+				}
+			}
+			return;
+		}
+
+		const PatternSeq& assignmentSeq = { *arg.name, "=" };
+		for (auto assignmentBegin = findTokenSequence(func.body.begin, func.body.end, assignmentSeq);
+			assignmentBegin < func.body.end;)
+		{
+			const auto& varName = makeUnique(*arg.name);
+			patchToken(assignmentBegin) = std::string(*arg.type) + ' ' + varName;
+			const auto assignmentEnd = findUnnestedTokenSequence(assignmentBegin + 2, func.body.end, { ";" });
+			if (assignmentEnd == func.body.end)
+			{
+				THROW_EXCEPTION("Failed to find end of assignment: " + toString(assignmentBegin));
+			}
+
+			auto& patch = patchToken(assignmentEnd);
+			patch = ";\n";
+			for (const auto& f : s->second)
+			{
+				patch += "    " + std::string(*arg.name) + "__" + std::string(*f.name) + " = " +
+					varName + '.' + std::string(*f.name) + ";\n";
+			}
+
+			assignmentBegin = findTokenSequence(assignmentEnd + 1, func.body.end, assignmentSeq);
+		}
+
+		const PatternSeq& rhsSeq = { "=", *arg.name, ";" };
+		for (auto rhsBegin = findTokenSequence(func.body.begin, func.body.end, rhsSeq);
+			rhsBegin < func.body.end;
+			rhsBegin = findTokenSequence(rhsBegin + 3, func.body.end, rhsSeq))
+		{
+			auto& patch = patchToken(rhsBegin - 1);
+			for (const auto& f : s->second)
+			{
+				patch += std::string(*arg.name) + "__" + std::string(*f.name) + ", ";
+			}
+			patch = std::string(*arg.type) + ' ' + std::string(*arg.name) + " = {" +
+				patch.substr(0, patch.length() - 2) + "};\n    " + std::string(*(rhsBegin - 1));
+		}
+
+		const PatternSeq& argSeq = { *arg.name, Regex("[,)]") };
+		for (auto argBegin = findTokenSequence(func.body.begin, func.body.end, argSeq);
+			argBegin < func.body.end;
+			argBegin = findTokenSequence(argBegin + 2, func.body.end, argSeq))
+		{
+			auto& patch = patchToken(argBegin);
+			for (const auto& f : s->second)
+			{
+				patch += std::string(*arg.name) + "__" + std::string(*f.name) + ", ";
+			}
+			patch.erase(patch.length() - 2, 2);
+		}
+
+		patchToken(arg.begin) = splitFunctionArg(func, arg, s->second);
+		removeTokens(arg.begin + 1, arg.end);
+	}
+
+	void ShaderPostprocessor::postprocessFunctionRet(Function& func)
+	{
+		const auto s = m_structs.find(*func.ret.type);
+		if (s == m_structs.end())
+		{
+			if ("main_fragment" == *func.name)
+			{
+				if (exists(func.ret.semantic) && "COLOR" == *func.ret.semantic && "float4" != *func.ret.type)
+				{
+					patchToken(func.ret.type) = "float4";
+					const PatternSeq& seq = { "return" };
+					for (auto begin = findTokenSequence(func.body.begin, func.body.end, seq); begin < func.body.end;)
+					{
+						const auto end = findUnnestedTokenSequence(begin + 1, func.body.end, { ";" });
+						if (end == m_tokens.end())
+						{
+							THROW_EXCEPTION("Unterminated return statement: " + toString(begin));
+						}
+						patchToken(begin) = "return _float4(";
+						patchToken(end) = ");";
+						begin = findTokenSequence(end + 1, func.body.end, seq);
+					}
+				}
+				patchTokenSequence(func.body.begin, func.body.end, { "discard" }, "discard; return 0");
+			}
+			return;
+		}
+
+		patchToken(func.ret.type) = "void";
+
+		const auto argsEnd = findBracketEnd(func.name + 1, m_tokens.end());
+		patchToken(argsEnd) = ((argsEnd == func.name + 2) ? "" : ", ") + splitFunctionArg(func, func.ret, s->second) + ')';
+
+		if (exists(func.ret.semantic))
+		{
+			patchToken(func.ret.semantic - 1) = {};
+			patchToken(func.ret.semantic) = {};
+		}
+
+		const PatternSeq& returnSeq = { "return" };
+		for (auto begin = findTokenSequence(func.body.begin, func.body.end, returnSeq); begin < func.body.end;)
+		{
+			const auto end = findUnnestedTokenSequence(begin + 1, func.body.end, { ";" });
+			if (end == m_tokens.end())
+			{
+				THROW_EXCEPTION("Unterminated return statement: " + toString(begin));
+			}
+
+			const auto& varName = '_' + makeUnique(*begin);
+			patchToken(begin) = std::string(*func.ret.type) + ' ' + varName + " = ";
+
+			auto& patch = patchToken(end);
+			patch = ";\n";
+			for (const auto& f : s->second)
+			{
+				patch += "    _ret__" + std::string(*f.name) + " = " +
+					varName + '.' + std::string(*f.name) + ";\n";
+			}
+
+			begin = findTokenSequence(end + 1, func.body.end, returnSeq);
+		}
+
+		const PatternSeq& declSeq = { *func.ret.type, IDENTIFIER, ";" };
+		for (auto begin = findTokenSequence(func.body.begin, func.body.end, declSeq);
+			begin < func.body.end;
+			begin = findTokenSequence(begin + 3, func.body.end, declSeq))
+		{
+			patchToken(begin + 2) = " = " + initStruct(s) + ';';
+		}
+	}
+
+	void ShaderPostprocessor::postprocessFunction(Function& func)
+	{
+		if (!func.isMain && '_' != func.name->front() &&
+			findTokenSequence(func.body.end + 1, m_tokens.end(), { *func.name }) == m_tokens.end())
+		{
+			removeTokens(func.mods.begin, func.body.end + 1);
+			return;
+		}
+
+		for (const auto& arg : func.args)
+		{
+			postprocessFunctionArg(func, arg);
+		}
+
+		postprocessFunctionRet(func);
+
+		patchTokenSequence(func.body.begin, func.body.end, { "static", "const" }, "const");
+		patchTokenSequence(func.body.begin, func.body.end, { "const", "static" }, "const");
+		patchTokenSequence(func.body.begin, func.body.end, { ".", "st" }, ".xy");
+		patchTokenSequence(func.body.begin, func.body.end, { "_frac", "(" }, "frac(");
+		postprocessDeadBranches(func.body);
+
+		const PatternSeq& seq = { Regex("(float)[234]?"), IDENTIFIER };
+		for (auto declBegin = findTokenSequence(func.body.begin, func.body.end, seq); declBegin < func.body.end;)
+		{
+			const auto declEnd = findTokenSequence(declBegin + 2, func.body.end, { ";" });
+			if (declEnd == func.body.end)
+			{
+				THROW_EXCEPTION("Failed to find end of variable declaration: " << toString(declBegin + 1));
+			}
+			postprocessVariableInit(declBegin + 1, declEnd);
+			declBegin = findTokenSequence(declEnd + 1, func.body.end, seq);
+		}
+	}
+
+	void ShaderPostprocessor::postprocessFunctions()
+	{
+		const PatternSeq seq = { IDENTIFIER, IDENTIFIER, "(" };
+		for (auto it = findTokenSequence(m_tokens.begin(), m_tokens.end(), seq); it < m_tokens.end();)
+		{
+			auto func = parseFunction(it);
+			postprocessFunction(func);
+			it = findTokenSequence(func.body.end + 1, m_tokens.end(), seq);
+		}
+	}
+
+	void ShaderPostprocessor::postprocessGlobalVariables()
+	{
+		const PatternSeq seq = { IDENTIFIER, IDENTIFIER, Regex("[\\[=]") };
+		for (auto begin = findUnnestedTokenSequence(m_tokens.begin(), m_tokens.end(), seq);
+			begin < m_tokens.end();
+			begin = findUnnestedTokenSequence(begin + 3, m_tokens.end(), seq))
+		{
+			if ("[" == *(begin + 2))
+			{
+				auto it = findBracketEnd(begin + 2, m_tokens.end());
+				if (it + 1 >= m_tokens.end() || "=" != *(it + 1))
+				{
+					continue;
+				}
+			}
+
+			auto it = begin;
+			while (it > m_tokens.begin() && matchToken(*(it - 1), IDENTIFIER) && "static" != *(it - 1))
+			{
+				--it;
+			}
+			if (it > m_tokens.begin() && "static" != *(it - 1))
+			{
+				patchToken(begin) = "static " + std::string(*begin);
+			}
+		}
+	}
+
+	void ShaderPostprocessor::postprocessScalarToVector()
+	{
+		const PatternSeq seq = { Regex("(float|int|bool)[234]"), "(" };
+		for (auto begin = findTokenSequence(m_tokens.begin(), m_tokens.end(), seq); begin < m_tokens.end();)
+		{
+			const auto end = findBracketEnd(begin + 1, m_tokens.end());
+			if (findUnnestedTokenSequence(begin + 2, end, { "," }) == end)
+			{
+				patchToken(begin) = '_' + std::string(*begin);
+			}
+			begin = findTokenSequence(begin + 2, m_tokens.end(), seq);
+		}
+	}
+
+	void ShaderPostprocessor::postprocessStructs()
+	{
+		for (auto& s : m_structs)
+		{
+			if (s.second.empty())
+			{
+				continue;
+			}
+
+			for (auto& f : s.second)
+			{
+				if (f.uniform)
+				{
+					patchToken(f.type - 1) = {};
+				}
+
+				if ("sampler2D" == *f.type)
+				{
+					patchToken(f.type) = {};
+					const auto begin = f.name;
+					const auto end = (exists(f.semantic) ? f.semantic : begin) + 2;
+					removeTokens(begin, end);
+				}
+			}
+
+			auto structEnd = findTokenSequence(s.second.back().name + 1, m_tokens.end(), { "}", ";" });
+			if (structEnd == m_tokens.end())
+			{
+				THROW_EXCEPTION("Failed to find end of struct: " + toString(s.first));
+			}
+
+			const PatternSeq seq = { s.first, "(" };
+			for (auto it = findTokenSequence(structEnd + 2, m_tokens.end(), seq);
+				it < m_tokens.end();
+				it = findTokenSequence(it + 2, m_tokens.end(), seq))
+			{
+				patchToken(it) = '_' + std::string(s.first);
+
+				auto& patch = patchToken(structEnd + 1);
+				if (!patch.empty())
+				{
+					continue;
+				}
+
+				patch = ";\n" + std::string(s.first) + " _" + std::string(s.first) + '(';
+				for (auto& f : s.second)
+				{
+					if ("sampler2D" != *f.type)
+					{
+						patch += std::string(*f.type) + ' ' + std::string(*f.name) + ", ";
+					}
+				}
+
+				patch.resize(patch.size() - 2);
+				patch += ")\n{\n  " + std::string(s.first) + " s = { ";
+				for (auto& f : s.second)
+				{
+					if ("sampler2D" != *f.type)
+					{
+						patch += std::string(*f.name) + ", ";
+					}
+				}
+				patch.resize(patch.size() - 2);
+				patch += " };\n  return s;\n}";
+			}
+		}
+	}
+
+	void ShaderPostprocessor::postprocessVariableInit(TokenIter begin, TokenIter end)
+	{
+		for (auto it = begin; it < end;)
+		{
+			if (!matchTokenSequence(it, end, { IDENTIFIER }))
+			{
+				THROW_EXCEPTION("Expected an identifier, found: " << toString(it));
+			}
+
+			if (it + 1 == end || "," == *(it + 1))
+			{
+				patchToken(it) = std::string(*it) + "=0";
+				it += 2;
+			}
+			else
+			{
+				it = findUnnestedTokenSequence(it + 2, end, { "," }) + 1;
+			}
+		}
+	}
+
+	void ShaderPostprocessor::postprocess()
+	{
+		tokenize();
+		parseStructs();
+		postprocessStructs();
+		postprocessArrayCtors();
+		postprocessScalarToVector();
+		postprocessFunctions();
+		postprocessGlobalVariables();
+		applyTokenPatches();
+		m_content = std::regex_replace(m_content, std::regex("#.*"), "");
+		m_content = std::regex_replace(m_content, std::regex("[ \t]+\n"), "\n");
+		m_content = std::regex_replace(m_content, std::regex("\n{3,}"), "\n\n");
+	}
+
+	std::string ShaderPostprocessor::splitFunctionArg(Function& func, const FunctionArg& arg, const std::vector<Field>& fields)
+	{
+		auto [argSem, argSemInd] = exists(arg.semantic) ? splitSemantic(*arg.semantic) : std::pair<Token, unsigned>{};
+		std::string patch;
+		for (const auto& f : fields)
+		{
+			const std::string newName = std::string(exists(arg.name) ? *arg.name : "_ret") + "__" + std::string(*f.name);
+			patch += ", ";
+			if (arg.uniform || f.uniform || "sampler2D" == *f.type)
+			{
+				patch += "uniform " + std::string(*f.type) + ' ' + newName;
+			}
+			else
+			{
+				std::string semantic;
+				if (exists(f.semantic))
+				{
+					semantic = *f.semantic;
+				}
+				else if (exists(arg.semantic))
+				{
+					semantic = std::string(argSem) + std::to_string(argSemInd);
+					++argSemInd;
+				}
+				else
+				{
+					semantic = getNextUnusedSemantic("TEXCOORD", arg.out ? func.usedOutputSemantics : func.usedInputSemantics);
+				}
+				patch += (arg.out ? "out " : "") + std::string(*f.type) + ' ' + newName + " : " + semantic;
+
+				if (!arg.out && "main_vertex" == *func.name)
+				{
+					const auto [sem, semInd] = splitSemantic(semantic);
+					if ("TEXCOORD" == sem)
+					{
+						m_texCoords[newName] = semInd;
+					}
+				}
+			}
+
+			if (exists(arg.name))
+			{
+				const PatternSeq seq = { *arg.name, ".", *f.name };
+				patchTokenSequence(func.body.begin, func.body.end, seq, newName);
+			}
+		}
+
+		return patch.empty() ? std::string() : patch.substr(2);
+	}
+
+	void ShaderPostprocessor::tokenize()
+	{
+		for (std::size_t pos = 0; pos < m_content.length(); ++pos)
+		{
+			auto next = m_content[pos];
+			if (' ' == next || '\t' == next || '\r' == next || '\n' == next)
+			{
+				continue;
+			}
+
+			if ('#' == next)
+			{
+				pos = m_content.find_first_of('\n', pos + 1);
+				continue;
+			}
+
+			if ('"' == next)
+			{
+				auto end = m_content.find_first_of('"', pos + 1);
+				if (std::string::npos == end)
+				{
+					THROW_EXCEPTION("Unmatched quote: " << toString(Token(m_content.data() + pos + 1, 1)));
+				}
+				m_tokens.push_back(substring(m_content, pos, end - pos + 1));
+				pos = end;
+				continue;
+			}
+
+			const std::size_t start = pos;
+			while (next >= 'A' && next <= 'Z' ||
+				next >= 'a' && next <= 'z' ||
+				next >= '0' && next <= '9' ||
+				'_' == next)
+			{
+				++pos;
+				next = m_content[pos];
+			}
+
+			if (pos != start)
+			{
+				m_tokens.push_back(substring(m_content, start, pos - start));
+				--pos;
+			}
+			else
+			{
+				m_tokens.push_back(substring(m_content, pos, 1));
+			}
+		}
+		indexTokens();
+	}
+
+	std::string ShaderPostprocessor::toPatchedString(TokenIter it)
+	{
+		const auto& patch = m_tokenPatches[it - m_tokens.begin()];
+		return patch ? *patch : std::string(*it);
+	}
+
+	std::string ShaderPostprocessor::toString(Token token)
+	{
+		if (token.data() < m_content.data() ||
+			token.data() + token.length() > m_content.data() + m_content.length())
+		{
+			return "'" + std::string(token) + "'";
+		}
+
+		int line = 0;
+		int tokenPos = token.data() - m_content.data();
+		int prevNewLinePos = -1;
+		for (int pos = -1; pos < tokenPos; pos = m_content.find('\n', pos + 1))
+		{
+			++line;
+			prevNewLinePos = pos;
+		}
+		int column = tokenPos - prevNewLinePos;
+		return "'" + std::string(token) + "' (line " + std::to_string(line) + ", column " + std::to_string(column) + ')';
+	}
+
+	void ShaderPostprocessor::removeEntryPointSemantics(const Function& func)
+	{
+		for (const auto& arg : func.args)
+		{
+			if (arg.uniform && "uniform" == *arg.begin)
+			{
+				patchToken(arg.begin) = {};
+			}
+			if (exists(arg.semantic))
+			{
+				removeTokens(arg.semantic - 1, arg.end);
+			}
+		}
+
+		if (exists(func.ret.semantic))
+		{
+			removeTokens(func.ret.semantic - 1, func.ret.semantic + 1);
+		}
+	}
+
+	void ShaderPostprocessor::removeTokens(TokenIter begin, TokenIter end)
+	{
+		for (auto it = begin; it < end; ++it)
+		{
+			patchToken(it) = {};
+		}
+	}
+
+	std::string ShaderPostprocessor::toString(TokenIter it)
+	{
+		return toString(*it);
+	}
+
+	std::string ShaderPostprocessor::toString(TokenIter begin, TokenIter end)
+	{
+		return toString(tokenFromRange(begin, end));
+	}
+}
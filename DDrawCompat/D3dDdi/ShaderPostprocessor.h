@@ -0,0 +1,155 @@
+#pragma once
+
+#include <map>
+#include <optional>
+#include <set>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <Windows.h>
+
+namespace D3dDdi
+{
+	class ShaderPostprocessor
+	{
+	public:
+		typedef std::string_view Token;
+
+		struct Pattern
+		{
+			Token pattern;
+			bool isNegated = false;
+			bool isOptional = false;
+			bool isRegex = false;
+
+			Pattern(Token pattern) : pattern(pattern) {}
+			Pattern(const char* pattern) : pattern(pattern) {}
+		};
+
+		struct Not : Pattern
+		{
+			Not(const Pattern& p) : Pattern(p) { isNegated = true; }
+		};
+
+		struct Optional : Pattern
+		{
+			Optional(const Pattern& p) : Pattern(p) { isOptional = true; }
+		};
+
+		struct Regex : Pattern
+		{
+			Regex(const Pattern& p) : Pattern(p) { isRegex = true; }
+		};
+
+		typedef std::vector<Token>::const_iterator TokenIter;
+		typedef std::initializer_list<Pattern> PatternSeq;
+
+		struct TokenRange
+		{
+			TokenIter begin;
+			TokenIter end;
+		};
+
+		ShaderPostprocessor(const std::string& content);
+
+		const std::string& getContent() const { return m_content; }
+		const std::map<std::string, unsigned>& getTexCoords() const { return m_texCoords; }
+
+		void fuse(const ShaderPostprocessor& prev, const std::string& prevInputSampler,
+			const std::set<std::string>& inputSamplers);
+		void postprocess();
+
+	private:
+		struct Declaration
+		{
+			TokenRange range;
+			TokenIter type;
+			std::vector<TokenIter> names;
+			TokenRange args;
+			TokenRange body;
+			bool isFunction;
+			bool isType;
+			bool isUniform;
+		};
+
+		struct Field
+		{
+			bool uniform;
+			TokenIter type;
+			TokenIter name;
+			TokenIter semantic;
+		};
+
+		struct FunctionArg : Field
+		{
+			TokenIter begin;
+			TokenIter end;
+			unsigned dim;
+			bool out;
+		};
+
+		struct Function
+		{
+			TokenRange mods;
+			FunctionArg ret;
+			TokenIter name;
+			std::vector<FunctionArg> args;
+			TokenRange body;
+			std::map<Token, std::set<unsigned>> usedInputSemantics;
+			std::map<Token, std::set<unsigned>> usedOutputSemantics;
+			bool isMain;
+		};
+
+		void applyTokenPatches();
+		bool exists(TokenIter it);
+		TokenIter findBracketEnd(TokenIter begin, TokenIter end);
+		TokenIter findToken(Token token);
+		TokenIter findTokenSequence(TokenIter begin, TokenIter end, PatternSeq seq);
+		TokenIter findUnnestedTokenSequence(TokenIter begin, TokenIter end, PatternSeq seq);
+		std::string fuseEntryPoint(ShaderPostprocessor& prev, const Function& prevFunc, const Function& func,
+			const std::map<std::string, std::string>& inputSemantics, std::map<std::string, std::string>& outputSemantics,
+			std::map<std::string, std::set<unsigned>>& usedOutputSemantics, const std::string& prevInputSampler,
+			const std::set<std::string>& inputSamplers);
+		void gatherUsedSemantics(const FunctionArg& arg, std::map<Token, std::set<unsigned>>& usedSemantics);
+		std::string getNextUnusedSemantic(Token semantic, std::map<Token, std::set<unsigned>>& usedSemantics);
+		bool hasSampler(const std::vector<Field>& fields);
+		void indexTokens();
+		std::string initStruct(std::map<Token, std::vector<Field>>::const_iterator s);
+		std::string makeUnique(Token token);
+		Function parseFunction(TokenIter returnType);
+		std::vector<Declaration> parseDeclarations();
+		Function parseEntryPoint(Token name);
+		FunctionArg parseFunctionArg(TokenIter begin, TokenIter end);
+		Field parseStructField(TokenIter begin, TokenIter end, TokenIter type);
+		void parseStructs();
+		std::string& patchToken(TokenIter it);
+		void patchTokenSequence(TokenIter begin, TokenIter end, PatternSeq seq, const std::string& patch);
+		void postprocessArrayCtors();
+		void postprocessDeadBranches(TokenRange body);
+		void postprocessFunctionArg(Function& func, const FunctionArg& arg);
+		void postprocessFunctionRet(Function& func);
+		void postprocessFunction(Function& func);
+		void postprocessFunctions();
+		void postprocessGlobalVariables();
+		void postprocessScalarToVector();
+		void postprocessStructs();
+		void postprocessVariableInit(TokenIter begin, TokenIter end);
+		void removeEntryPointSemantics(const Function& func);
+		void removeTokens(TokenIter begin, TokenIter end);
+		std::string splitFunctionArg(Function& func, const FunctionArg& arg, const std::vector<Field>& fields);
+		void tokenize();
+		std::string toPatchedString(TokenIter it);
+		std::string toString(Token token);
+		std::string toString(TokenIter it);
+		std::string toString(TokenIter begin, TokenIter end);
+
+		std::string m_content;
+		std::map<std::string, unsigned> m_texCoords;
+		std::map<Token, std::vector<Field>> m_structs;
+		std::vector<Token> m_tokens;
+		std::vector<std::optional<std::string>> m_tokenPatches;
+		std::vector<UINT> m_bracketEnds;
+		std::map<Token, std::vector<UINT>> m_tokenIndex;
+	};
+}
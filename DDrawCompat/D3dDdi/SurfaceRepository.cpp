@@ -8,13 +8,26 @@
 #include <D3dDdi/SurfaceRepository.h>
 #include <DDraw/DirectDrawSurface.h>
 #include <DDraw/LogUsedResourceFormat.h>
+#include <Gdi/GuiThread.h>
 #include <Gdi/VirtualScreen.h>
+#include <Overlay/StatsWindow.h>
 
 namespace
 {
+	const std::size_t MAX_CONVOLUTION_WEIGHT_TEXTURES = 4;
+
 	D3dDdi::SurfaceRepository* g_primaryRepository = nullptr;
 	bool g_enableSurfaceCheck = true;
 
+	void addSurfaceAllocation()
+	{
+		auto statsWindow = Gdi::GuiThread::getStatsWindow();
+		if (statsWindow && statsWindow->m_surfaceAllocations.isEnabled())
+		{
+			statsWindow->m_surfaceAllocations.add(StatsQueue::getTickCount());
+		}
+	}
+
 	void initDitherTexture(BYTE* tex, DWORD pitch, DWORD x, DWORD y, DWORD size, DWORD mul, DWORD value)
 	{
 		if (1 == size)
@@ -137,6 +150,7 @@ namespace D3dDdi
 			LOG_ONCE("ERROR: Failed to create repository surface: " << Compat::hex(result) << " " << desc);
 			return nullptr;
 		}
+		addSurfaceAllocation();
 		return surface;
 	}
 
@@ -145,6 +159,23 @@ namespace D3dDdi
 		g_enableSurfaceCheck = enable;
 	}
 
+	Resource* SurfaceRepository::getConvolutionWeightTexture(UINT64 key, DWORD width, DWORD height,
+		std::function<void(const DDSURFACEDESC2&)> initFunc)
+	{
+		if (m_convolutionWeightTextures.size() >= MAX_CONVOLUTION_WEIGHT_TEXTURES &&
+			m_convolutionWeightTextures.find(key) == m_convolutionWeightTextures.end())
+		{
+			for (auto& texture : m_convolutionWeightTextures)
+			{
+				release(texture.second);
+			}
+			m_convolutionWeightTextures.clear();
+		}
+
+		return getInitializedResource(m_convolutionWeightTextures[key], width, height, D3DDDIFMT_A8R8G8B8,
+			DDSCAPS_TEXTURE | DDSCAPS_VIDEOMEMORY, initFunc);
+	}
+
 	SurfaceRepository::Cursor SurfaceRepository::getCursor(HCURSOR cursor)
 	{
 		if (m_cursorMaskTexture.resource && isLost(m_cursorMaskTexture) ||
@@ -53,6 +53,8 @@ namespace D3dDdi
 		SurfaceRepository(CompatPtr<IDirectDraw7> dd);
 
 		void clearReleasedSurfaces();
+		Resource* getConvolutionWeightTexture(UINT64 key, DWORD width, DWORD height,
+			std::function<void(const DDSURFACEDESC2&)> initFunc);
 		Cursor getCursor(HCURSOR cursor);
 		CompatWeakPtr<IDirectDraw7> getDirectDraw() { return m_dd; }
 		Resource* getDitherTexture(DWORD size);
@@ -95,6 +97,7 @@ namespace D3dDdi
 		Surface m_cursorMaskTexture;
 		Surface m_cursorColorTexture;
 		Surface m_cursorTempTexture;
+		std::map<UINT64, Surface> m_convolutionWeightTextures;
 		Surface m_ditherTexture;
 		Surface m_gammaRampTexture;
 		Surface m_logicalXorTexture;
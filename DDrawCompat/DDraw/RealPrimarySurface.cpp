@@ -1,4 +1,10 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdlib>
 #include <memory>
+#include <optional>
+#include <vector>
 
 #include <Windows.h>
 #include <VersionHelpers.h>
@@ -9,10 +15,12 @@
 #include <Common/ScopedThreadPriority.h>
 #include <Common/Time.h>
 #include <Config/AtomicSetting.h>
+#include <Config/Settings/AsyncPresent.h>
 #include <Config/Settings/FpsLimiter.h>
 #include <Config/Settings/FullscreenMode.h>
 #include <Config/Settings/GdiInterops.h>
 #include <Config/Settings/PresentDelay.h>
+#include <Config/Settings/SkipDuplicateFrames.h>
 #include <Config/Settings/VSync.h>
 #include <D3dDdi/Device.h>
 #include <D3dDdi/KernelModeThunks.h>
@@ -30,6 +38,7 @@
 #include <Gdi/Cursor.h>
 #include <Gdi/DcFunctions.h>
 #include <Gdi/GuiThread.h>
+#include <Gdi/Palette.h>
 #include <Gdi/VirtualScreen.h>
 #include <Gdi/Window.h>
 #include <Input/Input.h>
@@ -41,6 +50,25 @@
 
 namespace
 {
+	struct FlipSlot
+	{
+		DDraw::Surface* surface;
+		UINT flipInterval;
+	};
+
+	struct FrameKey
+	{
+		HANDLE resource;
+		UINT subResourceIndex;
+		UINT writeCount;
+		UINT64 hash;
+		IDirectDrawSurface7* frontBuffer;
+		HWND presentationWindow;
+		std::vector<PALETTEENTRY> palette;
+
+		bool operator==(const FrameKey& other) const = default;
+	};
+
 	void onRelease();
 	void updatePresentationParams();
 
@@ -60,6 +88,19 @@ namespace
 	bool g_isOverlayUpdatePending = false;
 	bool g_isUpdatePending = false;
 	bool g_isUpdateReady = false;
+	bool g_isUntrackedUpdatePending = false;
+	HANDLE g_updateEvent = nullptr;
+	FrameKey g_lastFrameKey = {};
+	Compat::CriticalSection g_frameResourceCs;
+	std::vector<std::pair<HANDLE, D3dDdi::Resource*>> g_frameResources;
+
+	const UINT FLIP_SLOT_INDEX_MASK = 3;
+	const UINT FLIP_SLOT_PUBLISHED = 4;
+	std::array<FlipSlot, 3> g_flipSlots = {};
+	std::atomic<UINT> g_flipSlotShared = 1;
+	UINT g_flipSlotWrite = 0;
+	UINT g_flipSlotRead = 2;
+	HANDLE g_presentEvent = nullptr;
 	long long g_qpcUpdateStart = 0;
 
 	HWND g_deviceWindow = nullptr;
@@ -70,6 +111,56 @@ namespace
 
 	Config::AtomicSettingStore g_fpsLimiter(Config::fpsLimiter);
 
+	std::array<long long, 256> g_pacingJitter = {};
+	std::size_t g_pacingJitterCount = 0;
+	std::size_t g_pacingJitterIndex = 0;
+	long long g_qpcPrevPacingRelease = 0;
+
+	long long g_qpcFrameStart = 0;
+	long long g_qpcPresentedFrameStart = 0;
+	long long g_qpcFrameTime = 0;
+	long long g_qpcPresentCost = 0;
+	long long g_qpcAdaptiveTarget = 0;
+
+	void addInputLatency(long long qpcLatency)
+	{
+		auto statsWindow = Gdi::GuiThread::getStatsWindow();
+		if (statsWindow && statsWindow->m_inputLatency.isEnabled())
+		{
+			statsWindow->m_inputLatency.addSample(StatsQueue::getTickCount(), qpcLatency * 1'000'000 / Time::g_qpcFrequency);
+		}
+	}
+
+	void addPacingJitter(long long qpcRelease, long long qpcTargetFrameTime)
+	{
+		const long long qpcFrameTime = qpcRelease - g_qpcPrevPacingRelease;
+		g_qpcPrevPacingRelease = qpcRelease;
+
+		auto statsWindow = Gdi::GuiThread::getStatsWindow();
+		if (!statsWindow || !statsWindow->m_pacingJitterP50.isEnabled() && !statsWindow->m_pacingJitterP99.isEnabled() ||
+			qpcFrameTime > Time::g_qpcFrequency)
+		{
+			return;
+		}
+
+		const long long qpcJitter = std::abs(qpcFrameTime - qpcTargetFrameTime);
+		g_pacingJitter[g_pacingJitterIndex] = qpcJitter * 1'000'000 / Time::g_qpcFrequency;
+		g_pacingJitterIndex = (g_pacingJitterIndex + 1) % g_pacingJitter.size();
+		g_pacingJitterCount = std::min(g_pacingJitterCount + 1, g_pacingJitter.size());
+
+		auto jitter(g_pacingJitter);
+		const auto begin = jitter.begin();
+		const auto end = begin + g_pacingJitterCount;
+		const auto p50 = begin + g_pacingJitterCount / 2;
+		const auto p99 = begin + g_pacingJitterCount * 99 / 100;
+		std::nth_element(begin, p99, end);
+		std::nth_element(begin, p50, p99);
+
+		const auto tickCount = StatsQueue::getTickCount();
+		statsWindow->m_pacingJitterP50.addSample(tickCount, *p50);
+		statsWindow->m_pacingJitterP99.addSample(tickCount, *p99);
+	}
+
 	CompatPtr<IDirectDrawSurface7> getBackBuffer()
 	{
 		DDSCAPS2 caps = {};
@@ -124,12 +215,115 @@ namespace
 		return 1;
 	}
 
+	D3dDdi::Resource* findFrameResource(HANDLE resource)
+	{
+		auto it = std::find_if(g_frameResources.begin(), g_frameResources.end(),
+			[&](const auto& frameResource) { return resource == frameResource.first; });
+		return it != g_frameResources.end() ? it->second : nullptr;
+	}
+
+	bool isDuplicateFrame(D3dDdi::Resource& resource, CompatWeakPtr<IDirectDrawSurface7> src, bool isUntrackedUpdate,
+		UINT mode)
+	{
+		FrameKey key = {};
+		key.resource = resource;
+		key.subResourceIndex = DDraw::DirectDrawSurface::getSubResourceIndex(*src);
+		key.frontBuffer = g_frontBuffer.get();
+		key.presentationWindow = g_presentationWindow;
+
+		std::optional<UINT64> hash;
+		if (Config::Settings::SkipDuplicateFrames::HASH == mode)
+		{
+			hash = resource.getSysMemHash(key.subResourceIndex, Config::skipDuplicateFrames.getParam());
+		}
+		if (hash)
+		{
+			key.hash = *hash;
+		}
+		else
+		{
+			key.writeCount = resource.getWriteCount(key.subResourceIndex);
+		}
+
+		if (D3DDDIFMT_P8 == resource.getOrigDesc().Format)
+		{
+			key.palette = Gdi::Palette::getHardwarePalette();
+		}
+
+		const bool isDuplicate = !isUntrackedUpdate && key == g_lastFrameKey;
+		g_lastFrameKey = std::move(key);
+		return isDuplicate;
+	}
+
+	bool isDuplicateFrame(CompatWeakPtr<IDirectDrawSurface7> src, bool isUntrackedUpdate)
+	{
+		const auto mode = Config::skipDuplicateFrames.get();
+		if (Config::Settings::SkipDuplicateFrames::OFF == mode || !src)
+		{
+			g_lastFrameKey = {};
+			return false;
+		}
+
+		const HANDLE resourceHandle = DDraw::DirectDrawSurface::getDriverResourceHandle(*src);
+		if (Config::Settings::SkipDuplicateFrames::HASH != mode)
+		{
+			Compat::ScopedCriticalSection lock(g_frameResourceCs);
+			auto resource = findFrameResource(resourceHandle);
+			if (resource)
+			{
+				return isDuplicateFrame(*resource, src, isUntrackedUpdate, mode);
+			}
+		}
+
+		D3dDdi::ScopedCriticalSection ddiLock;
+		Compat::ScopedCriticalSection lock(g_frameResourceCs);
+		auto resource = findFrameResource(resourceHandle);
+		if (!resource)
+		{
+			resource = D3dDdi::Device::findResource(resourceHandle);
+			if (!resource)
+			{
+				g_lastFrameKey = {};
+				return false;
+			}
+			g_frameResources.emplace_back(resourceHandle, resource);
+		}
+		return isDuplicateFrame(*resource, src, isUntrackedUpdate, mode);
+	}
+
+	bool isFlipChainSurface(DDraw::Surface* surface)
+	{
+		auto primary(DDraw::PrimarySurface::getPrimary());
+		if (!primary)
+		{
+			return false;
+		}
+
+		DDSCAPS2 caps = {};
+		caps.dwCaps = DDSCAPS_FLIP;
+		auto current(CompatPtr<IDirectDrawSurface7>::from(primary.get()));
+		while (DDraw::Surface::getSurface(*current) != surface)
+		{
+			CompatPtr<IDirectDrawSurface7> next;
+			if (FAILED(current->GetAttachedSurface(current, &caps, &next.getRef())) || next == primary)
+			{
+				return false;
+			}
+			current.swap(next);
+		}
+		return true;
+	}
+
 	void onRelease()
 	{
 		LOG_FUNC("RealPrimarySurface::onRelease");
 
 		g_frontBuffer = nullptr;
 		g_lastFlipSurface = nullptr;
+		{
+			Compat::ScopedCriticalSection lock(g_frameResourceCs);
+			g_frameResources.clear();
+		}
 		g_windowedBackBuffer.release();
 		g_isFullscreen = false;
 		g_tagSurface = nullptr;
@@ -338,6 +532,58 @@ namespace
 		}
 	}
 
+	void presentFlip(DDraw::Surface* flipSurface, UINT flipInterval)
+	{
+		for (UINT i = flipInterval; i > 1; --i)
+		{
+			{
+				Compat::ScopedCriticalSection lock(g_presentCs);
+				g_isUpdatePending = true;
+				g_isUpdateReady = true;
+			}
+			{
+				DDraw::ScopedThreadLock lock;
+				DDraw::RealPrimarySurface::flush();
+			}
+			D3dDdi::KernelModeThunks::waitForPresentEnd();
+		}
+
+		D3dDdi::KernelModeThunks::setFlipEndVsyncCount();
+
+		{
+			DDraw::ScopedThreadLock lock;
+			{
+				Compat::ScopedCriticalSection presentLock(g_presentCs);
+				DDraw::RealPrimarySurface::scheduleUpdate(false, true);
+				g_lastFlipSurface = flipSurface && isFlipChainSurface(flipSurface) ? flipSurface : nullptr;
+			}
+
+			if (!Config::presentDelay.get())
+			{
+				DDraw::RealPrimarySurface::flush();
+			}
+		}
+
+		if (Config::Settings::VSync::WAIT == Config::vSync.get())
+		{
+			D3dDdi::KernelModeThunks::waitForFlipEnd();
+		}
+	}
+
+	unsigned WINAPI presentThreadProc(LPVOID /*lpParameter*/)
+	{
+		while (true)
+		{
+			WaitForSingleObject(g_presentEvent, INFINITE);
+			while (g_flipSlotShared & FLIP_SLOT_PUBLISHED)
+			{
+				g_flipSlotRead = g_flipSlotShared.exchange(g_flipSlotRead) & FLIP_SLOT_INDEX_MASK;
+				const auto& slot = g_flipSlots[g_flipSlotRead];
+				presentFlip(slot.surface, slot.flipInterval);
+			}
+		}
+	}
+
 	void setFullscreenPresentationMode(const Win32::DisplayMode::MonitorInfo& mi)
 	{
 		static Win32::DisplayMode::MonitorInfo prevMi = {};
@@ -353,19 +599,50 @@ namespace
 		Gdi::Window::setFullscreenMode(0 != mi.cbSize);
 	}
 
+	void updateEstimate(long long& qpcEstimate, long long qpcSample)
+	{
+		qpcSample = std::min(std::max(qpcSample, 0LL), Time::g_qpcFrequency / 10);
+		if (qpcSample > qpcEstimate)
+		{
+			qpcEstimate += (qpcSample - qpcEstimate) / 4;
+		}
+		else
+		{
+			qpcEstimate -= (qpcEstimate - qpcSample) / 32;
+		}
+	}
+
 	void updateNow(CompatWeakPtr<IDirectDrawSurface7> src, bool isOverlayOnly)
 	{
 		updatePresentationParams();
 
+		long long qpcFrameStart = 0;
 		{
 			Compat::ScopedCriticalSection lock(g_presentCs);
 			g_isOverlayUpdatePending = false;
 			g_isUpdatePending = false;
 			g_isUpdateReady = false;
+			g_isUntrackedUpdatePending = false;
+			if (!isOverlayOnly)
+			{
+				qpcFrameStart = g_qpcPresentedFrameStart;
+				g_qpcPresentedFrameStart = 0;
+			}
 		}
 
+		const auto qpcPresentStart = Time::queryPerformanceCounter();
 		present(src, isOverlayOnly);
 		D3dDdi::KernelModeThunks::setPresentEndVsyncCount();
+
+		if (!isOverlayOnly)
+		{
+			const auto qpcPresentEnd = Time::queryPerformanceCounter();
+			updateEstimate(g_qpcPresentCost, qpcPresentEnd - qpcPresentStart);
+			if (0 != qpcFrameStart)
+			{
+				addInputLatency(qpcPresentEnd - qpcFrameStart);
+			}
+		}
 	}
 
 	void updatePresentationParams()
@@ -455,7 +732,7 @@ namespace
 		{
 			if (msUntilUpdateReady > 0)
 			{
-				Sleep(1);
+				WaitForSingleObject(g_updateEvent, 1);
 			}
 			else
 			{
@@ -521,45 +798,38 @@ namespace DDraw
 		return DD_OK;
 	}
 
-	void RealPrimarySurface::flip(CompatPtr<IDirectDrawSurface7> surfaceTargetOverride, DWORD flags)
+	void RealPrimarySurface::endFrame()
 	{
-		const DWORD flipInterval = getFlipInterval(flags);
-		for (DWORD i = flipInterval; i > 1; --i)
+		if (0 == g_qpcFrameStart)
 		{
-			{
-				Compat::ScopedCriticalSection lock(g_presentCs);
-				g_isUpdatePending = true;
-				g_isUpdateReady = true;
-			}
-			flush();
-			D3dDdi::KernelModeThunks::waitForPresentEnd();
+			return;
 		}
 
-		D3dDdi::KernelModeThunks::setFlipEndVsyncCount();
+		updateEstimate(g_qpcFrameTime, Time::queryPerformanceCounter() - g_qpcFrameStart);
+		Compat::ScopedCriticalSection lock(g_presentCs);
+		g_qpcPresentedFrameStart = g_qpcFrameStart;
+		g_qpcFrameStart = 0;
+	}
 
+	void RealPrimarySurface::flip(CompatPtr<IDirectDrawSurface7> surfaceTargetOverride, DWORD flags)
+	{
+		const UINT flipInterval = getFlipInterval(flags);
+		Surface* flipSurface = nullptr;
+		if (0 != flipInterval)
 		{
-			Compat::ScopedCriticalSection lock(g_presentCs);
-			scheduleUpdate();
-			if (0 != flipInterval)
-			{
-				g_lastFlipSurface = Surface::getSurface(
-					surfaceTargetOverride ? *surfaceTargetOverride : *PrimarySurface::getLastSurface());
-			}
-			else
-			{
-				g_lastFlipSurface = nullptr;
-			}
+			flipSurface = Surface::getSurface(
+				surfaceTargetOverride ? *surfaceTargetOverride : *PrimarySurface::getLastSurface());
 		}
 
-		if (Config::Settings::VSync::WAIT == Config::vSync.get())
+		if (Config::asyncPresent.get())
 		{
-			scheduleUpdate(true);
-			D3dDdi::KernelModeThunks::waitForFlipEnd();
-		}
-		else if (!Config::presentDelay.get())
-		{
-			scheduleUpdate(true);
+			g_flipSlots[g_flipSlotWrite] = { flipSurface, flipInterval };
+			g_flipSlotWrite = g_flipSlotShared.exchange(g_flipSlotWrite | FLIP_SLOT_PUBLISHED) & FLIP_SLOT_INDEX_MASK;
+			SetEvent(g_presentEvent);
+			return;
 		}
+
+		presentFlip(flipSurface, flipInterval);
 	}
 
 	int RealPrimarySurface::flush()
@@ -594,9 +864,11 @@ namespace DDraw
 		}
 
 		bool isOverlayOnly = false;
+		bool isUntrackedUpdate = false;
 
 		{
 			Compat::ScopedCriticalSection lock(g_presentCs);
+			isUntrackedUpdate = g_isOverlayUpdatePending || g_isUntrackedUpdatePending;
 			if (!g_isUpdateReady)
 			{
 				if (g_isUpdatePending)
@@ -629,6 +901,24 @@ namespace DDraw
 			src = primary;
 		}
 
+		if (!isOverlayOnly && isDuplicateFrame(src, isUntrackedUpdate))
+		{
+			{
+				Compat::ScopedCriticalSection lock(g_presentCs);
+				g_isUpdatePending = false;
+				g_isUpdateReady = false;
+				g_qpcPresentedFrameStart = 0;
+			}
+			D3dDdi::KernelModeThunks::setPresentEndVsyncCount();
+
+			auto statsWindow = Gdi::GuiThread::getStatsWindow();
+			if (statsWindow)
+			{
+				statsWindow->m_presentSkips.add(StatsQueue::getTickCount());
+			}
+			return 1;
+		}
+
 		updateNow(src, isOverlayOnly);
 
 		RECT emptyRect = {};
@@ -677,7 +967,10 @@ namespace DDraw
 	{
 		g_isExclusiveFullscreen = Config::Settings::FullscreenMode::EXCLUSIVE == Config::fullscreenMode.get() ||
 			!IsWindows8OrGreater();
+		g_updateEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+		g_presentEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
 		Dll::createThread(&updateThreadProc, nullptr, THREAD_PRIORITY_TIME_CRITICAL);
+		Dll::createThread(&presentThreadProc, nullptr, THREAD_PRIORITY_TIME_CRITICAL);
 	}
 
 	bool RealPrimarySurface::isExclusiveFullscreen()
@@ -708,6 +1001,12 @@ namespace DDraw
 		return false;
 	}
 
+	void RealPrimarySurface::onDestroyResource(HANDLE resource)
+	{
+		Compat::ScopedCriticalSection lock(g_frameResourceCs);
+		std::erase_if(g_frameResources, [&](const auto& frameResource) { return resource == frameResource.first; });
+	}
+
 	void RealPrimarySurface::release()
 	{
 		DDraw::ScopedThreadLock lock;
@@ -745,12 +1044,16 @@ namespace DDraw
 		g_isOverlayUpdatePending = true;
 	}
 
-	void RealPrimarySurface::scheduleUpdate(bool allowFlush)
+	void RealPrimarySurface::scheduleUpdate(bool allowFlush, bool isWriteTracked)
 	{
 		const bool isPresentDelayEnabled = Config::presentDelay.get();
 
 		{
 			Compat::ScopedCriticalSection lock(g_presentCs);
+			if (!isWriteTracked)
+			{
+				g_isUntrackedUpdatePending = true;
+			}
 			if (!g_isUpdatePending)
 			{
 				g_qpcUpdateStart = Time::queryPerformanceCounter();
@@ -761,7 +1064,14 @@ namespace DDraw
 
 		if (allowFlush && !isPresentDelayEnabled)
 		{
-			flush();
+			if (Config::asyncPresent.get())
+			{
+				SetEvent(g_updateEvent);
+			}
+			else
+			{
+				flush();
+			}
 		}
 	}
 
@@ -801,9 +1111,18 @@ namespace DDraw
 		if (g_isUpdatePending)
 		{
 			g_isUpdateReady = true;
+			if (Config::asyncPresent.get())
+			{
+				SetEvent(g_updateEvent);
+			}
 		}
 	}
 
+	void RealPrimarySurface::startFrame()
+	{
+		g_qpcFrameStart = Time::queryPerformanceCounter();
+	}
+
 	void RealPrimarySurface::suppressLost(bool suppress)
 	{
 		g_suppressLost = suppress;
@@ -814,6 +1133,43 @@ namespace DDraw
 		g_fpsLimiter.update();
 	}
 
+	void RealPrimarySurface::waitForAdaptiveFrameStart(unsigned fpsLimit)
+	{
+		const auto qpcNow = Time::queryPerformanceCounter();
+		const auto qpcFrameCost = g_qpcFrameTime + g_qpcPresentCost + Time::g_qpcFrequency / 2000;
+		const auto qpcMinInterval = Time::g_qpcFrequency / fpsLimit;
+		const auto qpcVsyncInterval = D3dDdi::KernelModeThunks::getQpcVsyncInterval();
+
+		long long qpcTarget = 0;
+		if (0 != qpcVsyncInterval)
+		{
+			const auto qpcLastVsync = D3dDdi::KernelModeThunks::getQpcLastVsync();
+			const auto qpcEarliest = std::max(qpcNow + qpcFrameCost,
+				g_qpcAdaptiveTarget + qpcMinInterval - qpcVsyncInterval / 2);
+			const auto vsyncCount = (qpcEarliest - qpcLastVsync + qpcVsyncInterval - 1) / qpcVsyncInterval;
+			qpcTarget = qpcLastVsync + std::max(vsyncCount, 1LL) * qpcVsyncInterval;
+		}
+		else
+		{
+			qpcTarget = std::max(qpcNow + qpcFrameCost, g_qpcAdaptiveTarget + qpcMinInterval);
+		}
+		g_qpcAdaptiveTarget = qpcTarget;
+
+		const auto qpcWaitEnd = qpcTarget - qpcFrameCost;
+		if (qpcWaitEnd - qpcNow > 0)
+		{
+			Compat::ScopedThreadPriority prio(THREAD_PRIORITY_TIME_CRITICAL);
+			if (Config::asyncPresent.get())
+			{
+				Time::waitUntil(qpcWaitEnd);
+			}
+			else
+			{
+				Time::waitUntil(qpcWaitEnd, []() { flush(); });
+			}
+		}
+	}
+
 	void RealPrimarySurface::waitForFlip(CompatWeakPtr<IDirectDrawSurface7> surface)
 	{
 		auto primary(DDraw::PrimarySurface::getPrimary());
@@ -838,29 +1194,26 @@ namespace DDraw
 	void RealPrimarySurface::waitForFlipFpsLimit(unsigned fpsLimit, bool doFlush)
 	{
 		static long long g_qpcPrevWaitEnd = Time::queryPerformanceCounter() - Time::g_qpcFrequency;
+		const auto qpcTargetFrameTime = Time::g_qpcFrequency / fpsLimit;
 		auto qpcNow = Time::queryPerformanceCounter();
-		auto qpcWaitEnd = g_qpcPrevWaitEnd + Time::g_qpcFrequency / fpsLimit;
+		auto qpcWaitEnd = g_qpcPrevWaitEnd + qpcTargetFrameTime;
 		if (qpcNow - qpcWaitEnd >= 0)
 		{
 			g_qpcPrevWaitEnd = qpcNow;
+			addPacingJitter(qpcNow, qpcTargetFrameTime);
 			return;
 		}
 		g_qpcPrevWaitEnd = qpcWaitEnd;
 
 		Compat::ScopedThreadPriority prio(THREAD_PRIORITY_TIME_CRITICAL);
-		while (Time::qpcToMs(qpcWaitEnd - qpcNow) > 0)
+		if (doFlush && !Config::asyncPresent.get())
 		{
-			Time::waitForNextTick();
-			if (doFlush)
-			{
-				flush();
-			}
-			qpcNow = Time::queryPerformanceCounter();
+			Time::waitUntil(qpcWaitEnd, []() { flush(); });
 		}
-
-		while (qpcWaitEnd - qpcNow > 0)
+		else
 		{
-			qpcNow = Time::queryPerformanceCounter();
+			Time::waitUntil(qpcWaitEnd);
 		}
+		addPacingJitter(Time::queryPerformanceCounter(), qpcTargetFrameTime);
 	}
 }
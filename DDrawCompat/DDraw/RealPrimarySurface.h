@@ -14,6 +14,7 @@ namespace DDraw
 	{
 	public:
 		static HRESULT create(CompatRef<IDirectDraw> dd);
+		static void endFrame();
 		static void flip(CompatPtr<IDirectDrawSurface7> surfaceTargetOverride, DWORD flags);
 		static int flush();
 		static Config::AtomicSetting getFpsLimiter();
@@ -26,15 +27,18 @@ namespace DDraw
 		static bool isFullscreen();
 		static bool isLost();
 		static bool isProcessActive();
+		static void onDestroyResource(HANDLE resource);
 		static void release();
 		static HRESULT restore();
 		static void scheduleOverlayUpdate();
-		static void scheduleUpdate(bool allowFlush = false);
+		static void scheduleUpdate(bool allowFlush = false, bool isWriteTracked = false);
 		static HRESULT setGammaRamp(DDGAMMARAMP* rampData);
 		static void setPresentationWindowTopmost();
 		static void setUpdateReady();
+		static void startFrame();
 		static void suppressLost(bool suppress);
 		static void updateFpsLimiter();
+		static void waitForAdaptiveFrameStart(unsigned fpsLimit);
 		static void waitForFlip(CompatWeakPtr<IDirectDrawSurface7> surface);
 		static void waitForFlipFpsLimit(unsigned fpsLimit, bool doFlush = true);
 	};
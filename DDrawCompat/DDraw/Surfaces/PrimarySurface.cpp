@@ -364,7 +364,7 @@ namespace DDraw
 			ReleaseDC(g_deviceWindow, dc);
 		}
 
-		RealPrimarySurface::scheduleUpdate(true);
+		RealPrimarySurface::scheduleUpdate(true, true);
 	}
 
 	void PrimarySurface::waitForIdle()
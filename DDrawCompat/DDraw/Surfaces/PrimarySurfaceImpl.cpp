@@ -1,4 +1,5 @@
 #include <Common/CompatPtr.h>
+#include <Config/Settings/AsyncPresent.h>
 #include <Config/Settings/FpsLimiter.h>
 #include <Config/Settings/GdiInterops.h>
 #include <D3dDdi/KernelModeThunks.h>
@@ -144,8 +145,14 @@ namespace DDraw
 		}
 
 		RealPrimarySurface::flush();
+		const bool isFs = isFsBlt(lpDestRect);
+		if (isFs)
+		{
+			RealPrimarySurface::endFrame();
+		}
+
 		const auto fpsLimiter = RealPrimarySurface::getFpsLimiter();
-		if (Config::Settings::FpsLimiter::FLIPSTART == fpsLimiter.value && isFsBlt(lpDestRect))
+		if (Config::Settings::FpsLimiter::FLIPSTART == fpsLimiter.value && isFs)
 		{
 			RealPrimarySurface::waitForFlipFpsLimit(fpsLimiter.param);
 		}
@@ -188,12 +195,20 @@ namespace DDraw
 			{
 				statsWindow->m_blit.add();
 			}
-			RealPrimarySurface::scheduleUpdate(true);
+			RealPrimarySurface::scheduleUpdate(true, true);
 		}
 
-		if (Config::Settings::FpsLimiter::FLIPEND == fpsLimiter.value && isFsBlt(lpDestRect))
+		if (isFs)
 		{
-			RealPrimarySurface::waitForFlipFpsLimit(fpsLimiter.param);
+			if (Config::Settings::FpsLimiter::FLIPEND == fpsLimiter.value)
+			{
+				RealPrimarySurface::waitForFlipFpsLimit(fpsLimiter.param);
+			}
+			else if (Config::Settings::FpsLimiter::ADAPTIVE == fpsLimiter.value)
+			{
+				RealPrimarySurface::waitForAdaptiveFrameStart(fpsLimiter.param);
+			}
+			RealPrimarySurface::startFrame();
 		}
 		return result;
 	}
@@ -208,9 +223,14 @@ namespace DDraw
 		}
 
 		RealPrimarySurface::flush();
+		const bool isFs = isFsBltFast(dwX, dwY, lpDDSrcSurface, lpSrcRect);
+		if (isFs)
+		{
+			RealPrimarySurface::endFrame();
+		}
+
 		const auto fpsLimiter = RealPrimarySurface::getFpsLimiter();
-		if (Config::Settings::FpsLimiter::FLIPSTART == fpsLimiter.value
-			&& isFsBltFast(dwX, dwY, lpDDSrcSurface, lpSrcRect))
+		if (Config::Settings::FpsLimiter::FLIPSTART == fpsLimiter.value && isFs)
 		{
 			RealPrimarySurface::waitForFlipFpsLimit(fpsLimiter.param);
 		}
@@ -222,12 +242,19 @@ namespace DDraw
 			{
 				statsWindow->m_blit.add();
 			}
-			RealPrimarySurface::scheduleUpdate(true);
+			RealPrimarySurface::scheduleUpdate(true, true);
 		}
-		if (Config::Settings::FpsLimiter::FLIPEND == fpsLimiter.value
-			&& isFsBltFast(dwX, dwY, lpDDSrcSurface, lpSrcRect))
+		if (isFs)
 		{
-			RealPrimarySurface::waitForFlipFpsLimit(fpsLimiter.param);
+			if (Config::Settings::FpsLimiter::FLIPEND == fpsLimiter.value)
+			{
+				RealPrimarySurface::waitForFlipFpsLimit(fpsLimiter.param);
+			}
+			else if (Config::Settings::FpsLimiter::ADAPTIVE == fpsLimiter.value)
+			{
+				RealPrimarySurface::waitForAdaptiveFrameStart(fpsLimiter.param);
+			}
+			RealPrimarySurface::startFrame();
 		}
 		return result;
 	}
@@ -240,8 +267,12 @@ namespace DDraw
 			return DDERR_NOEXCLUSIVEMODE;
 		}
 
+		RealPrimarySurface::endFrame();
 		RealPrimarySurface::setUpdateReady();
-		RealPrimarySurface::flush();
+		if (!Config::asyncPresent.get())
+		{
+			RealPrimarySurface::flush();
+		}
 		RealPrimarySurface::waitForFlip(this->m_data->getDDS());
 
 		const auto fpsLimiter = RealPrimarySurface::getFpsLimiter();
@@ -292,6 +323,11 @@ namespace DDraw
 		{
 			RealPrimarySurface::waitForFlipFpsLimit(fpsLimiter.param);
 		}
+		else if (Config::Settings::FpsLimiter::ADAPTIVE == fpsLimiter.value)
+		{
+			RealPrimarySurface::waitForAdaptiveFrameStart(fpsLimiter.param);
+		}
+		RealPrimarySurface::startFrame();
 		return DD_OK;
 	}
 
@@ -335,7 +371,7 @@ namespace DDraw
 			{
 				statsWindow->m_lock.add();
 			}
-			RealPrimarySurface::scheduleUpdate();
+			RealPrimarySurface::scheduleUpdate(false, true);
 		}
 		return result;
 	}
@@ -382,7 +418,7 @@ namespace DDraw
 			{
 				statsWindow->m_lock.add();
 			}
-			RealPrimarySurface::scheduleUpdate();
+			RealPrimarySurface::scheduleUpdate(false, true);
 		}
 		return result;
 	}
@@ -5,6 +5,7 @@
 #include <Uxtheme.h>
 
 #include <Common/Hook.h>
+#include <Common/JobPool.h>
 #include <Common/Log.h>
 #include <Common/Path.h>
 #include <Common/ScopedCriticalSection.h>
@@ -412,6 +413,7 @@ BOOL WINAPI DllMain(HINSTANCE hinstDLL, DWORD fdwReason, LPVOID lpvReserved)
 	}
 	else if (fdwReason == DLL_PROCESS_DETACH)
 	{
+		JobPool::shutdown();
 		CALL_ORIG_FUNC(ClipCursor)(nullptr);
 		LOG_INFO << "DDrawCompat detached successfully";
 	}
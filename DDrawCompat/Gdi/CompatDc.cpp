@@ -45,6 +45,12 @@ namespace Gdi
 		{
 			D3dDdi::ScopedCriticalSection lock;
 			auto gdiResource = D3dDdi::Device::getGdiResource();
+			if (!m_isReadOnly && gdiResource)
+			{
+				D3dDdi::SurfaceRepository::enableSurfaceCheck(false);
+				gdiResource->prepareForCpuWrite(0);
+				D3dDdi::SurfaceRepository::enableSurfaceCheck(true);
+			}
 			if (!m_isReadOnly && (!gdiResource || DDraw::PrimarySurface::getFrontResource() == *gdiResource))
 			{
 				DDraw::RealPrimarySurface::scheduleUpdate();
@@ -38,7 +38,6 @@ namespace
 	Overlay::ConfigWindow* g_configWindow = nullptr;
 	Overlay::StatsWindow* g_statsWindow = nullptr;
 	HWND g_messageWindow = nullptr;
-	IWICImagingFactory* g_wicImagingFactory = nullptr;
 	bool g_isReady = false;
 
 	unsigned WINAPI screenshotThreadProc(LPVOID /*lpParameter*/);
@@ -250,13 +249,16 @@ namespace
 
 	HBITMAP loadImage(const std::filesystem::path& path)
 	{
-		if (!g_wicImagingFactory)
+		CompatPtr<IWICImagingFactory> wicImagingFactory;
+		CoCreateInstance(CLSID_WICImagingFactory, nullptr, CLSCTX_INPROC_SERVER, IID_IWICImagingFactory,
+			reinterpret_cast<void**>(&wicImagingFactory.getRef()));
+		if (!wicImagingFactory)
 		{
 			return nullptr;
 		}
 
 		CompatPtr<IWICBitmapDecoder> decoder;
-		g_wicImagingFactory->lpVtbl->CreateDecoderFromFilename(g_wicImagingFactory, path.c_str(), nullptr,
+		wicImagingFactory.get()->lpVtbl->CreateDecoderFromFilename(wicImagingFactory, path.c_str(), nullptr,
 			GENERIC_READ, WICDecodeMetadataCacheOnDemand, &decoder.getRef());
 		if (!decoder)
 		{
@@ -357,9 +359,6 @@ namespace
 			taskbarList = nullptr;
 		}
 
-		CoCreateInstance(CLSID_WICImagingFactory, nullptr, CLSCTX_INPROC_SERVER, IID_IWICImagingFactory,
-			reinterpret_cast<void**>(&g_wicImagingFactory));
-
 		WNDCLASS wc = {};
 		wc.lpfnWndProc = &messageWindowProc;
 		wc.hInstance = Dll::g_currentModule;
@@ -388,7 +387,6 @@ namespace
 
 		{
 			D3dDdi::ScopedCriticalSection lock;
-			D3dDdi::MetaShader::loadBitmaps();
 			g_isReady = true;
 			CALL_ORIG_FUNC(EnumWindows)(initTopLevelWindow, 0);
 		}
@@ -559,12 +557,7 @@ namespace Gdi
 
 		HBITMAP wicLoadImage(const std::filesystem::path& path)
 		{
-			HBITMAP bitmap = nullptr;
-			execute([&]()
-				{
-					bitmap = loadImage(path);
-				});
-			return bitmap;
+			return loadImage(path);
 		}
 	}
 }
@@ -6,6 +6,7 @@
 #include <Common/Log.h>
 #include <Config/Settings/AlternatePixelCenter.h>
 #include <Config/Settings/Antialiasing.h>
+#include <Config/Settings/AsyncPresent.h>
 #include <Config/Settings/BltFilter.h>
 #include <Config/Settings/ColorKeyMethod.h>
 #include <Config/Settings/ConfigHotKey.h>
@@ -16,12 +17,15 @@
 #include <Config/Settings/DisplayFilter.h>
 #include <Config/Settings/FontAntialiasing.h>
 #include <Config/Settings/FpsLimiter.h>
+#include <Config/Settings/MaxFrameLatency.h>
 #include <Config/Settings/MousePollingRate.h>
 #include <Config/Settings/MouseSensitivity.h>
 #include <Config/Settings/PresentDelay.h>
 #include <Config/Settings/RenderColorDepth.h>
 #include <Config/Settings/ResolutionScale.h>
 #include <Config/Settings/ResolutionScaleFilter.h>
+#include <Config/Settings/ShaderOptimizer.h>
+#include <Config/Settings/SkipDuplicateFrames.h>
 #include <Config/Settings/SpriteAltPixelCenter.h>
 #include <Config/Settings/SpriteDetection.h>
 #include <Config/Settings/SpriteFilter.h>
@@ -60,6 +64,7 @@ namespace
 	std::vector<SettingRow> g_settingRows = {
 		{ &Config::alternatePixelCenter },
 		{ &Config::antialiasing, &D3dDdi::Device::updateAllConfig },
+		{ &Config::asyncPresent },
 		{ &Config::bltFilter },
 		{ &Config::colorKeyMethod, &D3dDdi::Device::updateAllConfig },
 		{ &Config::configTransparency, []() { Gdi::GuiThread::getConfigWindow()->setAlpha(Config::configTransparency.get()); }},
@@ -68,12 +73,15 @@ namespace
 		{ &Config::displayFilter, []() { Gdi::GuiThread::getConfigWindow()->updateDisplayFilter(); }},
 		{ &Config::fontAntialiasing },
 		{ &Config::fpsLimiter, &DDraw::RealPrimarySurface::updateFpsLimiter },
+		{ &Config::maxFrameLatency },
 		{ &Config::mousePollingRate, &Input::updateMouseSensitivity },
 		{ &Config::mouseSensitivity, &Input::updateMouseSensitivitySetting },
 		{ &Config::presentDelay },
 		{ &Config::renderColorDepth, &D3dDdi::Device::updateAllConfig },
 		{ &Config::resolutionScale, &D3dDdi::Device::updateAllConfig },
 		{ &Config::resolutionScaleFilter },
+		{ &Config::shaderOptimizer },
+		{ &Config::skipDuplicateFrames },
 		{ &Config::spriteAltPixelCenter },
 		{ &Config::spriteDetection },
 		{ &Config::spriteFilter, &D3dDdi::Device::updateAllConfig },
@@ -7,13 +7,13 @@ class StatsEventCount : public StatsQueue
 public:
 	StatsEventCount();
 
-	void add(TickCount tickCount)
+	void add(TickCount tickCount, SampleCount count = 1)
 	{
 		if (isEnabled())
 		{
 			Compat::ScopedCriticalSection lock(m_cs);
 			setTickCount(tickCount);
-			m_sampleCount++;
+			m_sampleCount += count;
 		}
 	}
 
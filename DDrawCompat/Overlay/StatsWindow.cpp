@@ -101,6 +101,7 @@ namespace Overlay
 		m_statsRows.push_back({ "Present count", UpdateStats(m_present.m_count), &m_present.m_count });
 		m_statsRows.push_back({ "Present rate", UpdateStats(m_present.m_rate), &m_present.m_rate });
 		m_statsRows.push_back({ "Present time", UpdateStats(m_present.m_time), &m_present.m_time });
+		m_statsRows.push_back({ "Present skips", UpdateStats(m_presentSkips), &m_presentSkips });
 		m_statsRows.push_back({ "Flip count", UpdateStats(m_flip.m_count), &m_flip.m_count });
 		m_statsRows.push_back({ "Flip rate", UpdateStats(m_flip.m_rate), &m_flip.m_rate });
 		m_statsRows.push_back({ "Flip time", UpdateStats(m_flip.m_time), &m_flip.m_time });
@@ -113,7 +114,17 @@ namespace Overlay
 		m_statsRows.push_back({ "VBlank count", UpdateStats(m_vblank.m_count), &m_vblank.m_count });
 		m_statsRows.push_back({ "VBlank rate", UpdateStats(m_vblank.m_rate), &m_vblank.m_rate });
 		m_statsRows.push_back({ "VBlank time", UpdateStats(m_vblank.m_time), &m_vblank.m_time });
+		m_statsRows.push_back({ "VBlank misses", UpdateStats(m_vblankMisses), &m_vblankMisses });
 		m_statsRows.push_back({ "DDI usage", UpdateStats(m_ddiUsage), &m_ddiUsage });
+		m_statsRows.push_back({ "Const uploads", UpdateStats(m_shaderConstUploads), &m_shaderConstUploads });
+		m_statsRows.push_back({ "CGP skipped passes", UpdateStats(m_cgpSkippedPasses), &m_cgpSkippedPasses });
+		m_statsRows.push_back({ "Surface allocs", UpdateStats(m_surfaceAllocations), &m_surfaceAllocations });
+		m_statsRows.push_back({ "Draws per blit", UpdateStats(m_drawsPerBlit), &m_drawsPerBlit });
+		m_statsRows.push_back({ "Jitter p50 (us)", UpdateStats(m_pacingJitterP50), &m_pacingJitterP50 });
+		m_statsRows.push_back({ "Jitter p99 (us)", UpdateStats(m_pacingJitterP99), &m_pacingJitterP99 });
+		m_statsRows.push_back({ "Input latency (us)", UpdateStats(m_inputLatency), &m_inputLatency });
+		m_statsRows.push_back({ "Frame queue depth", UpdateStats(m_frameQueueDepth), &m_frameQueueDepth });
+		m_statsRows.push_back({ "Frame block (us)", UpdateStats(m_frameBlockTime), &m_frameBlockTime });
 		m_statsRows.push_back({ "GDI objects", UpdateStats(m_gdiObjects), &m_gdiObjects });
 		m_statsRows.push_back({ "", &getDebugInfo, nullptr, WS_VISIBLE | WS_GROUP });
 
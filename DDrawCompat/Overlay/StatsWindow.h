@@ -25,11 +25,22 @@ namespace Overlay
 
 		uint32_t m_presentCount;
 		StatsEventGroup m_present;
+		StatsEventCount m_presentSkips;
 		StatsEventGroup m_flip;
 		StatsEventGroup m_blit;
 		StatsEventGroup m_lock;
 		StatsEventGroup m_vblank;
+		StatsEventCount m_vblankMisses;
 		StatsTimer m_ddiUsage;
+		StatsEventCount m_shaderConstUploads;
+		StatsEventCount m_cgpSkippedPasses;
+		StatsEventCount m_surfaceAllocations;
+		StatsQueue m_drawsPerBlit;
+		StatsQueue m_pacingJitterP50;
+		StatsQueue m_pacingJitterP99;
+		StatsQueue m_inputLatency;
+		StatsQueue m_frameQueueDepth;
+		StatsQueue m_frameBlockTime;
 		StatsQueue m_gdiObjects;
 
 	private:
@@ -28,7 +28,12 @@ static const float4 g_maxRgbRcp           = c[7];
 static const float  g_ditherScale         = c[8].x;
 static const float  g_ditherOffset        = c[8].y;
 
-#ifdef NONNEGATIVE
+#ifdef WEIGHT_TABLE
+sampler2D s_weights : register(s3);
+
+static const float2 g_weightTexelSize     = g_extraParams[0].xy;
+static const float  g_weightPhaseCount    = g_extraParams[0].z;
+#elif defined(NONNEGATIVE)
 float4 kernel(float4 x);
 #else
 float kernel(float x);
@@ -66,9 +71,26 @@ void addSamples(inout float4 color, float4 textureCoord, float4 weights)
 #endif
 }
 
+#ifdef WEIGHT_TABLE
+float decodeWeight(float2 hiLo)
+{
+	return dot(round(hiLo * 255), float2(256, 1)) / 65535 * 2 - 0.5f;
+}
+
+float2 decodeWeights(float4 texel)
+{
+	return float2(decodeWeight(texel.rg), decodeWeight(texel.ba));
+}
+#endif
+
 float4 getWeights(float4 kernelCoord)
 {
-#ifdef NONNEGATIVE
+#ifdef WEIGHT_TABLE
+	const float2 weights0 = decodeWeights(tex2Dlod(s_weights, float4(kernelCoord.xy, 0, 0)));
+	const float2 weights1 = decodeWeights(tex2Dlod(s_weights, float4(kernelCoord.xz, 0, 0)));
+	const float2 weights = lerp(weights0, weights1, kernelCoord.w);
+	return float4(weights.x, 0, weights.y, 0);
+#elif defined(NONNEGATIVE)
 	return kernel(kernelCoord);
 #else
 	return float4(kernel(kernelCoord.x), kernel(kernelCoord.y), kernel(kernelCoord.z), kernel(kernelCoord.w));
@@ -90,8 +112,17 @@ float4 main(float2 texCoord : TEXCOORD0, float2 ditherCoord : TEXCOORD2) : COLOR
 	const float2 sampleCoordInt = sampleCoord - sampleCoordFrac;
 
 	float4 textureCoord = mad(sampleCoordInt.xyxy, g_textureCoordStep.xyxy, g_textureCoordOffset);
+#ifdef WEIGHT_TABLE
+	const float phase = (g_textureCoordStepPri.x > 0 ? sampleCoordFrac.x : sampleCoordFrac.y) * g_weightPhaseCount;
+	const float phaseInt = floor(phase);
+	float4 kernelCoord = float4(0.5f, phaseInt + 0.5f, phaseInt + 1.5f, 0) * g_weightTexelSize.xyyx;
+	kernelCoord.w = phase - phaseInt;
+	const float4 kernelCoordStepPri = float4(g_weightTexelSize.x, 0, 0, 0);
+#else
 	float4 kernelCoord = mad(-sampleCoordFrac.xyxy, g_kernelCoordStep.xyxy, g_kernelCoordOffset);
 	kernelCoord = g_textureCoordStepPri.x > 0 ? kernelCoord : kernelCoord.yxwz;
+	const float4 kernelCoordStepPri = g_kernelCoordStepPri.xyxy;
+#endif
 
 	const float4 weights = getWeights(kernelCoord);
 
@@ -113,7 +144,7 @@ float4 main(float2 texCoord : TEXCOORD0, float2 ditherCoord : TEXCOORD2) : COLOR
 	for (int i = 0; i < g_sampleCountHalfMinusOne; ++i)
 	{
 		textureCoord += g_textureCoordStepPri.xyxy;
-		kernelCoord += g_kernelCoordStepPri.xyxy;
+		kernelCoord += kernelCoordStepPri;
 		addSamples(color, textureCoord, getWeights(kernelCoord));
 	}
 
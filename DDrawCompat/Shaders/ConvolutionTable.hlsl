@@ -0,0 +1,3 @@
+#define WEIGHT_TABLE
+
+#include "Convolution.hlsli"
@@ -0,0 +1,220 @@
+// Replays a handle create/lookup/destroy sequence against Common/HandleMap, Common/ConcurrentHandleMap and the
+// standard maps they replaced. ConcurrentHandleMap is also replayed with reader threads looking up random handles
+// while the trace runs, and each object is overwritten after it is destroyed, so that a lookup returning a destroyed
+// object is reported.
+// Build and run on Linux from this directory:
+//   g++ -std=c++20 -O2 -pthread -Iinclude -I../../DDrawCompat HandleMapBenchmark.cpp
+//   ./a.out [trace.txt]
+// A trace file has one operation per line: "c <handle>" (create), "f <handle>" (find) or "d <handle>" (destroy),
+// with handles in hex. Without a trace file, a sequence modeled on a DirectDraw game is generated: 2000 resources
+// created at startup, then 1000 frames of 400 lookups each (80% to 32 hot resources such as render targets and
+// vertex buffers) with 2 resources destroyed and recreated per frame.
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <random>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <Common/ConcurrentHandleMap.h>
+#include <Common/HandleMap.h>
+
+namespace
+{
+	struct Op
+	{
+		char type;
+		HANDLE handle;
+	};
+
+	std::vector<Op> generateTrace()
+	{
+		std::mt19937 rng(42);
+		std::vector<HANDLE> handles;
+		UINT_PTR nextAddress = 0x0A000000;
+		auto createHandle = [&]()
+			{
+				nextAddress += 0x40 + (rng() % 64) * 0x10;
+				return reinterpret_cast<HANDLE>(nextAddress);
+			};
+
+		std::vector<Op> trace;
+		for (unsigned i = 0; i < 2000; ++i)
+		{
+			handles.push_back(createHandle());
+			trace.push_back({ 'c', handles.back() });
+		}
+
+		for (unsigned frame = 0; frame < 1000; ++frame)
+		{
+			for (unsigned i = 0; i < 400; ++i)
+			{
+				const std::size_t index = rng() % 5 < 4 ? rng() % 32 : rng() % handles.size();
+				trace.push_back({ 'f', handles[index] });
+			}
+
+			for (unsigned i = 0; i < 2; ++i)
+			{
+				const std::size_t index = 32 + rng() % (handles.size() - 32);
+				trace.push_back({ 'd', handles[index] });
+				handles[index] = createHandle();
+				trace.push_back({ 'c', handles[index] });
+			}
+		}
+		return trace;
+	}
+
+	std::vector<Op> loadTrace(const char* path)
+	{
+		std::vector<Op> trace;
+		std::ifstream f(path);
+		char type = 0;
+		UINT_PTR handle = 0;
+		while (f >> type >> std::hex >> handle)
+		{
+			trace.push_back({ type, reinterpret_cast<HANDLE>(handle) });
+		}
+		return trace;
+	}
+
+	template <typename Map>
+	void replay(const char* name, const std::vector<Op>& trace)
+	{
+		double best = 0;
+		std::size_t checksum = 0;
+		for (unsigned run = 0; run < 5; ++run)
+		{
+			Map map;
+			checksum = 0;
+			const auto start = std::chrono::steady_clock::now();
+			for (const auto& op : trace)
+			{
+				switch (op.type)
+				{
+				case 'c':
+					map.emplace(op.handle, std::make_unique<std::size_t>(reinterpret_cast<UINT_PTR>(op.handle)));
+					break;
+				case 'f':
+				{
+					auto it = map.find(op.handle);
+					if (it != map.end())
+					{
+						checksum += *it->second;
+					}
+					break;
+				}
+				case 'd':
+					map.erase(op.handle);
+					break;
+				}
+			}
+			const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+			if (0 == run || elapsed.count() < best)
+			{
+				best = elapsed.count();
+			}
+		}
+		std::printf("%-20s %7.2f ns/op (checksum %zu)\n", name, best / trace.size(), checksum);
+	}
+
+	bool replayConcurrent(const char* name, const std::vector<Op>& trace, unsigned readerCount)
+	{
+		const std::size_t DESTROYED = 0;
+		ConcurrentHandleMap<HANDLE, std::size_t> map;
+		HandleMap<HANDLE, std::unique_ptr<std::size_t>> objects;
+		std::atomic<bool> isDone = false;
+		std::atomic<std::size_t> lookupCount = 0;
+		std::atomic<std::size_t> errorCount = 0;
+
+		std::vector<std::thread> readers;
+		for (unsigned i = 0; i < readerCount; ++i)
+		{
+			readers.emplace_back([&, i]()
+				{
+					std::mt19937 rng(i);
+					std::size_t count = 0;
+					while (!isDone)
+					{
+						const auto& op = trace[rng() % trace.size()];
+						auto object = map.find(op.handle);
+						if (object && DESTROYED == *object)
+						{
+							++errorCount;
+						}
+						++count;
+					}
+					lookupCount += count;
+				});
+		}
+
+		std::size_t checksum = 0;
+		const auto start = std::chrono::steady_clock::now();
+		for (const auto& op : trace)
+		{
+			switch (op.type)
+			{
+			case 'c':
+			{
+				auto& object = objects[op.handle];
+				object = std::make_unique<std::size_t>(reinterpret_cast<UINT_PTR>(op.handle));
+				map.insert(op.handle, object.get());
+				break;
+			}
+			case 'f':
+			{
+				auto object = map.find(op.handle);
+				if (object)
+				{
+					checksum += *object;
+				}
+				break;
+			}
+			case 'd':
+			{
+				auto it = objects.find(op.handle);
+				if (it != objects.end())
+				{
+					map.erase(op.handle);
+					map.synchronize();
+					*it->second = DESTROYED;
+					objects.erase(it);
+				}
+				break;
+			}
+			}
+		}
+		const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+
+		isDone = true;
+		for (auto& reader : readers)
+		{
+			reader.join();
+		}
+
+		std::printf("%-20s %7.2f ns/op (checksum %zu), %u readers: %zu lookups, %zu destroyed objects found\n",
+			name, elapsed.count() / trace.size(), checksum, readerCount, lookupCount.load(), errorCount.load());
+		return 0 == errorCount;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	const auto trace = argc > 1 ? loadTrace(argv[1]) : generateTrace();
+	if (trace.empty())
+	{
+		std::printf("Failed to load %s\n", argv[1]);
+		return 1;
+	}
+	std::printf("%zu operations\n", trace.size());
+
+	replay<HandleMap<HANDLE, std::unique_ptr<std::size_t>>>("HandleMap", trace);
+	replay<std::map<HANDLE, std::unique_ptr<std::size_t>>>("std::map", trace);
+	replay<std::unordered_map<HANDLE, std::unique_ptr<std::size_t>>>("std::unordered_map", trace);
+	replayConcurrent("ConcurrentHandleMap", trace, 0);
+	return replayConcurrent("ConcurrentHandleMap", trace, 3) ? 0 : 1;
+}
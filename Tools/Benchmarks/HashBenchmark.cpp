@@ -0,0 +1,115 @@
+// Compares Common/Hash against the MD5 path it replaced, and checks it against the SMHasher verification value.
+// Build and run on Linux from this directory:
+//   g++ -std=c++20 -O2 -Iinclude -I../../DDrawCompat HashBenchmark.cpp ../../DDrawCompat/Common/Hash.cpp -lcrypto
+//   ./a.out
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include <openssl/evp.h>
+
+#include <Common/Hash.h>
+
+namespace
+{
+	const UINT VERIFICATION_VALUE = 0xB3ECE62A;
+
+	template <typename Func>
+	double measure(std::size_t size, Func func)
+	{
+		std::size_t iterations = 1;
+		while (true)
+		{
+			const auto start = std::chrono::steady_clock::now();
+			for (std::size_t i = 0; i < iterations; ++i)
+			{
+				func();
+			}
+			const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+			if (elapsed.count() >= 0.5)
+			{
+				return size * iterations / elapsed.count() / (1024 * 1024);
+			}
+			iterations *= 2;
+		}
+	}
+
+	Hash::Digest md5(const void* data, std::size_t size)
+	{
+		// Like the old BCrypt path, the algorithm is looked up for every hash
+		Hash::Digest digest = {};
+		EVP_MD* md = EVP_MD_fetch(nullptr, "MD5", nullptr);
+		EVP_MD_CTX* ctx = EVP_MD_CTX_new();
+		EVP_DigestInit_ex(ctx, md, nullptr);
+		EVP_DigestUpdate(ctx, data, size);
+		EVP_DigestFinal_ex(ctx, digest.data(), nullptr);
+		EVP_MD_CTX_free(ctx);
+		EVP_MD_free(md);
+		return digest;
+	}
+
+	bool verify()
+	{
+		// SMHasher VerificationTest: hash keys {}, {0}, {0, 1}, ... with seed 256 - length,
+		// then hash the concatenated digests with seed 0
+		BYTE key[256] = {};
+		std::vector<BYTE> digests;
+		for (UINT i = 0; i < 256; ++i)
+		{
+			key[i] = static_cast<BYTE>(i);
+			Hash::Hasher hasher(256 - i);
+			hasher.update(key, i);
+			const auto digest = hasher.digest();
+			digests.insert(digests.end(), digest.begin(), digest.end());
+		}
+
+		const auto digest = Hash::hash128(digests.data(), digests.size());
+		UINT result = 0;
+		memcpy(&result, digest.data(), sizeof(result));
+		std::printf("Verification value: %08X (expected %08X)\n", result, VERIFICATION_VALUE);
+		if (VERIFICATION_VALUE != result)
+		{
+			return false;
+		}
+
+		for (std::size_t split = 0; split <= 255; ++split)
+		{
+			Hash::Hasher hasher;
+			hasher.update(key, split);
+			hasher.update(key + split, sizeof(key) - split);
+			if (hasher.digest() != Hash::hash128(key, sizeof(key)))
+			{
+				std::printf("Streaming mismatch at split %zu\n", split);
+				return false;
+			}
+		}
+		return true;
+	}
+}
+
+int main()
+{
+	if (!verify())
+	{
+		std::printf("FAILED\n");
+		return 1;
+	}
+
+	std::printf("%10s %14s %14s\n", "Size", "MD5 MB/s", "Hash MB/s");
+	for (std::size_t size : { 64, 1024, 16 * 1024, 256 * 1024, 4 * 1024 * 1024 })
+	{
+		std::vector<BYTE> data(size);
+		for (std::size_t i = 0; i < size; ++i)
+		{
+			data[i] = static_cast<BYTE>(i * 131 + (i >> 8));
+		}
+
+		volatile BYTE sink = 0;
+		const double md5Speed = measure(size, [&]() { sink = sink + md5(data.data(), size)[0]; });
+		const double hashSpeed = measure(size, [&]() { sink = sink + Hash::hash128(data.data(), size)[0]; });
+		std::printf("%10zu %14.1f %14.1f\n", size, md5Speed, hashSpeed);
+	}
+	return 0;
+}
@@ -0,0 +1,175 @@
+// Measures the CGP shader postprocessor (D3dDdi/ShaderPostprocessor), which runs on every preset load
+// between D3DPreprocess and D3DCompile.
+// Build and run on Linux from this directory:
+//   g++ -std=c++20 -O2 -Iinclude -I../../DDrawCompat ShaderPostprocessorBenchmark.cpp ../../DDrawCompat/D3dDdi/ShaderPostprocessor.cpp
+//   ./a.out [preprocessed.cg...]
+// Without arguments, generated shaders in the style of the libretro Cg presets are measured.
+// Real presets can be passed as preprocessed files, e.g. the "Preprocessed content" section of a DDrawCompat debug log
+// (the "line N: " prefixes are removed on load), or the output of "cpp -P" run on a .cg file.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <regex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <D3dDdi/ShaderPostprocessor.h>
+
+namespace
+{
+	std::string generateShader(unsigned helperCount)
+	{
+		std::ostringstream os;
+		os << R"(#pragma parameter SHARPNESS "Sharpness" 2.0 1.0 5.0 1.0
+#pragma parameter SCANLINE_WEIGHT "Scanline weight" 0.3 0.0 1.0 0.05
+
+struct input
+{
+	float2 video_size;
+	float2 texture_size;
+	float2 output_size;
+	float frame_count;
+	float frame_direction;
+	float frame_rotation;
+};
+
+struct prev
+{
+	float2 tex_coord;
+	sampler2D texture;
+};
+
+struct out_vertex
+{
+	float4 position : POSITION;
+	float4 color : COLOR;
+	float2 texCoord : TEXCOORD0;
+	float2 one;
+	float mod_factor;
+	float2 ratio_scale;
+};
+
+const float PI = 3.141592653589;
+float weights[4] = { 0.1, 0.2, 0.3, 0.4 };
+
+)";
+
+		for (unsigned i = 0; i < helperCount; ++i)
+		{
+			os << "float4 helper" << i << "(float2 coord, sampler2D s, input IN, prev PREV)\n"
+				<< "{\n"
+				<< "\tfloat2 one = 1.0 / IN.texture_size;\n"
+				<< "\tfloat2 ratio_scale = coord * IN.texture_size - float2(0.5);\n"
+				<< "\tfloat filter = fwidth(ratio_scale.y);\n"
+				<< "\tfloat2 uv_ratio = frac(ratio_scale);\n"
+				<< "\tfloat4 coeffs = PI * float4(1.0 + uv_ratio.x, uv_ratio.x, 1.0 - uv_ratio.x, 2.0 - uv_ratio.x);\n"
+				<< "\tcoeffs = max(abs(coeffs), 1e-5);\n"
+				<< "\tcoeffs = 2.0 * sin(coeffs) * sin(coeffs / 2.0) / (coeffs * coeffs);\n"
+				<< "\tcoeffs /= dot(coeffs, float4(1.0));\n"
+				<< "\tfloat4 col = clamp(mul(coeffs, float4x4(\n"
+				<< "\t\ttex2D(s, coord + float2(-one.x, 0.0)),\n"
+				<< "\t\ttex2D(s, coord),\n"
+				<< "\t\ttex2D(s, coord + float2(one.x, 0.0)),\n"
+				<< "\t\ttex2D(s, coord + float2(2.0 * one.x, 0.0)))), 0.0, 1.0);\n"
+				<< "\tif (0)\n"
+				<< "\t{\n"
+				<< "\t\tcol = tex2D(PREV.texture, PREV.tex_coord);\n"
+				<< "\t}\n"
+				<< "\tfloat3 weight = float3(weights[" << i % 4 << "]) * (filter + uv_ratio.y * IN.frame_count);\n"
+				<< "\treturn float4(col.rgb * weight, 1.0);\n"
+				<< "}\n\n";
+		}
+
+		os << R"(out_vertex main_vertex(float4 position : POSITION, float4 color : COLOR, float2 texCoord : TEXCOORD0,
+	uniform float4x4 modelViewProj, uniform input IN)
+{
+	out_vertex OUT;
+	OUT.position = mul(modelViewProj, position);
+	OUT.color = color;
+	OUT.texCoord = texCoord;
+	OUT.one = 1.0 / IN.texture_size;
+	OUT.mod_factor = texCoord.x * IN.texture_size.x * IN.output_size.x / IN.video_size.x;
+	OUT.ratio_scale = texCoord * IN.texture_size;
+	return OUT;
+}
+
+float4 main_fragment(in out_vertex VAR, uniform sampler2D s0 : TEXUNIT0, uniform input IN, uniform prev PREV) : COLOR
+{
+	float4 col = float4(0.0);
+)";
+		for (unsigned i = 0; i < helperCount; ++i)
+		{
+			os << "\tcol += helper" << i << "(VAR.texCoord, s0, IN, PREV);\n";
+		}
+		os << "\treturn col / " << std::max(helperCount, 1u) << ".0;\n}\n";
+		return os.str();
+	}
+
+	std::string loadShader(const char* path)
+	{
+		std::ifstream f(path);
+		if (f.fail())
+		{
+			return {};
+		}
+		std::ostringstream oss;
+		oss << f.rdbuf();
+		return std::regex_replace(oss.str(), std::regex("^line [0-9]+: ", std::regex::multiline), "");
+	}
+
+	void measure(const std::string& name, const std::string& content)
+	{
+		std::string result;
+		double best = 0;
+		for (unsigned i = 0; i < 5; ++i)
+		{
+			D3dDdi::ShaderPostprocessor postprocessor(content);
+			const auto start = std::chrono::steady_clock::now();
+			try
+			{
+				postprocessor.postprocess();
+			}
+			catch (const std::exception& e)
+			{
+				std::printf("%-24s postprocessing failed: %s\n", name.c_str(), e.what());
+				return;
+			}
+			const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+			if (0 == i || elapsed.count() < best)
+			{
+				best = elapsed.count();
+			}
+			result = postprocessor.getContent();
+		}
+
+		std::printf("%-24s %8zu bytes in, %8zu bytes out, %10.3f ms\n",
+			name.c_str(), content.size(), result.size(), best);
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc > 1)
+	{
+		for (int i = 1; i < argc; ++i)
+		{
+			const auto content = loadShader(argv[i]);
+			if (content.empty())
+			{
+				std::printf("Failed to load %s\n", argv[i]);
+				return 1;
+			}
+			measure(argv[i], content);
+		}
+		return 0;
+	}
+
+	for (unsigned helperCount : { 1, 10, 50, 200 })
+	{
+		measure("generated, " + std::to_string(helperCount) + " helpers", generateShader(helperCount));
+	}
+	return 0;
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+// Minimal stand-in for the Windows SDK header, so that portable DDrawCompat sources can be built on Linux
+
+#include <climits>
+#include <cstdint>
+
+typedef std::uint8_t BYTE;
+typedef std::uint16_t WORD;
+typedef std::uint16_t UINT16;
+typedef std::uint32_t DWORD;
+typedef unsigned int UINT;
+typedef std::int32_t INT;
+typedef float FLOAT;
+typedef std::uint32_t UINT32;
+typedef std::uint64_t UINT64;
+typedef std::uintptr_t UINT_PTR;
+typedef void* HANDLE;
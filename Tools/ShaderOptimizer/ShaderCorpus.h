@@ -0,0 +1,222 @@
+#pragma once
+
+// Pixel shader token streams for ShaderOptimizerTest, each with the assembly listing it encodes.
+// The listings follow the patterns of the fixed function replacement and effect shaders of DirectX 8/9 era games
+// (texture modulation, lightmaps, bump and environment mapping, ps_1_4 dependent reads, fxc output), and each one
+// exercises a specific part of the optimizer: constant folding and propagation, copy propagation, redundant and dead
+// instructions, and the ps_1_x rules for co-issued instructions, cnd, texture instructions, phase and modifiers.
+
+#include <vector>
+
+#include <Windows.h>
+
+struct CorpusShader
+{
+	const char* name;
+	UINT optimizedInstructionCount;
+	std::vector<UINT> tokens;
+};
+
+const CorpusShader g_corpus[] = {
+	// ps_1_1
+	// tex t0
+	// mul r0, t0, v0
+	{ "ps_1_1 modulate", 2, {
+		0xffff0101, 0x00000042, 0xb00f0000, 0x00000005, 0x800f0000, 0xb0e40000, 0x90e40000, 0x0000ffff
+	} },
+
+	// ps_1_1
+	// def c0, 1.0, 1.0, 1.0, 1.0
+	// def c1, 0.5, 0.5, 0.5, 0.5
+	// tex t0
+	// tex t1
+	// mul r1, c0, c1
+	// mul r0, t0, t1
+	// mul_x2 r0, r0, r1
+	{ "ps_1_1 lightmap, constant product", 4, {
+		0xffff0101, 0x00000051, 0xa00f0000, 0x3f800000, 0x3f800000, 0x3f800000, 0x3f800000, 0x00000051,
+		0xa00f0001, 0x3f000000, 0x3f000000, 0x3f000000, 0x3f000000, 0x00000042, 0xb00f0000, 0x00000042,
+		0xb00f0001, 0x00000005, 0x800f0001, 0xa0e40000, 0xa0e40001, 0x00000005, 0x800f0000, 0xb0e40000,
+		0xb0e40001, 0x00000005, 0x810f0000, 0x80e40000, 0x80e40001, 0x0000ffff
+	} },
+
+	// ps_1_1
+	// tex t0
+	// tex t1
+	// mul r1, t1, v1
+	// mov r2, r1
+	// mul r0.rgb, t0, r2
+	// +mul r0.a, t0.a, r2.a
+	// add r0.rgb, r0, r2
+	{ "ps_1_1 co-issue", 7, {
+		0xffff0101, 0x00000042, 0xb00f0000, 0x00000042, 0xb00f0001, 0x00000005, 0x800f0001, 0xb0e40001,
+		0x90e40001, 0x00000001, 0x800f0002, 0x80e40001, 0x00000005, 0x80070000, 0xb0e40000, 0x80e40002,
+		0x40000005, 0x80080000, 0xb0ff0000, 0x80ff0002, 0x00000002, 0x80070000, 0x80e40000, 0x80e40002,
+		0x0000ffff
+	} },
+
+	// ps_1_1
+	// tex t0
+	// mul r1, t0, v0
+	// mov r0, r1
+	// mul r0.rgb, t0, r0
+	// +mov r0.a, r0.b
+	{ "ps_1_1 co-issue reading its pair", 5, {
+		0xffff0101, 0x00000042, 0xb00f0000, 0x00000005, 0x800f0001, 0xb0e40000, 0x90e40000, 0x00000001,
+		0x800f0000, 0x80e40001, 0x00000005, 0x80070000, 0xb0e40000, 0x80e40000, 0x40000001, 0x80080000,
+		0x80aa0000, 0x0000ffff
+	} },
+
+	// ps_1_1
+	// def c0, 0.75, 0.75, 0.75, 0.75
+	// tex t0
+	// add r1, c0, c0
+	// mul r0, t0, r1
+	{ "ps_1_1 out of range constant", 3, {
+		0xffff0101, 0x00000051, 0xa00f0000, 0x3f400000, 0x3f400000, 0x3f400000, 0x3f400000, 0x00000042,
+		0xb00f0000, 0x00000002, 0x800f0001, 0xa0e40000, 0xa0e40000, 0x00000005, 0x800f0000, 0xb0e40000,
+		0x80e40001, 0x0000ffff
+	} },
+
+	// ps_1_1
+	// tex t0
+	// texbem t1, t0
+	// texm3x2pad t2, t0_bx2
+	// texm3x2tex t3, t0_bx2
+	// mov r1, t3
+	// add r0, t1, r1
+	{ "ps_1_1 bump environment map", 6, {
+		0xffff0101, 0x00000042, 0xb00f0000, 0x00000043, 0xb00f0001, 0xb0e40000, 0x00000047, 0xb00f0002,
+		0xb4e40000, 0x00000048, 0xb00f0003, 0xb4e40000, 0x00000001, 0x800f0001, 0xb0e40003, 0x00000002,
+		0x800f0000, 0xb0e40001, 0x80e40001, 0x0000ffff
+	} },
+
+	// ps_1_3
+	// def c0, 0.5, 0.5, 0.5, 0.5
+	// def c1, 0.2, 0.4, 0.6, 0.25
+	// tex t0
+	// tex t1
+	// dp3_sat r1, t0_bx2, v0_bx2
+	// mul r1, r1, t1
+	// add_x2 r0, c1, -c0
+	// add r1, r1, r0
+	// mov r0.a, t0.a
+	// cnd r0, r0.a, r1, 1-t1
+	{ "ps_1_3 cnd with modifiers and shifts", 7, {
+		0xffff0103, 0x00000051, 0xa00f0000, 0x3f000000, 0x3f000000, 0x3f000000, 0x3f000000, 0x00000051,
+		0xa00f0001, 0x3e4ccccd, 0x3ecccccd, 0x3f19999a, 0x3e800000, 0x00000042, 0xb00f0000, 0x00000042,
+		0xb00f0001, 0x00000008, 0x801f0001, 0xb4e40000, 0x94e40000, 0x00000005, 0x800f0001, 0x80e40001,
+		0xb0e40001, 0x00000002, 0x810f0000, 0xa0e40001, 0xa1e40000, 0x00000002, 0x800f0001, 0x80e40001,
+		0x80e40000, 0x00000001, 0x80080000, 0xb0ff0000, 0x00000050, 0x800f0000, 0x80ff0000, 0x80e40001,
+		0xb6e40001, 0x0000ffff
+	} },
+
+	// ps_1_4
+	// def c0, 0.5, 0.5, 0.5, 1.0
+	// def c1, 0.25, 0.25, 0.25, 0.0
+	// texld r0, t0
+	// texcrd r1.rgb, t1
+	// mul r2, c0, c1
+	// add r3.rgb, r1, r2
+	// mul r5, r0, v0
+	// mul r5, r0, v0
+	// phase
+	// texld r4, r3
+	// mul r0.rgb, r5, r4
+	// +mov r0.a, c0.a
+	{ "ps_1_4 dependent read", 7, {
+		0xffff0104, 0x00000051, 0xa00f0000, 0x3f000000, 0x3f000000, 0x3f000000, 0x3f800000, 0x00000051,
+		0xa00f0001, 0x3e800000, 0x3e800000, 0x3e800000, 0x00000000, 0x00000042, 0x800f0000, 0xb0e40000,
+		0x00000040, 0x80070001, 0xb0e40001, 0x00000005, 0x800f0002, 0xa0e40000, 0xa0e40001, 0x00000002,
+		0x80070003, 0x80e40001, 0x80e40002, 0x00000005, 0x800f0005, 0x80e40000, 0x90e40000, 0x00000005,
+		0x800f0005, 0x80e40000, 0x90e40000, 0x0000fffd, 0x00000042, 0x800f0004, 0x80e40003, 0x00000005,
+		0x80070000, 0x80e40005, 0x80e40004, 0x40000001, 0x80080000, 0xa0ff0000, 0x0000ffff
+	} },
+
+	// ps_1_4
+	// texcrd r5.rgb, t0
+	// texld r0, t1
+	// mov r1, r0
+	// texdepth r5
+	// mul r0, r1, v0
+	{ "ps_1_4 texdepth", 4, {
+		0xffff0104, 0x00000040, 0x80070005, 0xb0e40000, 0x00000042, 0x800f0000, 0xb0e40001, 0x00000001,
+		0x800f0001, 0x80e40000, 0x00000057, 0x800f0005, 0x00000005, 0x800f0000, 0x80e40001, 0x90e40000,
+		0x0000ffff
+	} },
+
+	// ps_2_0
+	// def c0, 0.299, 0.587, 0.114, 0
+	// def c1, 1, 0, 0.5, 2
+	// dcl t0.xy
+	// dcl v0
+	// dcl_2d s0
+	// texld r0, t0, s0
+	// mul r0, r0, v0
+	// dp3 r1.x, r0, c0
+	// mul r3.w, c1.z, c1.w
+	// lrp r2.rgb, c1.z, r1.x, r0
+	// mov r2.a, r3.w
+	// mov oC0, r2
+	{ "ps_2_0 grayscale", 6, {
+		0xffff0200, 0x05000051, 0xa00f0000, 0x3e991687, 0x3f1645a2, 0x3de978d5, 0x00000000, 0x05000051,
+		0xa00f0001, 0x3f800000, 0x00000000, 0x3f000000, 0x40000000, 0x0200001f, 0x80000000, 0xb0030000,
+		0x0200001f, 0x80000000, 0x900f0000, 0x0200001f, 0x90000000, 0xa00f0800, 0x03000042, 0x800f0000,
+		0xb0e40000, 0xa0e40800, 0x03000005, 0x800f0000, 0x80e40000, 0x90e40000, 0x03000008, 0x80010001,
+		0x80e40000, 0xa0e40000, 0x03000005, 0x80080003, 0xa0aa0001, 0xa0ff0001, 0x04000012, 0x80070002,
+		0xa0aa0001, 0x80000001, 0x80e40000, 0x02000001, 0x80080002, 0x80ff0003, 0x02000001, 0x800f0800,
+		0x80e40002, 0x0000ffff
+	} },
+
+	// ps_2_0
+	// dcl t0.xy
+	// dcl_2d s0
+	// texld r0, t0, s0
+	// mul r1, r0, c0
+	// mul r1, r0, c0
+	// mov r2, r1
+	// add r2, r2, c1
+	// mov oC0, r2
+	{ "ps_2_0 duplicate expression", 4, {
+		0xffff0200, 0x0200001f, 0x80000000, 0xb0030000, 0x0200001f, 0x90000000, 0xa00f0800, 0x03000042,
+		0x800f0000, 0xb0e40000, 0xa0e40800, 0x03000005, 0x800f0001, 0x80e40000, 0xa0e40000, 0x03000005,
+		0x800f0001, 0x80e40000, 0xa0e40000, 0x02000001, 0x800f0002, 0x80e40001, 0x03000002, 0x800f0002,
+		0x80e40002, 0xa0e40001, 0x02000001, 0x800f0800, 0x80e40002, 0x0000ffff
+	} },
+
+	// ps_2_0
+	// dcl t0
+	// dcl_cube s0
+	// mov r0, t0
+	// m4x4 r1, r0, c0
+	// texld r2, r1, s0
+	// mov r3, c4
+	// mul r2, r2, r3
+	// mov oC0, r2
+	{ "ps_2_0 cube map", 5, {
+		0xffff0200, 0x0200001f, 0x80000000, 0xb00f0000, 0x0200001f, 0x98000000, 0xa00f0800, 0x02000001,
+		0x800f0000, 0xb0e40000, 0x03000014, 0x800f0001, 0x80e40000, 0xa0e40000, 0x03000042, 0x800f0002,
+		0x80e40001, 0xa0e40800, 0x02000001, 0x800f0003, 0xa0e40004, 0x03000005, 0x800f0002, 0x80e40002,
+		0x80e40003, 0x02000001, 0x800f0800, 0x80e40002, 0x0000ffff
+	} },
+
+	// ps_3_0
+	// def c0, 0.5, 2, 0, 1
+	// dcl_texcoord0 v0.xy
+	// dcl_color v1
+	// dcl_2d s0
+	// texld r0, v0, s0
+	// mul r1, r0, v1
+	// mad r2, c0.x, c0.y, c0.z
+	// mul r1.rgb, r1, r2
+	// add r3, -r1_abs, c0.w
+	// mov oC0, r1
+	{ "ps_3_0 modulate", 4, {
+		0xffff0300, 0x05000051, 0xa00f0000, 0x3f000000, 0x40000000, 0x00000000, 0x3f800000, 0x0200001f,
+		0x80000005, 0x90030000, 0x0200001f, 0x8000000a, 0x900f0001, 0x0200001f, 0x90000000, 0xa00f0800,
+		0x03000042, 0x800f0000, 0x90e40000, 0xa0e40800, 0x03000005, 0x800f0001, 0x80e40000, 0x90e40001,
+		0x04000004, 0x800f0002, 0xa0000000, 0xa0550000, 0xa0aa0000, 0x03000005, 0x80070001, 0x80e40001,
+		0x80e40002, 0x03000002, 0x800f0003, 0x8ce40001, 0xa0ff0000, 0x02000001, 0x800f0800, 0x80e40001,
+		0x0000ffff
+	} }
+};
@@ -0,0 +1,697 @@
+#include <algorithm>
+#include <array>
+#include <climits>
+#include <cmath>
+#include <cstring>
+#include <map>
+
+#include <d3d9.h>
+
+#include "ShaderEvaluator.h"
+
+namespace
+{
+	const UINT SAMPLE_COUNT = 16;
+	const UINT VERSION_1_4 = 0x104;
+	const UINT VERSION_2_0 = 0x200;
+
+	typedef std::array<float, 4> Vector;
+
+	struct State
+	{
+		UINT seed;
+		UINT version;
+		std::map<UINT, Vector> registers;
+		bool isKilled;
+	};
+
+	UINT mix(UINT hash, UINT value);
+
+	float dot(const Vector& v1, const Vector& v2, UINT count)
+	{
+		float result = 0;
+		for (UINT i = 0; i < count; ++i)
+		{
+			result += v1[i] * v2[i];
+		}
+		return result;
+	}
+
+	Vector getOpaqueResult(UINT opcode, UINT control, const std::array<Vector, 4>& src, UINT srcCount,
+		UINT skippedSrc = UINT_MAX)
+	{
+		UINT hash = mix(opcode, control);
+		for (UINT i = 0; i < srcCount; ++i)
+		{
+			if (i != skippedSrc)
+			{
+				for (auto c : src[i])
+				{
+					UINT bits = 0;
+					memcpy(&bits, &c, sizeof(bits));
+					hash = mix(hash, bits);
+				}
+			}
+		}
+
+		Vector result = {};
+		for (auto& c : result)
+		{
+			hash = mix(hash, 0x9E3779B9);
+			c = (hash >> 8) / 16777216.0f;
+		}
+		return result;
+	}
+
+	D3DSHADER_PARAM_REGISTER_TYPE getRegisterType(UINT32 token)
+	{
+		return static_cast<D3DSHADER_PARAM_REGISTER_TYPE>(
+			((token & D3DSP_REGTYPE_MASK) >> D3DSP_REGTYPE_SHIFT) |
+			((token & D3DSP_REGTYPE_MASK2) >> D3DSP_REGTYPE_SHIFT2));
+	}
+
+	UINT getRegisterKey(UINT32 token)
+	{
+		return (getRegisterType(token) << 16) | (token & D3DSP_REGNUM_MASK);
+	}
+
+	UINT getSourceCount(UINT opcode)
+	{
+		switch (opcode)
+		{
+		case D3DSIO_ABS:
+		case D3DSIO_DSX:
+		case D3DSIO_DSY:
+		case D3DSIO_EXP:
+		case D3DSIO_FRC:
+		case D3DSIO_LOG:
+		case D3DSIO_MOV:
+		case D3DSIO_NRM:
+		case D3DSIO_RCP:
+		case D3DSIO_RSQ:
+			return 1;
+
+		case D3DSIO_ADD:
+		case D3DSIO_BEM:
+		case D3DSIO_CRS:
+		case D3DSIO_DP3:
+		case D3DSIO_DP4:
+		case D3DSIO_M3x2:
+		case D3DSIO_M3x3:
+		case D3DSIO_M3x4:
+		case D3DSIO_M4x3:
+		case D3DSIO_M4x4:
+		case D3DSIO_MAX:
+		case D3DSIO_MIN:
+		case D3DSIO_MUL:
+		case D3DSIO_POW:
+		case D3DSIO_SGE:
+		case D3DSIO_SLT:
+		case D3DSIO_SUB:
+		case D3DSIO_TEX:
+		case D3DSIO_TEXLDL:
+			return 2;
+
+		case D3DSIO_CMP:
+		case D3DSIO_CND:
+		case D3DSIO_DP2ADD:
+		case D3DSIO_LRP:
+		case D3DSIO_MAD:
+			return 3;
+
+		case D3DSIO_TEXLDD:
+			return 4;
+		}
+		return UINT_MAX;
+	}
+
+	UINT getPs1ParameterCount(UINT opcode, UINT version)
+	{
+		switch (opcode)
+		{
+		case D3DSIO_NOP:
+		case D3DSIO_PHASE:
+			return 0;
+		case D3DSIO_TEX:
+		case D3DSIO_TEXCOORD:
+			return version < VERSION_1_4 ? 1 : 2;
+		case D3DSIO_TEXDEPTH:
+		case D3DSIO_TEXKILL:
+			return 1;
+		case D3DSIO_TEXBEM:
+		case D3DSIO_TEXBEML:
+		case D3DSIO_TEXDP3:
+		case D3DSIO_TEXDP3TEX:
+		case D3DSIO_TEXM3x2DEPTH:
+		case D3DSIO_TEXM3x2PAD:
+		case D3DSIO_TEXM3x2TEX:
+		case D3DSIO_TEXM3x3:
+		case D3DSIO_TEXM3x3PAD:
+		case D3DSIO_TEXM3x3TEX:
+		case D3DSIO_TEXM3x3VSPEC:
+		case D3DSIO_TEXREG2AR:
+		case D3DSIO_TEXREG2GB:
+		case D3DSIO_TEXREG2RGB:
+			return 2;
+		case D3DSIO_TEXM3x3SPEC:
+			return 3;
+		case D3DSIO_DEF:
+			return 5;
+		}
+
+		const UINT srcCount = getSourceCount(opcode);
+		return UINT_MAX == srcCount ? UINT_MAX : 1 + srcCount;
+	}
+
+	std::vector<std::pair<UINT, Vector>> getOutputs(const State& state)
+	{
+		std::vector<std::pair<UINT, Vector>> outputs;
+		for (const auto& reg : state.registers)
+		{
+			const auto regType = reg.first >> 16;
+			if (D3DSPR_COLOROUT == regType || D3DSPR_DEPTHOUT == regType ||
+				(state.version < VERSION_2_0 && D3DSPR_TEMP << 16 == reg.first))
+			{
+				outputs.push_back(reg);
+			}
+		}
+		return outputs;
+	}
+
+	Vector getRandomVector(UINT seed, UINT key)
+	{
+		UINT hash = mix(seed, key);
+		Vector result = {};
+		for (auto& c : result)
+		{
+			hash = mix(hash, 0x9E3779B9);
+			c = (hash >> 8) / 4194304.0f - 2;
+		}
+		return result;
+	}
+
+	bool isEqual(const State& state1, const State& state2)
+	{
+		const auto outputs1 = getOutputs(state1);
+		const auto outputs2 = getOutputs(state2);
+		return state1.isKilled == state2.isKilled &&
+			outputs1.size() == outputs2.size() &&
+			std::equal(outputs1.begin(), outputs1.end(), outputs2.begin(), [](const auto& o1, const auto& o2)
+				{
+					return o1.first == o2.first && 0 == memcmp(o1.second.data(), o2.second.data(), sizeof(o1.second));
+				});
+	}
+
+	UINT mix(UINT hash, UINT value)
+	{
+		hash ^= value;
+		hash *= 0x85EBCA6B;
+		hash ^= hash >> 13;
+		hash *= 0xC2B2AE35;
+		hash ^= hash >> 16;
+		return hash;
+	}
+
+	Vector readRegister(State& state, UINT32 token)
+	{
+		const UINT key = getRegisterKey(token);
+		auto it = state.registers.find(key);
+		if (it == state.registers.end())
+		{
+			const Vector value = D3DSPR_TEMP == getRegisterType(token) ? Vector{} : getRandomVector(state.seed, key);
+			it = state.registers.emplace(key, value).first;
+		}
+		return it->second;
+	}
+
+	bool readSource(State& state, UINT32 token, Vector& value)
+	{
+		if (token & D3DSHADER_ADDRESSMODE_MASK)
+		{
+			return false;
+		}
+
+		const auto reg = readRegister(state, token);
+		const UINT swizzle = (token & D3DVS_SWIZZLE_MASK) >> D3DVS_SWIZZLE_SHIFT;
+		for (UINT i = 0; i < 4; ++i)
+		{
+			value[i] = reg[(swizzle >> (2 * i)) & 3];
+		}
+
+		// The same expressions as in ShaderAssembler's constant folding, so that folded results compare bitwise equal
+		const auto reg2 = value;
+		switch (token & D3DSP_SRCMOD_MASK)
+		{
+		case D3DSPSM_NONE:
+			return true;
+		case D3DSPSM_NEG:
+			std::transform(value.begin(), value.end(), value.begin(), [](float c) { return -c; });
+			return true;
+		case D3DSPSM_BIAS:
+			std::transform(value.begin(), value.end(), value.begin(), [](float c) { return c - 0.5f; });
+			return true;
+		case D3DSPSM_BIASNEG:
+			std::transform(value.begin(), value.end(), value.begin(), [](float c) { return -(c - 0.5f); });
+			return true;
+		case D3DSPSM_SIGN:
+			std::transform(value.begin(), value.end(), value.begin(), [](float c) { return 2 * c - 1; });
+			return true;
+		case D3DSPSM_SIGNNEG:
+			std::transform(value.begin(), value.end(), value.begin(), [](float c) { return -(2 * c - 1); });
+			return true;
+		case D3DSPSM_COMP:
+			std::transform(value.begin(), value.end(), value.begin(), [](float c) { return 1 - c; });
+			return true;
+		case D3DSPSM_X2:
+			std::transform(value.begin(), value.end(), value.begin(), [](float c) { return 2 * c; });
+			return true;
+		case D3DSPSM_X2NEG:
+			std::transform(value.begin(), value.end(), value.begin(), [](float c) { return -2 * c; });
+			return true;
+		case D3DSPSM_DZ:
+			std::transform(value.begin(), value.end(), value.begin(), [&](float c) { return c / reg2[2]; });
+			return true;
+		case D3DSPSM_DW:
+			std::transform(value.begin(), value.end(), value.begin(), [&](float c) { return c / reg2[3]; });
+			return true;
+		case D3DSPSM_ABS:
+			std::transform(value.begin(), value.end(), value.begin(), [](float c) { return std::abs(c); });
+			return true;
+		case D3DSPSM_ABSNEG:
+			std::transform(value.begin(), value.end(), value.begin(), [](float c) { return -std::abs(c); });
+			return true;
+		}
+		return false;
+	}
+
+	void writeDestination(State& state, UINT32 token, const Vector& value)
+	{
+		const UINT shift = (token & D3DSP_DSTSHIFT_MASK) >> D3DSP_DSTSHIFT_SHIFT;
+		const float scale = shift < 8 ? static_cast<float>(1 << shift) : 1.0f / (1 << (16 - shift));
+		auto& reg = state.registers[getRegisterKey(token)];
+		for (UINT i = 0; i < 4; ++i)
+		{
+			if (token & (D3DSP_WRITEMASK_0 << i))
+			{
+				const float c = value[i] * scale;
+				reg[i] = (token & D3DSPDM_SATURATE) ? std::clamp(c, 0.0f, 1.0f) : c;
+			}
+		}
+	}
+
+	bool evaluatePs1TextureInstruction(State& state, State& input, UINT opcode, const UINT* params, UINT length)
+	{
+		const UINT32 dst = params[0];
+		const UINT regNum = dst & D3DSP_REGNUM_MASK;
+		std::array<Vector, 4> src = {};
+		UINT srcCount = 0;
+		for (UINT i = 1; i < length; ++i)
+		{
+			if (!readSource(input, params[i], src[srcCount++]))
+			{
+				return false;
+			}
+		}
+
+		if (D3DSIO_TEXDEPTH == opcode)
+		{
+			const auto value = readRegister(input, dst);
+			state.registers[D3DSPR_DEPTHOUT << 16].fill(value[0] / value[1]);
+			return true;
+		}
+
+		if (state.version >= VERSION_1_4)
+		{
+			switch (opcode)
+			{
+			case D3DSIO_TEX:
+				writeDestination(state, dst, getOpaqueResult(opcode, regNum, src, srcCount));
+				return true;
+			case D3DSIO_TEXCOORD:
+				writeDestination(state, dst, src[0]);
+				return true;
+			}
+			return false;
+		}
+
+		// ps_1_1 - ps_1_3: the destination register holds the texture coordinates of its stage until it's written,
+		// and the matrix instructions also depend on the preceding stages
+		const auto texCoords = readRegister(input, dst);
+		switch (opcode)
+		{
+		case D3DSIO_TEXCOORD:
+		{
+			Vector value = {};
+			std::transform(texCoords.begin(), texCoords.end(), value.begin(),
+				[](float c) { return std::clamp(c, 0.0f, 1.0f); });
+			value[3] = 1;
+			writeDestination(state, dst, value);
+			return true;
+		}
+
+		case D3DSIO_TEX:
+			writeDestination(state, dst, getOpaqueResult(opcode, regNum, { texCoords }, 1));
+			return true;
+		}
+
+		std::array<Vector, 4> prevStages = {};
+		for (UINT i = 0; i < 2 && i < regNum; ++i)
+		{
+			prevStages[i] = readRegister(input, (dst & ~D3DSP_REGNUM_MASK) | (regNum - 1 - i));
+		}
+		src[srcCount++] = texCoords;
+		src[srcCount++] = getOpaqueResult(opcode, regNum, prevStages, 2);
+		const auto result = getOpaqueResult(opcode, regNum, src, srcCount);
+		if (D3DSIO_TEXM3x2DEPTH == opcode)
+		{
+			state.registers[D3DSPR_DEPTHOUT << 16].fill(result[0]);
+		}
+		else
+		{
+			writeDestination(state, dst, result);
+		}
+		return true;
+	}
+
+	bool isPs1TextureInstruction(UINT opcode)
+	{
+		return opcode >= D3DSIO_TEXCOORD && opcode <= D3DSIO_TEXDEPTH && D3DSIO_TEXKILL != opcode &&
+			D3DSIO_EXPP != opcode && D3DSIO_LOGP != opcode && D3DSIO_CND != opcode && D3DSIO_DEF != opcode;
+	}
+
+	bool evaluateInstruction(State& state, State& input, UINT opcode, UINT control, const UINT* params, UINT length)
+	{
+		if (state.version < VERSION_2_0 && isPs1TextureInstruction(opcode))
+		{
+			return evaluatePs1TextureInstruction(state, input, opcode, params, length);
+		}
+
+		switch (opcode)
+		{
+		case D3DSIO_DCL:
+		case D3DSIO_NOP:
+		case D3DSIO_PHASE:
+			return true;
+
+		case D3DSIO_DEF:
+		case D3DSIO_DEFB:
+		case D3DSIO_DEFI:
+		{
+			if ((D3DSIO_DEFB == opcode ? 2 : 5) != length)
+			{
+				return false;
+			}
+			Vector value = {};
+			memcpy(value.data(), params + 1, (length - 1) * sizeof(UINT));
+			state.registers[getRegisterKey(params[0])] = value;
+			return true;
+		}
+
+		case D3DSIO_TEXKILL:
+		{
+			if (1 != length)
+			{
+				return false;
+			}
+			const auto value = readRegister(input, params[0]);
+			for (UINT i = 0; i < 4; ++i)
+			{
+				if ((params[0] & (D3DSP_WRITEMASK_0 << i)) && value[i] < 0)
+				{
+					state.isKilled = true;
+				}
+			}
+			return true;
+		}
+		}
+
+		UINT srcCount = getSourceCount(opcode);
+		if (D3DSIO_SINCOS == opcode && (2 == length || 4 == length))
+		{
+			srcCount = length - 1;
+		}
+		if (UINT_MAX == srcCount || 1 + srcCount != length)
+		{
+			return false;
+		}
+
+		std::array<Vector, 4> src = {};
+		for (UINT i = 0; i < srcCount; ++i)
+		{
+			if (!readSource(input, params[1 + i], src[i]))
+			{
+				return false;
+			}
+		}
+
+		auto forEach = [](auto func)
+			{
+				Vector result = {};
+				for (UINT i = 0; i < 4; ++i)
+				{
+					result[i] = func(i);
+				}
+				return result;
+			};
+		auto replicate = [](float value) { return Vector{ value, value, value, value }; };
+
+		Vector dst = {};
+		switch (opcode)
+		{
+		case D3DSIO_ABS:
+			dst = forEach([&](UINT i) { return std::abs(src[0][i]); });
+			break;
+		case D3DSIO_ADD:
+			dst = forEach([&](UINT i) { return src[0][i] + src[1][i]; });
+			break;
+		case D3DSIO_BEM:
+			dst = getOpaqueResult(opcode, control, src, srcCount);
+			break;
+		case D3DSIO_CMP:
+			dst = forEach([&](UINT i) { return src[0][i] >= 0 ? src[1][i] : src[2][i]; });
+			break;
+		case D3DSIO_CND:
+			dst = forEach([&](UINT i) { return src[0][i] > 0.5f ? src[1][i] : src[2][i]; });
+			break;
+		case D3DSIO_CRS:
+			dst = {
+				src[0][1] * src[1][2] - src[0][2] * src[1][1],
+				src[0][2] * src[1][0] - src[0][0] * src[1][2],
+				src[0][0] * src[1][1] - src[0][1] * src[1][0],
+				0
+			};
+			break;
+		case D3DSIO_DP2ADD:
+			dst = replicate(src[0][0] * src[1][0] + src[0][1] * src[1][1] + src[2][3]);
+			break;
+		case D3DSIO_DP3:
+			dst = replicate(dot(src[0], src[1], 3));
+			break;
+		case D3DSIO_DP4:
+			dst = replicate(dot(src[0], src[1], 4));
+			break;
+		case D3DSIO_DSX:
+		case D3DSIO_DSY:
+			dst = getOpaqueResult(opcode, control, src, srcCount);
+			break;
+		case D3DSIO_EXP:
+			dst = replicate(std::exp2(src[0][3]));
+			break;
+		case D3DSIO_FRC:
+			dst = forEach([&](UINT i) { return src[0][i] - std::floor(src[0][i]); });
+			break;
+		case D3DSIO_LOG:
+			dst = replicate(std::log2(std::abs(src[0][3])));
+			break;
+		case D3DSIO_LRP:
+			dst = forEach([&](UINT i) { return src[0][i] * (src[1][i] - src[2][i]) + src[2][i]; });
+			break;
+		case D3DSIO_M3x2:
+		case D3DSIO_M3x3:
+		case D3DSIO_M3x4:
+		case D3DSIO_M4x3:
+		case D3DSIO_M4x4:
+		{
+			const UINT dotCount = D3DSIO_M4x3 == opcode || D3DSIO_M4x4 == opcode ? 4 : 3;
+			const UINT rowCount = D3DSIO_M3x2 == opcode ? 2 : (D3DSIO_M3x4 == opcode || D3DSIO_M4x4 == opcode ? 4 : 3);
+			for (UINT i = 0; i < rowCount; ++i)
+			{
+				Vector row = {};
+				if (!readSource(input, (params[2] & ~D3DSP_REGNUM_MASK) | ((params[2] & D3DSP_REGNUM_MASK) + i), row))
+				{
+					return false;
+				}
+				dst[i] = dot(src[0], row, dotCount);
+			}
+			break;
+		}
+		case D3DSIO_MAD:
+			dst = forEach([&](UINT i) { return src[0][i] * src[1][i] + src[2][i]; });
+			break;
+		case D3DSIO_MAX:
+			dst = forEach([&](UINT i) { return std::max(src[0][i], src[1][i]); });
+			break;
+		case D3DSIO_MIN:
+			dst = forEach([&](UINT i) { return std::min(src[0][i], src[1][i]); });
+			break;
+		case D3DSIO_MOV:
+			dst = src[0];
+			break;
+		case D3DSIO_MUL:
+			dst = forEach([&](UINT i) { return src[0][i] * src[1][i]; });
+			break;
+		case D3DSIO_NRM:
+		{
+			const float rcpLength = 1 / std::sqrt(dot(src[0], src[0], 3));
+			dst = forEach([&](UINT i) { return src[0][i] * rcpLength; });
+			break;
+		}
+		case D3DSIO_POW:
+			dst = replicate(std::pow(std::abs(src[0][3]), src[1][3]));
+			break;
+		case D3DSIO_RCP:
+			dst = replicate(1 / src[0][3]);
+			break;
+		case D3DSIO_RSQ:
+			dst = replicate(1 / std::sqrt(std::abs(src[0][3])));
+			break;
+		case D3DSIO_SGE:
+			dst = forEach([&](UINT i) { return src[0][i] >= src[1][i] ? 1.0f : 0.0f; });
+			break;
+		case D3DSIO_SINCOS:
+			dst = { std::cos(src[0][3]), std::sin(src[0][3]), 0, 0 };
+			break;
+		case D3DSIO_SLT:
+			dst = forEach([&](UINT i) { return src[0][i] < src[1][i] ? 1.0f : 0.0f; });
+			break;
+		case D3DSIO_SUB:
+			dst = forEach([&](UINT i) { return src[0][i] - src[1][i]; });
+			break;
+		case D3DSIO_TEX:
+		case D3DSIO_TEXLDD:
+		case D3DSIO_TEXLDL:
+			dst = getOpaqueResult(opcode, control | ((params[2] & D3DSP_REGNUM_MASK) << 8), src, srcCount, 1);
+			break;
+		default:
+			return false;
+		}
+
+		writeDestination(state, params[0], dst);
+		return true;
+	}
+
+	bool evaluate(const std::vector<UINT>& tokens, State& state)
+	{
+		if (tokens.empty() || tokens[0] < D3DPS_VERSION(1, 1) || tokens[0] > D3DPS_VERSION(3, 0))
+		{
+			return false;
+		}
+
+		state.version = tokens[0] & 0xFFFF;
+		State input = state;
+		UINT pos = 1;
+		while (pos < tokens.size())
+		{
+			const UINT token = tokens[pos];
+			const UINT opcode = token & D3DSI_OPCODE_MASK;
+			if (D3DSIO_END == opcode)
+			{
+				return true;
+			}
+
+			if (D3DSIO_COMMENT == opcode)
+			{
+				pos += 1 + ((token & D3DSI_COMMENTSIZE_MASK) >> D3DSI_COMMENTSIZE_SHIFT);
+				continue;
+			}
+
+			const UINT length = state.version < VERSION_2_0
+				? getPs1ParameterCount(opcode, state.version)
+				: (token & D3DSI_INSTLENGTH_MASK) >> D3DSI_INSTLENGTH_SHIFT;
+			const UINT control = (token & D3DSP_OPCODESPECIFICCONTROL_MASK) >> D3DSP_OPCODESPECIFICCONTROL_SHIFT;
+			if (UINT_MAX == length || (0 == length && state.version >= VERSION_2_0) || pos + length >= tokens.size() ||
+				(token & D3DSHADER_INSTRUCTION_PREDICATED))
+			{
+				return false;
+			}
+
+			// A co-issued instruction reads the registers as they were before the instruction it's paired with
+			const bool isCoIssued = state.version < VERSION_2_0 && (token & D3DSI_COISSUE);
+			if (!isCoIssued)
+			{
+				input = state;
+			}
+
+			if (!evaluateInstruction(state, isCoIssued ? input : state, opcode, control, &tokens[pos + 1], length))
+			{
+				return false;
+			}
+			pos += 1 + length;
+		}
+		return false;
+	}
+}
+
+namespace ShaderEvaluator
+{
+	UINT countInstructions(const std::vector<UINT>& tokens)
+	{
+		if (tokens.empty())
+		{
+			return 0;
+		}
+
+		const UINT version = tokens[0] & 0xFFFF;
+		UINT count = 0;
+		UINT pos = 1;
+		while (pos < tokens.size())
+		{
+			const UINT token = tokens[pos];
+			const UINT opcode = token & D3DSI_OPCODE_MASK;
+			if (D3DSIO_END == opcode)
+			{
+				break;
+			}
+
+			if (D3DSIO_COMMENT == opcode)
+			{
+				pos += 1 + ((token & D3DSI_COMMENTSIZE_MASK) >> D3DSI_COMMENTSIZE_SHIFT);
+				continue;
+			}
+
+			const UINT length = version < VERSION_2_0
+				? getPs1ParameterCount(opcode, version)
+				: (token & D3DSI_INSTLENGTH_MASK) >> D3DSI_INSTLENGTH_SHIFT;
+			if (UINT_MAX == length)
+			{
+				return 0;
+			}
+
+			if (D3DSIO_DCL != opcode && D3DSIO_DEF != opcode && D3DSIO_DEFB != opcode && D3DSIO_DEFI != opcode &&
+				D3DSIO_NOP != opcode && D3DSIO_PHASE != opcode)
+			{
+				++count;
+			}
+			pos += 1 + length;
+		}
+		return count;
+	}
+
+	Result compare(const std::vector<UINT>& tokens1, const std::vector<UINT>& tokens2)
+	{
+		for (UINT seed = 0; seed < SAMPLE_COUNT; ++seed)
+		{
+			State state1 = { seed, 0, {}, false };
+			State state2 = { seed, 0, {}, false };
+			if (!evaluate(tokens1, state1) || !evaluate(tokens2, state2))
+			{
+				return Result::UNSUPPORTED;
+			}
+			if (!isEqual(state1, state2))
+			{
+				return Result::DIFFERENT;
+			}
+		}
+		return Result::EQUAL;
+	}
+}
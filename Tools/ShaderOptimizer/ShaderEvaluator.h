@@ -0,0 +1,18 @@
+#pragma once
+
+#include <vector>
+
+#include <Windows.h>
+
+namespace ShaderEvaluator
+{
+	enum class Result
+	{
+		EQUAL,
+		DIFFERENT,
+		UNSUPPORTED
+	};
+
+	Result compare(const std::vector<UINT>& tokens1, const std::vector<UINT>& tokens2);
+	UINT countInstructions(const std::vector<UINT>& tokens);
+}
@@ -0,0 +1,129 @@
+// Runs the pixel shader optimizer (D3dDdi::ShaderAssembler::optimize, enabled by the ShaderOptimizer setting) on a
+// corpus of ps_1_1 - ps_3_0 token streams, and checks each result against its original with a reference evaluator
+// that runs both on the same random inputs and compares the outputs bitwise.
+// Build and run on Linux from this directory:
+//   g++ -std=c++20 -O2 -fno-strict-aliasing -Iinclude -I../Benchmarks/include -I../../DDrawCompat ShaderOptimizerTest.cpp ShaderEvaluator.cpp ../../DDrawCompat/D3dDdi/ShaderAssembler.cpp
+//   ./a.out [-v] [shader.pso...]
+// Shader files contain raw token streams, such as the output of "fxc /T ps_2_0 /Fo shader.pso shader.hlsl", or the
+// "Pixel shader bytecode" of a DDrawCompat debug log converted to binary. Without shader files, ShaderCorpus.h is used.
+// -v prints the original and optimized disassembly (ps_1_x and ps_2_0 only).
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include <Common/Log.h>
+#include <D3dDdi/ShaderAssembler.h>
+
+#include "ShaderCorpus.h"
+#include "ShaderEvaluator.h"
+
+namespace
+{
+	bool g_isVerbose = false;
+
+	std::vector<UINT> loadShader(const char* path)
+	{
+		std::ifstream f(path, std::ios::binary);
+		std::vector<char> bytes((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+		std::vector<UINT> tokens(bytes.size() / 4);
+		std::memcpy(tokens.data(), bytes.data(), tokens.size() * 4);
+		return tokens;
+	}
+
+	bool test(const std::string& name, const std::vector<UINT>& tokens, UINT expectedInstructionCount)
+	{
+		D3dDdi::ShaderAssembler shaderAssembler(tokens.data(), tokens.size());
+		const bool isOptimized = shaderAssembler.optimize();
+		const auto& optimizedTokens = shaderAssembler.getTokens();
+		const UINT origCount = ShaderEvaluator::countInstructions(tokens);
+		const UINT optimizedCount = ShaderEvaluator::countInstructions(optimizedTokens);
+
+		const char* result = "equal";
+		bool isPassed = true;
+		if (isOptimized)
+		{
+			switch (ShaderEvaluator::compare(tokens, optimizedTokens))
+			{
+			case ShaderEvaluator::Result::EQUAL:
+				break;
+			case ShaderEvaluator::Result::DIFFERENT:
+				result = "DIFFERENT";
+				isPassed = false;
+				break;
+			default:
+				result = "unsupported by the evaluator";
+				isPassed = false;
+				break;
+			}
+		}
+		else if (optimizedTokens != tokens)
+		{
+			result = "MODIFIED WITHOUT OPTIMIZATION";
+			isPassed = false;
+		}
+
+		if (0 != expectedInstructionCount && optimizedCount != expectedInstructionCount)
+		{
+			result = "UNEXPECTED INSTRUCTION COUNT";
+			isPassed = false;
+		}
+
+		std::printf("%-40s %3u -> %3u instructions, %4zu -> %4zu tokens: %s\n", name.c_str(),
+			origCount, optimizedCount, tokens.size(), optimizedTokens.size(), result);
+
+		if (g_isVerbose || !isPassed)
+		{
+			std::printf("%s\n", D3dDdi::ShaderAssembler(tokens.data(), tokens.size()).disassemble().c_str());
+			if (isOptimized)
+			{
+				std::printf("%s\n", D3dDdi::ShaderAssembler(optimizedTokens.data(), optimizedTokens.size()).disassemble().c_str());
+			}
+		}
+		return isPassed;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	Compat::Log::setLogLevel(Config::Settings::LogLevel::DEBUG);
+
+	int argIndex = 1;
+	if (argIndex < argc && 0 == std::strcmp(argv[argIndex], "-v"))
+	{
+		g_isVerbose = true;
+		++argIndex;
+	}
+
+	UINT failedCount = 0;
+	if (argIndex < argc)
+	{
+		for (; argIndex < argc; ++argIndex)
+		{
+			const auto tokens = loadShader(argv[argIndex]);
+			if (tokens.empty())
+			{
+				std::printf("Failed to load %s\n", argv[argIndex]);
+				return 1;
+			}
+			failedCount += test(argv[argIndex], tokens, 0) ? 0 : 1;
+		}
+	}
+	else
+	{
+		for (const auto& shader : g_corpus)
+		{
+			failedCount += test(shader.name, shader.tokens, shader.optimizedInstructionCount) ? 0 : 1;
+		}
+	}
+
+	if (0 != failedCount)
+	{
+		std::printf("%u shaders failed\n", failedCount);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+// Minimal stand-in for DDrawCompat's logging, so that ShaderAssembler can be built on Linux.
+// Log output is discarded, but the log level is settable, because ShaderAssembler::disassemble checks it.
+
+namespace Config
+{
+	namespace Settings
+	{
+		class LogLevel
+		{
+		public:
+			enum Values { NONE, INFO, DEBUG, TRACE };
+		};
+	}
+}
+
+#define LOG_INFO Compat::Log(Config::Settings::LogLevel::INFO)
+#define LOG_DEBUG Compat::Log(Config::Settings::LogLevel::DEBUG)
+#define LOG_FUNC(...) Compat::LogFunc logFunc(__VA_ARGS__)
+#define LOG_RESULT(...) logFunc.setResult(__VA_ARGS__)
+#define LOG_ONCE(msg)
+
+namespace Compat
+{
+	class Log
+	{
+	public:
+		Log(unsigned /*logLevel*/) {}
+
+		template <typename T>
+		Log& operator<<(const T& /*value*/) { return *this; }
+
+		static unsigned getLogLevel() { return s_logLevel; }
+		static void setLogLevel(unsigned logLevel) { s_logLevel = logLevel; }
+
+	private:
+		static inline unsigned s_logLevel = Config::Settings::LogLevel::NONE;
+	};
+
+	class LogFunc
+	{
+	public:
+		template <typename... Params>
+		LogFunc(const char* /*funcName*/, const Params&... /*params*/) {}
+
+		template <typename T>
+		T setResult(T result) { return result; }
+	};
+
+	template <typename Elem>
+	int array(const Elem* /*elem*/, unsigned long /*size*/) { return 0; }
+
+	template <typename T>
+	int hex(T /*value*/) { return 0; }
+
+	inline int hexDump(const void* /*buf*/, unsigned long /*size*/) { return 0; }
+}
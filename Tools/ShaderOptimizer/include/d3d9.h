@@ -0,0 +1,236 @@
+#pragma once
+
+// Minimal stand-in for the Direct3D 9 SDK header: the shader bytecode definitions from d3d9types.h
+
+#include <Windows.h>
+
+#define D3DPS_VERSION(major, minor) (0xFFFF0000 | ((major) << 8) | (minor))
+#define D3DVS_VERSION(major, minor) (0xFFFE0000 | ((major) << 8) | (minor))
+
+enum D3DDECLUSAGE
+{
+	D3DDECLUSAGE_POSITION = 0,
+	D3DDECLUSAGE_BLENDWEIGHT,
+	D3DDECLUSAGE_BLENDINDICES,
+	D3DDECLUSAGE_NORMAL,
+	D3DDECLUSAGE_PSIZE,
+	D3DDECLUSAGE_TEXCOORD,
+	D3DDECLUSAGE_TANGENT,
+	D3DDECLUSAGE_BINORMAL,
+	D3DDECLUSAGE_TESSFACTOR,
+	D3DDECLUSAGE_POSITIONT,
+	D3DDECLUSAGE_COLOR,
+	D3DDECLUSAGE_FOG,
+	D3DDECLUSAGE_DEPTH,
+	D3DDECLUSAGE_SAMPLE
+};
+
+enum D3DSHADER_INSTRUCTION_OPCODE_TYPE
+{
+	D3DSIO_NOP = 0,
+	D3DSIO_MOV,
+	D3DSIO_ADD,
+	D3DSIO_SUB,
+	D3DSIO_MAD,
+	D3DSIO_MUL,
+	D3DSIO_RCP,
+	D3DSIO_RSQ,
+	D3DSIO_DP3,
+	D3DSIO_DP4,
+	D3DSIO_MIN,
+	D3DSIO_MAX,
+	D3DSIO_SLT,
+	D3DSIO_SGE,
+	D3DSIO_EXP,
+	D3DSIO_LOG,
+	D3DSIO_LIT,
+	D3DSIO_DST,
+	D3DSIO_LRP,
+	D3DSIO_FRC,
+	D3DSIO_M4x4,
+	D3DSIO_M4x3,
+	D3DSIO_M3x4,
+	D3DSIO_M3x3,
+	D3DSIO_M3x2,
+	D3DSIO_CALL,
+	D3DSIO_CALLNZ,
+	D3DSIO_LOOP,
+	D3DSIO_RET,
+	D3DSIO_ENDLOOP,
+	D3DSIO_LABEL,
+	D3DSIO_DCL,
+	D3DSIO_POW,
+	D3DSIO_CRS,
+	D3DSIO_SGN,
+	D3DSIO_ABS,
+	D3DSIO_NRM,
+	D3DSIO_SINCOS,
+	D3DSIO_REP,
+	D3DSIO_ENDREP,
+	D3DSIO_IF,
+	D3DSIO_IFC,
+	D3DSIO_ELSE,
+	D3DSIO_ENDIF,
+	D3DSIO_BREAK,
+	D3DSIO_BREAKC,
+	D3DSIO_MOVA,
+	D3DSIO_DEFB,
+	D3DSIO_DEFI,
+
+	D3DSIO_TEXCOORD = 64,
+	D3DSIO_TEXKILL,
+	D3DSIO_TEX,
+	D3DSIO_TEXBEM,
+	D3DSIO_TEXBEML,
+	D3DSIO_TEXREG2AR,
+	D3DSIO_TEXREG2GB,
+	D3DSIO_TEXM3x2PAD,
+	D3DSIO_TEXM3x2TEX,
+	D3DSIO_TEXM3x3PAD,
+	D3DSIO_TEXM3x3TEX,
+	D3DSIO_RESERVED0,
+	D3DSIO_TEXM3x3SPEC,
+	D3DSIO_TEXM3x3VSPEC,
+	D3DSIO_EXPP,
+	D3DSIO_LOGP,
+	D3DSIO_CND,
+	D3DSIO_DEF,
+	D3DSIO_TEXREG2RGB,
+	D3DSIO_TEXDP3TEX,
+	D3DSIO_TEXM3x2DEPTH,
+	D3DSIO_TEXDP3,
+	D3DSIO_TEXM3x3,
+	D3DSIO_TEXDEPTH,
+	D3DSIO_CMP,
+	D3DSIO_BEM,
+	D3DSIO_DP2ADD,
+	D3DSIO_DSX,
+	D3DSIO_DSY,
+	D3DSIO_TEXLDD,
+	D3DSIO_SETP,
+	D3DSIO_TEXLDL,
+	D3DSIO_BREAKP,
+
+	D3DSIO_PHASE = 0xFFFD,
+	D3DSIO_COMMENT = 0xFFFE,
+	D3DSIO_END = 0xFFFF
+};
+
+enum D3DSHADER_PARAM_REGISTER_TYPE
+{
+	D3DSPR_TEMP = 0,
+	D3DSPR_INPUT = 1,
+	D3DSPR_CONST = 2,
+	D3DSPR_ADDR = 3,
+	D3DSPR_TEXTURE = 3,
+	D3DSPR_RASTOUT = 4,
+	D3DSPR_ATTROUT = 5,
+	D3DSPR_TEXCRDOUT = 6,
+	D3DSPR_OUTPUT = 6,
+	D3DSPR_CONSTINT = 7,
+	D3DSPR_COLOROUT = 8,
+	D3DSPR_DEPTHOUT = 9,
+	D3DSPR_SAMPLER = 10,
+	D3DSPR_CONST2 = 11,
+	D3DSPR_CONST3 = 12,
+	D3DSPR_CONST4 = 13,
+	D3DSPR_CONSTBOOL = 14,
+	D3DSPR_LOOP = 15,
+	D3DSPR_TEMPFLOAT16 = 16,
+	D3DSPR_MISCTYPE = 17,
+	D3DSPR_LABEL = 18,
+	D3DSPR_PREDICATE = 19
+};
+
+enum D3DSHADER_PARAM_SRCMOD_TYPE
+{
+	D3DSPSM_NONE = 0 << 24,
+	D3DSPSM_NEG = 1 << 24,
+	D3DSPSM_BIAS = 2 << 24,
+	D3DSPSM_BIASNEG = 3 << 24,
+	D3DSPSM_SIGN = 4 << 24,
+	D3DSPSM_SIGNNEG = 5 << 24,
+	D3DSPSM_COMP = 6 << 24,
+	D3DSPSM_X2 = 7 << 24,
+	D3DSPSM_X2NEG = 8 << 24,
+	D3DSPSM_DZ = 9 << 24,
+	D3DSPSM_DW = 10 << 24,
+	D3DSPSM_ABS = 11 << 24,
+	D3DSPSM_ABSNEG = 12 << 24,
+	D3DSPSM_NOT = 13 << 24
+};
+
+enum D3DSHADER_MISCTYPE_OFFSETS
+{
+	D3DSMO_POSITION = 0,
+	D3DSMO_FACE = 1
+};
+
+enum D3DVS_RASTOUT_OFFSETS
+{
+	D3DSRO_POSITION = 0,
+	D3DSRO_FOG,
+	D3DSRO_POINT_SIZE
+};
+
+enum D3DSAMPLER_TEXTURE_TYPE
+{
+	D3DSTT_UNKNOWN = 0 << 27,
+	D3DSTT_2D = 2 << 27,
+	D3DSTT_CUBE = 3 << 27,
+	D3DSTT_VOLUME = 4 << 27
+};
+
+const UINT D3DSI_OPCODE_MASK = 0x0000FFFF;
+const UINT D3DSI_INSTLENGTH_MASK = 0x0F000000;
+const UINT D3DSI_INSTLENGTH_SHIFT = 24;
+const UINT D3DSI_COISSUE = 0x40000000;
+const UINT D3DSI_COMMENTSIZE_SHIFT = 16;
+const UINT D3DSI_COMMENTSIZE_MASK = 0x7FFF0000;
+const UINT D3DSHADER_INSTRUCTION_PREDICATED = 0x10000000;
+
+const UINT D3DSP_OPCODESPECIFICCONTROL_MASK = 0x00FF0000;
+const UINT D3DSP_OPCODESPECIFICCONTROL_SHIFT = 16;
+
+const UINT D3DSP_DCL_USAGE_SHIFT = 0;
+const UINT D3DSP_DCL_USAGE_MASK = 0x0000001F;
+const UINT D3DSP_DCL_USAGEINDEX_SHIFT = 16;
+const UINT D3DSP_DCL_USAGEINDEX_MASK = 0x000F0000;
+const UINT D3DSP_TEXTURETYPE_SHIFT = 27;
+const UINT D3DSP_TEXTURETYPE_MASK = 0x78000000;
+
+const UINT D3DSP_REGNUM_MASK = 0x000007FF;
+const UINT D3DSP_WRITEMASK_0 = 0x00010000;
+const UINT D3DSP_WRITEMASK_1 = 0x00020000;
+const UINT D3DSP_WRITEMASK_2 = 0x00040000;
+const UINT D3DSP_WRITEMASK_3 = 0x00080000;
+const UINT D3DSP_WRITEMASK_ALL = 0x000F0000;
+
+const UINT D3DSP_DSTMOD_SHIFT = 20;
+const UINT D3DSP_DSTMOD_MASK = 0x00F00000;
+const UINT D3DSPDM_NONE = 0 << D3DSP_DSTMOD_SHIFT;
+const UINT D3DSPDM_SATURATE = 1 << D3DSP_DSTMOD_SHIFT;
+const UINT D3DSPDM_PARTIALPRECISION = 2 << D3DSP_DSTMOD_SHIFT;
+const UINT D3DSPDM_MSAMPCENTROID = 4 << D3DSP_DSTMOD_SHIFT;
+
+const UINT D3DSP_DSTSHIFT_SHIFT = 24;
+const UINT D3DSP_DSTSHIFT_MASK = 0x0F000000;
+
+const UINT D3DSP_REGTYPE_SHIFT = 28;
+const UINT D3DSP_REGTYPE_SHIFT2 = 8;
+const UINT D3DSP_REGTYPE_MASK = 0x70000000;
+const UINT D3DSP_REGTYPE_MASK2 = 0x00001800;
+
+const UINT D3DSHADER_ADDRESSMODE_SHIFT = 13;
+const UINT D3DSHADER_ADDRESSMODE_MASK = 1 << D3DSHADER_ADDRESSMODE_SHIFT;
+
+const UINT D3DVS_SWIZZLE_SHIFT = 16;
+const UINT D3DVS_SWIZZLE_MASK = 0x00FF0000;
+const UINT D3DSP_NOSWIZZLE = (0 << 16) | (1 << 18) | (2 << 20) | (3 << 22);
+const UINT D3DSP_REPLICATERED = (0 << 16) | (0 << 18) | (0 << 20) | (0 << 22);
+const UINT D3DSP_REPLICATEGREEN = (1 << 16) | (1 << 18) | (1 << 20) | (1 << 22);
+const UINT D3DSP_REPLICATEBLUE = (2 << 16) | (2 << 18) | (2 << 20) | (2 << 22);
+const UINT D3DSP_REPLICATEALPHA = (3 << 16) | (3 << 18) | (3 << 20) | (3 << 22);
+
+const UINT D3DSP_SRCMOD_SHIFT = 24;
+const UINT D3DSP_SRCMOD_MASK = 0x0F000000;